@@ -47,7 +47,9 @@
 #include <string.h>
 
 #include <algorithm>
+#include <vector>
 
+#include "gromacs/domdec/domdec_compressx.h"
 #include "gromacs/domdec/domdec_network.h"
 #include "gromacs/domdec/ga2la.h"
 #include "gromacs/ewald/pme.h"
@@ -381,6 +383,65 @@ void dd_get_constraint_range(const gmx_domdec_t *dd, int *at_start, int *at_end)
     *at_end   = dd->comm->nat[ddnatCON];
 }
 
+/*! \brief Sends \p n_s coordinates backward along DD dimension index \p ddimind and receives \p n_r, compressed */
+static void dd_sendrecv_compressed_x(gmx_domdec_t *dd, int ddimind,
+                                     const rvec *buf_s, int n_s,
+                                     rvec *buf_r, int n_r)
+{
+    gmx_domdec_comm_t *comm = dd->comm;
+
+    if (dd_compressed_x_size(n_s) > comm->cbuf_s_nalloc)
+    {
+        comm->cbuf_s_nalloc = over_alloc_dd(dd_compressed_x_size(n_s));
+        srenew(comm->cbuf_s, comm->cbuf_s_nalloc);
+    }
+    if (dd_compressed_x_size(n_r) > comm->cbuf_r_nalloc)
+    {
+        comm->cbuf_r_nalloc = over_alloc_dd(dd_compressed_x_size(n_r));
+        srenew(comm->cbuf_r, comm->cbuf_r_nalloc);
+    }
+
+    int nint_s = dd_compress_x(n_s, buf_s, comm->cbuf_s);
+
+    dd_sendrecv_int(dd, ddimind, dddirBackward,
+                    comm->cbuf_s, nint_s,
+                    comm->cbuf_r, dd_compressed_x_size(n_r));
+
+    dd_decompress_x(n_r, comm->cbuf_r, buf_r);
+}
+
+/*! \brief Sets whether compressed halo coordinates are accurate enough
+ *
+ * The extent of each message is bounded by that of all local atoms,
+ * we add a 10% margin for the motion of atoms up to the next partitioning.
+ * See dd_compress_x_is_accurate() for the precision requirement.
+ * All ranks need to agree, so this requires a global reduction.
+ */
+static void set_compress_x(FILE *fplog, gmx_int64_t step,
+                           t_commrec *cr, gmx_domdec_t *dd,
+                           const rvec *x)
+{
+    gmx_domdec_comm_t *comm = dd->comm;
+    rvec               x0, x1, extent;
+    int                bAccurate;
+
+    dd_bounding_box_x(comm->nat[ddnatZONE], x, x0, x1);
+    rvec_sub(x1, x0, extent);
+    svmul(1.1, extent, extent);
+    bAccurate = dd_compress_x_is_accurate(extent);
+    gmx_sumi(1, &bAccurate, cr);
+
+    gmx_bool bActive = (bAccurate == dd->nnodes);
+    if (bActive != comm->bCompressXActive && fplog)
+    {
+        char buf[STEPSTRSIZE];
+        fprintf(fplog, "\nStep %s: %s compressed halo coordinate communication\n\n",
+                gmx_step_str(step, buf),
+                bActive ? "turning on" : "insufficient precision, turning off");
+    }
+    comm->bCompressXActive = bActive;
+}
+
 void dd_move_x(gmx_domdec_t *dd, matrix box, rvec x[])
 {
     int                    nzone, nat_tot, n, d, p, i, j, at0, at1, zone;
@@ -470,9 +531,18 @@ void dd_move_x(gmx_domdec_t *dd, matrix box, rvec x[])
                 rbuf = comm->vbuf2.v;
             }
             /* Send and receive the coordinates */
-            dd_sendrecv_rvec(dd, d, dddirBackward,
-                             buf,  ind->nsend[nzone+1],
-                             rbuf, ind->nrecv[nzone+1]);
+            if (comm->bCompressXActive)
+            {
+                dd_sendrecv_compressed_x(dd, d,
+                                         buf,  ind->nsend[nzone+1],
+                                         rbuf, ind->nrecv[nzone+1]);
+            }
+            else
+            {
+                dd_sendrecv_rvec(dd, d, dddirBackward,
+                                 buf,  ind->nsend[nzone+1],
+                                 rbuf, ind->nrecv[nzone+1]);
+            }
             if (!cd->bInPlace)
             {
                 j = 0;
@@ -1222,42 +1292,112 @@ static void get_commbuffer_counts(gmx_domdec_t *dd,
     }
 }
 
-static void dd_collect_vec_gatherv(gmx_domdec_t *dd,
-                                   const rvec *lv, rvec *v)
+/*! \brief Collects \p lv in \p v on the master rank with non-blocking communication
+ *
+ * The non-master ranks copy their home atom vector to a send buffer
+ * and continue without waiting for the master to receive the data.
+ * The send is completed at the next collection call, before the buffer
+ * is reused. Only the master, which writes the output, waits.
+ */
+static void dd_collect_vec_nonblocking(gmx_domdec_t *dd,
+                                       const rvec *lv, rvec *v)
 {
+#if GMX_MPI
+    gmx_domdec_comm_t   *comm = dd->comm;
     gmx_domdec_master_t *ma;
-    int                 *rcounts = nullptr, *disps = nullptr;
+    int                 *rcounts, *disps;
     int                  n, i, c, a;
-    rvec                *buf = nullptr;
+    rvec                *buf;
     t_block             *cgs_gl;
 
-    ma = dd->ma;
-
-    if (DDMASTER(dd))
+    if (!DDMASTER(dd))
     {
-        get_commbuffer_counts(dd, &rcounts, &disps);
+        if (comm->bCollectPending)
+        {
+            MPI_Wait(&comm->collect_request, MPI_STATUS_IGNORE);
+        }
+        if (dd->nat_home > comm->collect_buf_nalloc)
+        {
+            comm->collect_buf_nalloc = over_alloc_dd(dd->nat_home);
+            srenew(comm->collect_buf, comm->collect_buf_nalloc);
+        }
+        for (i = 0; i < dd->nat_home; i++)
+        {
+            copy_rvec(lv[i], comm->collect_buf[i]);
+        }
+        MPI_Isend(comm->collect_buf, dd->nat_home*sizeof(rvec), MPI_BYTE,
+                  DDMASTERRANK(dd), 0, comm->mpi_comm_collect,
+                  &comm->collect_request);
+        comm->bCollectPending = TRUE;
 
-        buf = ma->vbuf;
+        return;
     }
 
-    dd_gatherv(dd, dd->nat_home*sizeof(rvec), lv, rcounts, disps, buf);
+    ma = dd->ma;
 
-    if (DDMASTER(dd))
+    get_commbuffer_counts(dd, &rcounts, &disps);
+
+    buf = ma->vbuf;
+
+    std::vector<MPI_Request> req;
+    req.reserve(dd->nnodes - 1);
+    for (n = 0; n < dd->nnodes; n++)
     {
-        cgs_gl = &dd->comm->cgs_gl;
+        char *dest = reinterpret_cast<char *>(buf) + disps[n];
+        if (n == dd->rank)
+        {
+            memcpy(dest, lv, rcounts[n]);
+        }
+        else
+        {
+            req.push_back(MPI_Request());
+            MPI_Irecv(dest, rcounts[n], MPI_BYTE, DDRANK(dd, n),
+                      0, comm->mpi_comm_collect, &req.back());
+        }
+    }
+    MPI_Waitall(req.size(), req.data(), MPI_STATUSES_IGNORE);
 
-        a = 0;
-        for (n = 0; n < dd->nnodes; n++)
+    cgs_gl = &comm->cgs_gl;
+
+    a = 0;
+    for (n = 0; n < dd->nnodes; n++)
+    {
+        for (i = ma->index[n]; i < ma->index[n+1]; i++)
         {
-            for (i = ma->index[n]; i < ma->index[n+1]; i++)
+            for (c = cgs_gl->index[ma->cg[i]]; c < cgs_gl->index[ma->cg[i]+1]; c++)
             {
-                for (c = cgs_gl->index[ma->cg[i]]; c < cgs_gl->index[ma->cg[i]+1]; c++)
-                {
-                    copy_rvec(buf[a++], v[c]);
-                }
+                copy_rvec(buf[a++], v[c]);
             }
         }
     }
+#else
+    GMX_UNUSED_VALUE(dd);
+    GMX_UNUSED_VALUE(lv);
+    GMX_UNUSED_VALUE(v);
+#endif
+}
+
+void dd_finish_collect(gmx_domdec_t *dd)
+{
+#if GMX_MPI
+    gmx_domdec_comm_t *comm = dd->comm;
+
+    if (dd->nnodes <= GMX_DD_NNODES_SENDRECV)
+    {
+        return;
+    }
+    if (comm->bCollectPending)
+    {
+        MPI_Wait(&comm->collect_request, MPI_STATUS_IGNORE);
+        comm->bCollectPending = FALSE;
+    }
+    sfree(comm->collect_buf);
+    comm->collect_buf        = nullptr;
+    comm->collect_buf_nalloc = 0;
+    MPI_Comm_free(&comm->mpi_comm_collect);
+#else
+    GMX_UNUSED_VALUE(dd);
+#endif
 }
 
 void dd_collect_vec(gmx_domdec_t           *dd,
@@ -1275,7 +1415,7 @@ void dd_collect_vec(gmx_domdec_t           *dd,
     }
     else
     {
-        dd_collect_vec_gatherv(dd, lv, v);
+        dd_collect_vec_nonblocking(dd, lv, v);
     }
 }
 
@@ -1288,8 +1428,8 @@ void dd_collect_vec(gmx_domdec_t           *dd,
 }
 
 
-void dd_collect_state(gmx_domdec_t *dd,
-                      t_state *state_local, t_state *state)
+void dd_collect_state_without_atoms(gmx_domdec_t *dd,
+                                    t_state *state_local, t_state *state)
 {
     int nh = state->nhchainlength;
 
@@ -1326,6 +1466,13 @@ void dd_collect_state(gmx_domdec_t *dd,
             }
         }
     }
+}
+
+void dd_collect_state(gmx_domdec_t *dd,
+                      t_state *state_local, t_state *state)
+{
+    dd_collect_state_without_atoms(dd, state_local, state);
+
     if (state_local->flags & (1 << estX))
     {
         dd_collect_vec(dd, state_local, &state_local->x, &state->x);
@@ -1920,6 +2067,39 @@ static int ddcoord2simnodeid(t_commrec *cr, int x, int y, int z)
     return nodeid;
 }
 
+/*! \brief Returns the DD index of PP rank \p sim_nodeid with a Cartesian PP communicator
+ *
+ * The PP ranks might have been reordered when creating the Cartesian
+ * communicator. Before ddindex2simnodeid is set up, no reordering
+ * has been done yet and the DD index equals the rank.
+ */
+static int cartesian_simnode2ddindex(const gmx_domdec_t *dd, int sim_nodeid)
+{
+    if (dd->comm->simnodeid2ddindex == nullptr)
+    {
+        return sim_nodeid;
+    }
+
+    return dd->comm->simnodeid2ddindex[sim_nodeid];
+}
+
+/*! \brief Sets up simnodeid2ddindex, the inverse of ddindex2simnodeid
+ *
+ * \p numSimRanks is the total number of PP and PME ranks in this simulation.
+ */
+static void set_simnodeid2ddindex(gmx_domdec_comm_t *comm, int numPPRanks, int numSimRanks)
+{
+    snew(comm->simnodeid2ddindex, numSimRanks);
+    for (int i = 0; i < numSimRanks; i++)
+    {
+        comm->simnodeid2ddindex[i] = -1;
+    }
+    for (int ddindex = 0; ddindex < numPPRanks; ddindex++)
+    {
+        comm->simnodeid2ddindex[comm->ddindex2simnodeid[ddindex]] = ddindex;
+    }
+}
+
 static int dd_simnode2pmenode(const gmx_domdec_t         *dd,
                               const t_commrec gmx_unused *cr,
                               int                         sim_nodeid)
@@ -1946,7 +2126,7 @@ static int dd_simnode2pmenode(const gmx_domdec_t         *dd,
     {
         if (sim_nodeid < dd->nnodes)
         {
-            pmenode = dd->nnodes + ddindex2pmeindex(dd, sim_nodeid);
+            pmenode = dd->nnodes + ddindex2pmeindex(dd, cartesian_simnode2ddindex(dd, sim_nodeid));
         }
     }
     else
@@ -2079,6 +2259,17 @@ static gmx_bool receive_vir_ener(const gmx_domdec_t *dd, const t_commrec *cr)
             GMX_RELEASE_ASSERT(false, "Without MPI we should not have Cartesian PP-PME with #PMEnodes < #DDnodes");
 #endif
         }
+        else if (comm->bCartesianPP)
+        {
+            /* The PME rank receives from a consecutive range of DD indices */
+            int ddindex = dd_index(dd->nc, dd->ci);
+            if (ddindex + 1 < dd->nnodes &&
+                ddindex2pmeindex(dd, ddindex + 1) == ddindex2pmeindex(dd, ddindex))
+            {
+                /* This is not the last PP node for pmenode */
+                bReceive = FALSE;
+            }
+        }
         else
         {
             int pmenode = dd_simnode2pmenode(dd, cr, cr->sim_nodeid);
@@ -5089,7 +5280,53 @@ static float dd_force_imb_perf_loss(gmx_domdec_t *dd)
     }
 }
 
-static void print_dd_load_av(FILE *fplog, gmx_domdec_t *dd)
+/*! \brief Estimate the number of separate PME ranks that balances the PP and PME load
+ *
+ * The PP work scales as 1/numPpRanks and the PME work as 1/numPmeRanks.
+ * With the measured PME mesh/force time ratio \p pmeForceRatio,
+ * the PME and PP times become equal when the total number of ranks is
+ * split such that numPmeRanks/numPpRanks is pmeForceRatio times
+ * the current ratio. Of the numbers of PME ranks that mdrun accepts
+ * for this system, the one closest to this balance is returned,
+ * or -1 when there is none.
+ */
+static int balanced_num_pme_ranks(const gmx_domdec_t *dd, const t_inputrec *ir,
+                                  int numPpRanks, int numPmeRanks,
+                                  float pmeForceRatio)
+{
+    gmx_domdec_comm_t *comm     = dd->comm;
+    int                numRanks = numPpRanks + numPmeRanks;
+    int                natoms   = comm->cgs_gl.index[comm->cgs_gl.nr];
+    float              pmeWork  = pmeForceRatio*numPmeRanks;
+    int                numPmeRanksBalanced;
+
+    numPmeRanksBalanced = static_cast<int>(numRanks*pmeWork/(numPpRanks + pmeWork) + 0.5);
+
+    /* We need at least one PP and one PME rank */
+    numPmeRanksBalanced = std::max(1, std::min(numRanks - 1, numPmeRanksBalanced));
+
+    /* Search outward from the balanced count for a count that gives
+     * a valid DD grid and PME decomposition.
+     */
+    for (int offset = 0; offset < numRanks; offset++)
+    {
+        for (int sign = -1; sign <= 1; sign += 2)
+        {
+            int npme = numPmeRanksBalanced + sign*offset;
+            if ((offset > 0 || sign > 0) && npme >= 1 && npme < numRanks &&
+                dd_pme_ranks_fit(ir, comm->gridBox, &comm->gridDdbox,
+                                 natoms, numRanks, npme,
+                                 comm->gridCellsizeLimit, comm->cutoff))
+            {
+                return npme;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static void print_dd_load_av(FILE *fplog, gmx_domdec_t *dd, const t_inputrec *ir)
 {
     gmx_domdec_comm_t *comm = dd->comm;
 
@@ -5144,9 +5381,10 @@ static void print_dd_load_av(FILE *fplog, gmx_domdec_t *dd)
 
     /* Print the performance loss due to separate PME - PP rank imbalance */
     float lossFractionPme = 0;
+    float pmeForceRatio   = 0;
     if (numPmeRanks > 0 && comm->load_mdf > 0 && comm->load_step > 0)
     {
-        float pmeForceRatio = comm->load_pme/comm->load_mdf;
+        pmeForceRatio       = comm->load_pme/comm->load_mdf;
         lossFractionPme     = (comm->load_pme - comm->load_mdf)/comm->load_step;
         if (lossFractionPme <= 0)
         {
@@ -5193,6 +5431,19 @@ static void print_dd_load_av(FILE *fplog, gmx_domdec_t *dd)
                 (lossFractionPme < 0) ? "less"     : "more",
                 (lossFractionPme < 0) ? "decrease" : "increase",
                 (lossFractionPme < 0) ? "decrease" : "increase");
+        if (pmeForceRatio > 0)
+        {
+            int numPmeRanksBalanced = balanced_num_pme_ranks(dd, ir, numPpRanks, numPmeRanks, pmeForceRatio);
+            if (numPmeRanksBalanced > 0 && numPmeRanksBalanced != numPmeRanks)
+            {
+                sprintf(buf+strlen(buf),
+                        "      With the measured load, %d instead of %d PME ranks\n"
+                        "      (-npme %d) would better balance the PP and PME work.\n"
+                        "      mdrun does not change the number of PME ranks during a run,\n"
+                        "      but it can be changed when continuing from a checkpoint.\n",
+                        numPmeRanksBalanced, numPmeRanks, numPmeRanksBalanced);
+            }
+        }
         fprintf(fplog, "%s\n", buf);
         fprintf(stderr, "%s\n", buf);
     }
@@ -5564,16 +5815,180 @@ static void setup_neighbor_relations(gmx_domdec_t *dd)
     }
 }
 
+#if GMX_MPI
+/*! \brief Choose the block of DD cells to assign to the ranks of one physical node
+ *
+ * The halo volume communicated along dimension d is proportional
+ * to the area of the cell face normal to d, thus to the inverse
+ * of the cell size along d. We choose the block of \p nrank_node cells
+ * that minimizes the halo volume leaving the block, so the most
+ * communicated dimensions are kept within the node.
+ *
+ * \returns TRUE when a block that fits the DD grid was found.
+ */
+static gmx_bool choose_physicalnode_block(const ivec         nc,
+                                          int                nrank_node,
+                                          const gmx_ddbox_t *ddbox,
+                                          ivec               block)
+{
+    rvec     face_weight;
+    gmx_bool bFound = FALSE;
+    real     cost_min;
+
+    for (int d = 0; d < DIM; d++)
+    {
+        face_weight[d] = nc[d]/(ddbox->box_size[d]*ddbox->skew_fac[d]);
+    }
+
+    cost_min = 0;
+    for (int bx = 1; bx <= nc[XX]; bx++)
+    {
+        for (int by = 1; by <= nc[YY]; by++)
+        {
+            if (nc[XX] % bx != 0 || nc[YY] % by != 0 ||
+                nrank_node % (bx*by) != 0)
+            {
+                continue;
+            }
+            int bz = nrank_node/(bx*by);
+            if (bz > nc[ZZ] || nc[ZZ] % bz != 0)
+            {
+                continue;
+            }
+
+            ivec b = { bx, by, bz };
+            real cost = 0;
+            for (int d = 0; d < DIM; d++)
+            {
+                if (nc[d] > 1 && b[d] < nc[d])
+                {
+                    /* Two faces of nrank_node/b[d] cells leave the node */
+                    cost += 2*(nrank_node/b[d])*face_weight[d];
+                }
+            }
+            if (!bFound || cost < cost_min)
+            {
+                copy_ivec(b, block);
+                cost_min = cost;
+                bFound   = TRUE;
+            }
+        }
+    }
+
+    return bFound;
+}
+
+/*! \brief Returns the Cartesian rank this PP rank should get with physical node aware ordering
+ *
+ * The ranks on each physical node are assigned a compact block of
+ * DD cells. The nodes are ordered by their lowest rank and the ranks
+ * within a node by rank, so rank 0 keeps Cartesian rank 0.
+ * Returns -1 when no reordering should be done, this decision
+ * is the same on all ranks in \p comm_pp.
+ */
+static int physicalnode_ordered_rank(FILE               *fplog,
+                                     const gmx_domdec_t *dd,
+                                     MPI_Comm            comm_pp,
+                                     const gmx_ddbox_t  *ddbox)
+{
+    int nrank, rank;
+
+    MPI_Comm_size(comm_pp, &nrank);
+    MPI_Comm_rank(comm_pp, &rank);
+
+    std::vector<int> buf(nrank, 0);
+    std::vector<int> nodeHash(nrank);
+    buf[rank] = gmx_physicalnode_id_hash();
+    MPI_Allreduce(buf.data(), nodeHash.data(), nrank, MPI_INT, MPI_SUM, comm_pp);
+
+    /* Number the nodes in order of their first rank and count the ranks */
+    std::vector<int> nodeIndex(nrank);
+    std::vector<int> nodeHashes;
+    std::vector<int> nodeNumRanks;
+    int              myLocalIndex = 0;
+    for (int r = 0; r < nrank; r++)
+    {
+        size_t n = 0;
+        while (n < nodeHashes.size() && nodeHashes[n] != nodeHash[r])
+        {
+            n++;
+        }
+        if (n == nodeHashes.size())
+        {
+            nodeHashes.push_back(nodeHash[r]);
+            nodeNumRanks.push_back(0);
+        }
+        nodeIndex[r] = n;
+        if (r == rank)
+        {
+            myLocalIndex = nodeNumRanks[n];
+        }
+        nodeNumRanks[n]++;
+    }
+
+    if (nodeHashes.size() == 1)
+    {
+        /* All ranks share a node, there is nothing to gain */
+        return -1;
+    }
+    for (size_t n = 1; n < nodeNumRanks.size(); n++)
+    {
+        if (nodeNumRanks[n] != nodeNumRanks[0])
+        {
+            if (fplog)
+            {
+                fprintf(fplog, "The number of PP ranks differs between physical nodes, will not reorder the ranks\n");
+            }
+            return -1;
+        }
+    }
+
+    ivec block;
+    if (!choose_physicalnode_block(dd->nc, nodeNumRanks[0], ddbox, block))
+    {
+        if (fplog)
+        {
+            fprintf(fplog, "Can not divide the DD grid %d x %d x %d in blocks of %d ranks per physical node, will not reorder the ranks\n",
+                    dd->nc[XX], dd->nc[YY], dd->nc[ZZ], nodeNumRanks[0]);
+        }
+        return -1;
+    }
+
+    if (fplog)
+    {
+        fprintf(fplog, "Will assign blocks of %d x %d x %d DD cells to the ranks of each physical node\n",
+                block[XX], block[YY], block[ZZ]);
+    }
+
+    ivec nblock, block_ci, local_ci, ci;
+    for (int d = 0; d < DIM; d++)
+    {
+        nblock[d] = dd->nc[d]/block[d];
+    }
+    ddindex2xyz(nblock, nodeIndex[rank], block_ci);
+    ddindex2xyz(block, myLocalIndex, local_ci);
+    for (int d = 0; d < DIM; d++)
+    {
+        ci[d] = block_ci[d]*block[d] + local_ci[d];
+    }
+
+    /* MPI Cartesian ranks are ordered with the same major index as dd_index */
+    return dd_index(dd->nc, ci);
+}
+#endif
+
 static void make_pp_communicator(FILE                 *fplog,
                                  gmx_domdec_t         *dd,
                                  t_commrec gmx_unused *cr,
-                                 int gmx_unused        reorder)
+                                 int gmx_unused        reorder,
+                                 const gmx_ddbox_t    *ddbox)
 {
 #if GMX_MPI
     gmx_domdec_comm_t *comm;
     int                rank, *buf;
     ivec               periods;
     MPI_Comm           comm_cart;
+    gmx_bool           bNodeOrder = FALSE;
 
     comm = dd->comm;
 
@@ -5590,8 +6005,28 @@ static void make_pp_communicator(FILE                 *fplog,
         {
             periods[i] = TRUE;
         }
-        MPI_Cart_create(cr->mpi_comm_mygroup, DIM, dd->nc, periods, reorder,
+
+        /* Most MPI libraries do not reorder for Cartesian communicators,
+         * so we reorder ourselves to place neighboring DD cells on
+         * the same physical node.
+         */
+        MPI_Comm comm_pp = cr->mpi_comm_mygroup;
+        if (reorder)
+        {
+            int rank_ordered = physicalnode_ordered_rank(fplog, dd, comm_pp, ddbox);
+            if (rank_ordered >= 0)
+            {
+                MPI_Comm_split(cr->mpi_comm_mygroup, 0, rank_ordered, &comm_pp);
+                bNodeOrder = TRUE;
+            }
+        }
+        MPI_Cart_create(comm_pp, DIM, dd->nc, periods,
+                        bNodeOrder ? FALSE : reorder,
                         &comm_cart);
+        if (bNodeOrder)
+        {
+            MPI_Comm_free(&comm_pp);
+        }
         /* We overwrite the old communicator with the new cartesian one */
         cr->mpi_comm_mygroup = comm_cart;
     }
@@ -5599,6 +6034,14 @@ static void make_pp_communicator(FILE                 *fplog,
     dd->mpi_comm_all = cr->mpi_comm_mygroup;
     MPI_Comm_rank(dd->mpi_comm_all, &dd->rank);
 
+    if (dd->nnodes > GMX_DD_NNODES_SENDRECV)
+    {
+        /* Vectors are collected with non-blocking point-to-point calls,
+         * use a separate communicator to avoid matching other messages.
+         */
+        MPI_Comm_dup(dd->mpi_comm_all, &comm->mpi_comm_collect);
+    }
+
     if (comm->bCartesianPP_PME)
     {
         /* Since we want to use the original cartesian setup for sim,
@@ -5622,10 +6065,12 @@ static void make_pp_communicator(FILE                 *fplog,
     }
     else if (comm->bCartesianPP)
     {
-        if (cr->npmenodes == 0)
+        if (cr->npmenodes == 0 && !bNodeOrder)
         {
             /* The PP communicator is also
-             * the communicator for this simulation
+             * the communicator for this simulation.
+             * With node ordering the ranks differ, so we keep
+             * the original communicator and use ddindex2simnodeid.
              */
             cr->mpi_comm_mysim = cr->mpi_comm_mygroup;
         }
@@ -5646,6 +6091,7 @@ static void make_pp_communicator(FILE                 *fplog,
         MPI_Allreduce(buf, comm->ddindex2simnodeid, dd->nnodes, MPI_INT, MPI_SUM,
                       cr->mpi_comm_mysim);
         sfree(buf);
+        set_simnodeid2ddindex(comm, dd->nnodes, dd->nnodes + cr->npmenodes);
 
         /* Determine the master coordinates and rank.
          * The DD master should be the same node as the master of this sim.
@@ -5707,6 +6153,7 @@ static void receive_ddindex2simnodeid(gmx_domdec_t         *dd,
         MPI_Allreduce(buf, comm->ddindex2simnodeid, dd->nnodes, MPI_INT, MPI_SUM,
                       cr->mpi_comm_mysim);
         sfree(buf);
+        set_simnodeid2ddindex(comm, dd->nnodes, dd->nnodes + cr->npmenodes);
     }
 #else
     GMX_UNUSED_VALUE(dd);
@@ -5899,7 +6346,8 @@ static void split_communicator(FILE *fplog, t_commrec *cr, gmx_domdec_t *dd,
 
 /*! \brief Generates the MPI communicators for domain decomposition */
 static void make_dd_communicators(FILE *fplog, t_commrec *cr,
-                                  gmx_domdec_t *dd, int dd_rank_order)
+                                  gmx_domdec_t *dd, int dd_rank_order,
+                                  const gmx_ddbox_t *ddbox)
 {
     gmx_domdec_comm_t *comm;
     int                CartReorder;
@@ -5913,7 +6361,8 @@ static void make_dd_communicators(FILE *fplog, t_commrec *cr,
 
     /* Reorder the nodes by default. This might change the MPI ranks.
      * Real reordering is only supported on very few architectures,
-     * Blue Gene is one of them.
+     * Blue Gene is one of them. With a Cartesian PP communicator
+     * we reorder ourselves based on the physical nodes.
      */
     CartReorder = (getenv("GMX_NO_CART_REORDER") == nullptr);
 
@@ -5941,7 +6390,7 @@ static void make_dd_communicators(FILE *fplog, t_commrec *cr,
     if (cr->duty & DUTY_PP)
     {
         /* Copy or make a new PP communicator */
-        make_pp_communicator(fplog, dd, cr, CartReorder);
+        make_pp_communicator(fplog, dd, cr, CartReorder, ddbox);
     }
     else
     {
@@ -6458,6 +6907,8 @@ static void set_dd_limits_and_grid(FILE *fplog, t_commrec *cr, gmx_domdec_t *dd,
             cr->npmenodes = 0;
         }
 
+        comm->gridCellsizeLimit = comm->cellsize_limit;
+
         real acs = average_cellsize_min(dd, ddbox);
         if (acs < comm->cellsize_limit)
         {
@@ -6481,6 +6932,7 @@ static void set_dd_limits_and_grid(FILE *fplog, t_commrec *cr, gmx_domdec_t *dd,
                            comm->dlbState != edlbsOffForever, dlb_scale,
                            comm->cellsize_limit, comm->cutoff,
                            comm->bInterCGBondeds);
+        comm->gridCellsizeLimit = limit;
 
         if (dd->nc[XX] == 0)
         {
@@ -6499,6 +6951,11 @@ static void set_dd_limits_and_grid(FILE *fplog, t_commrec *cr, gmx_domdec_t *dd,
         }
         set_dd_dim(fplog, dd);
     }
+    if (MASTER(cr))
+    {
+        comm->gridDdbox = *ddbox;
+        copy_mat(box, comm->gridBox);
+    }
 
     if (fplog)
     {
@@ -7106,6 +7563,17 @@ static void set_dd_envvar_options(FILE *fplog, gmx_domdec_t *dd, int rank_mysim)
     comm->nstDDDump     = dd_getenv(fplog, "GMX_DD_NST_DUMP", 0);
     comm->nstDDDumpGrid = dd_getenv(fplog, "GMX_DD_NST_DUMP_GRID", 0);
     comm->DD_debug      = dd_getenv(fplog, "GMX_DD_DEBUG", 0);
+    comm->bCompressX    = dd_getenv(fplog, "GMX_DD_COMPRESS_X", 0);
+#if GMX_DOUBLE
+    if (comm->bCompressX)
+    {
+        if (fplog)
+        {
+            fprintf(fplog, "NOTE: GMX_DD_COMPRESS_X is ignored in double precision, compression would reduce the precision of the coordinates\n");
+        }
+        comm->bCompressX = FALSE;
+    }
+#endif
 
     if (dd->bSendRecv2 && fplog)
     {
@@ -7167,7 +7635,7 @@ gmx_domdec_t *init_domain_decomposition(FILE *fplog, t_commrec *cr,
                            ddbox,
                            npme_x, npme_y);
 
-    make_dd_communicators(fplog, cr, dd, dd_rank_order);
+    make_dd_communicators(fplog, cr, dd, dd_rank_order, ddbox);
 
     if (cr->duty & DUTY_PP)
     {
@@ -9062,7 +9530,7 @@ void print_dd_statistics(t_commrec *cr, t_inputrec *ir, FILE *fplog)
 
     if (comm->bRecordLoad && EI_DYNAMICS(ir->eI))
     {
-        print_dd_load_av(fplog, cr->dd);
+        print_dd_load_av(fplog, cr->dd, ir);
     }
 }
 
@@ -9526,6 +9994,12 @@ void dd_partition_system(FILE                *fplog,
     /* Set the charge group boundaries for neighbor searching */
     set_cg_boundaries(&comm->zones);
 
+    if (comm->bCompressX)
+    {
+        set_compress_x(fplog, step, cr, dd,
+                       as_rvec_array(state_local->x.data()));
+    }
+
     if (fr->cutoff_scheme == ecutsVERLET)
     {
         set_zones_size(dd, state_local->box, &ddbox,
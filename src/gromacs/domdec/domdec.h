@@ -213,10 +213,26 @@ void dd_collect_vec(struct gmx_domdec_t *dd,
 void dd_collect_vec(struct gmx_domdec_t *dd,
                     t_state *state_local, const PaddedRVecVector *lv, PaddedRVecVector *v);
 
+/*! \brief Completes the last non-blocking send of collected vectors and frees the collection buffers
+ *
+ * Should be called on all PP ranks after the last call to dd_collect_vec()
+ * or dd_collect_state().
+ */
+void dd_finish_collect(struct gmx_domdec_t *dd);
+
 /*! \brief Collects the local state \p state_local to \p state on the master rank */
 void dd_collect_state(struct gmx_domdec_t *dd,
                       t_state *state_local, t_state *state);
 
+/*! \brief Copies the non-atom entries of the local state \p state_local to \p state on the master rank
+ *
+ * Only the master rank copies, the other ranks return directly.
+ * Unlike dd_collect_state() this does not communicate, so it does not
+ * need to be called on all ranks, but it may be.
+ */
+void dd_collect_state_without_atoms(struct gmx_domdec_t *dd,
+                                    t_state *state_local, t_state *state);
+
 /*! \brief Cycle counter indices used internally in the domain decomposition */
 enum {
     ddCyclStep, ddCyclPPduringPME, ddCyclF, ddCyclWaitGPU, ddCyclPME, ddCyclNr
@@ -388,6 +404,17 @@ real dd_choose_grid(FILE *fplog,
                     gmx_bool bInterCGBondeds);
 
 
+/*! \brief Returns whether \p npme separate PME ranks out of \p nrank_tot ranks
+ * can be used for the system
+ *
+ * Applies the same restrictions on the number of PP and PME ranks
+ * as dd_choose_grid and checks that a DD grid exists that fits
+ * the cell size limit \p limit and the PME decomposition.
+ */
+gmx_bool dd_pme_ranks_fit(const t_inputrec *ir, matrix box, const gmx_ddbox_t *ddbox,
+                          int natoms, int nrank_tot, int npme,
+                          real limit, real cutoff);
+
 /* In domdec_box.c */
 
 /*! \brief Set the box and PBC data in \p ddbox */
@@ -0,0 +1,156 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ *
+ * \brief This file defines functions for fixed-point compression
+ * of halo coordinates in the domain decomposition
+ *
+ * \ingroup module_domdec
+ */
+
+#include "gmxpre.h"
+
+#include "domdec_compressx.h"
+
+#include "config.h"
+
+#include <cstring>
+
+#include <algorithm>
+
+#include "gromacs/math/vec.h"
+#include "gromacs/utility/real.h"
+
+/*! \brief The largest fixed-point value of a coordinate component */
+static const gmx_uint64_t c_maxInt = (static_cast<gmx_uint64_t>(1) << c_ddCompressXBits) - 1;
+
+/*! \brief The number of ints used for the origin and quantum of a compressed message */
+static const int c_headerSize = (2*DIM*sizeof(real) + sizeof(int) - 1)/sizeof(int);
+
+int dd_compressed_x_size(int n)
+{
+    return c_headerSize + 2*n;
+}
+
+void dd_bounding_box_x(int n, const rvec *x, rvec x0, rvec x1)
+{
+    if (n == 0)
+    {
+        clear_rvec(x0);
+        clear_rvec(x1);
+        return;
+    }
+
+    copy_rvec(x[0], x0);
+    copy_rvec(x[0], x1);
+    for (int i = 1; i < n; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            x0[d] = std::min(x0[d], x[i][d]);
+            x1[d] = std::max(x1[d], x[i][d]);
+        }
+    }
+}
+
+int dd_compress_x(int n, const rvec *x, int *buf)
+{
+    real  header[2*DIM];
+    real *x0      = header;
+    real *quantum = header + DIM;
+    rvec  x1, invQuantum;
+
+    dd_bounding_box_x(n, x, x0, x1);
+    for (int d = 0; d < DIM; d++)
+    {
+        quantum[d]    = (x1[d] - x0[d])/c_maxInt;
+        invQuantum[d] = (quantum[d] > 0 ? 1/quantum[d] : 0);
+    }
+    std::memcpy(buf, header, sizeof(header));
+
+    int *data = buf + c_headerSize;
+    for (int i = 0; i < n; i++)
+    {
+        gmx_uint64_t word = 0;
+        for (int d = 0; d < DIM; d++)
+        {
+            gmx_uint64_t u = static_cast<gmx_uint64_t>((x[i][d] - x0[d])*invQuantum[d] + 0.5);
+            word          |= std::min(u, c_maxInt) << (d*c_ddCompressXBits);
+        }
+        std::memcpy(data + 2*i, &word, sizeof(word));
+    }
+
+    return dd_compressed_x_size(n);
+}
+
+void dd_decompress_x(int n, const int *buf, rvec *x)
+{
+    real        header[2*DIM];
+    const real *x0      = header;
+    const real *quantum = header + DIM;
+
+    std::memcpy(header, buf, sizeof(header));
+
+    const int *data = buf + c_headerSize;
+    for (int i = 0; i < n; i++)
+    {
+        gmx_uint64_t word;
+        std::memcpy(&word, data + 2*i, sizeof(word));
+        for (int d = 0; d < DIM; d++)
+        {
+            x[i][d] = x0[d] + ((word >> (d*c_ddCompressXBits)) & c_maxInt)*quantum[d];
+        }
+    }
+}
+
+gmx_bool dd_compress_x_is_accurate(const rvec extent)
+{
+#if GMX_DOUBLE
+    GMX_UNUSED_VALUE(extent);
+
+    return FALSE;
+#else
+    for (int d = 0; d < DIM; d++)
+    {
+        if (0.5*extent[d]/c_maxInt > c_ddCompressXTolerance)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+#endif
+}
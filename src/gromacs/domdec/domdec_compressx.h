@@ -0,0 +1,89 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \libinternal \file
+ *
+ * \brief This file declares functions for fixed-point compression
+ * of halo coordinates in the domain decomposition
+ *
+ * \inlibraryapi
+ * \ingroup module_domdec
+ */
+#ifndef GMX_DOMDEC_DOMDEC_COMPRESSX_H
+#define GMX_DOMDEC_DOMDEC_COMPRESSX_H
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/real.h"
+
+/*! \brief The number of bits per coordinate component with compressed halo communication */
+const int c_ddCompressXBits = 21;
+
+/*! \brief Returns the number of ints needed to store \p n compressed coordinates */
+int dd_compressed_x_size(int n);
+
+/*! \brief Returns the lower and upper corner of the bounding box of \p n coordinates */
+void dd_bounding_box_x(int n, const rvec *x, rvec x0, rvec x1);
+
+/*! \brief Encodes \p n coordinates as fixed-point offsets into \p buf, returns the number of ints used
+ *
+ * The origin and quantum per dimension are stored in front of the data,
+ * each coordinate takes 3 components of c_ddCompressXBits in two ints.
+ * The quantum along a dimension is the extent of the coordinates along
+ * that dimension divided by 2^c_ddCompressXBits - 1.
+ */
+int dd_compress_x(int n, const rvec *x, int *buf);
+
+/*! \brief Decodes \p n coordinates from \p buf encoded by dd_compress_x() */
+void dd_decompress_x(int n, const int *buf, rvec *x);
+
+/*! \brief The maximum quantization error in nm we allow for compressed halo coordinates
+ *
+ * This is two orders of magnitude below the typical Verlet buffer and
+ * the precision of compressed trajectory output, so it does not affect
+ * the pair list or the interactions noticeably.
+ */
+const real c_ddCompressXTolerance = 1e-4;
+
+/*! \brief Returns whether coordinates with bounding box size \p extent can be compressed accurately enough
+ *
+ * We require half a quantum not to exceed c_ddCompressXTolerance along
+ * every dimension. With 21 bits per component this allows an extent of
+ * about 400 nm. In double precision compression would lose precision,
+ * so this returns FALSE.
+ */
+gmx_bool dd_compress_x_is_accurate(const rvec extent);
+
+#endif
@@ -218,6 +218,7 @@ struct gmx_domdec_comm_t
     int         cartpmedim;        /**< The number of dimensions for the PME setup that are Cartesian */
     int        *pmenodes;          /**< The PME ranks, size npmenodes */
     int        *ddindex2simnodeid; /**< The Cartesian index to sim rank conversion, used with bCartesianPP_PME */
+    int        *simnodeid2ddindex; /**< The inverse of ddindex2simnodeid, -1 for PME ranks */
     gmx_ddpme_t ddpme[2];          /**< The 1D or 2D PME domain decomposition setup */
 
     /* The DD particle-particle nodes only */
@@ -270,6 +271,10 @@ struct gmx_domdec_comm_t
     rvec box0;                    /**< box lower corner, required with dim's without pbc and -gcom */
     rvec box_size;                /**< box size, required with dim's without pbc and -gcom */
 
+    gmx_ddbox_t gridDdbox;        /**< The DD box used for choosing the DD grid, master rank only */
+    matrix      gridBox;          /**< The box used for choosing the DD grid, master rank only */
+    real        gridCellsizeLimit; /**< The cell size limit used for choosing the DD grid, master rank only */
+
     rvec cell_x0;                 /**< The DD cell lower corner, in triclinic space */
     rvec cell_x1;                 /**< The DD cell upper corner, in triclinic space */
 
@@ -322,6 +327,14 @@ struct gmx_domdec_comm_t
     int        nalloc_int2;            /**< Allocation size of \p buf_int2 */
     vec_rvec_t vbuf2;                  /**< Another rvec comm. buffer */
 
+    /* Fixed-point compressed halo coordinate communication */
+    gmx_bool   bCompressX;             /**< Compression of halo coordinates was requested */
+    gmx_bool   bCompressXActive;       /**< Compression is accurate enough with the current decomposition */
+    int       *cbuf_s;                 /**< Send buffer for compressed coordinates */
+    int        cbuf_s_nalloc;          /**< Allocation size of \p cbuf_s */
+    int       *cbuf_r;                 /**< Receive buffer for compressed coordinates */
+    int        cbuf_r_nalloc;          /**< Allocation size of \p cbuf_r */
+
     /* Communication buffers for local redistribution */
     int  **cggl_flag;                  /**< Charge group flag comm. buffers */
     int    cggl_flag_nalloc[DIM*2];    /**< Allocation sizes of \p *cggl_flag */
@@ -345,6 +358,15 @@ struct gmx_domdec_comm_t
     MPI_Comm        mpi_comm_gpu_shared; /**< The MPI load communicator for ranks sharing a GPU */
 #endif
 
+    /* Non-blocking collection of vectors on the master rank */
+    rvec           *collect_buf;         /**< Send buffer for the home atom vector, non-master ranks only */
+    int             collect_buf_nalloc;  /**< Allocation size of \p collect_buf */
+#if GMX_MPI
+    MPI_Comm        mpi_comm_collect;    /**< Communicator for collecting vectors, avoids tag clashes */
+    MPI_Request     collect_request;     /**< Request for the last send of \p collect_buf */
+    gmx_bool        bCollectPending;     /**< Is \p collect_request pending? */
+#endif
+
     /** Maximum DLB scaling per load balancing step in percent */
     int dlb_scale_lim;
 
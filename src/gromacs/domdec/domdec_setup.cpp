@@ -711,6 +711,79 @@ static real optimize_ncells(FILE *fplog,
     return limit;
 }
 
+gmx_bool dd_pme_ranks_fit(const t_inputrec *ir, matrix box, const gmx_ddbox_t *ddbox,
+                          int natoms, int nrank_tot, int npme,
+                          real limit, real cutoff)
+{
+    int  npp, ndiv, *div, *mdiv;
+    ivec itry, nc;
+
+    npp = nrank_tot - npme;
+    /* init_domain_decomposition does not support more PME than PP ranks */
+    if (npme < 1 || npme > npp)
+    {
+        return FALSE;
+    }
+
+    /* The same restrictions on the number of PP ranks as in dd_choose_grid */
+    if (npp > 12)
+    {
+        gmx_int64_t ldiv = largest_divisor(npp);
+        if (ldiv*ldiv*ldiv > static_cast<gmx_int64_t>(npp)*npp)
+        {
+            return FALSE;
+        }
+    }
+
+    /* Check for large prime factors and 2D PME decomposition as for
+     * the guessed number of PME ranks, without a load ratio requirement.
+     * A single PP rank, with a single PME rank, always fits.
+     */
+    if (npp > 1 && !fits_pp_pme_perf(nrank_tot, npme, 0))
+    {
+        return FALSE;
+    }
+
+    /* Check that there is a DD grid that fits the cell size limit and
+     * is compatible with the PME decomposition, as in optimize_ncells.
+     */
+    ndiv     = factorize(npp, &div, &mdiv);
+    itry[XX] = 1;
+    itry[YY] = 1;
+    itry[ZZ] = 1;
+    clear_ivec(nc);
+    assign_factors(nullptr, limit, cutoff, box, ddbox, natoms, ir, 0,
+                   npme, ndiv, div, mdiv, itry, nc);
+    sfree(div);
+    sfree(mdiv);
+
+    if (nc[XX] == 0)
+    {
+        return FALSE;
+    }
+
+    /* With OpenMP threads, gmx_pme_init requires at least pme_order
+     * (or exactly pme_order-1) grid lines per PME rank along x.
+     * The PME decomposition along x is chosen as in comm_cost_est.
+     */
+    int npme_x;
+    if (nc[XX] == 1 && nc[YY] > 1)
+    {
+        npme_x = 1;
+    }
+    else if (nc[YY] == 1)
+    {
+        npme_x = npme;
+    }
+    else
+    {
+        npme_x = (npme % nc[XX] == 0) ? nc[XX] : npme;
+    }
+
+    return (ir->nkx >= npme_x*ir->pme_order ||
+            ir->nkx == npme_x*(ir->pme_order - 1));
+}
+
 real dd_choose_grid(FILE *fplog,
                     t_commrec *cr, gmx_domdec_t *dd,
                     const t_inputrec *ir,
@@ -1938,7 +1938,8 @@ static int make_local_bondeds_excls(gmx_domdec_t *dd,
                                     t_blocka *lexcls, int *excl_count)
 {
     int                nzone_bondeds, nzone_excl;
-    int                izone, cg0, cg1;
+    int                cg_end_bondeds, cg_end_excl;
+    int                izone;
     real               rc2;
     int                nbonded_local;
     int                thread;
@@ -1981,124 +1982,146 @@ static int make_local_bondeds_excls(gmx_domdec_t *dd,
     lexcls->nra   = 0;
     *excl_count   = 0;
 
-    for (izone = 0; izone < nzone_bondeds; izone++)
-    {
-        cg0 = zones->cg_range[izone];
-        cg1 = zones->cg_range[izone + 1];
+    /* Exclusions are only generated for zones where we assign bondeds */
+    nzone_excl  = std::min(nzone_excl, nzone_bondeds);
+
+    cg_end_bondeds = zones->cg_range[nzone_bondeds];
+    cg_end_excl    = zones->cg_range[nzone_excl];
 
+    /* We process all zones in a single pass. Each thread handles a contiguous
+     * range of charge groups, which can span multiple zones. Appending
+     * the thread results in thread order then gives the same order as
+     * processing the zones one by one, but we avoid a parallel region
+     * and a serial reduction over the threads for every zone.
+     */
 #pragma omp parallel for num_threads(rt->nthread) schedule(static)
-        for (thread = 0; thread < rt->nthread; thread++)
+    for (thread = 0; thread < rt->nthread; thread++)
+    {
+        try
         {
-            try
-            {
-                int       cg0t, cg1t;
-                t_idef   *idef_t;
-                int     **vsite_pbc;
-                int      *vsite_pbc_nalloc;
-                t_blocka *excl_t;
+            int       cg0t, cg1t;
+            t_idef   *idef_t;
+            int     **vsite_pbc;
+            int      *vsite_pbc_nalloc;
+            t_blocka *excl_t;
 
-                cg0t = cg0 + ((cg1 - cg0)* thread   )/rt->nthread;
-                cg1t = cg0 + ((cg1 - cg0)*(thread+1))/rt->nthread;
+            cg0t = (cg_end_bondeds* thread   )/rt->nthread;
+            cg1t = (cg_end_bondeds*(thread+1))/rt->nthread;
 
+            if (thread == 0)
+            {
+                idef_t = idef;
+            }
+            else
+            {
+                idef_t = &rt->th_work[thread].idef;
+                clear_idef(idef_t);
+            }
+
+            if (vsite && vsite->bHaveChargeGroups && vsite->n_intercg_vsite > 0)
+            {
                 if (thread == 0)
                 {
-                    idef_t = idef;
+                    vsite_pbc        = vsite->vsite_pbc_loc;
+                    vsite_pbc_nalloc = vsite->vsite_pbc_loc_nalloc;
                 }
                 else
                 {
-                    idef_t = &rt->th_work[thread].idef;
-                    clear_idef(idef_t);
+                    vsite_pbc        = rt->th_work[thread].vsite_pbc;
+                    vsite_pbc_nalloc = rt->th_work[thread].vsite_pbc_nalloc;
                 }
+            }
+            else
+            {
+                vsite_pbc        = nullptr;
+                vsite_pbc_nalloc = nullptr;
+            }
 
-                if (vsite && vsite->bHaveChargeGroups && vsite->n_intercg_vsite > 0)
-                {
-                    if (thread == 0)
-                    {
-                        vsite_pbc        = vsite->vsite_pbc_loc;
-                        vsite_pbc_nalloc = vsite->vsite_pbc_loc_nalloc;
-                    }
-                    else
-                    {
-                        vsite_pbc        = rt->th_work[thread].vsite_pbc;
-                        vsite_pbc_nalloc = rt->th_work[thread].vsite_pbc_nalloc;
-                    }
-                }
-                else
+            rt->th_work[thread].nbonded = 0;
+            for (int zone = 0; zone < nzone_bondeds; zone++)
+            {
+                int cg0 = std::max(cg0t, zones->cg_range[zone]);
+                int cg1 = std::min(cg1t, zones->cg_range[zone + 1]);
+                if (cg0 >= cg1)
                 {
-                    vsite_pbc        = nullptr;
-                    vsite_pbc_nalloc = nullptr;
+                    continue;
                 }
 
-                rt->th_work[thread].nbonded =
+                rt->th_work[thread].nbonded +=
                     make_bondeds_zone(dd, zones,
                                       mtop->molblock,
                                       bRCheckMB, rcheck, bRCheck2B, rc2,
                                       la2lc, pbc_null, cg_cm, idef->iparams,
                                       idef_t,
                                       vsite_pbc, vsite_pbc_nalloc,
-                                      izone,
-                                      dd->cgindex[cg0t], dd->cgindex[cg1t]);
-
-                if (izone < nzone_excl)
-                {
-                    if (thread == 0)
-                    {
-                        excl_t = lexcls;
-                    }
-                    else
-                    {
-                        excl_t      = &rt->th_work[thread].excl;
-                        excl_t->nr  = 0;
-                        excl_t->nra = 0;
-                    }
-
-                    if (dd->cgindex[dd->ncg_tot] == dd->ncg_tot &&
-                        !rt->bExclRequired)
-                    {
-                        /* No charge groups and no distance check required */
-                        make_exclusions_zone(dd, zones,
-                                             mtop->moltype, cginfo,
-                                             excl_t,
-                                             izone,
-                                             cg0t, cg1t);
-                    }
-                    else
-                    {
-                        rt->th_work[thread].excl_count =
-                            make_exclusions_zone_cg(dd, zones,
-                                                    mtop->moltype, bRCheck2B, rc2,
-                                                    la2lc, pbc_null, cg_cm, cginfo,
-                                                    excl_t,
-                                                    izone,
-                                                    cg0t, cg1t);
-                    }
-                }
+                                      zone,
+                                      dd->cgindex[cg0], dd->cgindex[cg1]);
             }
-            GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
-        }
 
-        if (rt->nthread > 1)
-        {
-            combine_idef(idef, rt->th_work, rt->nthread, vsite);
-        }
-
-        for (thread = 0; thread < rt->nthread; thread++)
-        {
-            nbonded_local += rt->th_work[thread].nbonded;
-        }
+            /* The exclusions are split separately, as they often cover
+             * fewer zones than the bondeds.
+             */
+            cg0t = (cg_end_excl* thread   )/rt->nthread;
+            cg1t = (cg_end_excl*(thread+1))/rt->nthread;
 
-        if (izone < nzone_excl)
-        {
-            if (rt->nthread > 1)
+            if (thread == 0)
             {
-                combine_blocka(lexcls, rt->th_work, rt->nthread);
+                excl_t = lexcls;
+            }
+            else
+            {
+                excl_t      = &rt->th_work[thread].excl;
+                excl_t->nr  = 0;
+                excl_t->nra = 0;
             }
 
-            for (thread = 0; thread < rt->nthread; thread++)
+            rt->th_work[thread].excl_count = 0;
+            for (int zone = 0; zone < nzone_excl; zone++)
             {
-                *excl_count += rt->th_work[thread].excl_count;
+                int cg0 = std::max(cg0t, zones->cg_range[zone]);
+                int cg1 = std::min(cg1t, zones->cg_range[zone + 1]);
+                if (cg0 >= cg1)
+                {
+                    continue;
+                }
+
+                if (dd->cgindex[dd->ncg_tot] == dd->ncg_tot &&
+                    !rt->bExclRequired)
+                {
+                    /* No charge groups and no distance check required */
+                    make_exclusions_zone(dd, zones,
+                                         mtop->moltype, cginfo,
+                                         excl_t,
+                                         zone,
+                                         cg0, cg1);
+                }
+                else
+                {
+                    rt->th_work[thread].excl_count +=
+                        make_exclusions_zone_cg(dd, zones,
+                                                mtop->moltype, bRCheck2B, rc2,
+                                                la2lc, pbc_null, cg_cm, cginfo,
+                                                excl_t,
+                                                zone,
+                                                cg0, cg1);
+                }
             }
+            /* Set the end also when this thread had no atoms to process */
+            excl_t->nr = dd->cgindex[cg1t];
         }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    if (rt->nthread > 1)
+    {
+        combine_idef(idef, rt->th_work, rt->nthread, vsite);
+        combine_blocka(lexcls, rt->th_work, rt->nthread);
+    }
+
+    for (thread = 0; thread < rt->nthread; thread++)
+    {
+        nbonded_local += rt->th_work[thread].nbonded;
+        *excl_count   += rt->th_work[thread].excl_count;
     }
 
     /* Some zones might not have exclusions, but some code still needs to
@@ -0,0 +1,172 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the fixed-point compression of halo coordinates
+ *
+ * \ingroup module_domdec
+ */
+#include "gmxpre.h"
+
+#include "gromacs/domdec/domdec_compressx.h"
+
+#include "config.h"
+
+#include <cmath>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/real.h"
+
+namespace
+{
+
+//! Compresses and decompresses \p x and checks that the result is within half a quantum
+void checkRoundTrip(const std::vector<gmx::RVec> &x)
+{
+    int                    n = x.size();
+    std::vector<int>       buf(dd_compressed_x_size(n));
+    std::vector<gmx::RVec> xDecoded(n);
+    rvec                   x0, x1;
+
+    EXPECT_EQ(dd_compressed_x_size(n), dd_compress_x(n, as_rvec_array(x.data()), buf.data()));
+    dd_decompress_x(n, buf.data(), as_rvec_array(xDecoded.data()));
+
+    dd_bounding_box_x(n, as_rvec_array(x.data()), x0, x1);
+    for (int d = 0; d < DIM; d++)
+    {
+        /* Half a quantum plus rounding of the decoded value */
+        real tolerance = 0.5*(x1[d] - x0[d])/((1 << c_ddCompressXBits) - 1) +
+            4*GMX_REAL_EPS*std::max(std::abs(x0[d]), std::abs(x1[d]));
+        for (int i = 0; i < n; i++)
+        {
+            EXPECT_NEAR(x[i][d], xDecoded[i][d], tolerance) << "atom " << i << " dimension " << d;
+        }
+    }
+}
+
+TEST(CompressXTest, RoundTripIsWithinHalfAQuantum)
+{
+    std::vector<gmx::RVec> x;
+    for (int i = 0; i < 100; i++)
+    {
+        x.push_back(gmx::RVec(2.5 + 0.0137*i, 7.1 - 0.0291*i, 0.3 + 0.0071*(i % 13)));
+    }
+    checkRoundTrip(x);
+}
+
+TEST(CompressXTest, BoundingBoxCornersAreExact)
+{
+    std::vector<gmx::RVec> x = { { 1.5, 2.0, 3.25 }, { 4.0, 2.75, 3.5 }, { 2.0, 2.5, 3.0 } };
+    std::vector<int>       buf(dd_compressed_x_size(x.size()));
+    std::vector<gmx::RVec> xDecoded(x.size());
+
+    dd_compress_x(x.size(), as_rvec_array(x.data()), buf.data());
+    dd_decompress_x(x.size(), buf.data(), as_rvec_array(xDecoded.data()));
+    EXPECT_EQ(x[0][XX], xDecoded[0][XX]);
+    EXPECT_EQ(x[1][YY], xDecoded[1][YY]);
+    EXPECT_EQ(x[2][ZZ], xDecoded[2][ZZ]);
+    EXPECT_FLOAT_EQ(x[1][XX], xDecoded[1][XX]);
+    EXPECT_FLOAT_EQ(x[0][YY], xDecoded[0][YY]);
+    EXPECT_FLOAT_EQ(x[1][ZZ], xDecoded[1][ZZ]);
+}
+
+TEST(CompressXTest, HandlesZeroExtent)
+{
+    std::vector<gmx::RVec> x(5, gmx::RVec(1.25, -0.5, 3.0));
+    checkRoundTrip(x);
+}
+
+TEST(CompressXTest, HandlesSingleAndNoCoordinates)
+{
+    checkRoundTrip(std::vector<gmx::RVec>(1, gmx::RVec(0.1, 0.2, 0.3)));
+    checkRoundTrip(std::vector<gmx::RVec>());
+}
+
+TEST(CompressXTest, IsAccurateForRealisticDecompositions)
+{
+    /* A 10 nm box on a 4x4x4 grid with a cut-off of 1.2 nm,
+     * with the 10% margin for atom motion added by domdec.
+     */
+    rvec grid4x4x4 = { 1.1*3.7, 1.1*3.7, 1.1*3.7 };
+    /* A 100 nm slab along x on 2 ranks, not decomposed along y and z */
+    rvec slab      = { 1.1*51.2, 100, 100 };
+
+#if GMX_DOUBLE
+    /* Compression would reduce the precision of double coordinates */
+    EXPECT_FALSE(dd_compress_x_is_accurate(grid4x4x4));
+    EXPECT_FALSE(dd_compress_x_is_accurate(slab));
+#else
+    EXPECT_TRUE(dd_compress_x_is_accurate(grid4x4x4));
+    EXPECT_TRUE(dd_compress_x_is_accurate(slab));
+#endif
+}
+
+TEST(CompressXTest, IsNotAccurateForHugeExtents)
+{
+    rvec hugeInZ = { 10, 10, 1000 };
+
+    EXPECT_FALSE(dd_compress_x_is_accurate(hugeInZ));
+}
+
+TEST(CompressXTest, RoundTripErrorIsWithinToleranceAtLargestAccurateExtent)
+{
+    real                   extent = 2*c_ddCompressXTolerance*((1 << c_ddCompressXBits) - 1);
+    std::vector<gmx::RVec> x;
+    for (int i = 0; i < 100; i++)
+    {
+        x.push_back(gmx::RVec(extent*i/99, 0.5*extent*(i % 7)/6, extent*(99 - i)/99));
+    }
+    std::vector<int>       buf(dd_compressed_x_size(x.size()));
+    std::vector<gmx::RVec> xDecoded(x.size());
+
+    dd_compress_x(x.size(), as_rvec_array(x.data()), buf.data());
+    dd_decompress_x(x.size(), buf.data(), as_rvec_array(xDecoded.data()));
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            /* Allow for single precision rounding of the decoded value */
+            EXPECT_NEAR(x[i][d], xDecoded[i][d], c_ddCompressXTolerance + 2*GMX_FLOAT_EPS*extent)
+            << "atom " << i << " dimension " << d;
+        }
+    }
+}
+
+} // namespace
@@ -0,0 +1,151 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the check on the number of separate PME ranks
+ *
+ * \ingroup module_domdec
+ */
+#include "gmxpre.h"
+
+#include <gtest/gtest.h>
+
+#include "gromacs/domdec/domdec.h"
+#include "gromacs/domdec/domdec_struct.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/utility/real.h"
+
+namespace
+{
+
+//! Test fixture with a cubic PME system of 12000 atoms
+class PmeRanksFitTest : public ::testing::Test
+{
+    public:
+        PmeRanksFitTest()
+        {
+            ir_.ePBC        = epbcXYZ;
+            ir_.coulombtype = eelPME;
+            ir_.nkx         = 48;
+            ir_.nky         = 48;
+            ir_.nkz         = 48;
+            ir_.pme_order   = 4;
+            setBox(5);
+        }
+
+        //! Sets a cubic box with edge \p boxSize nm
+        void setBox(real boxSize)
+        {
+            clear_mat(box_);
+            ddbox_.npbcdim     = DIM;
+            ddbox_.nboundeddim = DIM;
+            for (int d = 0; d < DIM; d++)
+            {
+                box_[d][d]         = boxSize;
+                ddbox_.box0[d]     = 0;
+                ddbox_.box_size[d] = boxSize;
+                ddbox_.tric_dir[d] = 0;
+                ddbox_.skew_fac[d] = 1;
+            }
+        }
+
+        //! Returns whether \p npme PME ranks out of \p nrank_tot ranks fit
+        bool fits(int nrank_tot, int npme)
+        {
+            return dd_pme_ranks_fit(&ir_, box_, &ddbox_, natoms_, nrank_tot, npme,
+                                    limit_, cutoff_);
+        }
+
+        //! The PME input parameters
+        t_inputrec  ir_;
+        //! The unit cell
+        matrix      box_;
+        //! The DD box matching box_
+        gmx_ddbox_t ddbox_;
+        //! The number of atoms
+        int         natoms_ = 12000;
+        //! The minimum DD cell size
+        real        limit_  = 0.5;
+        //! The DD communication cut-off
+        real        cutoff_ = 1.0;
+};
+
+TEST_F(PmeRanksFitTest, SinglePPRankFits)
+{
+    EXPECT_TRUE(fits(2, 1));
+}
+
+TEST_F(PmeRanksFitTest, MorePmeThanPPRanksDoNotFit)
+{
+    EXPECT_FALSE(fits(3, 2));
+    EXPECT_FALSE(fits(5, 3));
+    EXPECT_FALSE(fits(1, 1));
+}
+
+TEST_F(PmeRanksFitTest, NoPmeRanksDoNotFit)
+{
+    EXPECT_FALSE(fits(4, 0));
+}
+
+TEST_F(PmeRanksFitTest, RegularSplitFits)
+{
+    EXPECT_TRUE(fits(12, 4));
+    EXPECT_TRUE(fits(4, 2));
+}
+
+TEST_F(PmeRanksFitTest, LargePrimeFactorDoesNotFit)
+{
+    /* 11 PP ranks can only be decomposed along one dimension */
+    EXPECT_FALSE(fits(14, 3));
+}
+
+TEST_F(PmeRanksFitTest, CellsSmallerThanCutoffDoNotFit)
+{
+    setBox(1.5);
+    EXPECT_FALSE(fits(12, 4));
+}
+
+TEST_F(PmeRanksFitTest, TooFewGridLinesPerPmeRankDoNotFit)
+{
+    ir_.nkx = 4;
+    ir_.nky = 4;
+    ir_.nkz = 4;
+    EXPECT_FALSE(fits(12, 4));
+}
+
+} // namespace
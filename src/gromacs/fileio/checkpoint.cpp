@@ -41,10 +41,15 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
+#include <string>
+#include <vector>
+
 #include <fcntl.h>
 #if GMX_NATIVE_WINDOWS
 #include <io.h>
@@ -71,10 +76,12 @@
 #include "gromacs/utility/arrayref.h"
 #include "gromacs/utility/baseversion.h"
 #include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/directoryenumerator.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/int64_to_int.h"
+#include "gromacs/utility/path.h"
 #include "gromacs/utility/programcontext.h"
 #include "gromacs/utility/smalloc.h"
 #include "gromacs/utility/sysinfo.h"
@@ -86,6 +93,7 @@
 
 #define CPT_MAGIC1 171817
 #define CPT_MAGIC2 171819
+#define CPT_PART_MAGIC 171821
 #define CPTSTRLEN 1024
 
 /* cpt_version should normally only be changed
@@ -94,7 +102,12 @@
  * But old code can not read a new entry that is present in the file
  * (but can read a new format when new entries are not present).
  */
-static const int cpt_version = 16;
+static const int cpt_version = 17;
+
+/* The state entries that are stored per atom in the checkpoint part files
+ * written by each rank, instead of in the checkpoint file itself.
+ */
+static const int cpt_part_flags = (1<<estX) | (1<<estV);
 
 
 const char *est_names[estNR] =
@@ -841,7 +854,7 @@ static void do_cpt_header(XDR *xd, gmx_bool bRead, int *file_version,
                           int *natoms, int *ngtc, int *nnhpres, int *nhchainlength,
                           int *nlambda, int *flags_state,
                           int *flags_eks, int *flags_enh, int *flags_dfh,
-                          int *nED, int *eSwapCoords,
+                          int *nED, int *eSwapCoords, int *nparts,
                           FILE *list)
 {
     bool_t res = 0;
@@ -991,6 +1004,14 @@ static void do_cpt_header(XDR *xd, gmx_bool bRead, int *file_version,
     {
         *eSwapCoords = eswapNO;
     }
+    if (*file_version >= 17)
+    {
+        do_cpt_int_err(xd, "#state parts", nparts, list);
+    }
+    else
+    {
+        *nparts = 0;
+    }
 }
 
 static int do_cpt_footer(XDR *xd, int file_version)
@@ -1552,13 +1573,323 @@ static int do_cpt_files(XDR *xd, gmx_bool bRead,
 }
 
 
+/* Returns the name of the file with the atom data of rank part for a
+ * checkpoint written to fn at step.
+ */
+static std::string cpt_part_filename(const char *fn, gmx_int64_t step, int part)
+{
+    char        sbuf[STEPSTRSIZE];
+    std::string name(fn);
+    size_t      extlen = std::strlen(ftp2ext(fn2ftp(fn))) + 1;
+
+    name.resize(name.size() - extlen);
+    name += "_step" + std::string(gmx_step_str(step, sbuf)) +
+        "_part" + std::to_string(part) + (fn + std::strlen(fn) - extlen);
+
+    return name;
+}
+
+/* Reads or writes the names of the part files, without directory.
+ * The names are owned by the caller, also when listing them.
+ */
+static void do_cpt_part_names(XDR *xd, gmx_bool bRead, int nparts,
+                              char ***names, FILE *list)
+{
+    if (bRead)
+    {
+        snew(*names, nparts);
+    }
+    for (int i = 0; i < nparts; i++)
+    {
+        do_cpt_string_err(xd, bRead, "state part file", &(*names)[i], nullptr);
+        if (list)
+        {
+            fprintf(list, "state part file = %s\n", (*names)[i]);
+        }
+    }
+}
+
+/* Frees the nparts names read by do_cpt_part_names() */
+static void free_cpt_part_names(int nparts, char **names)
+{
+    for (int i = 0; i < nparts; i++)
+    {
+        sfree(names[i]);
+    }
+    sfree(names);
+}
+
+/* Reads or writes n rvecs stored with precision double_prec */
+template <typename T>
+static int do_cpt_part_rvecs(XDR *xd, gmx_bool bRead, int n, rvec *v)
+{
+    std::vector<T> buf(n*DIM);
+
+    if (!bRead)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                buf[i*DIM + d] = v[i][d];
+            }
+        }
+    }
+    if (xdr_vector(xd, reinterpret_cast<char *>(buf.data()), n*DIM, sizeof(T),
+                   sizeof(T) == sizeof(float) ? (xdrproc_t)xdr_float : (xdrproc_t)xdr_double) == 0)
+    {
+        return -1;
+    }
+    if (bRead)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                v[i][d] = buf[i*DIM + d];
+            }
+        }
+    }
+
+    return 0;
+}
+
+void write_checkpoint_part(const char *fn, gmx_int64_t step, int part,
+                           int natoms, int nhome, const int *gatindex,
+                           int flags, const rvec *x, const rvec *v)
+{
+    std::string partfn = cpt_part_filename(fn, step, part);
+    t_fileio   *fp     = gmx_fio_open(partfn.c_str(), "w");
+    XDR        *xd     = gmx_fio_getxdr(fp);
+    int         magic  = CPT_PART_MAGIC;
+    int         version, double_prec;
+    int         res;
+
+    version     = cpt_version;
+    double_prec = GMX_DOUBLE;
+    flags      &= cpt_part_flags;
+    do_cpt_int_err(xd, "magic", &magic, nullptr);
+    do_cpt_int_err(xd, "checkpoint file version", &version, nullptr);
+    do_cpt_int_err(xd, "GROMACS double precision", &double_prec, nullptr);
+    do_cpt_step_err(xd, "step", &step, nullptr);
+    do_cpt_int_err(xd, "part", &part, nullptr);
+    do_cpt_int_err(xd, "#atoms", &natoms, nullptr);
+    do_cpt_int_err(xd, "state flags", &flags, nullptr);
+    do_cpt_int_err(xd, "#home atoms", &nhome, nullptr);
+    res = xdr_vector(xd, (char *)gatindex, nhome, sizeof(int), (xdrproc_t)xdr_int);
+    if (res != 0 && (flags & (1<<estX)))
+    {
+        res = (do_cpt_part_rvecs<real>(xd, FALSE, nhome, const_cast<rvec *>(x)) == 0);
+    }
+    if (res != 0 && (flags & (1<<estV)))
+    {
+        res = (do_cpt_part_rvecs<real>(xd, FALSE, nhome, const_cast<rvec *>(v)) == 0);
+    }
+    magic = CPT_MAGIC2;
+    if (res == 0 || xdr_int(xd, &magic) == 0 ||
+        gmx_fio_fsync(fp) != 0 || gmx_fio_close(fp) != 0)
+    {
+        gmx_file("Cannot write checkpoint; maybe you are out of disk space?");
+    }
+}
+
+void remove_checkpoint_part(const char *fn, gmx_int64_t step, int part)
+{
+    std::string partfn = cpt_part_filename(fn, step, part);
+
+    /* Not fatal, the file might have been removed already */
+    std::remove(partfn.c_str());
+}
+
+/* Returns the step of checkpoint fn when it exists and refers to part
+ * files, -1 otherwise. Increases *nparts_max to the number of parts.
+ */
+static gmx_int64_t cpt_step_with_parts(const char *fn, int *nparts_max)
+{
+    int         file_version;
+    char       *version, *btime, *buser, *bhost, *fprog, *ftime;
+    int         double_prec;
+    int         eIntegrator, simulation_part;
+    int         nppnodes, npme;
+    ivec        dd_nc;
+    int         nlambda;
+    int         flags_eks, flags_enh, flags_dfh;
+    double      t;
+    t_state     state;
+    int         nED, eSwapCoords, nparts;
+    gmx_int64_t step;
+    t_fileio   *fp;
+
+    if (!gmx_fexist(fn) || (fp = gmx_fio_open(fn, "r")) == nullptr)
+    {
+        return -1;
+    }
+    do_cpt_header(gmx_fio_getxdr(fp), TRUE, &file_version,
+                  &version, &btime, &buser, &bhost, &double_prec, &fprog, &ftime,
+                  &eIntegrator, &simulation_part, &step, &t, &nppnodes, dd_nc, &npme,
+                  &state.natoms, &state.ngtc, &state.nnhpres, &state.nhchainlength,
+                  &nlambda, &state.flags, &flags_eks, &flags_enh, &flags_dfh,
+                  &nED, &eSwapCoords, &nparts, nullptr);
+    gmx_fio_close(fp);
+    sfree(version);
+    sfree(btime);
+    sfree(buser);
+    sfree(bhost);
+    sfree(fprog);
+    sfree(ftime);
+
+    *nparts_max = std::max(*nparts_max, nparts);
+
+    return (nparts > 0 ? step : -1);
+}
+
+void remove_unreferenced_checkpoint_parts(const char *fn,
+                                          gmx_int64_t *step_prev, gmx_int64_t *step,
+                                          int *nparts)
+{
+    size_t      extlen = std::strlen(ftp2ext(fn2ftp(fn))) + 1;
+    std::string ext(fn + std::strlen(fn) - extlen);
+    std::string base(fn, std::strlen(fn) - extlen);
+    std::string dir    = gmx::Path::getParentPath(fn);
+    std::string prefix = gmx::Path::getFilename(base) + "_step";
+    char        sbuf[STEPSTRSIZE];
+
+    *nparts    = 0;
+    *step_prev = cpt_step_with_parts((base + "_prev" + ext).c_str(), nparts);
+    *step      = cpt_step_with_parts(fn, nparts);
+
+    std::vector<std::string> stale;
+    for (const std::string &name :
+         gmx::DirectoryEnumerator::enumerateFilesWithExtension(dir.empty() ? "." : dir.c_str(),
+                                                               ext.c_str(), false))
+    {
+        /* Part files are named <base>_step<step>_part<part><ext> */
+        size_t partpos = name.rfind("_part");
+        if (name.compare(0, prefix.size(), prefix) != 0 ||
+            partpos == std::string::npos || partpos <= prefix.size())
+        {
+            continue;
+        }
+        std::string stepstr = name.substr(prefix.size(), partpos - prefix.size());
+        std::string partstr = name.substr(partpos + 5, name.size() - partpos - 5 - ext.size());
+        if (partstr.empty() ||
+            stepstr.find_first_not_of("0123456789") != std::string::npos ||
+            partstr.find_first_not_of("0123456789") != std::string::npos ||
+            (*step_prev >= 0 && stepstr == gmx_step_str(*step_prev, sbuf)) ||
+            (*step >= 0 && stepstr == gmx_step_str(*step, sbuf)))
+        {
+            continue;
+        }
+        stale.push_back(dir.empty() ? name : gmx::Path::join(dir, name));
+    }
+    for (const std::string &partfn : stale)
+    {
+        /* Not fatal, the file might have been removed already */
+        std::remove(partfn.c_str());
+    }
+}
+
+/* Reads the atom data of the checkpoint fn at step from its part files */
+static void read_cpt_parts(const char *fn, gmx_int64_t step,
+                           int nparts, char **names, t_state *state)
+{
+    std::string       dir = gmx::Path::getParentPath(fn);
+    std::vector<char> bRead(state->natoms, FALSE);
+    std::vector<int>  gatindex;
+    int               nread = 0;
+
+    for (int p = 0; p < nparts; p++)
+    {
+        std::string partfn = (dir.empty() ? std::string(names[p]) : gmx::Path::join(dir, names[p]));
+        if (!gmx_fexist(partfn.c_str()))
+        {
+            gmx_fatal(FARGS, "Checkpoint file %s refers to part file %s, which does not exist",
+                      fn, partfn.c_str());
+        }
+        t_fileio   *fp = gmx_fio_open(partfn.c_str(), "r");
+        XDR        *xd = gmx_fio_getxdr(fp);
+        int         magic, version, double_prec, part, natoms, flags, nhome;
+        gmx_int64_t step_f;
+
+        do_cpt_int_err(xd, "magic", &magic, nullptr);
+        if (magic != CPT_PART_MAGIC)
+        {
+            gmx_fatal(FARGS, "File %s is not a checkpoint part file", partfn.c_str());
+        }
+        do_cpt_int_err(xd, "checkpoint file version", &version, nullptr);
+        do_cpt_int_err(xd, "GROMACS double precision", &double_prec, nullptr);
+        do_cpt_step_err(xd, "step", &step_f, nullptr);
+        do_cpt_int_err(xd, "part", &part, nullptr);
+        do_cpt_int_err(xd, "#atoms", &natoms, nullptr);
+        do_cpt_int_err(xd, "state flags", &flags, nullptr);
+        do_cpt_int_err(xd, "#home atoms", &nhome, nullptr);
+        if (step_f != step || natoms != state->natoms || nhome < 0 || nhome > natoms)
+        {
+            gmx_fatal(FARGS, "Checkpoint part file %s does not match checkpoint file %s",
+                      partfn.c_str(), fn);
+        }
+        gatindex.resize(nhome);
+        if (xdr_vector(xd, reinterpret_cast<char *>(gatindex.data()), nhome, sizeof(int), (xdrproc_t)xdr_int) == 0)
+        {
+            cp_error();
+        }
+        for (int i = 0; i < nhome; i++)
+        {
+            if (gatindex[i] < 0 || gatindex[i] >= natoms || bRead[gatindex[i]])
+            {
+                gmx_fatal(FARGS, "Checkpoint part file %s contains an invalid or duplicate atom index",
+                          partfn.c_str());
+            }
+            bRead[gatindex[i]] = TRUE;
+        }
+        nread += nhome;
+
+        std::vector<gmx::RVec> buf(nhome);
+        for (int ecpt : { estX, estV })
+        {
+            if (!(flags & (1<<ecpt)))
+            {
+                continue;
+            }
+            int ret = (double_prec ?
+                       do_cpt_part_rvecs<double>(xd, TRUE, nhome, as_rvec_array(buf.data())) :
+                       do_cpt_part_rvecs<float>(xd, TRUE, nhome, as_rvec_array(buf.data())));
+            if (ret != 0)
+            {
+                cp_error();
+            }
+            if (state->flags & (1<<ecpt))
+            {
+                gmx::PaddedRVecVector &vec = (ecpt == estX ? state->x : state->v);
+                for (int i = 0; i < nhome; i++)
+                {
+                    vec[gatindex[i]] = buf[i];
+                }
+            }
+        }
+        magic = -1;
+        if (xdr_int(xd, &magic) == 0 || magic != CPT_MAGIC2)
+        {
+            cp_error();
+        }
+        gmx_fio_close(fp);
+    }
+
+    if (nread != state->natoms)
+    {
+        gmx_fatal(FARGS, "The part files of checkpoint file %s contain %d atoms instead of %d",
+                  fn, nread, state->natoms);
+    }
+}
+
 void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
                       FILE *fplog, t_commrec *cr,
                       ivec domdecCells, int nppnodes,
                       int eIntegrator, int simulation_part,
                       gmx_bool bExpanded, int elamstats,
                       gmx_int64_t step, double t,
-                      t_state *state, energyhistory_t *enerhist)
+                      t_state *state, energyhistory_t *enerhist,
+                      int nparts)
 {
     t_fileio            *fp;
     int                  file_version;
@@ -1575,7 +1906,8 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
     gmx_file_position_t *outputfiles;
     int                  noutputfiles;
     char                *ftime;
-    int                  flags_eks, flags_enh, flags_dfh;
+    int                  flags_eks, flags_enh, flags_dfh, flags_state;
+    char               **partnames = nullptr;
     t_fileio            *ret;
 
     if (DOMAINDECOMP(cr))
@@ -1693,16 +2025,30 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
                   DOMAINDECOMP(cr) ? domdecCells : nullptr, &npmenodes,
                   &state->natoms, &state->ngtc, &state->nnhpres,
                   &state->nhchainlength, &nlambda, &state->flags, &flags_eks, &flags_enh, &flags_dfh,
-                  &nED, &eSwapCoords,
+                  &nED, &eSwapCoords, &nparts,
                   nullptr);
 
+    /* With parts, the atom data has been written by each rank to its own file */
+    flags_state = state->flags;
+    if (nparts > 0)
+    {
+        snew(partnames, nparts);
+        for (int i = 0; i < nparts; i++)
+        {
+            partnames[i] = gmx_strdup(gmx::Path::getFilename(cpt_part_filename(fn, step, i)).c_str());
+        }
+        do_cpt_part_names(gmx_fio_getxdr(fp), FALSE, nparts, &partnames, nullptr);
+        free_cpt_part_names(nparts, partnames);
+        flags_state &= ~cpt_part_flags;
+    }
+
     sfree(version);
     sfree(btime);
     sfree(buser);
     sfree(bhost);
     sfree(fprog);
 
-    if ((do_cpt_state(gmx_fio_getxdr(fp), state->flags, state, nullptr) < 0)        ||
+    if ((do_cpt_state(gmx_fio_getxdr(fp), flags_state, state, nullptr) < 0)        ||
         (do_cpt_ekinstate(gmx_fio_getxdr(fp), flags_eks, &state->ekinstate, nullptr) < 0) ||
         (do_cpt_enerhist(gmx_fio_getxdr(fp), FALSE, flags_enh, enerhist, nullptr) < 0)  ||
         (do_cpt_df_hist(gmx_fio_getxdr(fp), flags_dfh, nlambda, &state->dfhist, nullptr) < 0)  ||
@@ -1965,7 +2311,8 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
     int                  eIntegrator_f, nppnodes_f, npmenodes_f;
     ivec                 dd_nc_f;
     int                  natoms, ngtc, nnhpres, nhchainlength, nlambda, fflags, flags_eks, flags_enh, flags_dfh;
-    int                  nED, eSwapCoords;
+    int                  nED, eSwapCoords, nparts;
+    char               **partnames = nullptr;
     int                  d;
     int                  ret;
     gmx_file_position_t *outputfiles;
@@ -1997,7 +2344,11 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
                   &nppnodes_f, dd_nc_f, &npmenodes_f,
                   &natoms, &ngtc, &nnhpres, &nhchainlength, &nlambda,
                   &fflags, &flags_eks, &flags_enh, &flags_dfh,
-                  &nED, &eSwapCoords, nullptr);
+                  &nED, &eSwapCoords, &nparts, nullptr);
+    if (nparts > 0)
+    {
+        do_cpt_part_names(gmx_fio_getxdr(fp), TRUE, nparts, &partnames, nullptr);
+    }
 
     if (bAppendOutputFiles &&
         file_version >= 13 && double_prec != GMX_DOUBLE)
@@ -2131,7 +2482,7 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
                         reproducibilityRequested);
         }
     }
-    ret             = do_cpt_state(gmx_fio_getxdr(fp), fflags, state, nullptr);
+    ret             = do_cpt_state(gmx_fio_getxdr(fp), nparts > 0 ? (fflags & ~cpt_part_flags) : fflags, state, nullptr);
     *init_fep_state = state->fep_state;  /* there should be a better way to do this than setting it here.
                                             Investigate for 5.0. */
     if (ret)
@@ -2200,6 +2551,12 @@ static void read_checkpoint(const char *fn, FILE **pfplog,
         gmx_file("Cannot read/write checkpoint; corrupt file, or maybe you are out of disk space?");
     }
 
+    if (nparts > 0)
+    {
+        read_cpt_parts(fn, *step, nparts, partnames, state);
+        free_cpt_part_names(nparts, partnames);
+    }
+
     sfree(fprog);
     sfree(ftime);
     sfree(btime);
@@ -2401,7 +2758,7 @@ void read_checkpoint_part_and_step(const char  *filename,
     int       flags_eks, flags_enh, flags_dfh;
     double    t;
     t_state   state;
-    int       nED, eSwapCoords;
+    int       nED, eSwapCoords, nparts;
     t_fileio *fp;
 
     if (filename == nullptr ||
@@ -2422,7 +2779,7 @@ void read_checkpoint_part_and_step(const char  *filename,
                   &eIntegrator, simulation_part, step, &t, &nppnodes, dd_nc, &npme,
                   &state.natoms, &state.ngtc, &state.nnhpres, &state.nhchainlength,
                   &nlambda, &state.flags, &flags_eks, &flags_enh, &flags_dfh,
-                  &nED, &eSwapCoords, nullptr);
+                  &nED, &eSwapCoords, &nparts, nullptr);
 
     gmx_fio_close(fp);
 }
@@ -2439,7 +2796,8 @@ static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
     ivec                 dd_nc;
     int                  nlambda;
     int                  flags_eks, flags_enh, flags_dfh;
-    int                  nED, eSwapCoords;
+    int                  nED, eSwapCoords, nparts;
+    char               **partnames = nullptr;
     int                  nfiles_loc;
     gmx_file_position_t *files_loc = nullptr;
     int                  ret;
@@ -2449,9 +2807,13 @@ static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
                   &eIntegrator, simulation_part, step, t, &nppnodes, dd_nc, &npme,
                   &state->natoms, &state->ngtc, &state->nnhpres, &state->nhchainlength,
                   &nlambda, &state->flags, &flags_eks, &flags_enh, &flags_dfh,
-                  &nED, &eSwapCoords, nullptr);
+                  &nED, &eSwapCoords, &nparts, nullptr);
+    if (nparts > 0)
+    {
+        do_cpt_part_names(gmx_fio_getxdr(fp), TRUE, nparts, &partnames, nullptr);
+    }
     ret =
-        do_cpt_state(gmx_fio_getxdr(fp), state->flags, state, nullptr);
+        do_cpt_state(gmx_fio_getxdr(fp), nparts > 0 ? (state->flags & ~cpt_part_flags) : state->flags, state, nullptr);
     if (ret)
     {
         cp_error();
@@ -2515,6 +2877,12 @@ static void read_checkpoint_data(t_fileio *fp, int *simulation_part,
         cp_error();
     }
 
+    if (nparts > 0)
+    {
+        read_cpt_parts(gmx_fio_getname(fp), *step, nparts, partnames, state);
+        free_cpt_part_names(nparts, partnames);
+    }
+
     sfree(fprog);
     sfree(ftime);
     sfree(btime);
@@ -2586,7 +2954,8 @@ void list_checkpoint(const char *fn, FILE *out)
     ivec                 dd_nc;
     int                  nlambda;
     int                  flags_eks, flags_enh, flags_dfh;
-    int                  nED, eSwapCoords;
+    int                  nED, eSwapCoords, nparts;
+    char               **partnames;
     int                  ret;
     gmx_file_position_t *outputfiles;
     int                  nfiles;
@@ -2599,9 +2968,15 @@ void list_checkpoint(const char *fn, FILE *out)
                   &eIntegrator, &simulation_part, &step, &t, &nppnodes, dd_nc, &npme,
                   &state.natoms, &state.ngtc, &state.nnhpres, &state.nhchainlength,
                   &nlambda, &state.flags,
-                  &flags_eks, &flags_enh, &flags_dfh, &nED, &eSwapCoords,
+                  &flags_eks, &flags_enh, &flags_dfh, &nED, &eSwapCoords, &nparts,
                   out);
-    ret = do_cpt_state(gmx_fio_getxdr(fp), state.flags, &state, out);
+    if (nparts > 0)
+    {
+        /* The atom data in the part files is not listed */
+        do_cpt_part_names(gmx_fio_getxdr(fp), TRUE, nparts, &partnames, out);
+        free_cpt_part_names(nparts, partnames);
+    }
+    ret = do_cpt_state(gmx_fio_getxdr(fp), nparts > 0 ? (state.flags & ~cpt_part_flags) : state.flags, &state, out);
     if (ret)
     {
         cp_error();
@@ -61,6 +61,9 @@ struct t_trxframe;
 /* Write a checkpoint to <fn>.cpt
  * Appends the _step<step>.cpt with bNumberAndKeep,
  * otherwise moves the previous <fn>.cpt to <fn>_prev.cpt
+ * With nparts > 0 the coordinates and velocities are not written,
+ * instead the checkpoint refers to the nparts files written by
+ * write_checkpoint_part() for this step, which should exist.
  */
 void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
                       FILE *fplog, t_commrec *cr,
@@ -68,7 +71,31 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
                       int eIntegrator, int simulation_part,
                       gmx_bool bExpanded, int elamstats,
                       gmx_int64_t step, double t,
-                      t_state *state, energyhistory_t *enerhist);
+                      t_state *state, energyhistory_t *enerhist,
+                      int nparts);
+
+/* Write the coordinates and/or velocities, as given by flags, of the nhome
+ * atoms with global indices gatindex to a part file of checkpoint fn.
+ * The file name is fn with _step<step>_part<part> inserted before the
+ * extension. Each rank can write its part in parallel, without
+ * collecting the state. The file is synced to disk before returning.
+ */
+void write_checkpoint_part(const char *fn, gmx_int64_t step, int part,
+                           int natoms, int nhome, const int *gatindex,
+                           int flags, const rvec *x, const rvec *v);
+
+/* Remove the part file written by write_checkpoint_part() */
+void remove_checkpoint_part(const char *fn, gmx_int64_t step, int part);
+
+/* Remove the part files of checkpoint fn left by earlier runs, which are
+ * referenced neither by fn nor by the previous checkpoint <fn>_prev.
+ * Returns the steps of these two checkpoints in step_prev and step,
+ * or -1 when they do not exist or were not written in parts, and
+ * the largest number of parts they refer to in nparts.
+ */
+void remove_unreferenced_checkpoint_parts(const char *fn,
+                                          gmx_int64_t *step_prev, gmx_int64_t *step,
+                                          int *nparts);
 
 /* Loads a checkpoint from fn for run continuation.
  * Generates a fatal error on system size mismatch.
@@ -80,6 +107,8 @@ void write_checkpoint(const char *fn, gmx_bool bNumberAndKeep,
  * With bAppend and bForceAppend: truncate anyhow if the system does not
  * support file locking.
  * With reproducibilityRequested warns about version, build, #ranks differences.
+ * The coordinates and velocities of a checkpoint with parts are assembled
+ * from the part files, so it can be continued with any number of ranks.
  */
 void load_checkpoint(const char *fn, FILE **fplog,
                      const t_commrec *cr, ivec dd_nc, int *npme,
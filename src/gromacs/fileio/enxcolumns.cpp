@@ -0,0 +1,725 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "enxcolumns.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <vector>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/smalloc.h"
+
+/* File layout, all integers are stored big-endian:
+ *
+ * header:  magic, version (int32), energy file end, offset, step of the
+ *          last frame (int64), time of the last frame (double),
+ *          number of frames (int64), number of terms (int32), followed
+ *          by the name and unit of each term (int32 length + characters)
+ * chunks:  magic, number of frames, number of columns (int32), energy
+ *          file offset of the first frame (int64), the size of each
+ *          column (int64), followed by the data of each column
+ *
+ * The columns are those in the enum below, followed by e, eav and esum
+ * of each energy term. Each column stores a 64-bit value per frame,
+ * integers as the difference with the previous value, doubles as the
+ * exclusive or with the previous bit pattern. The zero bytes at both
+ * ends of these are dropped, a leading byte gives their counts.
+ */
+
+/*! \brief Magic number at the start of a columnar energy file, "ECOL" */
+static const int c_enxcolMagic = 0x45434f4c;
+
+/*! \brief Version of the columnar energy file format */
+static const int c_enxcolVersion = 1;
+
+/*! \brief Magic number at the start of each chunk, "CHNK" */
+static const int c_enxcolChunkMagic = 0x43484e4b;
+
+/*! \brief The number of frames that are stored per chunk */
+static const int c_enxcolFramesPerChunk = 1000;
+
+/*! \brief Size of the part of the header that is rewritten when frames are added */
+static const int c_enxcolFixedHeaderSize = 2*4 + 5*8 + 4;
+
+/*! \brief The columns for each frame, the energy terms follow */
+enum {
+    ecolTime, ecolStep, ecolNsteps, ecolDt, ecolNsum, ecolNre, ecolNR
+};
+
+/*! \brief The number of columns for each energy term: e, eav and esum */
+static const int c_enxcolColumnsPerTerm = 3;
+
+/*! \brief Position and size of a chunk of frames */
+struct t_enxcolchunk
+{
+    int                      nframes;      //!< The number of frames in the chunk
+    gmx_off_t                offset;       //!< File offset of the chunk
+    gmx_off_t                energyOffset; //!< Energy file offset of the first frame
+    std::vector<gmx_off_t>   columnOffset; //!< File offset of each column
+    std::vector<gmx_int64_t> columnSize;   //!< Size of each column in bytes
+};
+
+struct t_enxcolumns
+{
+    FILE                                   *fp;              //!< The columnar file
+    int                                     nterms;          //!< The number of energy terms
+    gmx_int64_t                             nframes;         //!< The number of frames
+    gmx_off_t                               energyFileEnd;   //!< End of the last frame in the energy file
+    gmx_off_t                               lastFrameOffset; //!< Start of the last frame in the energy file
+    gmx_int64_t                             lastStep;        //!< The step of the last frame
+    double                                  lastTime;        //!< The time of the last frame
+    std::vector<t_enxcolchunk>              chunks;          //!< The chunks
+    std::vector<bool>                       bRead;           //!< Whether each column is read
+    int                                     chunk;           //!< The chunk in values, -1 before the first
+    int                                     frameInChunk;    //!< The next frame in the chunk
+    std::vector<std::vector<gmx_uint64_t> > values;          //!< The values of the read columns of the chunk
+};
+
+gmx_bool gmx_enxcol_enabled()
+{
+    return (getenv("GMX_NO_ENERGY_COLUMNS") == nullptr);
+}
+
+std::string gmx_enxcol_filename(const char *fn)
+{
+    return std::string(fn) + ".ecol";
+}
+
+/*! \brief Returns the number of columns for \p nterms energy terms */
+static int enxcol_ncolumns(int nterms)
+{
+    return ecolNR + c_enxcolColumnsPerTerm*nterms;
+}
+
+/*! \brief Returns whether column \p col stores integers */
+static bool enxcol_is_integer(int col)
+{
+    return (col == ecolStep || col == ecolNsteps || col == ecolNsum || col == ecolNre);
+}
+
+/*! \brief Appends the \p nbytes lowest bytes of \p value to \p buf, most significant first */
+static void put_bytes(std::vector<unsigned char> *buf, gmx_uint64_t value, int nbytes)
+{
+    for (int b = nbytes - 1; b >= 0; b--)
+    {
+        buf->push_back(static_cast<unsigned char>(value >> (8*b)));
+    }
+}
+
+/*! \brief Returns the value of the \p nbytes bytes at \p p, most significant first */
+static gmx_uint64_t get_bytes(const unsigned char *p, int nbytes)
+{
+    gmx_uint64_t value = 0;
+    for (int b = 0; b < nbytes; b++)
+    {
+        value = (value << 8) | p[b];
+    }
+    return value;
+}
+
+/*! \brief Returns the bit pattern of \p d */
+static gmx_uint64_t double_to_bits(double d)
+{
+    gmx_uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+
+/*! \brief Returns the double with bit pattern \p bits */
+static double bits_to_double(gmx_uint64_t bits)
+{
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+/*! \brief Returns whether \p n bytes could be read from \p fp into \p buf */
+static bool read_bytes(FILE *fp, std::vector<unsigned char> *buf, size_t n)
+{
+    buf->resize(n);
+    return (n == 0 || fread(buf->data(), 1, n, fp) == n);
+}
+
+/*! \brief Appends the compressed values of column \p col to \p buf */
+static void encode_column(const std::vector<gmx_uint64_t> &values, int col,
+                          std::vector<unsigned char> *buf)
+{
+    const bool   bInteger = enxcol_is_integer(col);
+    gmx_uint64_t prev     = 0;
+
+    for (gmx_uint64_t value : values)
+    {
+        gmx_uint64_t x;
+        if (bInteger)
+        {
+            /* Zig-zag encode the difference, so small negative values have few bytes */
+            gmx_int64_t diff = static_cast<gmx_int64_t>(value - prev);
+            x = (static_cast<gmx_uint64_t>(diff) << 1) ^ static_cast<gmx_uint64_t>(diff >> 63);
+        }
+        else
+        {
+            x = value ^ prev;
+        }
+        prev = value;
+
+        int lead  = 0;
+        int trail = 0;
+        if (x == 0)
+        {
+            lead = 8;
+        }
+        else
+        {
+            while (((x >> (56 - 8*lead)) & 0xff) == 0)
+            {
+                lead++;
+            }
+            while (((x >> (8*trail)) & 0xff) == 0)
+            {
+                trail++;
+            }
+        }
+        buf->push_back(static_cast<unsigned char>((lead << 4) | trail));
+        for (int b = 8 - lead - 1; b >= trail; b--)
+        {
+            buf->push_back(static_cast<unsigned char>(x >> (8*b)));
+        }
+    }
+}
+
+/*! \brief Decodes \p n values of column \p col from \p data, returns whether the data was consistent */
+static bool decode_column(const std::vector<unsigned char> &data, int col, int n,
+                          std::vector<gmx_uint64_t> *values)
+{
+    const bool   bInteger = enxcol_is_integer(col);
+    gmx_uint64_t prev     = 0;
+    size_t       pos      = 0;
+
+    values->resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        if (pos >= data.size())
+        {
+            return false;
+        }
+        int lead  = data[pos] >> 4;
+        int trail = data[pos] & 0xf;
+        pos++;
+        if (lead + trail > 8 || pos + 8 - lead - trail > data.size())
+        {
+            return false;
+        }
+        gmx_uint64_t x = 0;
+        for (int b = 8 - lead - 1; b >= trail; b--)
+        {
+            x |= static_cast<gmx_uint64_t>(data[pos++]) << (8*b);
+        }
+        if (bInteger)
+        {
+            gmx_int64_t diff = static_cast<gmx_int64_t>(x >> 1) ^ -static_cast<gmx_int64_t>(x & 1);
+            prev             = prev + static_cast<gmx_uint64_t>(diff);
+        }
+        else
+        {
+            prev = prev ^ x;
+        }
+        (*values)[i] = prev;
+    }
+
+    return (pos == data.size());
+}
+
+/*! \brief Writes the part of the header of \p columns that changes when frames are added */
+static void write_fixed_header(FILE *fp, const t_enxcolumns *columns)
+{
+    std::vector<unsigned char> buf;
+
+    put_bytes(&buf, c_enxcolMagic, 4);
+    put_bytes(&buf, c_enxcolVersion, 4);
+    put_bytes(&buf, columns->energyFileEnd, 8);
+    put_bytes(&buf, columns->lastFrameOffset, 8);
+    put_bytes(&buf, columns->lastStep, 8);
+    put_bytes(&buf, double_to_bits(columns->lastTime), 8);
+    put_bytes(&buf, columns->nframes, 8);
+    put_bytes(&buf, columns->nterms, 4);
+    GMX_ASSERT(buf.size() == c_enxcolFixedHeaderSize, "The fixed header size should match");
+    if (gmx_fseek(fp, 0, SEEK_SET) != 0 || fwrite(buf.data(), 1, buf.size(), fp) != buf.size())
+    {
+        gmx_file("Cannot write the header of a columnar energy file");
+    }
+}
+
+/*! \brief Writes the names and units of the energy terms after the fixed header */
+static void write_term_names(FILE *fp, int nterms, const gmx_enxnm_t *enm)
+{
+    std::vector<unsigned char> buf;
+
+    for (int i = 0; i < nterms; i++)
+    {
+        const char *strings[2] = { enm[i].name, enm[i].unit };
+        for (const char *s : strings)
+        {
+            size_t len = (s != nullptr ? std::strlen(s) : 0);
+            put_bytes(&buf, len, 4);
+            buf.insert(buf.end(), s, s + len);
+        }
+    }
+    if (fwrite(buf.data(), 1, buf.size(), fp) != buf.size())
+    {
+        gmx_file("Cannot write the header of a columnar energy file");
+    }
+}
+
+/*! \brief Reads the header of \p columns and checks the term names against \p enm */
+static bool read_header(t_enxcolumns *columns, int nre, const gmx_enxnm_t *enm)
+{
+    std::vector<unsigned char> buf;
+
+    if (!read_bytes(columns->fp, &buf, c_enxcolFixedHeaderSize) ||
+        static_cast<int>(get_bytes(&buf[0], 4)) != c_enxcolMagic ||
+        static_cast<int>(get_bytes(&buf[4], 4)) != c_enxcolVersion)
+    {
+        return false;
+    }
+    columns->energyFileEnd   = get_bytes(&buf[8], 8);
+    columns->lastFrameOffset = get_bytes(&buf[16], 8);
+    columns->lastStep        = get_bytes(&buf[24], 8);
+    columns->lastTime        = bits_to_double(get_bytes(&buf[32], 8));
+    columns->nframes         = get_bytes(&buf[40], 8);
+    columns->nterms          = get_bytes(&buf[48], 4);
+    if (columns->nterms != nre || columns->nframes < 0)
+    {
+        return false;
+    }
+    for (int i = 0; i < nre; i++)
+    {
+        const char *strings[2] = { enm[i].name, enm[i].unit };
+        for (const char *s : strings)
+        {
+            size_t len = (s != nullptr ? std::strlen(s) : 0);
+            if (!read_bytes(columns->fp, &buf, 4) || get_bytes(&buf[0], 4) != len ||
+                !read_bytes(columns->fp, &buf, len) ||
+                (len > 0 && std::memcmp(buf.data(), s, len) != 0))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/*! \brief Reads the chunk headers of \p columns, returns whether they contain the expected number of frames */
+static bool read_chunk_table(t_enxcolumns *columns)
+{
+    const int                  ncol   = enxcol_ncolumns(columns->nterms);
+    gmx_int64_t                nfound = 0;
+    std::vector<unsigned char> buf;
+
+    while (nfound < columns->nframes)
+    {
+        t_enxcolchunk chunk;
+
+        chunk.offset = gmx_ftell(columns->fp);
+        if (!read_bytes(columns->fp, &buf, 3*4 + 8 + ncol*8) ||
+            static_cast<int>(get_bytes(&buf[0], 4)) != c_enxcolChunkMagic ||
+            static_cast<int>(get_bytes(&buf[8], 4)) != ncol)
+        {
+            return false;
+        }
+        chunk.nframes      = get_bytes(&buf[4], 4);
+        chunk.energyOffset = get_bytes(&buf[12], 8);
+        gmx_off_t offset = chunk.offset + buf.size();
+        for (int col = 0; col < ncol; col++)
+        {
+            chunk.columnOffset.push_back(offset);
+            chunk.columnSize.push_back(get_bytes(&buf[20 + 8*col], 8));
+            offset += chunk.columnSize.back();
+        }
+        if (chunk.nframes <= 0 || gmx_fseek(columns->fp, offset, SEEK_SET) != 0)
+        {
+            return false;
+        }
+        nfound += chunk.nframes;
+        columns->chunks.push_back(chunk);
+    }
+
+    return (nfound == columns->nframes);
+}
+
+/*! \brief Returns the size of file \p fn, -1 when it can not be opened */
+static gmx_off_t file_size(const char *fn)
+{
+    FILE     *fp;
+    gmx_off_t size = -1;
+
+    fp = fopen(fn, "rb");
+    if (fp != nullptr)
+    {
+        if (gmx_fseek(fp, 0, SEEK_END) == 0)
+        {
+            size = gmx_ftell(fp);
+        }
+        fclose(fp);
+    }
+
+    return size;
+}
+
+/*! \brief Returns whether the last frame of \p columns matches the frame at the same offset in \p ef */
+static bool last_frame_matches(const t_enxcolumns *columns, ener_file_t ef)
+{
+    t_fileio  *fio = enx_file_pointer(ef);
+    gmx_off_t  pos = gmx_fio_ftell(fio);
+    t_enxframe fr;
+    bool       bMatch;
+
+    if (columns->nframes == 0)
+    {
+        return (columns->energyFileEnd == 0);
+    }
+    init_enxframe(&fr);
+    bMatch = (gmx_fio_seek(fio, columns->lastFrameOffset) == 0 &&
+              do_enx(ef, &fr) &&
+              fr.step == columns->lastStep && fr.t == columns->lastTime &&
+              gmx_fio_ftell(fio) == columns->energyFileEnd);
+    free_enxframe(&fr);
+    gmx_fio_seek(fio, pos);
+
+    return bMatch;
+}
+
+t_enxcolumns *gmx_enxcol_open(const char *fn, ener_file_t ef,
+                              int nre, const gmx_enxnm_t *enm)
+{
+    t_enxcolumns *columns;
+
+    if (!gmx_enxcol_enabled())
+    {
+        return nullptr;
+    }
+    FILE *fp = fopen(gmx_enxcol_filename(fn).c_str(), "rb");
+    if (fp == nullptr)
+    {
+        return nullptr;
+    }
+
+    columns               = new t_enxcolumns;
+    columns->fp           = fp;
+    columns->chunk        = -1;
+    columns->frameInChunk = 0;
+    if (!read_header(columns, nre, enm) ||
+        file_size(fn) < columns->energyFileEnd ||
+        !read_chunk_table(columns) ||
+        !last_frame_matches(columns, ef))
+    {
+        gmx_enxcol_close(columns);
+        return nullptr;
+    }
+    columns->bRead.assign(enxcol_ncolumns(nre), false);
+    for (int col = 0; col < ecolNR; col++)
+    {
+        columns->bRead[col] = true;
+    }
+    columns->values.resize(enxcol_ncolumns(nre));
+
+    return columns;
+}
+
+gmx_int64_t gmx_enxcol_nframes(const t_enxcolumns *columns)
+{
+    return columns->nframes;
+}
+
+gmx_off_t gmx_enxcol_energy_file_end(const t_enxcolumns *columns)
+{
+    return columns->energyFileEnd;
+}
+
+void gmx_enxcol_select(t_enxcolumns *columns, int nset, const int set[])
+{
+    for (int i = 0; i < nset; i++)
+    {
+        GMX_RELEASE_ASSERT(set[i] >= 0 && set[i] < columns->nterms, "Selected terms should exist");
+        for (int c = 0; c < c_enxcolColumnsPerTerm; c++)
+        {
+            columns->bRead[ecolNR + c_enxcolColumnsPerTerm*set[i] + c] = true;
+        }
+    }
+}
+
+/*! \brief Reads and decodes the selected columns of chunk \p c */
+static void read_chunk(t_enxcolumns *columns, int c)
+{
+    const t_enxcolchunk       &chunk = columns->chunks[c];
+    std::vector<unsigned char> buf;
+
+    for (size_t col = 0; col < columns->bRead.size(); col++)
+    {
+        if (columns->bRead[col])
+        {
+            if (gmx_fseek(columns->fp, chunk.columnOffset[col], SEEK_SET) != 0 ||
+                !read_bytes(columns->fp, &buf, chunk.columnSize[col]) ||
+                !decode_column(buf, col, chunk.nframes, &columns->values[col]))
+            {
+                gmx_fatal(FARGS, "Corrupt data in columnar energy file, remove it or rebuild it with gmx enecolumns -rebuild");
+            }
+        }
+    }
+    columns->chunk        = c;
+    columns->frameInChunk = 0;
+}
+
+gmx_bool gmx_enxcol_read_frame(t_enxcolumns *columns, t_enxframe *fr)
+{
+    if (columns->chunk < 0 ||
+        columns->frameInChunk == columns->chunks[columns->chunk].nframes)
+    {
+        if (columns->chunk + 1 == static_cast<int>(columns->chunks.size()))
+        {
+            return FALSE;
+        }
+        read_chunk(columns, columns->chunk + 1);
+    }
+
+    const int                                      i      = columns->frameInChunk++;
+    const std::vector<std::vector<gmx_uint64_t> > &values = columns->values;
+
+    fr->t      = bits_to_double(values[ecolTime][i]);
+    fr->step   = values[ecolStep][i];
+    fr->nsteps = values[ecolNsteps][i];
+    fr->dt     = bits_to_double(values[ecolDt][i]);
+    fr->nsum   = values[ecolNsum][i];
+    fr->nre    = values[ecolNre][i];
+    fr->nblock = 0;
+    if (fr->e_alloc < columns->nterms)
+    {
+        fr->e_alloc = columns->nterms;
+        srenew(fr->ener, fr->e_alloc);
+    }
+    for (int term = 0; term < columns->nterms; term++)
+    {
+        int col = ecolNR + c_enxcolColumnsPerTerm*term;
+        if (columns->bRead[col])
+        {
+            fr->ener[term].e    = bits_to_double(values[col    ][i]);
+            fr->ener[term].eav  = bits_to_double(values[col + 1][i]);
+            fr->ener[term].esum = bits_to_double(values[col + 2][i]);
+        }
+        else
+        {
+            fr->ener[term].e    = 0;
+            fr->ener[term].eav  = 0;
+            fr->ener[term].esum = 0;
+        }
+    }
+
+    return TRUE;
+}
+
+void gmx_enxcol_close(t_enxcolumns *columns)
+{
+    if (columns != nullptr)
+    {
+        if (columns->fp != nullptr)
+        {
+            fclose(columns->fp);
+        }
+        delete columns;
+    }
+}
+
+/*! \brief Writes the \p nframes frames in \p values as a chunk to \p fp */
+static void write_chunk(FILE *fp, std::vector<std::vector<gmx_uint64_t> > *values,
+                        gmx_off_t energyOffset)
+{
+    const int                                ncol    = values->size();
+    const int                                nframes = (*values)[0].size();
+    std::vector<unsigned char>               header;
+    std::vector<std::vector<unsigned char> > data(ncol);
+
+    put_bytes(&header, c_enxcolChunkMagic, 4);
+    put_bytes(&header, nframes, 4);
+    put_bytes(&header, ncol, 4);
+    put_bytes(&header, energyOffset, 8);
+    for (int col = 0; col < ncol; col++)
+    {
+        encode_column((*values)[col], col, &data[col]);
+        put_bytes(&header, data[col].size(), 8);
+        (*values)[col].clear();
+    }
+    bool bOK = (fwrite(header.data(), 1, header.size(), fp) == header.size());
+    for (int col = 0; col < ncol && bOK; col++)
+    {
+        bOK = (fwrite(data[col].data(), 1, data[col].size(), fp) == data[col].size());
+    }
+    if (!bOK)
+    {
+        gmx_file("Cannot write columnar energy file");
+    }
+}
+
+gmx_int64_t gmx_enxcol_update(const char *fn, gmx_bool bRebuild, gmx_int64_t *nnew)
+{
+    ener_file_t                             ef;
+    t_fileio                               *fio;
+    int                                     nre;
+    gmx_enxnm_t                            *enm = nullptr;
+    t_enxcolumns                           *columns;
+    std::string                             colfn = gmx_enxcol_filename(fn);
+    FILE                                   *fp;
+    t_enxframe                              fr;
+    gmx_int64_t                             nold;
+    gmx_off_t                               chunkEnergyOffset = 0;
+    std::vector<std::vector<gmx_uint64_t> > values;
+
+    ef  = open_enx(fn, "r");
+    fio = enx_file_pointer(ef);
+    do_enxnms(ef, &nre, &enm);
+
+    columns = (bRebuild ? nullptr : gmx_enxcol_open(fn, ef, nre, enm));
+    if (columns != nullptr && !columns->chunks.empty())
+    {
+        /* Continue after the last full chunk, so appending a few frames
+         * at a time does not accumulate small chunks.
+         */
+        const t_enxcolchunk &last = columns->chunks.back();
+        gmx_off_t            truncateAt;
+        gmx_off_t            energyOffset;
+
+        nold = columns->nframes;
+        if (last.nframes < c_enxcolFramesPerChunk)
+        {
+            truncateAt        = last.offset;
+            energyOffset      = last.energyOffset;
+            columns->nframes -= last.nframes;
+        }
+        else
+        {
+            truncateAt   = file_size(colfn.c_str());
+            energyOffset = columns->energyFileEnd;
+        }
+        fclose(columns->fp);
+        columns->fp = nullptr;
+        if (gmx_truncate(colfn.c_str(), truncateAt) != 0)
+        {
+            gmx_file(colfn.c_str());
+        }
+        fp = gmx_ffopen(colfn.c_str(), "r+b");
+        if (gmx_fseek(fp, 0, SEEK_END) != 0 || gmx_fio_seek(fio, energyOffset) != 0)
+        {
+            gmx_file(colfn.c_str());
+        }
+        columns->fp = fp;
+    }
+    else
+    {
+        gmx_enxcol_close(columns);
+        fp                       = gmx_ffopen(colfn.c_str(), "wb");
+        columns                  = new t_enxcolumns;
+        columns->fp              = fp;
+        columns->nterms          = nre;
+        columns->nframes         = 0;
+        columns->energyFileEnd   = 0;
+        columns->lastFrameOffset = 0;
+        columns->lastStep        = 0;
+        columns->lastTime        = 0;
+        write_fixed_header(fp, columns);
+        write_term_names(fp, nre, enm);
+        nold                     = 0;
+    }
+
+    values.resize(enxcol_ncolumns(nre));
+    init_enxframe(&fr);
+    gmx_off_t frameOffset = gmx_fio_ftell(fio);
+    while (do_enx(ef, &fr))
+    {
+        if (fr.nre != 0 && fr.nre != nre)
+        {
+            gmx_fatal(FARGS, "Frame at time %g in energy file %s has %d instead of %d energy terms",
+                      fr.t, fn, fr.nre, nre);
+        }
+        if (values[0].empty())
+        {
+            chunkEnergyOffset = frameOffset;
+        }
+        values[ecolTime].push_back(double_to_bits(fr.t));
+        values[ecolStep].push_back(fr.step);
+        values[ecolNsteps].push_back(fr.nsteps);
+        values[ecolDt].push_back(double_to_bits(fr.dt));
+        values[ecolNsum].push_back(fr.nsum);
+        values[ecolNre].push_back(fr.nre);
+        for (int term = 0; term < nre; term++)
+        {
+            int    col = ecolNR + c_enxcolColumnsPerTerm*term;
+            bool   bE  = (fr.nre > 0);
+            values[col    ].push_back(double_to_bits(bE ? fr.ener[term].e : 0));
+            values[col + 1].push_back(double_to_bits(bE ? fr.ener[term].eav : 0));
+            values[col + 2].push_back(double_to_bits(bE ? fr.ener[term].esum : 0));
+        }
+        columns->lastFrameOffset = frameOffset;
+        columns->lastStep        = fr.step;
+        columns->lastTime        = fr.t;
+        columns->nframes++;
+        frameOffset              = gmx_fio_ftell(fio);
+        columns->energyFileEnd   = frameOffset;
+        if (static_cast<int>(values[0].size()) == c_enxcolFramesPerChunk)
+        {
+            write_chunk(fp, &values, chunkEnergyOffset);
+        }
+    }
+    if (!values[0].empty())
+    {
+        write_chunk(fp, &values, chunkEnergyOffset);
+    }
+    write_fixed_header(fp, columns);
+    gmx_ffclose(fp);
+
+    gmx_int64_t nframes = columns->nframes;
+    *nnew               = nframes - nold;
+    delete columns;
+    free_enxframe(&fr);
+    free_enxnms(nre, enm);
+    close_enx(ef);
+
+    return nframes;
+}
@@ -0,0 +1,116 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares the columnar companion files of energy files.
+ *
+ * Energy files store all terms of a frame together, so extracting a
+ * few terms requires reading and decoding the whole file. A columnar
+ * companion file, named by appending ".ecol" to the energy file name,
+ * stores the same energies in chunks of frames, with each quantity
+ * of a chunk stored as a separately compressed column, so that only
+ * the columns of the requested terms need to be read. Only the frame
+ * times, steps, sums and the energy terms are stored; the data blocks
+ * of energy frames (restraint and free-energy data) are not.
+ *
+ * The companion is created and extended by gmx enecolumns. It is only
+ * used as far as it is consistent with the energy file, frames added
+ * to the energy file later are read from the energy file. Setting the
+ * environment variable GMX_NO_ENERGY_COLUMNS disables its use.
+ *
+ * \inlibraryapi
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_ENXCOLUMNS_H
+#define GMX_FILEIO_ENXCOLUMNS_H
+
+#include <string>
+
+#include "gromacs/fileio/enxio.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/futil.h"
+
+/*! \libinternal \brief Reader for a columnar energy file, the contents are private */
+struct t_enxcolumns;
+
+/*! \brief Returns whether columnar energy files should be used */
+gmx_bool gmx_enxcol_enabled();
+
+/*! \brief Returns the name of the columnar file for energy file \p fn */
+std::string gmx_enxcol_filename(const char *fn);
+
+/*! \brief Creates or extends the columnar file of energy file \p fn
+ *
+ * Unless \p bRebuild is set, an existing columnar file that is
+ * consistent with the energy file is extended with the frames that
+ * were added to the energy file, otherwise the file is written anew.
+ * Returns the number of frames in the columnar file and in \p nnew
+ * the number of frames that were added.
+ */
+gmx_int64_t gmx_enxcol_update(const char *fn, gmx_bool bRebuild, gmx_int64_t *nnew);
+
+/*! \brief Opens the columnar file of the energy file \p fn opened as \p ef
+ *
+ * \p nre and \p enm are the energy terms of \p ef, as returned by
+ * do_enxnms(). Returns nullptr when there is no columnar file, when
+ * it is disabled or when it is not consistent with the energy file.
+ * The read position of \p ef is not changed.
+ */
+t_enxcolumns *gmx_enxcol_open(const char *fn, ener_file_t ef,
+                              int nre, const gmx_enxnm_t *enm);
+
+/*! \brief Returns the number of frames in \p columns */
+gmx_int64_t gmx_enxcol_nframes(const t_enxcolumns *columns);
+
+/*! \brief Returns the position in the energy file after the last frame in \p columns */
+gmx_off_t gmx_enxcol_energy_file_end(const t_enxcolumns *columns);
+
+/*! \brief Selects the \p nset energy terms with indices \p set to be read
+ *
+ * By default no terms are read.
+ */
+void gmx_enxcol_select(t_enxcolumns *columns, int nset, const int set[]);
+
+/*! \brief Reads the next frame from \p columns into \p fr
+ *
+ * Only the selected terms are set, the other terms are zero.
+ * \p fr has no blocks. Returns FALSE after the last frame.
+ */
+gmx_bool gmx_enxcol_read_frame(t_enxcolumns *columns, t_enxframe *fr);
+
+/*! \brief Closes \p columns, which can be nullptr */
+void gmx_enxcol_close(t_enxcolumns *columns);
+
+#endif
@@ -58,6 +58,8 @@
 
 #include "gromacs/fileio/xdrf.h"
 
+struct t_fio_mmap;
+
 struct t_fileio
 {
     FILE           *fp;                /* the file pointer */
@@ -68,6 +70,14 @@ struct t_fileio
     XDR         *xdr;                  /* the xdr data pointer */
     enum xdr_op  xdrmode;              /* the xdr mode */
     int          iFTP;                 /* the file type identifier */
+    FILE        *fpFrameIndex;         /* the frame index sidecar, NULL when
+                                          frames are not indexed */
+    t_fio_mmap  *mapping;              /* the memory mapping xdr reads from,
+                                          NULL when reading through fp */
+    gmx_off_t     chksumOffset;        /* the file offset chksum was computed at,
+                                          -1 when no checksum is cached */
+    int           chksumSize;          /* the return value of the md5 computation */
+    unsigned char chksum[16];          /* the cached md5 sum of the output file */
 
     t_fileio    *next, *prev;          /* next and previous file pointers in the
                                           linked list */
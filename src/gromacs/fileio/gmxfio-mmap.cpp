@@ -0,0 +1,368 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "gmxfio-mmap.h"
+
+#include "config.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+
+#if GMX_INTERNAL_XDR && HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "gromacs/utility/smalloc.h"
+
+/* Mapping replaces the operations of the XDR stream, which is only
+ * possible with our own XDR implementation.
+ */
+#if GMX_INTERNAL_XDR && HAVE_MMAP
+
+/* Accessing a mapped page beyond the end of the file raises SIGBUS,
+ * so when the file is truncated while it is mapped, reading the
+ * truncated part should be avoided. The file size is therefore
+ * checked again before every bulk read, such as the coordinates of
+ * a frame, and before reading beyond this many bytes after the last
+ * check. A truncated file then appears to end at the new size, as
+ * with buffered reading. Only truncation during the read of a single
+ * frame or interval can not be detected.
+ */
+static const gmx_off_t c_mmapCheckInterval = 65536;
+
+struct t_fio_mmap
+{
+    int                  fd;         /* the file descriptor of the mapped file */
+    const unsigned char *data;       /* the mapped data, nullptr when size is 0 */
+    gmx_off_t            size;       /* the number of mapped bytes */
+    gmx_off_t            pos;        /* the read position */
+    gmx_off_t            checkedEnd; /* reads up to here need no check of the file size */
+};
+
+/* (Re)maps the whole file when its size changed, returns FALSE when that is not possible */
+static gmx_bool mmap_map_file(t_fio_mmap *mapping)
+{
+    struct stat st;
+    void       *addr = nullptr;
+
+    if (fstat(mapping->fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return FALSE;
+    }
+    gmx_off_t size = st.st_size;
+    if (size == mapping->size)
+    {
+        return TRUE;
+    }
+    if (static_cast<gmx_off_t>(static_cast<size_t>(size)) != size)
+    {
+        /* The file does not fit in the address space */
+        return FALSE;
+    }
+    if (size > 0)
+    {
+        addr = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, mapping->fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            return FALSE;
+        }
+#if HAVE_POSIX_MADVISE
+        /* Trajectories are mostly read from start to end, ask for
+         * aggressive readahead. This is only a hint, so errors are ignored.
+         */
+        posix_madvise(addr, static_cast<size_t>(size), POSIX_MADV_SEQUENTIAL);
+#endif
+    }
+    if (mapping->data != nullptr)
+    {
+        munmap(const_cast<unsigned char *>(mapping->data), static_cast<size_t>(mapping->size));
+    }
+    mapping->data = static_cast<const unsigned char *>(addr);
+    mapping->size = size;
+
+    return TRUE;
+}
+
+/* Returns whether len bytes can be read, remaps the file when it has grown or
+ * has been truncated. With bBulk the file size is always checked.
+ */
+static inline gmx_bool mmap_available(t_fio_mmap *mapping, gmx_off_t len, gmx_bool bBulk)
+{
+    gmx_off_t end = mapping->pos + len;
+
+    if (!bBulk && end <= mapping->checkedEnd)
+    {
+        return TRUE;
+    }
+    if (!mmap_map_file(mapping))
+    {
+        return FALSE;
+    }
+    mapping->checkedEnd = std::min(mapping->size, bBulk ? end : end + c_mmapCheckInterval);
+
+    return (end <= mapping->size);
+}
+
+/* Returns the 32-bit big-endian XDR integer at p */
+static inline xdr_uint32_t mmap_load32(const unsigned char *p)
+{
+    return ((static_cast<xdr_uint32_t>(p[0]) << 24) |
+            (static_cast<xdr_uint32_t>(p[1]) << 16) |
+            (static_cast<xdr_uint32_t>(p[2]) <<  8) |
+            static_cast<xdr_uint32_t>(p[3]));
+}
+
+static bool_t xdrmmap_getbytes(XDR *xdrs, char *addr, unsigned int len)
+{
+    t_fio_mmap *mapping = reinterpret_cast<t_fio_mmap *>(xdrs->x_private);
+
+    if (!mmap_available(mapping, len, TRUE))
+    {
+        return FALSE;
+    }
+    if (len > 0)
+    {
+        std::memcpy(addr, mapping->data + mapping->pos, len);
+        mapping->pos += len;
+    }
+    return TRUE;
+}
+
+static bool_t xdrmmap_putbytes(XDR gmx_unused *xdrs, char gmx_unused *addr, unsigned int gmx_unused len)
+{
+    return FALSE;
+}
+
+static unsigned int xdrmmap_getpos(XDR *xdrs)
+{
+    return static_cast<unsigned int>(reinterpret_cast<t_fio_mmap *>(xdrs->x_private)->pos);
+}
+
+static bool_t xdrmmap_setpos(XDR *xdrs, unsigned int pos)
+{
+    t_fio_mmap *mapping = reinterpret_cast<t_fio_mmap *>(xdrs->x_private);
+
+    mapping->pos        = pos;
+    mapping->checkedEnd = 0;
+    return TRUE;
+}
+
+static xdr_int32_t *xdrmmap_inline(XDR gmx_unused *xdrs, int gmx_unused len)
+{
+    return nullptr;
+}
+
+static void xdrmmap_destroy(XDR gmx_unused *xdrs)
+{
+    /* The mapping is owned by the t_fileio */
+}
+
+static bool_t xdrmmap_getuint32(XDR *xdrs, xdr_uint32_t *ip)
+{
+    t_fio_mmap *mapping = reinterpret_cast<t_fio_mmap *>(xdrs->x_private);
+
+    if (!mmap_available(mapping, 4, FALSE))
+    {
+        return FALSE;
+    }
+    *ip           = mmap_load32(mapping->data + mapping->pos);
+    mapping->pos += 4;
+    return TRUE;
+}
+
+static bool_t xdrmmap_getint32(XDR *xdrs, xdr_int32_t *ip)
+{
+    xdr_uint32_t u;
+
+    if (!xdrmmap_getuint32(xdrs, &u))
+    {
+        return FALSE;
+    }
+    *ip = static_cast<xdr_int32_t>(u);
+    return TRUE;
+}
+
+static bool_t xdrmmap_putint32(XDR gmx_unused *xdrs, xdr_int32_t gmx_unused *ip)
+{
+    return FALSE;
+}
+
+static bool_t xdrmmap_putuint32(XDR gmx_unused *xdrs, xdr_uint32_t gmx_unused *ip)
+{
+    return FALSE;
+}
+
+static struct XDR::xdr_ops xdrmmap_ops =
+{
+    xdrmmap_getbytes,  /* deserialize counted bytes */
+    xdrmmap_putbytes,  /* serialize counted bytes */
+    xdrmmap_getpos,    /* get offset in the stream */
+    xdrmmap_setpos,    /* set offset in the stream */
+    xdrmmap_inline,    /* prime stream for inline macros */
+    xdrmmap_destroy,   /* destroy stream */
+    xdrmmap_getint32,  /* deserialize a int */
+    xdrmmap_putint32,  /* serialize a int */
+    xdrmmap_getuint32, /* deserialize a int */
+    xdrmmap_putuint32  /* serialize a int */
+};
+
+t_fio_mmap *gmx_fio_mmap_create(FILE *fp, XDR *xdr)
+{
+    t_fio_mmap *mapping;
+
+    if (getenv("GMX_NO_MMAP_TRAJECTORY") != nullptr)
+    {
+        return nullptr;
+    }
+
+    snew(mapping, 1);
+    mapping->fd   = fileno(fp);
+    mapping->data = nullptr;
+    mapping->size       = 0;
+    mapping->pos        = 0;
+    mapping->checkedEnd = 0;
+    if (!mmap_map_file(mapping))
+    {
+        sfree(mapping);
+        return nullptr;
+    }
+
+    xdr->x_op      = XDR_DECODE;
+    xdr->x_ops     = &xdrmmap_ops;
+    xdr->x_private = reinterpret_cast<char *>(mapping);
+
+    return mapping;
+}
+
+void gmx_fio_mmap_destroy(t_fio_mmap *mapping)
+{
+    if (mapping->data != nullptr)
+    {
+        munmap(const_cast<unsigned char *>(mapping->data), static_cast<size_t>(mapping->size));
+    }
+    sfree(mapping);
+}
+
+gmx_off_t gmx_fio_mmap_tell(const t_fio_mmap *mapping)
+{
+    return mapping->pos;
+}
+
+int gmx_fio_mmap_seek(t_fio_mmap *mapping, gmx_off_t pos)
+{
+    if (pos < 0)
+    {
+        return -1;
+    }
+    mapping->pos        = pos;
+    mapping->checkedEnd = 0;
+    return 0;
+}
+
+gmx_bool gmx_fio_mmap_get_rvecs(t_fio_mmap *mapping, rvec *x, int n, gmx_bool bDouble)
+{
+    const int            valueSize = (bDouble ? sizeof(double) : sizeof(float));
+    const gmx_off_t      nbytes    = static_cast<gmx_off_t>(n)*DIM*valueSize;
+    const unsigned char *p;
+
+    if (!mmap_available(mapping, nbytes, TRUE))
+    {
+        return FALSE;
+    }
+    p             = mapping->data + mapping->pos;
+    mapping->pos += nbytes;
+    if (x == nullptr)
+    {
+        return TRUE;
+    }
+
+    real *xr = x[0];
+    if (bDouble)
+    {
+        for (int i = 0; i < n*DIM; i++)
+        {
+            gmx_uint64_t u = ((static_cast<gmx_uint64_t>(mmap_load32(p + 8*i)) << 32) |
+                              mmap_load32(p + 8*i + 4));
+            double       d;
+            std::memcpy(&d, &u, sizeof(d));
+            xr[i] = d;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < n*DIM; i++)
+        {
+            xdr_uint32_t u = mmap_load32(p + 4*i);
+            float        f;
+            std::memcpy(&f, &u, sizeof(f));
+            xr[i] = f;
+        }
+    }
+
+    return TRUE;
+}
+
+#else
+
+t_fio_mmap *gmx_fio_mmap_create(FILE gmx_unused *fp, XDR gmx_unused *xdr)
+{
+    return nullptr;
+}
+
+void gmx_fio_mmap_destroy(t_fio_mmap gmx_unused *mapping)
+{
+}
+
+gmx_off_t gmx_fio_mmap_tell(const t_fio_mmap gmx_unused *mapping)
+{
+    return -1;
+}
+
+int gmx_fio_mmap_seek(t_fio_mmap gmx_unused *mapping, gmx_off_t gmx_unused pos)
+{
+    return -1;
+}
+
+gmx_bool gmx_fio_mmap_get_rvecs(t_fio_mmap gmx_unused *mapping, rvec gmx_unused *x,
+                                int gmx_unused n, gmx_bool gmx_unused bDouble)
+{
+    return FALSE;
+}
+
+#endif
@@ -0,0 +1,86 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Declares memory-mapped reading of XDR trajectory files for gmxfio.
+ *
+ * XTC, TRR and TPR files that are opened read-only are mapped into memory
+ * and the XDR stream of the t_fileio reads directly from the mapped
+ * pages, instead of copying every field through the stdio buffer.
+ * The mapping requires the internal XDR implementation, since the
+ * stream operations are replaced. When mapping is not possible, or
+ * the environment variable GMX_NO_MMAP_TRAJECTORY is set, the files
+ * are read through stdio as before.
+ */
+#ifndef GMX_FILEIO_GMXFIO_MMAP_H
+#define GMX_FILEIO_GMXFIO_MMAP_H
+
+#include <cstdio>
+
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/futil.h"
+
+/*! \internal \brief A read-only memory mapping of a file */
+struct t_fio_mmap;
+
+/*! \brief Maps the regular file \p fp into memory and sets up \p xdr to read from it
+ *
+ * Returns nullptr, without touching \p xdr, when mapping is disabled,
+ * not supported or fails. The mapping follows the size of the file,
+ * so reading continues when the file grows and stops at the new end
+ * when the file is truncated while it is read.
+ */
+t_fio_mmap *gmx_fio_mmap_create(FILE *fp, XDR *xdr);
+
+/*! \brief Unmaps the file, the XDR stream using it should be destroyed first */
+void gmx_fio_mmap_destroy(t_fio_mmap *mapping);
+
+/*! \brief Returns the read position in the file */
+gmx_off_t gmx_fio_mmap_tell(const t_fio_mmap *mapping);
+
+/*! \brief Sets the read position in the file, returns 0 on success */
+int gmx_fio_mmap_seek(t_fio_mmap *mapping, gmx_off_t pos);
+
+/*! \brief Reads \p n XDR vectors of floats or, with \p bDouble, doubles into \p x
+ *
+ * The values are converted directly from the mapped pages. When \p x
+ * is nullptr the vectors are skipped. Returns FALSE when the file
+ * ends before all vectors.
+ */
+gmx_bool gmx_fio_mmap_get_rvecs(t_fio_mmap *mapping, rvec *x, int n, gmx_bool bDouble);
+
+#endif
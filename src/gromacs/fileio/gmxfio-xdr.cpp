@@ -48,6 +48,7 @@
 #include "gromacs/utility/smalloc.h"
 
 #include "gmxfio-impl.h"
+#include "gmxfio-mmap.h"
 
 /* Enumerated for data types in files */
 enum {
@@ -264,6 +265,12 @@ static gmx_bool do_xdr(t_fileio *fio, void *item, int nitem, int eio,
             }
             break;
         case eioNRVEC:
+            if (fio->mapping != nullptr)
+            {
+                /* Convert directly from the mapped file */
+                res = gmx_fio_mmap_get_rvecs(fio->mapping, (rvec *) item, nitem, fio->bDouble);
+                break;
+            }
             ptr = nullptr;
             res = 1;
             for (j = 0; (j < nitem) && res; j++)
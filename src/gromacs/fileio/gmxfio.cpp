@@ -55,12 +55,14 @@
 
 #include "gromacs/fileio/filetypes.h"
 #include "gromacs/fileio/md5.h"
+#include "gromacs/fileio/trajectoryindex.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/mutex.h"
 #include "gromacs/utility/smalloc.h"
 
 #include "gmxfio-impl.h"
+#include "gmxfio-mmap.h"
 
 /* This is the new improved and thread safe version of gmxfio. */
 
@@ -98,6 +100,10 @@ static int gmx_fio_int_flush(t_fileio* fio)
     {
         rc = fflush(fio->fp);
     }
+    if (fio->fpFrameIndex)
+    {
+        fflush(fio->fpFrameIndex);
+    }
 
     return rc;
 }
@@ -305,8 +311,10 @@ t_fileio *gmx_fio_open(const char *fn, const char *mode)
     tMPI_Lock_init(&(fio->mtx));
     bRead      = (newmode[0] == 'r' && newmode[1] != '+');
     bReadWrite = (newmode[1] == '+');
-    fio->fp    = nullptr;
-    fio->xdr   = nullptr;
+    fio->fp           = nullptr;
+    fio->xdr          = nullptr;
+    fio->fpFrameIndex = nullptr;
+    fio->mapping      = nullptr;
     if (fn)
     {
         if (fn2ftp(fn) == efTNG)
@@ -330,7 +338,18 @@ t_fileio *gmx_fio_open(const char *fn, const char *mode)
                 fio->xdrmode = XDR_DECODE;
             }
             snew(fio->xdr, 1);
-            xdrstdio_create(fio->xdr, fio->fp, fio->xdrmode);
+            /* Trajectories and run input files that are only read are
+             * read from a memory mapping, when possible, which avoids
+             * copying all data through the stdio buffer.
+             */
+            if (bRead && (fio->iFTP == efXTC || fio->iFTP == efTRR || fio->iFTP == efTPR))
+            {
+                fio->mapping = gmx_fio_mmap_create(fio->fp, fio->xdr);
+            }
+            if (fio->mapping == nullptr)
+            {
+                xdrstdio_create(fio->xdr, fio->fp, fio->xdrmode);
+            }
         }
 
         /* for appending seek to end of file to make sure ftell gives correct position
@@ -339,6 +358,13 @@ t_fileio *gmx_fio_open(const char *fn, const char *mode)
         {
             gmx_fseek(fio->fp, 0, SEEK_END);
         }
+
+        /* A frame index of an overwritten trajectory is stale */
+        if (newmode[0] == 'w' && (fio->iFTP == efXTC || fio->iFTP == efTRR))
+        {
+            remove(gmx_trxindex_filename(fn).c_str());
+        }
+
     }
     else
     {
@@ -348,6 +374,7 @@ t_fileio *gmx_fio_open(const char *fn, const char *mode)
     fio->bRead             = bRead;
     fio->bReadWrite        = bReadWrite;
     fio->bDouble           = (sizeof(real) == sizeof(double));
+    fio->chksumOffset      = -1;
 
     /* and now insert this file into the list of open files. */
     gmx_fio_insert(fio);
@@ -364,12 +391,24 @@ static int gmx_fio_close_locked(t_fileio *fio)
         sfree(fio->xdr);
     }
 
+    if (fio->mapping != nullptr)
+    {
+        gmx_fio_mmap_destroy(fio->mapping);
+        fio->mapping = nullptr;
+    }
+
     if (fio->fp != nullptr)
     {
         rc = gmx_ffclose(fio->fp); /* fclose returns 0 if happy */
 
     }
 
+    if (fio->fpFrameIndex != nullptr)
+    {
+        fclose(fio->fpFrameIndex);
+        fio->fpFrameIndex = nullptr;
+    }
+
     return rc;
 }
 
@@ -607,10 +646,20 @@ int gmx_fio_get_output_file_positions(gmx_file_position_t **p_outputfiles,
             /* Get the file position */
             gmx_fio_int_get_file_position(cur, &outputfiles[nfiles].offset);
 #ifndef GMX_FAHCORE
-            outputfiles[nfiles].chksum_size
-                = gmx_fio_int_get_file_md5(cur,
-                                           outputfiles[nfiles].offset,
-                                           outputfiles[nfiles].chksum);
+            /* Output files are only appended to, so when nothing was written
+             * since the previous checkpoint the checksum is still valid.
+             * This avoids re-reading files that are written rarely.
+             */
+            if (cur->chksumOffset != outputfiles[nfiles].offset)
+            {
+                cur->chksumSize
+                    = gmx_fio_int_get_file_md5(cur,
+                                               outputfiles[nfiles].offset,
+                                               cur->chksum);
+                cur->chksumOffset = outputfiles[nfiles].offset;
+            }
+            outputfiles[nfiles].chksum_size = cur->chksumSize;
+            std::memcpy(outputfiles[nfiles].chksum, cur->chksum, sizeof(cur->chksum));
 #endif
             nfiles++;
         }
@@ -648,8 +697,13 @@ int gmx_fio_getftp(t_fileio* fio)
 void gmx_fio_rewind(t_fileio* fio)
 {
     gmx_fio_lock(fio);
+    fio->chksumOffset = -1;
 
-    if (fio->xdr)
+    if (fio->mapping)
+    {
+        gmx_fio_mmap_seek(fio->mapping, 0);
+    }
+    else if (fio->xdr)
     {
         xdr_destroy(fio->xdr);
         frewind(fio->fp);
@@ -684,6 +738,10 @@ static int gmx_fio_int_fsync(t_fileio *fio)
     {
         rc = gmx_fsync(fio->fp);
     }
+    if (fio->fpFrameIndex)
+    {
+        gmx_fsync(fio->fpFrameIndex);
+    }
     return rc;
 }
 
@@ -742,7 +800,11 @@ gmx_off_t gmx_fio_ftell(t_fileio* fio)
     gmx_off_t ret = 0;
 
     gmx_fio_lock(fio);
-    if (fio->fp)
+    if (fio->mapping)
+    {
+        ret = gmx_fio_mmap_tell(fio->mapping);
+    }
+    else if (fio->fp)
     {
         ret = gmx_ftell(fio->fp);
     }
@@ -750,12 +812,41 @@ gmx_off_t gmx_fio_ftell(t_fileio* fio)
     return ret;
 }
 
+void gmx_fio_open_frame_index(t_fileio *fio, gmx_bool bAppend)
+{
+    gmx_fio_lock(fio);
+    if (fio->fpFrameIndex == nullptr && !fio->bRead &&
+        (fio->iFTP == efXTC || fio->iFTP == efTRR))
+    {
+        fio->fpFrameIndex = gmx_trxindex_open_for_writing(fio->fn, bAppend,
+                                                          gmx_ftell(fio->fp));
+    }
+    gmx_fio_unlock(fio);
+}
+
+void gmx_fio_add_frame_to_index(t_fileio *fio, gmx_off_t start,
+                                gmx_int64_t step, double time)
+{
+    gmx_fio_lock(fio);
+    if (fio->fpFrameIndex)
+    {
+        gmx_trxindex_write_frame(fio->fpFrameIndex, start,
+                                 gmx_ftell(fio->fp) - start, step, time);
+    }
+    gmx_fio_unlock(fio);
+}
+
 int gmx_fio_seek(t_fileio* fio, gmx_off_t fpos)
 {
     int rc;
 
     gmx_fio_lock(fio);
-    if (fio->fp)
+    fio->chksumOffset = -1;
+    if (fio->mapping)
+    {
+        rc = gmx_fio_mmap_seek(fio->mapping, fpos);
+    }
+    else if (fio->fp)
     {
         rc = gmx_fseek(fio->fp, fpos, SEEK_SET);
     }
@@ -792,12 +883,55 @@ gmx_bool gmx_fio_getread(t_fileio* fio)
     return ret;
 }
 
+/* The XTC search routines position fp themselves, so for a mapped
+ * file they read through a temporary stdio XDR stream. Returns the
+ * stream to use, which should be passed to fio_end_stdio_xdr() after use.
+ */
+static XDR *fio_begin_stdio_xdr(t_fileio *fio, XDR *xdrStdio)
+{
+    if (fio->mapping == nullptr)
+    {
+        return fio->xdr;
+    }
+    gmx_fseek(fio->fp, gmx_fio_mmap_tell(fio->mapping), SEEK_SET);
+    xdrstdio_create(xdrStdio, fio->fp, XDR_DECODE);
+
+    return xdrStdio;
+}
+
+/* Continues reading from the mapping where the stdio stream ended */
+static void fio_end_stdio_xdr(t_fileio *fio, XDR *xdr)
+{
+    if (fio->mapping != nullptr)
+    {
+        xdr_destroy(xdr);
+        gmx_fio_mmap_seek(fio->mapping, gmx_ftell(fio->fp));
+    }
+}
+
 int xtc_seek_time(t_fileio *fio, real time, int natoms, gmx_bool bSeekForwardOnly)
 {
-    int ret;
+    XDR  xdrStdio, *xdr;
+    int  ret;
+
+    gmx_fio_lock(fio);
+    xdr = fio_begin_stdio_xdr(fio, &xdrStdio);
+    ret = xdr_xtc_seek_time(time, fio->fp, xdr, natoms, bSeekForwardOnly);
+    fio_end_stdio_xdr(fio, xdr);
+    gmx_fio_unlock(fio);
+
+    return ret;
+}
+
+float xtc_get_last_frame_time(t_fileio *fio, int natoms, gmx_bool *bOK)
+{
+    XDR   xdrStdio, *xdr;
+    float ret;
 
     gmx_fio_lock(fio);
-    ret = xdr_xtc_seek_time(time, fio->fp, fio->xdr, natoms, bSeekForwardOnly);
+    xdr = fio_begin_stdio_xdr(fio, &xdrStdio);
+    ret = xdr_xtc_get_last_frame_time(fio->fp, xdr, natoms, bOK);
+    fio_end_stdio_xdr(fio, xdr);
     gmx_fio_unlock(fio);
 
     return ret;
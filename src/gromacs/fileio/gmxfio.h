@@ -132,6 +132,19 @@ gmx_off_t gmx_fio_ftell(t_fileio *fio);
 int gmx_fio_seek(t_fileio *fio, gmx_off_t fpos);
 /* Set file position if possible, quit otherwise */
 
+void gmx_fio_open_frame_index(t_fileio *fio, gmx_bool bAppend);
+/* Start maintaining the .fidx frame index of XTC or TRR file fio,
+ * which should be opened for writing. With bAppend the existing
+ * index is extended, see trajectoryindex.h. Only mdrun does this,
+ * trajectories written by other tools get no index. */
+
+void gmx_fio_add_frame_to_index(t_fileio *fio, gmx_off_t start,
+                                gmx_int64_t step, double time);
+/* Record a trajectory frame that starts at start and ends at the
+ * current position in the frame index of fio, if fio has one.
+ * Only files for which gmx_fio_open_frame_index was called
+ * have a frame index. */
+
 FILE *gmx_fio_getfp(t_fileio *fio);
 /* Return the file pointer itself */
 
@@ -180,6 +193,10 @@ int gmx_fio_get_file_md5(t_fileio *fio, gmx_off_t offset,
 
 int xtc_seek_time(t_fileio *fio, real time, int natoms, gmx_bool bSeekForwardOnly);
 
+float xtc_get_last_frame_time(t_fileio *fio, int natoms, gmx_bool *bOK);
+/* Return the time of the last frame in the XTC file fio, the file
+ * position is not changed */
+
 
 #ifdef __cplusplus
 }
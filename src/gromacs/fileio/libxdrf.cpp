@@ -36,6 +36,7 @@
  */
 #include "gmxpre.h"
 
+#include <cfloat>
 #include <climits>
 #include <cmath>
 #include <cstdio>
@@ -46,6 +47,7 @@
 
 #include "gromacs/fileio/xdr_datatype.h"
 #include "gromacs/fileio/xdrf.h"
+#include "gromacs/simd/simd.h"
 #include "gromacs/utility/futil.h"
 
 /* This is just for clarity - it can never be anything but 4! */
@@ -90,53 +92,6 @@ static const int magicints[] = {
 #define LASTIDX static_cast<int>((sizeof(magicints) / sizeof(*magicints)))
 
 
-/*____________________________________________________________________________
- |
- | sendbits - encode num into buf using the specified number of bits
- |
- | This routines appends the value of num to the bits already present in
- | the array buf. You need to give it the number of bits to use and you
- | better make sure that this number of bits is enough to hold the value
- | Also num must be positive.
- |
- */
-
-static void sendbits(int buf[], int num_of_bits, int num)
-{
-
-    unsigned int    cnt, lastbyte;
-    int             lastbits;
-    unsigned char * cbuf;
-
-    cbuf     = (reinterpret_cast<unsigned char *>(buf)) + 3 * sizeof(*buf);
-    cnt      = static_cast<unsigned int>(buf[0]);
-    lastbits = buf[1];
-    lastbyte = static_cast<unsigned int>(buf[2]);
-    while (num_of_bits >= 8)
-    {
-        lastbyte     = (lastbyte << 8) | ((num >> (num_of_bits -8)) /* & 0xff*/);
-        cbuf[cnt++]  = lastbyte >> lastbits;
-        num_of_bits -= 8;
-    }
-    if (num_of_bits > 0)
-    {
-        lastbyte  = (lastbyte << num_of_bits) | num;
-        lastbits += num_of_bits;
-        if (lastbits >= 8)
-        {
-            lastbits   -= 8;
-            cbuf[cnt++] = lastbyte >> lastbits;
-        }
-    }
-    buf[0] = cnt;
-    buf[1] = lastbits;
-    buf[2] = lastbyte;
-    if (lastbits > 0)
-    {
-        cbuf[cnt] = lastbyte << (8 - lastbits);
-    }
-}
-
 /*_________________________________________________________________________
  |
  | sizeofint - calculate bitsize of an integer
@@ -207,26 +162,96 @@ static int sizeofints( const int num_of_ints, unsigned int sizes[])
 
 /*____________________________________________________________________________
  |
- | sendints - send a small set of small integers in compressed format
- |
- | this routine is used internally by xdr3dfcoord, to send a set of
- | small integers to the buffer.
- | Multiplication with fixed (specified maximum ) sizes is used to get
- | to one big, multibyte integer. Allthough the routine could be
- | modified to handle sizes bigger than 16777216, or more than just
- | a few integers, this is not done, because the gain in compression
- | isn't worth the effort. Note that overflowing the multiplication
- | or the byte buffer (32 bytes) is unchecked and causes bad results.
+ | encoding of compressed coordinates
  |
+ | The bit stream is written through a 64-bit register from which whole
+ | bytes are stored, instead of updating a byte buffer for every call.
+ | Sets of small integers that fit in 64 bits are combined with plain
+ | 64-bit multiplications instead of a byte-wise long multiplication.
+ | The produced bit stream is identical to that of the original sendbits()
+ | and sendints() routines.
  */
 
-static void sendints(int buf[], const int num_of_ints, const int num_of_bits,
-                     unsigned int sizes[], unsigned int nums[])
+/* The bit stream writer state, the nbits low bits of bits are pending */
+typedef struct {
+    unsigned char *data;  /* the next byte to store */
+    gmx_uint64_t   bits;  /* the bit buffer */
+    int            nbits; /* the number of pending bits, less than 8 between calls */
+} t_xdr_bitwriter;
+
+static void bitwriter_init(t_xdr_bitwriter *bw, unsigned char *data)
 {
+    bw->data  = data;
+    bw->bits  = 0;
+    bw->nbits = 0;
+}
 
+/* Append the num_of_bits <= 32 low bits of num, num should fit in these bits */
+static inline void bitwriter_put(t_xdr_bitwriter *bw, int num_of_bits, unsigned int num)
+{
+    bw->bits   = (bw->bits << num_of_bits) | num;
+    bw->nbits += num_of_bits;
+    while (bw->nbits >= 8)
+    {
+        bw->nbits  -= 8;
+        *bw->data++ = static_cast<unsigned char>(bw->bits >> bw->nbits);
+    }
+}
+
+/* Store the pending bits, padded with zeros, returns the end of the data */
+static unsigned char *bitwriter_flush(t_xdr_bitwriter *bw)
+{
+    if (bw->nbits > 0)
+    {
+        *bw->data++ = static_cast<unsigned char>(bw->bits << (8 - bw->nbits));
+        bw->nbits   = 0;
+    }
+    return bw->data;
+}
+
+/*____________________________________________________________________________
+ |
+ | bitwriter_put_ints - send a small set of small integers in compressed format
+ |
+ | Three small integers are combined to one large integer by multiplication
+ | with their fixed (specified maximum) sizes, which is stored with its least
+ | significant byte first using num_of_bits bits. Allthough the routine could
+ | be modified to handle sizes bigger than 16777216, this is not done,
+ | because the gain in compression isn't worth the effort.
+ */
+
+static void bitwriter_put_ints(t_xdr_bitwriter *bw, const int num_of_bits,
+                               const unsigned int sizes[], const unsigned int nums[])
+{
     int          i, num_of_bytes, bytecnt;
     unsigned int bytes[32], tmp;
 
+    for (i = 1; i < 3; i++)
+    {
+        if (nums[i] >= sizes[i])
+        {
+            fprintf(stderr, "major breakdown in sendints num %u doesn't "
+                    "match size %u\n", nums[i], sizes[i]);
+            exit(1);
+        }
+    }
+
+    if (num_of_bits <= 64)
+    {
+        gmx_uint64_t num = (static_cast<gmx_uint64_t>(nums[0])*sizes[1] + nums[1])*sizes[2] + nums[2];
+
+        for (i = 8; i <= num_of_bits; i += 8)
+        {
+            bitwriter_put(bw, 8, static_cast<unsigned int>(num & 0xff));
+            num >>= 8;
+        }
+        if (num_of_bits % 8 != 0)
+        {
+            bitwriter_put(bw, num_of_bits % 8, static_cast<unsigned int>(num));
+        }
+        return;
+    }
+
     tmp          = nums[0];
     num_of_bytes = 0;
     do
@@ -236,14 +261,8 @@ static void sendints(int buf[], const int num_of_ints, const int num_of_bits,
     }
     while (tmp != 0);
 
-    for (i = 1; i < num_of_ints; i++)
+    for (i = 1; i < 3; i++)
     {
-        if (nums[i] >= sizes[i])
-        {
-            fprintf(stderr, "major breakdown in sendints num %u doesn't "
-                    "match size %u\n", nums[i], sizes[i]);
-            exit(1);
-        }
         /* use one step multiply */
         tmp = nums[i];
         for (bytecnt = 0; bytecnt < num_of_bytes; bytecnt++)
@@ -259,738 +278,661 @@ static void sendints(int buf[], const int num_of_ints, const int num_of_bits,
         }
         num_of_bytes = bytecnt;
     }
-    if (num_of_bits >= num_of_bytes * 8)
+    for (i = 0; i < num_of_bits/8; i++)
     {
-        for (i = 0; i < num_of_bytes; i++)
-        {
-            sendbits(buf, 8, bytes[i]);
-        }
-        sendbits(buf, num_of_bits - num_of_bytes * 8, 0);
+        bitwriter_put(bw, 8, i < num_of_bytes ? bytes[i] : 0);
     }
-    else
+    if (num_of_bits % 8 != 0)
     {
-        for (i = 0; i < num_of_bytes-1; i++)
-        {
-            sendbits(buf, 8, bytes[i]);
-        }
-        sendbits(buf, num_of_bits- (num_of_bytes -1) * 8, bytes[i]);
+        bitwriter_put(bw, num_of_bits % 8, i < num_of_bytes ? bytes[i] : 0);
     }
 }
 
 
-/*___________________________________________________________________________
- |
- | receivebits - decode number from buf using specified number of bits
+/*____________________________________________________________________________
  |
- | extract the number of bits from the array buf and construct an integer
- | from it. Return that value.
+ | decoding of compressed coordinates
  |
+ | The routines below are the inverse of sendbits() and sendints(). The bit
+ | stream is read through a 64-bit register that is refilled with whole
+ | words instead of byte by byte. Sets of small integers that fit in 64 bits
+ | are decoded with plain 64-bit divisions instead of the byte-wise long
+ | division that is needed for larger sets.
  */
 
-static int receivebits(int buf[], int num_of_bits)
-{
-
-    int             cnt, num, lastbits;
-    unsigned int    lastbyte;
-    unsigned char * cbuf;
-    int             mask = (1 << num_of_bits) -1;
+/* The bit stream reader state, the valid bits are the nbits low bits of bits */
+typedef struct {
+    const unsigned char *data;  /* the next byte to load */
+    const unsigned char *end;   /* the end of the compressed data */
+    gmx_uint64_t         bits;  /* the bit buffer */
+    int                  nbits; /* the number of valid bits in bits */
+} t_xdr_bitreader;
 
-    cbuf     = reinterpret_cast<unsigned char *>(buf) + 3 * sizeof(*buf);
-    cnt      = buf[0];
-    lastbits = static_cast<unsigned int>(buf[1]);
-    lastbyte = static_cast<unsigned int>(buf[2]);
+static void bitreader_init(t_xdr_bitreader *br, const unsigned char *data, int nbytes)
+{
+    br->data  = data;
+    br->end   = data + nbytes;
+    br->bits  = 0;
+    br->nbits = 0;
+}
 
-    num = 0;
-    while (num_of_bits >= 8)
+/* Fill the bit buffer with at least 57 bits, pads with zeros beyond the end of the data */
+static inline void bitreader_refill(t_xdr_bitreader *br)
+{
+    if (br->end - br->data >= 8)
     {
-        lastbyte     = ( lastbyte << 8 ) | cbuf[cnt++];
-        num         |=  (lastbyte >> lastbits) << (num_of_bits - 8);
-        num_of_bits -= 8;
+        /* Load a big-endian word and append as many whole bytes as fit */
+        gmx_uint64_t word   = 0;
+        int          nbytes = (64 - br->nbits) >> 3;
+        for (int b = 0; b < 8; b++)
+        {
+            word = (word << 8) | br->data[b];
+        }
+        if (nbytes == 8)
+        {
+            br->bits = word;
+        }
+        else
+        {
+            br->bits = (br->bits << (8*nbytes)) | (word >> (64 - 8*nbytes));
+        }
+        br->data  += nbytes;
+        br->nbits += 8*nbytes;
     }
-    if (num_of_bits > 0)
+    else
     {
-        if (lastbits < num_of_bits)
+        while (br->nbits <= 56)
         {
-            lastbits += 8;
-            lastbyte  = (lastbyte << 8) | cbuf[cnt++];
+            br->bits   = (br->bits << 8) | (br->data < br->end ? *br->data++ : 0);
+            br->nbits += 8;
         }
-        lastbits -= num_of_bits;
-        num      |= (lastbyte >> lastbits) & ((1 << num_of_bits) -1);
     }
-    num   &= mask;
-    buf[0] = cnt;
-    buf[1] = lastbits;
-    buf[2] = lastbyte;
-    return num;
 }
 
-/*____________________________________________________________________________
- |
- | receiveints - decode 'small' integers from the buf array
- |
- | this routine is the inverse from sendints() and decodes the small integers
- | written to buf by calculating the remainder and doing divisions with
- | the given sizes[]. You need to specify the total number of bits to be
- | used from buf in num_of_bits.
- |
- */
-
-static void receiveints(int buf[], const int num_of_ints, int num_of_bits,
-                        unsigned int sizes[], int nums[])
+/* Returns the next num_of_bits bits as an integer, num_of_bits should be at most 32 */
+static inline unsigned int bitreader_get(t_xdr_bitreader *br, int num_of_bits)
 {
-    int bytes[32];
-    int i, j, num_of_bytes, p, num;
-
-    bytes[0]     = bytes[1] = bytes[2] = bytes[3] = 0;
-    num_of_bytes = 0;
-    while (num_of_bits > 8)
-    {
-        bytes[num_of_bytes++] = receivebits(buf, 8);
-        num_of_bits          -= 8;
-    }
-    if (num_of_bits > 0)
-    {
-        bytes[num_of_bytes++] = receivebits(buf, num_of_bits);
-    }
-    for (i = num_of_ints-1; i > 0; i--)
+    if (br->nbits < num_of_bits)
     {
-        num = 0;
-        for (j = num_of_bytes-1; j >= 0; j--)
-        {
-            num      = (num << 8) | bytes[j];
-            p        = num / sizes[i];
-            bytes[j] = p;
-            num      = num - p * sizes[i];
-        }
-        nums[i] = num;
+        bitreader_refill(br);
     }
-    nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
-}
+    br->nbits -= num_of_bits;
 
-/*____________________________________________________________________________
- |
- | xdr3dfcoord - read or write compressed 3d coordinates to xdr file.
- |
- | this routine reads or writes (depending on how you opened the file with
- | xdropen() ) a large number of 3d coordinates (stored in *fp).
- | The number of coordinates triplets to write is given by *size. On
- | read this number may be zero, in which case it reads as many as were written
- | or it may specify the number if triplets to read (which should match the
- | number written).
- | Compression is achieved by first converting all floating numbers to integer
- | using multiplication by *precision and rounding to the nearest integer.
- | Then the minimum and maximum value are calculated to determine the range.
- | The limited range of integers so found, is used to compress the coordinates.
- | In addition the differences between succesive coordinates is calculated.
- | If the difference happens to be 'small' then only the difference is saved,
- | compressing the data even more. The notion of 'small' is changed dynamically
- | and is enlarged or reduced whenever needed or possible.
- | Extra compression is achieved in the case of GROMOS and coordinates of
- | water molecules. GROMOS first writes out the Oxygen position, followed by
- | the two hydrogens. In order to make the differences smaller (and thereby
- | compression the data better) the order is changed into first one hydrogen
- | then the oxygen, followed by the other hydrogen. This is rather special, but
- | it shouldn't harm in the general case.
- |
- */
+    return static_cast<unsigned int>((br->bits >> br->nbits) & ((static_cast<gmx_uint64_t>(1) << num_of_bits) - 1));
+}
 
-int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
+/* Decodes three integers that were written with sendints() */
+static inline void bitreader_get_ints(t_xdr_bitreader *br, int num_of_bits,
+                                      const unsigned int sizes[3], int nums[3])
 {
-    int     *ip  = nullptr;
-    int     *buf = nullptr;
-    gmx_bool bRead;
-
-    /* preallocate a small buffer and ip on the stack - if we need more
-       we can always malloc(). This is faster for small values of size: */
-    unsigned     prealloc_size = 3*16;
-    int          prealloc_ip[3*16], prealloc_buf[3*20];
-    int          we_should_free = 0;
-
-    int          minint[3], maxint[3], mindiff, *lip, diff;
-    int          lint1, lint2, lint3, oldlint1, oldlint2, oldlint3, smallidx;
-    int          minidx, maxidx;
-    unsigned     sizeint[3], sizesmall[3], bitsizeint[3], size3, *luip;
-    int          flag, k;
-    int          smallnum, smaller, larger, i, is_small, is_smaller, run, prevrun;
-    float       *lfp, lf;
-    int          tmp, *thiscoord,  prevcoord[3];
-    unsigned int tmpcoord[30];
-
-    int          bufsize, lsize;
-    unsigned int bitsize;
-    float        inv_precision;
-    int          errval = 1;
-    int          rc;
-
-    bRead         = (xdrs->x_op == XDR_DECODE);
-    bitsizeint[0] = bitsizeint[1] = bitsizeint[2] = 0;
-    prevcoord[0]  = prevcoord[1]  = prevcoord[2]  = 0;
-
-    // The static analyzer warns about garbage values for thiscoord[] further
-    // down. It might be thrown off by all the reinterpret_casts, but we might
-    // as well make sure the small preallocated buffer is zero-initialized.
-    for (i = 0; i < static_cast<int>(prealloc_size); i++)
-    {
-        prealloc_ip[i] = 0;
-    }
-
-    if (!bRead)
+    if (num_of_bits <= 64)
     {
-        /* xdrs is open for writing */
-
-        if (xdr_int(xdrs, size) == 0)
-        {
-            return 0;
-        }
-        size3 = *size * 3;
-        /* when the number of coordinates is small, don't try to compress; just
-         * write them as floats using xdr_vector
+        /* The combined integer is stored as little-endian bytes, with
+         * the remaining bits of the last, most significant, byte last.
          */
-        if (*size <= 9)
+        int          nfull = (num_of_bits - 1) >> 3;
+        int          shift = 0;
+        gmx_uint64_t v     = 0;
+        while (nfull >= 4)
         {
-            return (xdr_vector(xdrs, reinterpret_cast<char *>(fp), static_cast<unsigned int>(size3),
-                               static_cast<unsigned int>(sizeof(*fp)), (xdrproc_t)xdr_float));
+            unsigned int w = bitreader_get(br, 32);
+            w      = (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+            v     |= static_cast<gmx_uint64_t>(w) << shift;
+            shift += 32;
+            nfull -= 4;
         }
-
-        if (xdr_float(xdrs, precision) == 0)
+        while (nfull > 0)
         {
-            return 0;
+            v     |= static_cast<gmx_uint64_t>(bitreader_get(br, 8)) << shift;
+            shift += 8;
+            nfull--;
         }
+        v |= static_cast<gmx_uint64_t>(bitreader_get(br, num_of_bits - shift)) << shift;
+
+        nums[2] = static_cast<int>(v % sizes[2]);
+        v      /= sizes[2];
+        nums[1] = static_cast<int>(v % sizes[1]);
+        v      /= sizes[1];
+        nums[0] = static_cast<int>(static_cast<unsigned int>(v));
+    }
+    else
+    {
+        /* Long division over the bytes */
+        int bytes[32];
+        int i, j, num_of_bytes, p, num;
 
-        if (size3 <= prealloc_size)
+        bytes[0]     = bytes[1] = bytes[2] = bytes[3] = 0;
+        num_of_bytes = 0;
+        while (num_of_bits > 8)
         {
-            ip  = prealloc_ip;
-            buf = prealloc_buf;
+            bytes[num_of_bytes++] = bitreader_get(br, 8);
+            num_of_bits          -= 8;
         }
-        else
+        bytes[num_of_bytes++] = bitreader_get(br, num_of_bits);
+        for (i = 2; i > 0; i--)
         {
-            we_should_free = 1;
-            bufsize        = static_cast<int>(size3 * 1.2);
-            ip             = reinterpret_cast<int *>(malloc(size3 * sizeof(*ip)));
-            buf            = reinterpret_cast<int *>(malloc(bufsize * sizeof(*buf)));
-            if (ip == nullptr || buf == nullptr)
+            num = 0;
+            for (j = num_of_bytes-1; j >= 0; j--)
             {
-                fprintf(stderr, "malloc failed\n");
-                exit(1);
+                num      = (num << 8) | bytes[j];
+                p        = num / sizes[i];
+                bytes[j] = p;
+                num      = num - p * sizes[i];
             }
+            nums[i] = num;
         }
-        /* buf[0-2] are special and do not contain actual data */
-        buf[0]    = buf[1] = buf[2] = 0;
-        minint[0] = minint[1] = minint[2] = INT_MAX;
-        maxint[0] = maxint[1] = maxint[2] = INT_MIN;
-        prevrun   = -1;
-        lfp       = fp;
-        lip       = ip;
-        mindiff   = INT_MAX;
-        oldlint1  = oldlint2 = oldlint3 = 0;
-        while (lfp < fp + size3)
-        {
-            /* find nearest integer */
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (fabs(lf) > MAXABS)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint1 = static_cast<int>(lf);
-            if (lint1 < minint[0])
-            {
-                minint[0] = lint1;
-            }
-            if (lint1 > maxint[0])
-            {
-                maxint[0] = lint1;
-            }
-            *lip++ = lint1;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (fabs(lf) > MAXABS)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint2 = static_cast<int>(lf);
-            if (lint2 < minint[1])
-            {
-                minint[1] = lint2;
-            }
-            if (lint2 > maxint[1])
-            {
-                maxint[1] = lint2;
-            }
-            *lip++ = lint2;
-            lfp++;
-            if (*lfp >= 0.0)
-            {
-                lf = *lfp * *precision + 0.5;
-            }
-            else
-            {
-                lf = *lfp * *precision - 0.5;
-            }
-            if (std::abs(lf) > MAXABS)
-            {
-                /* scaling would cause overflow */
-                errval = 0;
-            }
-            lint3 = static_cast<int>(lf);
-            if (lint3 < minint[2])
-            {
-                minint[2] = lint3;
-            }
-            if (lint3 > maxint[2])
-            {
-                maxint[2] = lint3;
-            }
-            *lip++ = lint3;
-            lfp++;
-            diff = std::abs(oldlint1-lint1)+std::abs(oldlint2-lint2)+std::abs(oldlint3-lint3);
-            if (diff < mindiff && lfp > fp + 3)
-            {
-                mindiff = diff;
-            }
-            oldlint1 = lint1;
-            oldlint2 = lint2;
-            oldlint3 = lint3;
-        }
-        if ( (xdr_int(xdrs, &(minint[0])) == 0) ||
-             (xdr_int(xdrs, &(minint[1])) == 0) ||
-             (xdr_int(xdrs, &(minint[2])) == 0) ||
-             (xdr_int(xdrs, &(maxint[0])) == 0) ||
-             (xdr_int(xdrs, &(maxint[1])) == 0) ||
-             (xdr_int(xdrs, &(maxint[2])) == 0))
-        {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
+        nums[0] = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
+    }
+}
+
+int xdr3dfcoord_read(XDR *xdrs, t_xdr3dfcoord_data *data)
+{
+    int nbytes;
+
+    if (xdr_int(xdrs, &data->natoms) == 0 || data->natoms < 0)
+    {
+        return 0;
+    }
+    if (data->natoms <= 9)
+    {
+        /* Small sets are stored uncompressed, store the floats as bytes */
+        data->precision = -1;
+        nbytes          = data->natoms*3*sizeof(float);
+    }
+    else
+    {
+        if ( (xdr_float(xdrs, &data->precision) == 0) ||
+             (xdr_int(xdrs, &(data->minint[0])) == 0) ||
+             (xdr_int(xdrs, &(data->minint[1])) == 0) ||
+             (xdr_int(xdrs, &(data->minint[2])) == 0) ||
+             (xdr_int(xdrs, &(data->maxint[0])) == 0) ||
+             (xdr_int(xdrs, &(data->maxint[1])) == 0) ||
+             (xdr_int(xdrs, &(data->maxint[2])) == 0) ||
+             (xdr_int(xdrs, &data->smallidx) == 0) ||
+             (xdr_int(xdrs, &nbytes) == 0) || nbytes < 0)
+        {
             return 0;
         }
-
-        if ((float)maxint[0] - (float)minint[0] >= MAXABS ||
-            (float)maxint[1] - (float)minint[1] >= MAXABS ||
-            (float)maxint[2] - (float)minint[2] >= MAXABS)
+    }
+    if (nbytes > data->nalloc)
+    {
+        data->nalloc = nbytes;
+        data->bytes  = reinterpret_cast<unsigned char *>(realloc(data->bytes, data->nalloc));
+        if (data->bytes == nullptr)
         {
-            /* turning value in unsigned by subtracting minint
-             * would cause overflow
-             */
-            errval = 0;
+            fprintf(stderr, "malloc failed\n");
+            exit(1);
         }
-        sizeint[0] = maxint[0] - minint[0]+1;
-        sizeint[1] = maxint[1] - minint[1]+1;
-        sizeint[2] = maxint[2] - minint[2]+1;
+    }
+    data->nbytes = nbytes;
+    if (data->natoms <= 9)
+    {
+        return xdr_vector(xdrs, reinterpret_cast<char *>(data->bytes), static_cast<unsigned int>(data->natoms*3),
+                          static_cast<unsigned int>(sizeof(float)), (xdrproc_t)xdr_float);
+    }
+
+    return xdr_opaque(xdrs, reinterpret_cast<char *>(data->bytes), static_cast<unsigned int>(nbytes));
+}
 
-        /* check if one of the sizes is to big to be multiplied */
-        if ((sizeint[0] | sizeint[1] | sizeint[2] ) > 0xffffff)
+int xdr3dfcoord_decode(const t_xdr3dfcoord_data *data, float *fp)
+{
+    t_xdr_bitreader br;
+    int             minint[3], smallidx, smallnum, run, is_smaller, i, k, tmp;
+    unsigned int    sizeint[3], sizesmall[3], bitsizeint[3], bitsize;
+    int             thiscoord[3], prevcoord[3];
+    float          *lfp, inv_precision;
+    const int       lsize = data->natoms;
+
+    if (lsize <= 9)
+    {
+        std::memcpy(fp, data->bytes, lsize*3*sizeof(float));
+        return 1;
+    }
+
+    for (int d = 0; d < 3; d++)
+    {
+        minint[d]     = data->minint[d];
+        sizeint[d]    = data->maxint[d] - data->minint[d] + 1;
+        bitsizeint[d] = 0;
+    }
+    /* check if one of the sizes is to big to be multiplied */
+    if ((sizeint[0] | sizeint[1] | sizeint[2] ) > 0xffffff)
+    {
+        bitsizeint[0] = sizeofint(sizeint[0]);
+        bitsizeint[1] = sizeofint(sizeint[1]);
+        bitsizeint[2] = sizeofint(sizeint[2]);
+        bitsize       = 0; /* flag the use of large sizes */
+    }
+    else
+    {
+        bitsize = sizeofints(3, sizeint);
+    }
+
+    smallidx = data->smallidx;
+    if (smallidx < FIRSTIDX || smallidx >= LASTIDX)
+    {
+        return 0;
+    }
+    /* In a valid stream smallnum is always half the current magic integer */
+    smallnum     = magicints[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+
+    bitreader_init(&br, data->bytes, data->nbytes);
+
+    lfp           = fp;
+    inv_precision = 1.0 / data->precision;
+    run           = 0;
+    i             = 0;
+    while (i < lsize)
+    {
+        if (bitsize == 0)
         {
-            bitsizeint[0] = sizeofint(sizeint[0]);
-            bitsizeint[1] = sizeofint(sizeint[1]);
-            bitsizeint[2] = sizeofint(sizeint[2]);
-            bitsize       = 0; /* flag the use of large sizes */
+            thiscoord[0] = bitreader_get(&br, bitsizeint[0]);
+            thiscoord[1] = bitreader_get(&br, bitsizeint[1]);
+            thiscoord[2] = bitreader_get(&br, bitsizeint[2]);
         }
         else
         {
-            bitsize = sizeofints(3, sizeint);
+            bitreader_get_ints(&br, bitsize, sizeint, thiscoord);
         }
-        luip     = reinterpret_cast<unsigned int *>(ip);
-        smallidx = FIRSTIDX;
-        while (smallidx < LASTIDX && magicints[smallidx] < mindiff)
+
+        i++;
+        prevcoord[0] = thiscoord[0] + minint[0];
+        prevcoord[1] = thiscoord[1] + minint[1];
+        prevcoord[2] = thiscoord[2] + minint[2];
+
+        is_smaller = 0;
+        if (bitreader_get(&br, 1))
         {
-            smallidx++;
+            run        = bitreader_get(&br, 5);
+            is_smaller = run % 3;
+            run       -= is_smaller;
+            is_smaller--;
         }
-        if (xdr_int(xdrs, &smallidx) == 0)
+        if (run > 0)
         {
-            if (we_should_free)
+            if (i + run/3 > lsize)
             {
-                free(ip);
-                free(buf);
-            }
-            return 0;
-        }
-
-        maxidx       = std::min(LASTIDX, smallidx + 8);
-        minidx       = maxidx - 8; /* often this equal smallidx */
-        smaller      = magicints[std::max(FIRSTIDX, smallidx-1)] / 2;
-        smallnum     = magicints[smallidx] / 2;
-        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
-        larger       = magicints[maxidx] / 2;
-        i            = 0;
-        while (i < *size)
-        {
-            is_small  = 0;
-            thiscoord = reinterpret_cast<int *>(luip) + i * 3;
-            if (smallidx < maxidx && i >= 1 &&
-                std::abs(thiscoord[0] - prevcoord[0]) < larger &&
-                std::abs(thiscoord[1] - prevcoord[1]) < larger &&
-                std::abs(thiscoord[2] - prevcoord[2]) < larger)
-            {
-                is_smaller = 1;
-            }
-            else if (smallidx > minidx)
-            {
-                is_smaller = -1;
-            }
-            else
-            {
-                is_smaller = 0;
-            }
-            if (i + 1 < *size)
-            {
-                if (std::abs(thiscoord[0] - thiscoord[3]) < smallnum &&
-                    std::abs(thiscoord[1] - thiscoord[4]) < smallnum &&
-                    std::abs(thiscoord[2] - thiscoord[5]) < smallnum)
-                {
-                    /* interchange first with second atom for better
-                     * compression of water molecules
-                     */
-                    tmp          = thiscoord[0]; thiscoord[0] = thiscoord[3];
-                    thiscoord[3] = tmp;
-                    tmp          = thiscoord[1]; thiscoord[1] = thiscoord[4];
-                    thiscoord[4] = tmp;
-                    tmp          = thiscoord[2]; thiscoord[2] = thiscoord[5];
-                    thiscoord[5] = tmp;
-                    is_small     = 1;
-                }
-
+                /* Corrupt data, the run extends beyond the last atom */
+                return 0;
             }
-            tmpcoord[0] = thiscoord[0] - minint[0];
-            tmpcoord[1] = thiscoord[1] - minint[1];
-            tmpcoord[2] = thiscoord[2] - minint[2];
-            if (bitsize == 0)
-            {
-                sendbits(buf, bitsizeint[0], tmpcoord[0]);
-                sendbits(buf, bitsizeint[1], tmpcoord[1]);
-                sendbits(buf, bitsizeint[2], tmpcoord[2]);
-            }
-            else
-            {
-                sendints(buf, 3, bitsize, sizeint, tmpcoord);
-            }
-            prevcoord[0] = thiscoord[0];
-            prevcoord[1] = thiscoord[1];
-            prevcoord[2] = thiscoord[2];
-            thiscoord    = thiscoord + 3;
+            /* The first small coordinate was interchanged with the large
+             * one for better compression of water molecules.
+             */
+            bitreader_get_ints(&br, smallidx, sizesmall, thiscoord);
             i++;
-
-            run = 0;
-            if (is_small == 0 && is_smaller == -1)
-            {
-                is_smaller = 0;
-            }
-            while (is_small && run < 8*3)
-            {
-                if (is_smaller == -1 && (
-                        SQR(thiscoord[0] - prevcoord[0]) +
-                        SQR(thiscoord[1] - prevcoord[1]) +
-                        SQR(thiscoord[2] - prevcoord[2]) >= smaller * smaller))
-                {
-                    is_smaller = 0;
-                }
-
-                tmpcoord[run++] = thiscoord[0] - prevcoord[0] + smallnum;
-                tmpcoord[run++] = thiscoord[1] - prevcoord[1] + smallnum;
-                tmpcoord[run++] = thiscoord[2] - prevcoord[2] + smallnum;
-
-                prevcoord[0] = thiscoord[0];
-                prevcoord[1] = thiscoord[1];
-                prevcoord[2] = thiscoord[2];
-
+            tmp          = thiscoord[0] + prevcoord[0] - smallnum;
+            thiscoord[0] = prevcoord[0];
+            prevcoord[0] = tmp;
+            tmp          = thiscoord[1] + prevcoord[1] - smallnum;
+            thiscoord[1] = prevcoord[1];
+            prevcoord[1] = tmp;
+            tmp          = thiscoord[2] + prevcoord[2] - smallnum;
+            thiscoord[2] = prevcoord[2];
+            prevcoord[2] = tmp;
+            *lfp++       = prevcoord[0] * inv_precision;
+            *lfp++       = prevcoord[1] * inv_precision;
+            *lfp++       = prevcoord[2] * inv_precision;
+            *lfp++       = thiscoord[0] * inv_precision;
+            *lfp++       = thiscoord[1] * inv_precision;
+            *lfp++       = thiscoord[2] * inv_precision;
+            for (k = 3; k < run; k += 3)
+            {
+                bitreader_get_ints(&br, smallidx, sizesmall, thiscoord);
                 i++;
-                thiscoord = thiscoord + 3;
-                is_small  = 0;
-                if (i < *size &&
-                    abs(thiscoord[0] - prevcoord[0]) < smallnum &&
-                    abs(thiscoord[1] - prevcoord[1]) < smallnum &&
-                    abs(thiscoord[2] - prevcoord[2]) < smallnum)
-                {
-                    is_small = 1;
-                }
-            }
-            if (run != prevrun || is_smaller != 0)
-            {
-                prevrun = run;
-                sendbits(buf, 1, 1); /* flag the change in run-length */
-                sendbits(buf, 5, run+is_smaller+1);
-            }
-            else
-            {
-                sendbits(buf, 1, 0); /* flag the fact that runlength did not change */
-            }
-            for (k = 0; k < run; k += 3)
-            {
-                sendints(buf, 3, smallidx, sizesmall, &tmpcoord[k]);
-            }
-            if (is_smaller != 0)
-            {
-                smallidx += is_smaller;
-                if (is_smaller < 0)
-                {
-                    smallnum = smaller;
-                    smaller  = magicints[smallidx-1] / 2;
-                }
-                else
-                {
-                    smaller  = smallnum;
-                    smallnum = magicints[smallidx] / 2;
-                }
-                sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+                prevcoord[0] = thiscoord[0] + prevcoord[0] - smallnum;
+                prevcoord[1] = thiscoord[1] + prevcoord[1] - smallnum;
+                prevcoord[2] = thiscoord[2] + prevcoord[2] - smallnum;
+                *lfp++       = prevcoord[0] * inv_precision;
+                *lfp++       = prevcoord[1] * inv_precision;
+                *lfp++       = prevcoord[2] * inv_precision;
             }
         }
-        if (buf[1] != 0)
+        else
         {
-            buf[0]++;
+            *lfp++ = prevcoord[0] * inv_precision;
+            *lfp++ = prevcoord[1] * inv_precision;
+            *lfp++ = prevcoord[2] * inv_precision;
         }
-        /* buf[0] holds the length in bytes */
-        if (xdr_int(xdrs, &(buf[0])) == 0)
+        if (is_smaller != 0)
         {
-            if (we_should_free)
+            smallidx += is_smaller;
+            if (smallidx < FIRSTIDX || smallidx >= LASTIDX)
             {
-                free(ip);
-                free(buf);
+                return 0;
             }
-            return 0;
+            smallnum     = magicints[smallidx] / 2;
+            sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
         }
+    }
 
+    return 1;
+}
 
-        rc = errval * (xdr_opaque(xdrs, reinterpret_cast<char *>(&(buf[3])), static_cast<unsigned int>(buf[0])));
-        if (we_should_free)
-        {
-            free(ip);
-            free(buf);
-        }
-        return rc;
+/* Round x*precision to the nearest integer, sets *overflow when it does not fit */
+static inline int quantize_coord(float x, float precision, int *overflow)
+{
+    float lf;
 
+    if (x >= 0.0)
+    {
+        lf = x * precision + 0.5;
     }
     else
     {
+        lf = x * precision - 0.5;
+    }
+    if (std::abs(lf) > MAXABS)
+    {
+        /* scaling would cause overflow */
+        *overflow = 1;
+    }
+    return static_cast<int>(lf);
+}
 
-        /* xdrs is open for reading */
+/* Convert the size3 floats in fp to integers in ip using precision and
+ * determine the minimum and maximum integer of each dimension.
+ * Returns 0 when scaling causes overflow.
+ */
+static int quantize_coords(const float *fp, int size3, float precision,
+                           int *ip, int minint[], int maxint[])
+{
+    int i    = 0;
+    int ovfl = 0;
 
-        if (xdr_int(xdrs, &lsize) == 0)
-        {
-            return 0;
-        }
-        if (*size != 0 && lsize != *size)
+    for (int d = 0; d < 3; d++)
+    {
+        minint[d] = INT_MAX;
+        maxint[d] = INT_MIN;
+    }
+#if GMX_SIMD_HAVE_FLOAT && GMX_SIMD_HAVE_FINT32_ARITHMETICS && GMX_SIMD_FINT32_WIDTH == GMX_SIMD_FLOAT_WIDTH
+    /* Three SIMD registers hold a whole number of coordinate triplets, so
+     * each element always receives the same dimension. The rounding is done
+     * with the same float operations as in quantize_coord(). The max() with
+     * the lowest float does not change the product, but keeps the compiler
+     * from contracting the multiplication and addition to an FMA, which
+     * would round differently.
+     */
+    const gmx::SimdFloat prec(precision);
+    const gmx::SimdFloat lowest(-FLT_MAX);
+    const gmx::SimdFloat half(0.5f);
+    const gmx::SimdFloat minusHalf(-0.5f);
+    const gmx::SimdFloat zero(0.0f);
+    const gmx::SimdFloat maxAbs(static_cast<float>(MAXABS));
+    gmx::SimdFInt32      vmin[3], vmax[3];
+    gmx::SimdFBool       vovfl = (maxAbs < zero);
+
+    for (int k = 0; k < 3; k++)
+    {
+        vmin[k] = gmx::SimdFInt32(INT_MAX);
+        vmax[k] = gmx::SimdFInt32(INT_MIN);
+    }
+    for (; i + 3*GMX_SIMD_FLOAT_WIDTH <= size3; i += 3*GMX_SIMD_FLOAT_WIDTH)
+    {
+        for (int k = 0; k < 3; k++)
         {
-            fprintf(stderr, "wrong number of coordinates in xdr3dfcoord; "
-                    "%d arg vs %d in file", *size, lsize);
+            gmx::SimdFloat  x  = gmx::loadU(fp + i + k*GMX_SIMD_FLOAT_WIDTH);
+            gmx::SimdFloat  lf = gmx::max(lowest, x * prec);
+            gmx::SimdFInt32 li;
+
+            lf      = lf + gmx::blend(minusHalf, half, zero <= x);
+            vovfl   = vovfl || (maxAbs < gmx::abs(lf));
+            li      = gmx::cvttR2I(lf);
+            vmin[k] = gmx::blend(vmin[k], li, li < vmin[k]);
+            vmax[k] = gmx::blend(vmax[k], li, vmax[k] < li);
+            gmx::storeU(ip + i + k*GMX_SIMD_FLOAT_WIDTH, li);
         }
-        *size = lsize;
-        size3 = *size * 3;
-        if (*size <= 9)
+    }
+    if (i > 0)
+    {
+        std::int32_t tmin[GMX_SIMD_FINT32_WIDTH], tmax[GMX_SIMD_FINT32_WIDTH];
+
+        for (int k = 0; k < 3; k++)
         {
-            *precision = -1;
-            return (xdr_vector(xdrs, reinterpret_cast<char *>(fp), static_cast<unsigned int>(size3),
-                               static_cast<unsigned int>(sizeof(*fp)), (xdrproc_t)xdr_float));
+            gmx::storeU(tmin, vmin[k]);
+            gmx::storeU(tmax, vmax[k]);
+            for (int j = 0; j < GMX_SIMD_FINT32_WIDTH; j++)
+            {
+                int d     = (k*GMX_SIMD_FLOAT_WIDTH + j) % 3;
+                minint[d] = std::min(minint[d], static_cast<int>(tmin[j]));
+                maxint[d] = std::max(maxint[d], static_cast<int>(tmax[j]));
+            }
         }
-        if (xdr_float(xdrs, precision) == 0)
+        ovfl = gmx::anyTrue(vovfl);
+    }
+#endif
+    for (; i < size3; i += 3)
+    {
+        for (int d = 0; d < 3; d++)
         {
-            return 0;
+            ip[i + d] = quantize_coord(fp[i + d], precision, &ovfl);
+            minint[d] = std::min(minint[d], ip[i + d]);
+            maxint[d] = std::max(maxint[d], ip[i + d]);
         }
+    }
 
-        if (size3 <= prealloc_size)
+    return !ovfl;
+}
+
+int xdr3dfcoord_encode(const float *fp, int natoms, float precision,
+                       t_xdr3dfcoord_data *data)
+{
+    t_xdr_bitwriter bw;
+    int             minint[3], maxint[3], mindiff, diff;
+    int            *ip, *thiscoord, prevcoord[3];
+    int             smallidx, minidx, maxidx, smallnum, smaller, larger;
+    int             i, k, tmp, is_small, is_smaller, run, prevrun;
+    unsigned int    sizeint[3], sizesmall[3], bitsizeint[3], bitsize;
+    unsigned int    tmpcoord[30];
+    int             nalloc;
+    int             errval = 1;
+    const int       size3  = natoms * 3;
+
+    /* Small sets are stored uncompressed, store the floats as bytes,
+     * with at most 102 bits per atom otherwise.
+     */
+    nalloc = (natoms <= 9 ? size3*sizeof(float) : 13*natoms);
+    if (nalloc > data->nalloc)
+    {
+        data->nalloc = nalloc;
+        data->bytes  = reinterpret_cast<unsigned char *>(realloc(data->bytes, data->nalloc));
+        if (data->bytes == nullptr)
         {
-            ip  = prealloc_ip;
-            buf = prealloc_buf;
+            fprintf(stderr, "malloc failed\n");
+            exit(1);
         }
-        else
+    }
+    data->natoms = natoms;
+    if (natoms <= 9)
+    {
+        data->precision = -1;
+        data->nbytes    = size3*sizeof(float);
+        if (size3 > 0)
         {
-            we_should_free = 1;
-            bufsize        = static_cast<int>(size3 * 1.2);
-            ip             = reinterpret_cast<int *>(malloc(size3 * sizeof(*ip)));
-            buf            = reinterpret_cast<int *>(malloc(bufsize * sizeof(*buf)));
-            if (ip == nullptr || buf == nullptr)
-            {
-                fprintf(stderr, "malloc failed\n");
-                exit(1);
-            }
+            std::memcpy(data->bytes, fp, data->nbytes);
         }
+        return 1;
+    }
+    data->precision = precision;
 
-        buf[0] = buf[1] = buf[2] = 0;
+    ip = reinterpret_cast<int *>(malloc(size3 * sizeof(*ip)));
+    if (ip == nullptr)
+    {
+        fprintf(stderr, "malloc failed\n");
+        exit(1);
+    }
 
-        if ( (xdr_int(xdrs, &(minint[0])) == 0) ||
-             (xdr_int(xdrs, &(minint[1])) == 0) ||
-             (xdr_int(xdrs, &(minint[2])) == 0) ||
-             (xdr_int(xdrs, &(maxint[0])) == 0) ||
-             (xdr_int(xdrs, &(maxint[1])) == 0) ||
-             (xdr_int(xdrs, &(maxint[2])) == 0))
-        {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
-        }
+    if (quantize_coords(fp, size3, precision, ip, minint, maxint) == 0)
+    {
+        errval = 0;
+    }
+    mindiff = INT_MAX;
+    for (i = 3; i < size3; i += 3)
+    {
+        diff    = std::abs(ip[i - 3] - ip[i]) + std::abs(ip[i - 2] - ip[i + 1]) + std::abs(ip[i - 1] - ip[i + 2]);
+        mindiff = std::min(mindiff, diff);
+    }
 
-        sizeint[0] = maxint[0] - minint[0]+1;
-        sizeint[1] = maxint[1] - minint[1]+1;
-        sizeint[2] = maxint[2] - minint[2]+1;
+    if ((float)maxint[0] - (float)minint[0] >= MAXABS ||
+        (float)maxint[1] - (float)minint[1] >= MAXABS ||
+        (float)maxint[2] - (float)minint[2] >= MAXABS)
+    {
+        /* turning value in unsigned by subtracting minint
+         * would cause overflow
+         */
+        errval = 0;
+    }
+    for (int d = 0; d < 3; d++)
+    {
+        data->minint[d] = minint[d];
+        data->maxint[d] = maxint[d];
+        sizeint[d]      = maxint[d] - minint[d] + 1;
+        bitsizeint[d]   = 0;
+    }
 
-        /* check if one of the sizes is to big to be multiplied */
-        if ((sizeint[0] | sizeint[1] | sizeint[2] ) > 0xffffff)
+    /* check if one of the sizes is to big to be multiplied */
+    if ((sizeint[0] | sizeint[1] | sizeint[2] ) > 0xffffff)
+    {
+        bitsizeint[0] = sizeofint(sizeint[0]);
+        bitsizeint[1] = sizeofint(sizeint[1]);
+        bitsizeint[2] = sizeofint(sizeint[2]);
+        bitsize       = 0; /* flag the use of large sizes */
+    }
+    else
+    {
+        bitsize = sizeofints(3, sizeint);
+    }
+    smallidx = FIRSTIDX;
+    while (smallidx < LASTIDX && magicints[smallidx] < mindiff)
+    {
+        smallidx++;
+    }
+    data->smallidx = smallidx;
+
+    bitwriter_init(&bw, data->bytes);
+    prevcoord[0] = prevcoord[1] = prevcoord[2] = 0;
+    prevrun      = -1;
+    maxidx       = std::min(LASTIDX, smallidx + 8);
+    minidx       = maxidx - 8; /* often this equal smallidx */
+    smaller      = magicints[std::max(FIRSTIDX, smallidx-1)] / 2;
+    smallnum     = magicints[smallidx] / 2;
+    sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
+    larger       = magicints[maxidx] / 2;
+    i            = 0;
+    while (i < natoms)
+    {
+        is_small  = 0;
+        thiscoord = ip + i * 3;
+        if (smallidx < maxidx && i >= 1 &&
+            std::abs(thiscoord[0] - prevcoord[0]) < larger &&
+            std::abs(thiscoord[1] - prevcoord[1]) < larger &&
+            std::abs(thiscoord[2] - prevcoord[2]) < larger)
         {
-            bitsizeint[0] = sizeofint(sizeint[0]);
-            bitsizeint[1] = sizeofint(sizeint[1]);
-            bitsizeint[2] = sizeofint(sizeint[2]);
-            bitsize       = 0; /* flag the use of large sizes */
+            is_smaller = 1;
+        }
+        else if (smallidx > minidx)
+        {
+            is_smaller = -1;
         }
         else
         {
-            bitsize = sizeofints(3, sizeint);
+            is_smaller = 0;
         }
-
-        if (xdr_int(xdrs, &smallidx) == 0)
+        if (i + 1 < natoms)
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
+            if (std::abs(thiscoord[0] - thiscoord[3]) < smallnum &&
+                std::abs(thiscoord[1] - thiscoord[4]) < smallnum &&
+                std::abs(thiscoord[2] - thiscoord[5]) < smallnum)
+            {
+                /* interchange first with second atom for better
+                 * compression of water molecules
+                 */
+                tmp          = thiscoord[0]; thiscoord[0] = thiscoord[3];
+                thiscoord[3] = tmp;
+                tmp          = thiscoord[1]; thiscoord[1] = thiscoord[4];
+                thiscoord[4] = tmp;
+                tmp          = thiscoord[2]; thiscoord[2] = thiscoord[5];
+                thiscoord[5] = tmp;
+                is_small     = 1;
             }
-            return 0;
-        }
 
-        smaller      = magicints[std::max(FIRSTIDX, smallidx-1)] / 2;
-        smallnum     = magicints[smallidx] / 2;
-        sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
-
-        /* buf[0] holds the length in bytes */
-
-        if (xdr_int(xdrs, &(buf[0])) == 0)
+        }
+        tmpcoord[0] = thiscoord[0] - minint[0];
+        tmpcoord[1] = thiscoord[1] - minint[1];
+        tmpcoord[2] = thiscoord[2] - minint[2];
+        if (bitsize == 0)
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
+            bitwriter_put(&bw, bitsizeint[0], tmpcoord[0]);
+            bitwriter_put(&bw, bitsizeint[1], tmpcoord[1]);
+            bitwriter_put(&bw, bitsizeint[2], tmpcoord[2]);
         }
-
-
-        if (xdr_opaque(xdrs, reinterpret_cast<char *>(&(buf[3])), static_cast<unsigned int>(buf[0])) == 0)
+        else
         {
-            if (we_should_free)
-            {
-                free(ip);
-                free(buf);
-            }
-            return 0;
+            bitwriter_put_ints(&bw, bitsize, sizeint, tmpcoord);
         }
-
-
-
-        buf[0] = buf[1] = buf[2] = 0;
-
-        lfp           = fp;
-        inv_precision = 1.0 / *precision;
-        run           = 0;
-        i             = 0;
-        lip           = ip;
-        while (i < lsize)
+        prevcoord[0] = thiscoord[0];
+        prevcoord[1] = thiscoord[1];
+        prevcoord[2] = thiscoord[2];
+        thiscoord    = thiscoord + 3;
+        i++;
+
+        run = 0;
+        if (is_small == 0 && is_smaller == -1)
         {
-            thiscoord = reinterpret_cast<int *>(lip) + i * 3;
-
-            if (bitsize == 0)
-            {
-                thiscoord[0] = receivebits(buf, bitsizeint[0]);
-                thiscoord[1] = receivebits(buf, bitsizeint[1]);
-                thiscoord[2] = receivebits(buf, bitsizeint[2]);
-            }
-            else
+            is_smaller = 0;
+        }
+        while (is_small && run < 8*3)
+        {
+            if (is_smaller == -1 && (
+                    SQR(thiscoord[0] - prevcoord[0]) +
+                    SQR(thiscoord[1] - prevcoord[1]) +
+                    SQR(thiscoord[2] - prevcoord[2]) >= smaller * smaller))
             {
-                receiveints(buf, 3, bitsize, sizeint, thiscoord);
+                is_smaller = 0;
             }
 
-            i++;
-            thiscoord[0] += minint[0];
-            thiscoord[1] += minint[1];
-            thiscoord[2] += minint[2];
+            tmpcoord[run++] = thiscoord[0] - prevcoord[0] + smallnum;
+            tmpcoord[run++] = thiscoord[1] - prevcoord[1] + smallnum;
+            tmpcoord[run++] = thiscoord[2] - prevcoord[2] + smallnum;
 
             prevcoord[0] = thiscoord[0];
             prevcoord[1] = thiscoord[1];
             prevcoord[2] = thiscoord[2];
 
-
-            flag       = receivebits(buf, 1);
-            is_smaller = 0;
-            if (flag == 1)
-            {
-                run        = receivebits(buf, 5);
-                is_smaller = run % 3;
-                run       -= is_smaller;
-                is_smaller--;
-            }
-            if (run > 0)
-            {
-                thiscoord += 3;
-                for (k = 0; k < run; k += 3)
-                {
-                    receiveints(buf, 3, smallidx, sizesmall, thiscoord);
-                    i++;
-                    thiscoord[0] += prevcoord[0] - smallnum;
-                    thiscoord[1] += prevcoord[1] - smallnum;
-                    thiscoord[2] += prevcoord[2] - smallnum;
-                    if (k == 0)
-                    {
-                        /* interchange first with second atom for better
-                         * compression of water molecules
-                         */
-                        tmp          = thiscoord[0]; thiscoord[0] = prevcoord[0];
-                        prevcoord[0] = tmp;
-                        tmp          = thiscoord[1]; thiscoord[1] = prevcoord[1];
-                        prevcoord[1] = tmp;
-                        tmp          = thiscoord[2]; thiscoord[2] = prevcoord[2];
-                        prevcoord[2] = tmp;
-                        *lfp++       = prevcoord[0] * inv_precision;
-                        *lfp++       = prevcoord[1] * inv_precision;
-                        *lfp++       = prevcoord[2] * inv_precision;
-                    }
-                    else
-                    {
-                        prevcoord[0] = thiscoord[0];
-                        prevcoord[1] = thiscoord[1];
-                        prevcoord[2] = thiscoord[2];
-                    }
-                    *lfp++ = thiscoord[0] * inv_precision;
-                    *lfp++ = thiscoord[1] * inv_precision;
-                    *lfp++ = thiscoord[2] * inv_precision;
-                }
-            }
-            else
+            i++;
+            thiscoord = thiscoord + 3;
+            is_small  = 0;
+            if (i < natoms &&
+                std::abs(thiscoord[0] - prevcoord[0]) < smallnum &&
+                std::abs(thiscoord[1] - prevcoord[1]) < smallnum &&
+                std::abs(thiscoord[2] - prevcoord[2]) < smallnum)
             {
-                *lfp++ = thiscoord[0] * inv_precision;
-                *lfp++ = thiscoord[1] * inv_precision;
-                *lfp++ = thiscoord[2] * inv_precision;
+                is_small = 1;
             }
+        }
+        if (run != prevrun || is_smaller != 0)
+        {
+            prevrun = run;
+            bitwriter_put(&bw, 1, 1); /* flag the change in run-length */
+            bitwriter_put(&bw, 5, run+is_smaller+1);
+        }
+        else
+        {
+            bitwriter_put(&bw, 1, 0); /* flag the fact that runlength did not change */
+        }
+        for (k = 0; k < run; k += 3)
+        {
+            bitwriter_put_ints(&bw, smallidx, sizesmall, &tmpcoord[k]);
+        }
+        if (is_smaller != 0)
+        {
             smallidx += is_smaller;
             if (is_smaller < 0)
             {
                 smallnum = smaller;
-                if (smallidx > FIRSTIDX)
-                {
-                    smaller = magicints[smallidx - 1] /2;
-                }
-                else
-                {
-                    smaller = 0;
-                }
+                smaller  = magicints[smallidx-1] / 2;
             }
-            else if (is_smaller > 0)
+            else
             {
                 smaller  = smallnum;
                 smallnum = magicints[smallidx] / 2;
@@ -998,12 +940,107 @@ int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
             sizesmall[0] = sizesmall[1] = sizesmall[2] = magicints[smallidx];
         }
     }
-    if (we_should_free)
+    data->nbytes = bitwriter_flush(&bw) - data->bytes;
+
+    free(ip);
+
+    return errval;
+}
+
+int xdr3dfcoord_write(XDR *xdrs, t_xdr3dfcoord_data *data)
+{
+    if (xdr_int(xdrs, &data->natoms) == 0)
     {
-        free(ip);
-        free(buf);
+        return 0;
+    }
+    if (data->natoms <= 9)
+    {
+        return xdr_vector(xdrs, reinterpret_cast<char *>(data->bytes), static_cast<unsigned int>(data->natoms*3),
+                          static_cast<unsigned int>(sizeof(float)), (xdrproc_t)xdr_float);
+    }
+    if ( (xdr_float(xdrs, &data->precision) == 0) ||
+         (xdr_int(xdrs, &(data->minint[0])) == 0) ||
+         (xdr_int(xdrs, &(data->minint[1])) == 0) ||
+         (xdr_int(xdrs, &(data->minint[2])) == 0) ||
+         (xdr_int(xdrs, &(data->maxint[0])) == 0) ||
+         (xdr_int(xdrs, &(data->maxint[1])) == 0) ||
+         (xdr_int(xdrs, &(data->maxint[2])) == 0) ||
+         (xdr_int(xdrs, &data->smallidx) == 0) ||
+         (xdr_int(xdrs, &data->nbytes) == 0))
+    {
+        return 0;
+    }
+
+    return xdr_opaque(xdrs, reinterpret_cast<char *>(data->bytes), static_cast<unsigned int>(data->nbytes));
+}
+
+/*____________________________________________________________________________
+ |
+ | xdr3dfcoord - read or write compressed 3d coordinates to xdr file.
+ |
+ | this routine reads or writes (depending on how you opened the file with
+ | xdropen() ) a large number of 3d coordinates (stored in *fp).
+ | The number of coordinates triplets to write is given by *size. On
+ | read this number may be zero, in which case it reads as many as were written
+ | or it may specify the number if triplets to read (which should match the
+ | number written).
+ | Compression is achieved by first converting all floating numbers to integer
+ | using multiplication by *precision and rounding to the nearest integer.
+ | Then the minimum and maximum value are calculated to determine the range.
+ | The limited range of integers so found, is used to compress the coordinates.
+ | In addition the differences between succesive coordinates is calculated.
+ | If the difference happens to be 'small' then only the difference is saved,
+ | compressing the data even more. The notion of 'small' is changed dynamically
+ | and is enlarged or reduced whenever needed or possible.
+ | Extra compression is achieved in the case of GROMOS and coordinates of
+ | water molecules. GROMOS first writes out the Oxygen position, followed by
+ | the two hydrogens. In order to make the differences smaller (and thereby
+ | compression the data better) the order is changed into first one hydrogen
+ | then the oxygen, followed by the other hydrogen. This is rather special, but
+ | it shouldn't harm in the general case.
+ |
+ */
+
+int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision)
+{
+    t_xdr3dfcoord_data data;
+    int                rc;
+
+    data.nalloc = 0;
+    data.bytes  = nullptr;
+
+    if (xdrs->x_op != XDR_DECODE)
+    {
+        /* xdrs is open for writing */
+
+        rc  = xdr3dfcoord_encode(fp, *size, *precision, &data);
+        rc *= xdr3dfcoord_write(xdrs, &data);
+        free(data.bytes);
+
+        return rc;
+    }
+    else
+    {
+
+        /* xdrs is open for reading */
+
+        if (xdr3dfcoord_read(xdrs, &data) == 0)
+        {
+            free(data.bytes);
+            return 0;
+        }
+        if (*size != 0 && data.natoms != *size)
+        {
+            fprintf(stderr, "wrong number of coordinates in xdr3dfcoord; "
+                    "%d arg vs %d in file", *size, data.natoms);
+        }
+        *size      = data.natoms;
+        *precision = data.precision;
+        rc         = xdr3dfcoord_decode(&data, fp);
+        free(data.bytes);
+
+        return rc;
     }
-    return 1;
 }
 
 
@@ -0,0 +1,218 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the columnar energy files
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/enxcolumns.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/enxio.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+//! The number of energy terms in the test files
+const int c_nre = 3;
+
+class EnergyColumnsTest : public ::testing::Test
+{
+    public:
+        EnergyColumnsTest()
+        {
+            fn_ = fileManager_.getTemporaryFilePath(".edr");
+            fileManager_.getTemporaryFilePath(".edr.ecol");
+            snew(enm_, c_nre);
+            for (int i = 0; i < c_nre; i++)
+            {
+                enm_[i].name = gmx_strdup(names_[i]);
+                enm_[i].unit = gmx_strdup("kJ/mol");
+            }
+        }
+        ~EnergyColumnsTest()
+        {
+            free_enxnms(c_nre, enm_);
+        }
+
+        //! Returns the value of \p term in \p frame
+        static real value(int frame, int term)
+        {
+            return 0.25*frame*(term + 1) - 3*term + 0.001*(frame % 7);
+        }
+
+        //! Writes an energy file with \p nframes frames
+        void writeFrames(int nframes)
+        {
+            ener_file_t ef  = open_enx(fn_.c_str(), "w");
+            int         nre = c_nre;
+            do_enxnms(ef, &nre, &enm_);
+
+            t_enxframe  fr;
+            init_enxframe(&fr);
+            snew(fr.ener, c_nre);
+            fr.e_alloc = c_nre;
+            for (int frame = 0; frame < nframes; frame++)
+            {
+                fr.t      = 0.002*10*frame;
+                fr.step   = 10*frame;
+                fr.nsteps = 10;
+                fr.dt     = 0.002;
+                fr.nsum   = 10;
+                fr.nre    = c_nre;
+                for (int i = 0; i < c_nre; i++)
+                {
+                    fr.ener[i].e    = value(frame, i);
+                    fr.ener[i].eav  = 2*value(frame, i);
+                    fr.ener[i].esum = -value(frame, i);
+                }
+                do_enx(ef, &fr);
+            }
+            free_enxframe(&fr);
+            close_enx(ef);
+        }
+
+        //! Checks \p fr against the written frame \p frame, for term 1 only
+        void checkFrame(const t_enxframe &fr, int frame)
+        {
+            EXPECT_EQ(10*frame, fr.step);
+            EXPECT_EQ(0.002*10*frame, fr.t);
+            EXPECT_EQ(10, fr.nsum);
+            ASSERT_EQ(c_nre, fr.nre);
+            EXPECT_EQ(value(frame, 1), fr.ener[1].e);
+            EXPECT_EQ(2*value(frame, 1), fr.ener[1].eav);
+            EXPECT_EQ(-value(frame, 1), fr.ener[1].esum);
+            EXPECT_EQ(0, fr.ener[2].e);
+        }
+
+        /*! \brief Reads the energy file through its columns, returns the number of frames read from the columns
+         *
+         * Frames after the columns are read from the energy file, like
+         * gmx energy does.
+         */
+        int readFrames(int nframes)
+        {
+            ener_file_t   ef  = open_enx(fn_.c_str(), "r");
+            int           nre = 0;
+            gmx_enxnm_t  *enm = nullptr;
+            do_enxnms(ef, &nre, &enm);
+
+            t_enxcolumns *columns = gmx_enxcol_open(fn_.c_str(), ef, nre, enm);
+            int           ncolumnFrames = 0;
+            t_enxframe    fr;
+            int           frame = 0;
+            init_enxframe(&fr);
+            if (columns != nullptr)
+            {
+                int set[] = { 1 };
+                gmx_enxcol_select(columns, 1, set);
+                while (gmx_enxcol_read_frame(columns, &fr))
+                {
+                    checkFrame(fr, frame++);
+                }
+                ncolumnFrames = frame;
+                EXPECT_EQ(0, gmx_fio_seek(enx_file_pointer(ef), gmx_enxcol_energy_file_end(columns)));
+                gmx_enxcol_close(columns);
+            }
+            while (do_enx(ef, &fr))
+            {
+                EXPECT_EQ(10*frame, fr.step);
+                EXPECT_EQ(value(frame, 1), fr.ener[1].e);
+                frame++;
+            }
+            EXPECT_EQ(nframes, frame);
+            free_enxframe(&fr);
+            free_enxnms(nre, enm);
+            close_enx(ef);
+
+            return ncolumnFrames;
+        }
+
+        const char                *names_[c_nre] = { "Bond", "Potential", "Pressure" };
+        std::string                fn_;
+        gmx_enxnm_t               *enm_;
+        gmx::test::TestFileManager fileManager_;
+};
+
+TEST_F(EnergyColumnsTest, ReadsSelectedTermsAcrossChunks)
+{
+    writeFrames(2345);
+    gmx_int64_t nnew;
+    EXPECT_EQ(2345, gmx_enxcol_update(fn_.c_str(), FALSE, &nnew));
+    EXPECT_EQ(2345, nnew);
+    EXPECT_EQ(2345, readFrames(2345));
+}
+
+TEST_F(EnergyColumnsTest, UpdateAddsAppendedFrames)
+{
+    gmx_int64_t nnew;
+    writeFrames(1500);
+    gmx_enxcol_update(fn_.c_str(), FALSE, &nnew);
+
+    /* Rewriting with more frames keeps the first frames identical */
+    writeFrames(2100);
+    EXPECT_EQ(1500, readFrames(2100));
+    EXPECT_EQ(2100, gmx_enxcol_update(fn_.c_str(), FALSE, &nnew));
+    EXPECT_EQ(600, nnew);
+    EXPECT_EQ(2100, readFrames(2100));
+    EXPECT_EQ(2100, gmx_enxcol_update(fn_.c_str(), FALSE, &nnew));
+    EXPECT_EQ(0, nnew);
+    EXPECT_EQ(2100, readFrames(2100));
+}
+
+TEST_F(EnergyColumnsTest, ColumnsOfOtherFileAreIgnored)
+{
+    gmx_int64_t nnew;
+    writeFrames(300);
+    gmx_enxcol_update(fn_.c_str(), FALSE, &nnew);
+
+    writeFrames(200);
+    EXPECT_EQ(0, readFrames(200));
+    EXPECT_EQ(200, gmx_enxcol_update(fn_.c_str(), FALSE, &nnew));
+    EXPECT_EQ(200, nnew);
+    EXPECT_EQ(200, readFrames(200));
+}
+
+} // namespace
@@ -0,0 +1,115 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Implements the test fixture for writing small XTC and TRR trajectories.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "trajectoryfiletest.h"
+
+#include "gromacs/fileio/filetypes.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/trrio.h"
+#include "gromacs/fileio/xtcio.h"
+#include "gromacs/math/vec.h"
+
+namespace gmx
+{
+namespace test
+{
+
+const int TrajectoryFileTest::c_natoms;
+
+TrajectoryFileTest::TrajectoryFileTest() : x_(c_natoms), v_(c_natoms), f_(c_natoms)
+{
+    clear_mat(box_);
+}
+
+std::string TrajectoryFileTest::trajectoryFileName(const char *ext)
+{
+    std::string suffix = std::string(".") + ext;
+    fileManager_.getTemporaryFilePath(suffix + ".fidx");
+    return fileManager_.getTemporaryFilePath(suffix);
+}
+
+void TrajectoryFileTest::setFrame(int frame)
+{
+    for (int i = 0; i < c_natoms; i++)
+    {
+        x_[i][XX] = 0.013*i + 0.1*frame;
+        x_[i][YY] = 1.5 - 0.021*i;
+        x_[i][ZZ] = 0.7 + 0.003*i*frame;
+        v_[i][XX] = -0.5 + 0.01*i;
+        v_[i][YY] = 0.1*frame;
+        v_[i][ZZ] = 0.2;
+        f_[i][XX] = 100*i;
+        f_[i][YY] = -3.7*frame;
+        f_[i][ZZ] = 1e-3*i;
+    }
+    box_[XX][XX] = 3 + 0.01*frame;
+    box_[YY][YY] = 3;
+    box_[ZZ][ZZ] = 3;
+}
+
+void TrajectoryFileTest::writeFrames(const std::string &fn, const char *mode, int begin, int end,
+                                     bool bIndex)
+{
+    t_fileio *fio = gmx_fio_open(fn.c_str(), mode);
+    if (bIndex)
+    {
+        gmx_fio_open_frame_index(fio, mode[0] == 'a');
+    }
+    for (int frame = begin; frame < end; frame++)
+    {
+        setFrame(frame);
+        if (gmx_fio_getftp(fio) == efXTC)
+        {
+            write_xtc(fio, c_natoms, 10*frame, 0.5*frame, box_, as_rvec_array(x_.data()), 1000);
+        }
+        else
+        {
+            gmx_trr_write_frame(fio, 10*frame, 0.5*frame, 0, box_, c_natoms,
+                                as_rvec_array(x_.data()), as_rvec_array(v_.data()),
+                                as_rvec_array(f_.data()));
+        }
+    }
+    gmx_fio_close(fio);
+}
+
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,96 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Declares a test fixture for writing small XTC and TRR trajectories.
+ *
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_TESTS_TRAJECTORYFILETEST_H
+#define GMX_FILEIO_TESTS_TRAJECTORYFILETEST_H
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/vectypes.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+
+/*! \internal \brief
+ * Test fixture that writes trajectories with known frames
+ *
+ * Frame i has step 10*i and time 0.5*i, and the x coordinate of
+ * atom 0 is 0.1*i.
+ */
+class TrajectoryFileTest : public ::testing::Test
+{
+    public:
+        TrajectoryFileTest();
+
+        //! Returns a temporary trajectory file name with extension \p ext, also registers its index for cleanup
+        std::string trajectoryFileName(const char *ext);
+
+        //! Sets the coordinates, velocities, forces and box for \p frame
+        void setFrame(int frame);
+
+        /*! \brief Writes frames \p begin to \p end to \p fn with \p mode
+         *
+         * XTC files only get coordinates. With \p bIndex the frame
+         * index is maintained, as mdrun does.
+         */
+        void writeFrames(const std::string &fn, const char *mode, int begin, int end,
+                         bool bIndex = true);
+
+        //! The number of atoms in each frame
+        static const int            c_natoms = 25;
+        //! Coordinates, velocities and forces of the last frame set
+        std::vector<RVec>           x_, v_, f_;
+        //! Box of the last frame set
+        matrix                      box_;
+        //! Manager for the trajectory files
+        TestFileManager             fileManager_;
+};
+
+} // namespace test
+} // namespace gmx
+
+#endif
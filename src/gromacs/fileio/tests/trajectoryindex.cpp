@@ -0,0 +1,297 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the trajectory frame index
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/trajectoryindex.h"
+
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/oenv.h"
+#include "gromacs/fileio/timecontrol.h"
+#include "gromacs/fileio/trxio.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "trajectoryfiletest.h"
+
+namespace
+{
+
+class TrajectoryIndexTest : public gmx::test::TrajectoryFileTest
+{
+    public:
+        ~TrajectoryIndexTest()
+        {
+            unsetTimeValue(TBEGIN);
+            unsetTimeValue(TDELTA);
+        }
+
+        //! Checks that \p index contains frames 0 to \p nframes
+        void checkIndex(const t_trxindex *index, int nframes)
+        {
+            ASSERT_NE(nullptr, index);
+            ASSERT_EQ(nframes, index->nframes);
+            for (int frame = 0; frame < nframes; frame++)
+            {
+                EXPECT_EQ(10*frame, index->step[frame]);
+                EXPECT_EQ(0.5*frame, index->time[frame]);
+                if (frame > 0)
+                {
+                    EXPECT_EQ(index->offset[frame - 1] + index->size[frame - 1], index->offset[frame]);
+                }
+            }
+        }
+
+        //! Checks that writing and building the index of a trajectory with extension \p ext agree
+        void runWriteAndBuild(const char *ext)
+        {
+            std::string fn = trajectoryFileName(ext);
+            writeFrames(fn, "w", 0, 5);
+
+            t_trxindex *written = gmx_trxindex_read(fn.c_str());
+            checkIndex(written, 5);
+            t_trxindex *built = gmx_trxindex_build(fn.c_str(), nullptr);
+            checkIndex(built, 5);
+            for (int frame = 0; frame < 5; frame++)
+            {
+                EXPECT_EQ(written->offset[frame], built->offset[frame]);
+                EXPECT_EQ(written->size[frame], built->size[frame]);
+            }
+            gmx_trxindex_done(written);
+            gmx_trxindex_done(built);
+        }
+
+        /*! \brief Reads all frames of \p fn that pass the time control
+         *
+         * Returns the times of the frames read, and in \p nframesRead
+         * the number of frames that were read or skipped by reading.
+         * In \p nindexed the number of indexed frames after reading
+         * is returned, this is 0 when the index was discarded.
+         */
+        std::vector<real> readFrameTimes(const std::string &fn, int *nframesRead, int *nindexed)
+        {
+            gmx_output_env_t *oenv;
+            t_trxstatus      *status;
+            t_trxframe        fr;
+            std::vector<real> times;
+
+            output_env_init_default(&oenv);
+            if (read_first_frame(oenv, &status, fn.c_str(), &fr, TRX_NEED_X))
+            {
+                do
+                {
+                    times.push_back(fr.time);
+                    EXPECT_FLOAT_EQ(0.2*fr.time, fr.x[0][XX]) << "Wrong coordinates at time " << fr.time;
+                }
+                while (read_next_frame(oenv, status, &fr));
+                *nframesRead = nframes_read(status);
+                *nindexed    = trx_indexed_frame_count(status);
+                close_trx(status);
+                sfree(fr.x);
+            }
+            output_env_done(oenv);
+
+            return times;
+        }
+
+};
+
+TEST_F(TrajectoryIndexTest, XtcWriterAndScanAgree)
+{
+    runWriteAndBuild("xtc");
+}
+
+TEST_F(TrajectoryIndexTest, TrrWriterAndScanAgree)
+{
+    runWriteAndBuild("trr");
+}
+
+TEST_F(TrajectoryIndexTest, OnlyRequestedByWriter)
+{
+    std::string fn = trajectoryFileName("xtc");
+    writeFrames(fn, "w", 0, 3, false);
+
+    EXPECT_FALSE(gmx_fexist(gmx_trxindex_filename(fn.c_str()).c_str()));
+    EXPECT_EQ(nullptr, gmx_trxindex_read(fn.c_str()));
+}
+
+TEST_F(TrajectoryIndexTest, OverwritingRemovesIndex)
+{
+    std::string fn = trajectoryFileName("trr");
+    writeFrames(fn, "w", 0, 3);
+    EXPECT_TRUE(gmx_fexist(gmx_trxindex_filename(fn.c_str()).c_str()));
+    writeFrames(fn, "w", 0, 3, false);
+
+    EXPECT_FALSE(gmx_fexist(gmx_trxindex_filename(fn.c_str()).c_str()));
+}
+
+TEST_F(TrajectoryIndexTest, AppendingExtendsIndex)
+{
+    std::string fn = trajectoryFileName("xtc");
+    writeFrames(fn, "w", 0, 3);
+    writeFrames(fn, "a", 3, 6);
+
+    t_trxindex *index = gmx_trxindex_read(fn.c_str());
+    checkIndex(index, 6);
+    gmx_trxindex_done(index);
+}
+
+TEST_F(TrajectoryIndexTest, IndexBeyondTrajectoryIsIgnored)
+{
+    std::string fn = trajectoryFileName("xtc");
+    writeFrames(fn, "w", 0, 4);
+
+    /* Overwrite the trajectory with fewer frames and an index of the old one */
+    t_trxindex *index = gmx_trxindex_read(fn.c_str());
+    writeFrames(fn, "w", 0, 2);
+    gmx_trxindex_write(fn.c_str(), index);
+    gmx_trxindex_done(index);
+
+    index = gmx_trxindex_read(fn.c_str());
+    checkIndex(index, 2);
+    gmx_trxindex_done(index);
+}
+
+TEST_F(TrajectoryIndexTest, CanSeekToIndexedFrame)
+{
+    std::string       fn = trajectoryFileName("xtc");
+    writeFrames(fn, "w", 0, 8);
+
+    gmx_output_env_t *oenv;
+    t_trxstatus      *status;
+    t_trxframe        fr;
+    output_env_init_default(&oenv);
+    ASSERT_TRUE(read_first_frame(oenv, &status, fn.c_str(), &fr, TRX_NEED_X));
+    ASSERT_EQ(8, trx_indexed_frame_count(status));
+
+    int begin, end;
+    gmx_trxindex_partition(8, 3, 2, &begin, &end);
+    EXPECT_EQ(5, begin);
+    EXPECT_EQ(8, end);
+    ASSERT_TRUE(trx_seek_indexed_frame(status, begin));
+    ASSERT_TRUE(read_next_frame(oenv, status, &fr));
+    EXPECT_EQ(10*begin, fr.step);
+    EXPECT_FLOAT_EQ(0.1*begin, fr.x[0][XX]);
+
+    close_trx(status);
+    sfree(fr.x);
+    output_env_done(oenv);
+}
+
+TEST_F(TrajectoryIndexTest, BeginTimeSkipsIndexedFrames)
+{
+    /* XTC reading searches for the begin time, TRR reading needs the index */
+    std::string fn = trajectoryFileName("trr");
+    writeFrames(fn, "w", 0, 10);
+
+    int               nframesRead, nindexed;
+    setTimeValue(TBEGIN, 2);
+    std::vector<real> times = readFrameTimes(fn, &nframesRead, &nindexed);
+    ASSERT_EQ(6U, times.size());
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        EXPECT_FLOAT_EQ(2 + 0.5*i, times[i]);
+    }
+    EXPECT_EQ(10, nindexed);
+
+    /* Without index the same frames are read, but the skipped frames
+     * are read instead of jumped over.
+     */
+    std::remove(gmx_trxindex_filename(fn.c_str()).c_str());
+    int nframesReadWithoutIndex;
+    EXPECT_EQ(times, readFrameTimes(fn, &nframesReadWithoutIndex, &nindexed));
+    EXPECT_EQ(0, nindexed);
+    EXPECT_LT(nframesRead, nframesReadWithoutIndex);
+}
+
+TEST_F(TrajectoryIndexTest, DeltaTimeSkipsIndexedFrames)
+{
+    std::string fn = trajectoryFileName("xtc");
+    writeFrames(fn, "w", 0, 10);
+
+    int               nframesRead, nindexed;
+    setTimeValue(TBEGIN, 1);
+    setTimeValue(TDELTA, 1.5);
+    std::vector<real> times = readFrameTimes(fn, &nframesRead, &nindexed);
+    ASSERT_EQ(3U, times.size());
+    EXPECT_FLOAT_EQ(1.5, times[0]);
+    EXPECT_FLOAT_EQ(3.0, times[1]);
+    EXPECT_FLOAT_EQ(4.5, times[2]);
+    EXPECT_EQ(10, nindexed);
+
+    std::remove(gmx_trxindex_filename(fn.c_str()).c_str());
+    int nframesReadWithoutIndex;
+    EXPECT_EQ(times, readFrameTimes(fn, &nframesReadWithoutIndex, &nindexed));
+    EXPECT_LT(nframesRead, nframesReadWithoutIndex);
+}
+
+TEST_F(TrajectoryIndexTest, MismatchingIndexIsDiscarded)
+{
+    /* TRR frames all have the same size, so the indexed offsets are frame starts */
+    std::string fn = trajectoryFileName("trr");
+    writeFrames(fn, "w", 0, 8);
+
+    /* Replace the trajectory by frames with other steps and times,
+     * and restore the index of the old trajectory.
+     */
+    t_trxindex *index = gmx_trxindex_read(fn.c_str());
+    writeFrames(fn, "w", 4, 12, false);
+    gmx_trxindex_write(fn.c_str(), index);
+    gmx_trxindex_done(index);
+
+    int               nframesRead, nindexed;
+    setTimeValue(TBEGIN, 3);
+    std::vector<real> times = readFrameTimes(fn, &nframesRead, &nindexed);
+    ASSERT_EQ(6U, times.size());
+    for (size_t i = 0; i < times.size(); i++)
+    {
+        EXPECT_FLOAT_EQ(3 + 0.5*i, times[i]);
+    }
+    EXPECT_EQ(0, nindexed);
+}
+
+} // namespace
@@ -0,0 +1,232 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for reading XTC and TRR trajectories through trxio
+ *
+ * On platforms with mmap() these exercise reading from memory-mapped files.
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/trxio.h"
+
+#include "config.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/oenv.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/gmxomp.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "trajectoryfiletest.h"
+
+namespace
+{
+
+class TrajectoryReadingTest : public gmx::test::TrajectoryFileTest
+{
+    public:
+        TrajectoryReadingTest()
+        {
+            output_env_init_default(&oenv_);
+        }
+        ~TrajectoryReadingTest()
+        {
+            output_env_done(oenv_);
+        }
+
+        gmx_output_env_t           *oenv_;
+};
+
+TEST_F(TrajectoryReadingTest, TrrFramesAreReadExactly)
+{
+    std::string fn = trajectoryFileName("trr");
+    writeFrames(fn, "w", 0, 3);
+
+    t_trxstatus *status;
+    t_trxframe   fr;
+    int          frame = 0;
+    ASSERT_TRUE(read_first_frame(oenv_, &status, fn.c_str(), &fr, TRX_READ_X | TRX_READ_V | TRX_READ_F));
+    do
+    {
+        setFrame(frame);
+        ASSERT_TRUE(fr.bX && fr.bV && fr.bF);
+        EXPECT_EQ(10*frame, fr.step);
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_EQ(box_[d][d], fr.box[d][d]);
+        }
+        for (int i = 0; i < c_natoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_EQ(x_[i][d], fr.x[i][d]);
+                EXPECT_EQ(v_[i][d], fr.v[i][d]);
+                EXPECT_EQ(f_[i][d], fr.f[i][d]);
+            }
+        }
+        frame++;
+    }
+    while (read_next_frame(oenv_, status, &fr));
+    EXPECT_EQ(3, frame);
+
+    close_trx(status);
+    sfree(fr.x);
+    sfree(fr.v);
+    sfree(fr.f);
+}
+
+TEST_F(TrajectoryReadingTest, XtcFramesDecodedInBatchesMatchSerialReading)
+{
+    std::string fn = trajectoryFileName("xtc");
+    /* Without a frame index, frames are decoded in batches with multiple threads */
+    writeFrames(fn, "w", 0, 7, false);
+
+    const int                       nthreadsDefault = gmx_omp_get_max_threads();
+    std::vector<gmx_int64_t>        step[2];
+    std::vector<real>               time[2];
+    std::vector<std::vector<real> > coords[2];
+    for (int pass = 0; pass < 2; pass++)
+    {
+        /* With 3 threads the last batch is incomplete */
+        gmx_omp_set_num_threads(pass == 0 ? 1 : 3);
+
+        t_trxstatus *status;
+        t_trxframe   fr;
+        ASSERT_TRUE(read_first_frame(oenv_, &status, fn.c_str(), &fr, TRX_NEED_X));
+        do
+        {
+            EXPECT_EQ(fr.not_ok, 0);
+            step[pass].push_back(fr.step);
+            time[pass].push_back(fr.time);
+            std::vector<real> frameCoords(fr.box[0], fr.box[0] + DIM*DIM);
+            frameCoords.insert(frameCoords.end(), fr.x[0], fr.x[0] + DIM*fr.natoms);
+            coords[pass].push_back(frameCoords);
+        }
+        while (read_next_frame(oenv_, status, &fr));
+
+        close_trx(status);
+        sfree(fr.x);
+    }
+    gmx_omp_set_num_threads(nthreadsDefault);
+
+    EXPECT_EQ(7U, step[0].size());
+    EXPECT_TRUE(step[0] == step[1]);
+    EXPECT_TRUE(time[0] == time[1]);
+    EXPECT_TRUE(coords[0] == coords[1]);
+}
+
+TEST_F(TrajectoryReadingTest, FinalFrameTimeKeepsReadPosition)
+{
+    std::string fn = trajectoryFileName("xtc");
+    writeFrames(fn, "w", 0, 4);
+
+    t_trxstatus *status;
+    t_trxframe   fr;
+    ASSERT_TRUE(read_first_frame(oenv_, &status, fn.c_str(), &fr, TRX_NEED_X));
+    EXPECT_FLOAT_EQ(1.5, trx_get_time_of_final_frame(status));
+    ASSERT_TRUE(read_next_frame(oenv_, status, &fr));
+    EXPECT_EQ(10, fr.step);
+
+    close_trx(status);
+    sfree(fr.x);
+}
+
+#if GMX_INTERNAL_XDR && HAVE_MMAP
+/* Only reading from a memory mapping continues after the end of the file */
+TEST_F(TrajectoryReadingTest, ReadingContinuesAfterFileGrows)
+{
+    if (std::getenv("GMX_NO_MMAP_TRAJECTORY") != nullptr)
+    {
+        return;
+    }
+    std::string fn = trajectoryFileName("xtc");
+    writeFrames(fn, "w", 0, 2);
+
+    t_trxstatus *status;
+    t_trxframe   fr;
+    ASSERT_TRUE(read_first_frame(oenv_, &status, fn.c_str(), &fr, TRX_NEED_X));
+    ASSERT_TRUE(read_next_frame(oenv_, status, &fr));
+    EXPECT_FALSE(read_next_frame(oenv_, status, &fr));
+
+    writeFrames(fn, "a", 2, 4);
+    ASSERT_TRUE(read_next_frame(oenv_, status, &fr));
+    EXPECT_EQ(20, fr.step);
+    EXPECT_FLOAT_EQ(0.2, fr.x[0][XX]);
+    ASSERT_TRUE(read_next_frame(oenv_, status, &fr));
+    EXPECT_EQ(30, fr.step);
+
+    close_trx(status);
+    sfree(fr.x);
+}
+#endif
+
+#if !GMX_NATIVE_WINDOWS
+/* A mapped file that is truncated should give end of file instead of SIGBUS */
+TEST_F(TrajectoryReadingTest, ReadingStopsAfterFileIsTruncated)
+{
+    for (const char *ext : { "xtc", "trr" })
+    {
+        std::string fn = trajectoryFileName(ext);
+        writeFrames(fn, "w", 0, 4);
+
+        t_trxstatus *status;
+        t_trxframe   fr;
+        ASSERT_TRUE(read_first_frame(oenv_, &status, fn.c_str(), &fr, TRX_NEED_X));
+
+        /* Truncate to zero length, as opening for writing does */
+        std::FILE *fp = std::fopen(fn.c_str(), "w");
+        ASSERT_NE(nullptr, fp);
+        std::fclose(fp);
+        EXPECT_FALSE(read_next_frame(oenv_, status, &fr)) << "Reading truncated " << ext << " file";
+
+        close_trx(status);
+        sfree(fr.x);
+        sfree(fr.v);
+        sfree(fr.f);
+    }
+}
+#endif
+
+} // namespace
@@ -0,0 +1,362 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \internal \file
+ * \brief
+ * Tests for reading and writing XTC trajectories
+ *
+ * \ingroup module_fileio
+ */
+#include "gmxpre.h"
+
+#include "gromacs/fileio/xtcio.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/smalloc.h"
+
+#include "testutils/testfilemanager.h"
+
+namespace
+{
+
+/*! \brief Returns coordinate \p d of atom \p i in \p frame of the reference file, in units of 0.001 nm
+ *
+ * xtc-reference.xtc contains two frames of 300 atoms written with
+ * precision 1000 by the xdr3dfcoord encoder of GROMACS 2017, before
+ * the decoder was rewritten. The coordinates are triplets of nearby
+ * atoms, in frame 1 spread over a range that needs the large
+ * integer sizes.
+ */
+int referenceCoordinate(int frame, int i, int d)
+{
+    int molecule = i/3;
+    switch (d)
+    {
+        case XX:
+            return (frame == 0 ? (370*molecule) % 5000 : (370037*molecule) % 1800000 - 900000) + 100*(i % 3);
+        case YY:
+            return (1130*molecule) % 4000 - 70*(i % 3);
+        default:
+            return -((710*molecule + 300*frame) % 6000) + 90*(i % 3);
+    }
+}
+
+//! The number of atoms in the reference file
+const int c_referenceNatoms = 300;
+
+TEST(XtcReferenceTest, ReferenceFileDecodesToKnownCoordinates)
+{
+    gmx::test::TestFileManager fileManager;
+    t_fileio                  *fio = open_xtc(fileManager.getInputFilePath("xtc-reference.xtc").c_str(), "r");
+    int                        natoms;
+    gmx_int64_t                step;
+    real                       time, prec;
+    matrix                     box;
+    rvec                      *x;
+    gmx_bool                   bOK;
+
+    ASSERT_TRUE(read_first_xtc(fio, &natoms, &step, &time, box, &x, &prec, &bOK));
+    ASSERT_EQ(c_referenceNatoms, natoms);
+    for (int frame = 0; frame < 2; frame++)
+    {
+        if (frame > 0)
+        {
+            ASSERT_TRUE(read_next_xtc(fio, natoms, &step, &time, box, x, &prec, &bOK));
+        }
+        EXPECT_TRUE(bOK);
+        EXPECT_EQ(100*frame, step);
+        EXPECT_FLOAT_EQ(0.2*frame, time);
+        EXPECT_FLOAT_EQ(1000, prec);
+        EXPECT_FLOAT_EQ(frame == 0 ? 5 : 1800, box[XX][XX]);
+        EXPECT_FLOAT_EQ(4, box[YY][YY]);
+        EXPECT_FLOAT_EQ(6, box[ZZ][ZZ]);
+        for (int i = 0; i < natoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                /* The decoded values are the integers times 1/precision */
+                double reference = 0.001*referenceCoordinate(frame, i, d);
+                EXPECT_NEAR(reference, x[i][d], 1e-6*std::max(1.0, std::fabs(reference)))
+                << "frame " << frame << " atom " << i << " dimension " << d;
+            }
+        }
+    }
+    EXPECT_FALSE(read_next_xtc(fio, natoms, &step, &time, box, x, &prec, &bOK));
+    sfree(x);
+    close_xtc(fio);
+}
+
+//! Returns the contents of the binary file \p fn
+std::vector<char> readBytes(const std::string &fn)
+{
+    std::vector<char> bytes;
+    FILE             *fp = std::fopen(fn.c_str(), "rb");
+    if (fp != nullptr)
+    {
+        char buf[4096];
+        for (size_t n; (n = std::fread(buf, 1, sizeof(buf), fp)) > 0; )
+        {
+            bytes.insert(bytes.end(), buf, buf + n);
+        }
+        std::fclose(fp);
+    }
+    return bytes;
+}
+
+TEST(XtcReferenceTest, EncoderWritesReferenceFile)
+{
+    gmx::test::TestFileManager fileManager;
+    const std::string          fn = fileManager.getTemporaryFilePath(".xtc");
+    std::vector<gmx::RVec>     x(c_referenceNatoms);
+    matrix                     box;
+
+    clear_mat(box);
+    t_fileio *fio = open_xtc(fn.c_str(), "w");
+    for (int frame = 0; frame < 2; frame++)
+    {
+        for (int i = 0; i < c_referenceNatoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                x[i][d] = static_cast<float>(referenceCoordinate(frame, i, d)/1000.0);
+            }
+        }
+        box[XX][XX] = (frame == 0 ? 5 : 1800);
+        box[YY][YY] = 4;
+        box[ZZ][ZZ] = 6;
+        ASSERT_TRUE(write_xtc(fio, c_referenceNatoms, 100*frame, 0.2f*frame, box,
+                              as_rvec_array(x.data()), 1000));
+    }
+    close_xtc(fio);
+
+    /* The encoder should be byte-identical to the one that wrote the file */
+    const std::vector<char> reference = readBytes(fileManager.getInputFilePath("xtc-reference.xtc"));
+    const std::vector<char> written   = readBytes(fn);
+    ASSERT_EQ(reference.size(), written.size());
+    EXPECT_TRUE(reference == written);
+}
+
+class XtcReadTest : public ::testing::TestWithParam<int>
+{
+    public:
+        //! Writes \p nframes frames of \p natoms atoms to \p fn, with triplets of nearby atoms
+        void writeFrames(const std::string &fn, int natoms, int nframes)
+        {
+            std::vector<gmx::RVec> x(natoms);
+            matrix                 box;
+
+            clear_mat(box);
+            t_fileio *fio = open_xtc(fn.c_str(), "w");
+            for (int frame = 0; frame < nframes; frame++)
+            {
+                for (int i = 0; i < natoms; i++)
+                {
+                    int molecule = i/3;
+                    x[i][XX] = std::fmod(0.37*molecule + 0.05*frame, 5.0) + 0.1*(i % 3);
+                    x[i][YY] = std::fmod(1.13*molecule, 4.0) - 0.07*(i % 3);
+                    x[i][ZZ] = std::fmod(0.71*molecule + 0.3*frame, 6.0) + 0.09*(i % 3);
+                }
+                box[XX][XX] = 5 + 0.01*frame;
+                box[YY][YY] = 4;
+                box[ZZ][ZZ] = 6;
+                ASSERT_TRUE(write_xtc(fio, natoms, 100*frame, 0.2*frame, box,
+                                      as_rvec_array(x.data()), 1000));
+            }
+            close_xtc(fio);
+        }
+
+        gmx::test::TestFileManager fileManager_;
+};
+
+TEST_P(XtcReadTest, DecodedCoordinatesAreWithinPrecision)
+{
+    const int         natoms  = GetParam();
+    const int         nframes = 2;
+    const std::string fn      = fileManager_.getTemporaryFilePath(".xtc");
+    writeFrames(fn, natoms, nframes);
+
+    int               natomsRead;
+    gmx_int64_t       step;
+    real              time, prec;
+    matrix            box;
+    rvec             *x;
+    gmx_bool          bOK;
+    t_fileio         *fio = open_xtc(fn.c_str(), "r");
+    ASSERT_TRUE(read_first_xtc(fio, &natomsRead, &step, &time, box, &x, &prec, &bOK));
+    ASSERT_EQ(natoms, natomsRead);
+    for (int frame = 0; frame < nframes; frame++)
+    {
+        if (frame > 0)
+        {
+            ASSERT_TRUE(read_next_xtc(fio, natoms, &step, &time, box, x, &prec, &bOK));
+        }
+        EXPECT_TRUE(bOK);
+        EXPECT_EQ(100*frame, step);
+        for (int i = 0; i < natoms; i++)
+        {
+            int molecule = i/3;
+            EXPECT_NEAR(std::fmod(0.37*molecule + 0.05*frame, 5.0) + 0.1*(i % 3), x[i][XX], 0.0006);
+            EXPECT_NEAR(std::fmod(1.13*molecule, 4.0) - 0.07*(i % 3), x[i][YY], 0.0006);
+            EXPECT_NEAR(std::fmod(0.71*molecule + 0.3*frame, 6.0) + 0.09*(i % 3), x[i][ZZ], 0.0006);
+        }
+    }
+    EXPECT_FALSE(read_next_xtc(fio, natoms, &step, &time, box, x, &prec, &bOK));
+    sfree(x);
+    close_xtc(fio);
+}
+
+TEST_P(XtcReadTest, ParallelFrameReadingMatchesSerialReading)
+{
+    const int         natoms    = GetParam();
+    const int         nframes   = 7;
+    const int         maxframes = 3;
+    const std::string fn        = fileManager_.getTemporaryFilePath(".xtc");
+    writeFrames(fn, natoms, nframes);
+
+    /* Read all frames serially */
+    int               natomsRead;
+    gmx_int64_t       step[nframes];
+    real              time[nframes], prec[nframes];
+    matrix            box[nframes];
+    rvec             *x[nframes];
+    gmx_bool          bOK;
+    t_fileio         *fio = open_xtc(fn.c_str(), "r");
+    ASSERT_TRUE(read_first_xtc(fio, &natomsRead, &step[0], &time[0], box[0], &x[0], &prec[0], &bOK));
+    ASSERT_EQ(natoms, natomsRead);
+    for (int frame = 1; frame < nframes; frame++)
+    {
+        snew(x[frame], natoms);
+        ASSERT_TRUE(read_next_xtc(fio, natoms, &step[frame], &time[frame], box[frame], x[frame], &prec[frame], &bOK));
+    }
+    close_xtc(fio);
+
+    /* Read the frames after the first in batches, the last one incomplete */
+    gmx_int64_t       stepBatch[maxframes];
+    real              timeBatch[maxframes], precBatch[maxframes];
+    matrix            boxBatch[maxframes];
+    rvec             *xBatch[maxframes];
+    for (int f = 0; f < maxframes; f++)
+    {
+        snew(xBatch[f], natoms);
+    }
+    fio = open_xtc(fn.c_str(), "r");
+    ASSERT_TRUE(read_first_xtc(fio, &natomsRead, &stepBatch[0], &timeBatch[0], boxBatch[0], &xBatch[0], &precBatch[0], &bOK));
+    int frame = 1;
+    int nread;
+    while ((nread = read_next_xtc_frames(fio, natoms, maxframes, stepBatch, timeBatch, boxBatch,
+                                         xBatch, precBatch, &bOK)) > 0)
+    {
+        EXPECT_TRUE(bOK);
+        ASSERT_LE(frame + nread, nframes);
+        for (int f = 0; f < nread; f++, frame++)
+        {
+            EXPECT_EQ(step[frame], stepBatch[f]);
+            EXPECT_EQ(time[frame], timeBatch[f]);
+            EXPECT_EQ(prec[frame], precBatch[f]);
+            for (int i = 0; i < DIM; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_EQ(box[frame][i][d], boxBatch[f][i][d]);
+                }
+            }
+            for (int i = 0; i < natoms; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_EQ(x[frame][i][d], xBatch[f][i][d]);
+                }
+            }
+        }
+    }
+    EXPECT_TRUE(bOK);
+    EXPECT_EQ(nframes, frame);
+    close_xtc(fio);
+
+    for (int f = 0; f < nframes; f++)
+    {
+        sfree(x[f]);
+    }
+    for (int f = 0; f < maxframes; f++)
+    {
+        sfree(xBatch[f]);
+    }
+}
+
+TEST_P(XtcReadTest, EncodedCoordinatesDecodeWithinPrecision)
+{
+    const int          natoms = GetParam();
+    std::vector<float> x(3*natoms), xDecoded(3*natoms);
+    t_xdr3dfcoord_data data;
+
+    data.nalloc = 0;
+    data.bytes  = nullptr;
+    /* The second pass spans a range that needs the large integer sizes */
+    for (float range : { 5.0f, 30000.0f })
+    {
+        for (int i = 0; i < natoms; i++)
+        {
+            int molecule = i/3;
+            x[3*i + XX]  = std::fmod(0.37f*molecule, range) - 0.5f*range + 0.1f*(i % 3);
+            x[3*i + YY]  = std::fmod(1.13f*molecule, 4.0f) - 0.07f*(i % 3);
+            x[3*i + ZZ]  = -std::fmod(0.71f*molecule, 6.0f) + 0.09f*(i % 3);
+        }
+        ASSERT_TRUE(xdr3dfcoord_encode(x.data(), natoms, 1000, &data));
+        EXPECT_EQ(natoms, data.natoms);
+        ASSERT_TRUE(xdr3dfcoord_decode(&data, xDecoded.data()));
+        for (int i = 0; i < 3*natoms; i++)
+        {
+            EXPECT_NEAR(x[i], xDecoded[i], 0.0005 + 2e-7*range);
+        }
+    }
+    free(data.bytes);
+}
+
+//! Numbers of atoms for uncompressed, small and larger frames
+INSTANTIATE_TEST_CASE_P(NumberOfAtoms, XtcReadTest, ::testing::Values(5, 30, 3000));
+
+} // namespace
@@ -56,6 +56,8 @@ real rTimeValue(int tcontrol);
 
 void setTimeValue(int tcontrol, real value);
 
+void unsetTimeValue(int tcontrol);
+
 #ifdef __cplusplus
 }
 #endif
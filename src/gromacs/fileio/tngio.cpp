@@ -39,8 +39,11 @@
 #include "config.h"
 
 #include <cmath>
+#include <cstdlib>
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #if GMX_USE_TNG
 #include "tng/tng_io.h"
@@ -59,6 +62,7 @@
 #include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/programcontext.h"
 #include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
 #include "gromacs/utility/sysinfo.h"
 
 static const char *modeToVerb(char mode)
@@ -321,12 +325,124 @@ greatest_common_divisor_if_positive(int n1, int n2)
 
 /* By default try to write 100 frames (of actual output) in each frame set.
  * This number is the number of outputs of the most frequently written data
- * type per frame set.
- * TODO for 5.1: Verify that 100 frames per frame set is efficient for most
- * setups regarding compression efficiency and compression time. Make this
- * a hidden command-line option? */
+ * type per frame set. It can be changed with GMX_TNG_FRAMES_PER_FRAME_SET.
+ * Longer frame sets compress better, but are kept in memory until they
+ * are complete.
+ */
 const int defaultFramesPerFrameSet = 100;
 
+/*! \libinternal \brief Returns the number of frames per frame set of the
+ * most frequently written data type, set with GMX_TNG_FRAMES_PER_FRAME_SET */
+static int frames_per_frame_set()
+{
+    const char *env = getenv("GMX_TNG_FRAMES_PER_FRAME_SET");
+    int         nframes;
+
+    if (env == nullptr)
+    {
+        return defaultFramesPerFrameSet;
+    }
+    nframes = std::strtol(env, nullptr, 10);
+    if (nframes < 1)
+    {
+        gmx_fatal(FARGS, "GMX_TNG_FRAMES_PER_FRAME_SET should be a positive number, not '%s'", env);
+    }
+
+    return nframes;
+}
+
+/*! \libinternal \brief A data block of which the compression can be set
+ * with GMX_TNG_COMPRESSION */
+struct TngBlockCompression
+{
+    //! The TNG id of the data block
+    gmx_int64_t blockId;
+    //! The name of the block in GMX_TNG_COMPRESSION
+    const char *name;
+    //! Whether the lossy TNG algorithm can be used
+    bool        bLossyAllowed;
+    //! The algorithm set by the user, -1 when not set
+    int         compression;
+};
+
+/*! \libinternal \brief Parses the value \p env of GMX_TNG_COMPRESSION
+ *
+ * This holds comma-separated block=algorithm settings, e.g.
+ * "positions=gzip,forces=none". The blocks are positions, velocities,
+ * forces, box and lambda, the algorithms none, gzip and tng. The lossy
+ * tng algorithm only supports positions and velocities. The TNG library
+ * does not implement its XTC algorithm, so that is not offered.
+ */
+static std::vector<TngBlockCompression> parse_tng_compression(const char *env)
+{
+    /* The names of the algorithms, indexed by tng_compression */
+    const char                      *algorithmNames[] = { "none", nullptr, "tng", "gzip" };
+    std::vector<TngBlockCompression> blocks           = {
+        { TNG_TRAJ_POSITIONS, "positions", true, -1 },
+        { TNG_TRAJ_VELOCITIES, "velocities", true, -1 },
+        { TNG_TRAJ_FORCES, "forces", false, -1 },
+        { TNG_TRAJ_BOX_SHAPE, "box", false, -1 },
+        { TNG_GMX_LAMBDA, "lambda", false, -1 }
+    };
+
+    if (env == nullptr)
+    {
+        return blocks;
+    }
+    for (const std::string &setting : gmx::splitDelimitedString(env, ','))
+    {
+        size_t               pos       = setting.find('=');
+        std::string          blockName = gmx::stripString(setting.substr(0, pos));
+        std::string          algorithm = (pos == std::string::npos ? "" : gmx::stripString(setting.substr(pos + 1)));
+        TngBlockCompression *block     = nullptr;
+
+        for (TngBlockCompression &b : blocks)
+        {
+            if (blockName == b.name)
+            {
+                block = &b;
+            }
+        }
+        for (int c = TNG_UNCOMPRESSED; c <= TNG_GZIP_COMPRESSION && block != nullptr; c++)
+        {
+            if (algorithmNames[c] != nullptr && algorithm == algorithmNames[c])
+            {
+                block->compression = c;
+            }
+        }
+        if (block == nullptr || block->compression < 0)
+        {
+            gmx_fatal(FARGS, "Invalid setting '%s' in GMX_TNG_COMPRESSION, use block=algorithm with blocks positions, velocities, forces, box or lambda and algorithms none, gzip or tng",
+                      setting.c_str());
+        }
+        if (!block->bLossyAllowed && block->compression == TNG_TNG_COMPRESSION)
+        {
+            gmx_fatal(FARGS, "GMX_TNG_COMPRESSION: the lossy algorithm %s can only be used for positions and velocities, not for %s",
+                      algorithm.c_str(), block->name);
+        }
+    }
+
+    return blocks;
+}
+
+/*! \libinternal \brief Returns the compression algorithm for data block
+ * \p blockId, \p defaultCompression unless set with GMX_TNG_COMPRESSION */
+static char tng_block_compression(gmx_int64_t blockId, char defaultCompression)
+{
+    static const std::vector<TngBlockCompression> blocks =
+        parse_tng_compression(getenv("GMX_TNG_COMPRESSION"));
+
+    for (const TngBlockCompression &b : blocks)
+    {
+        if (b.blockId == blockId && b.compression >= 0)
+        {
+            return b.compression;
+        }
+    }
+
+    return defaultCompression;
+}
+
 /*! \libinternal \brief  Set the number of frames per frame
  * set according to output intervals.
  * The default is that 100 frames are written of the data
@@ -338,7 +454,7 @@ static void tng_set_frames_per_frame_set(tng_trajectory_t  tng,
     int     gcd = -1;
 
     /* Set the number of frames per frame set to contain at least
-     * defaultFramesPerFrameSet of the lowest common denominator of
+     * frames_per_frame_set() of the lowest common denominator of
      * the writing interval of positions and velocities. */
     /* FIXME after 5.0: consider nstenergy also? */
     if (bUseLossyCompression)
@@ -355,7 +471,7 @@ static void tng_set_frames_per_frame_set(tng_trajectory_t  tng,
         return;
     }
 
-    tng_num_frames_per_frame_set_set(tng, gcd * defaultFramesPerFrameSet);
+    tng_num_frames_per_frame_set_set(tng, gcd * frames_per_frame_set());
 }
 
 /*! \libinternal \brief Set the data-writing intervals, and number of
@@ -413,7 +529,7 @@ static void set_writing_intervals(tng_trajectory_t  tng,
     {
         set_writing_interval(tng, xout, 3, TNG_TRAJ_POSITIONS,
                              "POSITIONS", TNG_PARTICLE_BLOCK_DATA,
-                             compression);
+                             tng_block_compression(TNG_TRAJ_POSITIONS, compression));
         /* TODO: if/when we write energies to TNG also, reconsider how
          * and when box information is written, because GROMACS
          * behaviour pre-5.0 was to write the box with every
@@ -430,7 +546,7 @@ static void set_writing_intervals(tng_trajectory_t  tng,
     {
         set_writing_interval(tng, vout, 3, TNG_TRAJ_VELOCITIES,
                              "VELOCITIES", TNG_PARTICLE_BLOCK_DATA,
-                             compression);
+                             tng_block_compression(TNG_TRAJ_VELOCITIES, compression));
 
         gcd = greatest_common_divisor_if_positive(gcd, vout);
         if (lowest < 0 || vout < lowest)
@@ -442,7 +558,7 @@ static void set_writing_intervals(tng_trajectory_t  tng,
     {
         set_writing_interval(tng, fout, 3, TNG_TRAJ_FORCES,
                              "FORCES", TNG_PARTICLE_BLOCK_DATA,
-                             TNG_GZIP_COMPRESSION);
+                             tng_block_compression(TNG_TRAJ_FORCES, TNG_GZIP_COMPRESSION));
 
         gcd = greatest_common_divisor_if_positive(gcd, fout);
         if (lowest < 0 || fout < lowest)
@@ -456,11 +572,11 @@ static void set_writing_intervals(tng_trajectory_t  tng,
            denominator of other output */
         set_writing_interval(tng, gcd, 1, TNG_GMX_LAMBDA,
                              "LAMBDAS", TNG_NON_PARTICLE_BLOCK_DATA,
-                             TNG_GZIP_COMPRESSION);
+                             tng_block_compression(TNG_GMX_LAMBDA, TNG_GZIP_COMPRESSION));
 
         set_writing_interval(tng, gcd, 9, TNG_TRAJ_BOX_SHAPE,
                              "BOX SHAPE", TNG_NON_PARTICLE_BLOCK_DATA,
-                             TNG_GZIP_COMPRESSION);
+                             tng_block_compression(TNG_TRAJ_BOX_SHAPE, TNG_GZIP_COMPRESSION));
         if (gcd < lowest / 10)
         {
             gmx_warning("The lowest common denominator of trajectory output is "
@@ -779,7 +895,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                        reinterpret_cast<const real *>(x),
                        3, TNG_TRAJ_POSITIONS, "POSITIONS",
                        TNG_PARTICLE_BLOCK_DATA,
-                       compression) != TNG_SUCCESS)
+                       tng_block_compression(TNG_TRAJ_POSITIONS, compression)) != TNG_SUCCESS)
         {
             gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
         }
@@ -791,7 +907,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                        reinterpret_cast<const real *>(v),
                        3, TNG_TRAJ_VELOCITIES, "VELOCITIES",
                        TNG_PARTICLE_BLOCK_DATA,
-                       compression) != TNG_SUCCESS)
+                       tng_block_compression(TNG_TRAJ_VELOCITIES, compression)) != TNG_SUCCESS)
         {
             gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
         }
@@ -805,7 +921,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                        reinterpret_cast<const real *>(f),
                        3, TNG_TRAJ_FORCES, "FORCES",
                        TNG_PARTICLE_BLOCK_DATA,
-                       TNG_GZIP_COMPRESSION) != TNG_SUCCESS)
+                       tng_block_compression(TNG_TRAJ_FORCES, TNG_GZIP_COMPRESSION)) != TNG_SUCCESS)
         {
             gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
         }
@@ -817,7 +933,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                    reinterpret_cast<const real *>(box),
                    9, TNG_TRAJ_BOX_SHAPE, "BOX SHAPE",
                    TNG_NON_PARTICLE_BLOCK_DATA,
-                   TNG_GZIP_COMPRESSION) != TNG_SUCCESS)
+                   tng_block_compression(TNG_TRAJ_BOX_SHAPE, TNG_GZIP_COMPRESSION)) != TNG_SUCCESS)
     {
         gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
     }
@@ -826,7 +942,7 @@ void gmx_fwrite_tng(tng_trajectory_t tng,
                    reinterpret_cast<const real *>(&lambda),
                    1, TNG_GMX_LAMBDA, "LAMBDAS",
                    TNG_NON_PARTICLE_BLOCK_DATA,
-                   TNG_GZIP_COMPRESSION) != TNG_SUCCESS)
+                   tng_block_compression(TNG_GMX_LAMBDA, TNG_GZIP_COMPRESSION)) != TNG_SUCCESS)
     {
         gmx_file("Cannot write TNG trajectory frame; maybe you are out of disk space?");
     }
@@ -950,22 +1066,22 @@ void gmx_prepare_tng_writing(const char              *filename,
                     case TNG_TRAJ_VELOCITIES:
                         set_writing_interval(*output, interval, 3, fallbackIds[i],
                                              fallbackNames[i], TNG_PARTICLE_BLOCK_DATA,
-                                             compression_type);
+                                             tng_block_compression(fallbackIds[i], compression_type));
                         break;
                     case TNG_TRAJ_FORCES:
                         set_writing_interval(*output, interval, 3, fallbackIds[i],
                                              fallbackNames[i], TNG_PARTICLE_BLOCK_DATA,
-                                             TNG_GZIP_COMPRESSION);
+                                             tng_block_compression(fallbackIds[i], TNG_GZIP_COMPRESSION));
                         break;
                     case TNG_TRAJ_BOX_SHAPE:
                         set_writing_interval(*output, interval, 9, fallbackIds[i],
                                              fallbackNames[i], TNG_NON_PARTICLE_BLOCK_DATA,
-                                             TNG_GZIP_COMPRESSION);
+                                             tng_block_compression(fallbackIds[i], TNG_GZIP_COMPRESSION));
                         break;
                     case TNG_GMX_LAMBDA:
                         set_writing_interval(*output, interval, 1, fallbackIds[i],
                                              fallbackNames[i], TNG_NON_PARTICLE_BLOCK_DATA,
-                                             TNG_GZIP_COMPRESSION);
+                                             tng_block_compression(fallbackIds[i], TNG_GZIP_COMPRESSION));
                         break;
                     default:
                         continue;
@@ -115,6 +115,7 @@ enum tpxv {
     tpxv_ReplacePullPrintCOM12,                              /**< Replaced print-com-1, 2 with pull-print-com */
     tpxv_PullExternalPotential,                              /**< Added pull type external potential */
     tpxv_GenericParamsForElectricField,                      /**< Introduced KeyValueTree and moved electric field parameters */
+    tpxv_CompressedXStreams,                                 /**< Added additional compressed coordinate output streams */
     tpxv_Count                                               /**< the total number of tpxv versions */
 };
 
@@ -445,6 +446,18 @@ static void do_imd(t_fileio *fio, t_IMD *imd, gmx_bool bRead)
     gmx_fio_ndo_int(fio, imd->ind, imd->nat);
 }
 
+static void do_x_stream(t_fileio *fio, t_compressed_x_stream *xs, gmx_bool bRead)
+{
+    gmx_fio_do_int(fio, xs->nstxout);
+    gmx_fio_do_real(fio, xs->precision);
+    gmx_fio_do_int(fio, xs->nat);
+    if (bRead)
+    {
+        snew(xs->ind, xs->nat);
+    }
+    gmx_fio_ndo_int(fio, xs->ind, xs->nat);
+}
+
 static void do_fepvals(t_fileio *fio, t_lambda *fepvals, gmx_bool bRead, int file_version)
 {
     /* i is defined in the ndo_double macro; use g to iterate. */
@@ -1571,6 +1584,24 @@ static void do_inputrec(t_fileio *fio, t_inputrec *ir, gmx_bool bRead,
         ir->bIMD = FALSE;
     }
 
+    /* Additional compressed coordinate output */
+    if (file_version >= tpxv_CompressedXStreams)
+    {
+        gmx_fio_do_int(fio, ir->n_x_streams);
+        if (bRead)
+        {
+            snew(ir->x_streams, ir->n_x_streams);
+        }
+        for (int s = 0; s < ir->n_x_streams; s++)
+        {
+            do_x_stream(fio, &ir->x_streams[s], bRead);
+        }
+    }
+    else
+    {
+        ir->n_x_streams = 0;
+    }
+
     /* grpopts stuff */
     gmx_fio_do_int(fio, ir->opts.ngtc);
     if (file_version >= 69)
@@ -3131,9 +3162,13 @@ static void do_tpxheader(t_fileio *fio, gmx_bool bRead, t_tpxheader *tpx,
     }
 }
 
+/* Reads or writes a tpr file. When reading with x==nullptr, the coordinates
+ * and velocities are stored in state, unless bSkipXV is set, then they are
+ * skipped, which avoids allocating and converting them when not needed.
+ */
 static int do_tpx(t_fileio *fio, gmx_bool bRead,
                   t_inputrec *ir, t_state *state, rvec *x, rvec *v,
-                  gmx_mtop_t *mtop)
+                  gmx_mtop_t *mtop, gmx_bool bSkipXV)
 {
     t_tpxheader     tpx;
     gmx_mtop_t      dum_top;
@@ -3172,7 +3207,7 @@ static int do_tpx(t_fileio *fio, gmx_bool bRead,
     {
         state->flags = 0;
         init_gtc_state(state, tpx.ngtc, 0, 0);
-        if (x == nullptr)
+        if (x == nullptr && !bSkipXV)
         {
             // v is also nullptr by the above assertion, so we may
             // need to make memory in state for storing the contents
@@ -3189,7 +3224,7 @@ static int do_tpx(t_fileio *fio, gmx_bool bRead,
         }
     }
 
-    if (x == nullptr)
+    if (x == nullptr && !bSkipXV)
     {
         x = as_rvec_array(state->x.data());
         v = as_rvec_array(state->v.data());
@@ -3247,7 +3282,7 @@ static int do_tpx(t_fileio *fio, gmx_bool bRead,
     do_test(fio, tpx.bX, x);
     if (tpx.bX)
     {
-        if (bRead)
+        if (bRead && x != nullptr)
         {
             state->flags |= (1<<estX);
         }
@@ -3257,7 +3292,7 @@ static int do_tpx(t_fileio *fio, gmx_bool bRead,
     do_test(fio, tpx.bV, v);
     if (tpx.bV)
     {
-        if (bRead)
+        if (bRead && v != nullptr)
         {
             state->flags |= (1<<estV);
         }
@@ -3268,7 +3303,7 @@ static int do_tpx(t_fileio *fio, gmx_bool bRead,
     if (tpx.bF)
     {
         rvec *dummyForces;
-        snew(dummyForces, state->natoms);
+        snew(dummyForces, tpx.natoms);
         gmx_fio_ndo_rvec(fio, dummyForces, tpx.natoms);
         sfree(dummyForces);
     }
@@ -3387,7 +3422,7 @@ void write_tpx_state(const char *fn,
     do_tpx(fio, FALSE,
            const_cast<t_inputrec *>(ir),
            const_cast<t_state *>(state), nullptr, nullptr,
-           const_cast<gmx_mtop_t *>(mtop));
+           const_cast<gmx_mtop_t *>(mtop), FALSE);
     close_tpx(fio);
 }
 
@@ -3397,7 +3432,7 @@ void read_tpx_state(const char *fn,
     t_fileio *fio;
 
     fio = open_tpx(fn, "r");
-    do_tpx(fio, TRUE, ir, state, nullptr, nullptr, mtop);
+    do_tpx(fio, TRUE, ir, state, nullptr, nullptr, mtop, FALSE);
     close_tpx(fio);
 }
 
@@ -3410,7 +3445,7 @@ int read_tpx(const char *fn,
     int       ePBC;
 
     fio     = open_tpx(fn, "r");
-    ePBC    = do_tpx(fio, TRUE, ir, &state, x, v, mtop);
+    ePBC    = do_tpx(fio, TRUE, ir, &state, x, v, mtop, x == nullptr);
     close_tpx(fio);
     *natoms = mtop->natoms;
     if (box)
@@ -102,6 +102,7 @@ int read_tpx(const char *fn,
              rvec *x, rvec *v, gmx_mtop_t *mtop);
 /* Read a file, and close it again.
  * When step, t or lambda are NULL they will not be stored.
+ * When x or v are NULL, the coordinates or velocities are skipped.
  * Returns ir->ePBC, if it could be read from the file.
  */
 
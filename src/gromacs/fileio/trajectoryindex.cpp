@@ -0,0 +1,473 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include "trajectoryindex.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "gromacs/fileio/filetypes.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/gmxfio-xdr.h"
+#include "gromacs/fileio/trrio.h"
+#include "gromacs/fileio/xdrf.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/cstringutil.h"
+#include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/smalloc.h"
+
+/*! \brief The first line of an index file, identifies the format */
+static const char *const c_trxindexHeader = "# GROMACS trajectory frame index, version 1";
+
+/*! \brief Magic number at the start of each XTC frame */
+static const int c_xtcMagic = 1995;
+
+/*! \brief Size of an XDR int or float */
+static const int c_xdrUnitSize = 4;
+
+gmx_bool gmx_trxindex_enabled()
+{
+    return (getenv("GMX_NO_TRAJECTORY_INDEX") == nullptr);
+}
+
+std::string gmx_trxindex_filename(const char *fn)
+{
+    return std::string(fn) + ".fidx";
+}
+
+static void trxindex_add(t_trxindex *index, gmx_off_t offset, gmx_off_t size,
+                         gmx_int64_t step, double time)
+{
+    if (index->nframes == index->nalloc)
+    {
+        index->nalloc = over_alloc_large(index->nframes + 1);
+        srenew(index->offset, index->nalloc);
+        srenew(index->size, index->nalloc);
+        srenew(index->step, index->nalloc);
+        srenew(index->time, index->nalloc);
+    }
+    index->offset[index->nframes] = offset;
+    index->size[index->nframes]   = size;
+    index->step[index->nframes]   = step;
+    index->time[index->nframes]   = time;
+    index->nframes++;
+}
+
+/*! \brief Returns the file offset just after the last indexed frame */
+static gmx_off_t trxindex_end(const t_trxindex *index)
+{
+    if (index->nframes == 0)
+    {
+        return 0;
+    }
+    return index->offset[index->nframes - 1] + index->size[index->nframes - 1];
+}
+
+/*! \brief Returns the size of file \p fn, -1 when it can not be opened */
+static gmx_off_t file_size(const char *fn)
+{
+    FILE     *fp;
+    gmx_off_t size = -1;
+
+    fp = fopen(fn, "rb");
+    if (fp != nullptr)
+    {
+        if (gmx_fseek(fp, 0, SEEK_END) == 0)
+        {
+            size = gmx_ftell(fp);
+        }
+        fclose(fp);
+    }
+
+    return size;
+}
+
+/*! \brief Reads index file \p fn, stops at the first entry that is inconsistent with the previous ones */
+static t_trxindex *read_index_file(const char *fn)
+{
+    FILE       *fp;
+    char        line[STRLEN];
+    t_trxindex *index;
+
+    fp = fopen(fn, "r");
+    if (fp == nullptr)
+    {
+        return nullptr;
+    }
+    if (fgets(line, STRLEN, fp) == nullptr ||
+        std::strncmp(line, c_trxindexHeader, std::strlen(c_trxindexHeader)) != 0)
+    {
+        fclose(fp);
+        return nullptr;
+    }
+
+    snew(index, 1);
+    while (fgets(line, STRLEN, fp) != nullptr)
+    {
+        gmx_int64_t offset, size, step;
+        double      time;
+
+        if (line[0] == '#')
+        {
+            continue;
+        }
+        /* A line without a newline was cut off by an interrupted write */
+        if (std::strchr(line, '\n') == nullptr ||
+            sscanf(line, "%" GMX_SCNd64 " %" GMX_SCNd64 " %" GMX_SCNd64 " %lf",
+                   &offset, &size, &step, &time) != 4 ||
+            offset != trxindex_end(index) || size <= 0)
+        {
+            break;
+        }
+        trxindex_add(index, offset, size, step, time);
+    }
+    fclose(fp);
+
+    return index;
+}
+
+t_trxindex *gmx_trxindex_read(const char *fn)
+{
+    t_trxindex *index;
+    gmx_off_t   trajectorySize;
+
+    if (!gmx_trxindex_enabled())
+    {
+        return nullptr;
+    }
+
+    index = read_index_file(gmx_trxindex_filename(fn).c_str());
+    if (index == nullptr)
+    {
+        return nullptr;
+    }
+
+    /* Frames that are not (completely) present in the trajectory
+     * are of no use, the trajectory was truncated or is being written.
+     */
+    trajectorySize = file_size(fn);
+    while (index->nframes > 0 && trxindex_end(index) > trajectorySize)
+    {
+        index->nframes--;
+    }
+    if (index->nframes == 0)
+    {
+        gmx_trxindex_done(index);
+        index = nullptr;
+    }
+
+    return index;
+}
+
+/*! \brief Reads the step and time from the XTC frame header at the current position and skips the frame data
+ *
+ * Returns FALSE when no complete header could be read or the magic number is wrong.
+ */
+static gmx_bool xtc_read_header_and_skip(t_fileio *fio, gmx_int64_t *step, double *time)
+{
+    XDR      *xd = gmx_fio_getxdr(fio);
+    int       magic, natoms, intStep, lsize, nbytes;
+    float     ftime;
+    gmx_off_t pos;
+
+    if (!xdr_int(xd, &magic) || magic != c_xtcMagic ||
+        !xdr_int(xd, &natoms) || !xdr_int(xd, &intStep) ||
+        !xdr_float(xd, &ftime))
+    {
+        return FALSE;
+    }
+    *step = intStep;
+    *time = ftime;
+
+    /* Skip the box and read the number of atoms of the coordinate block */
+    pos = gmx_fio_ftell(fio) + DIM*DIM*c_xdrUnitSize;
+    if (gmx_fio_seek(fio, pos) != 0 || !xdr_int(xd, &lsize) || lsize != natoms)
+    {
+        return FALSE;
+    }
+    if (lsize <= 9)
+    {
+        /* Small systems are stored uncompressed */
+        pos = gmx_fio_ftell(fio) + lsize*DIM*c_xdrUnitSize;
+    }
+    else
+    {
+        /* Skip precision, minint, maxint and smallidx, read the byte count */
+        pos = gmx_fio_ftell(fio) + (1 + 2*DIM + 1)*c_xdrUnitSize;
+        if (gmx_fio_seek(fio, pos) != 0 || !xdr_int(xd, &nbytes) || nbytes < 0)
+        {
+            return FALSE;
+        }
+        /* The compressed bytes are padded to a multiple of the XDR unit */
+        pos = gmx_fio_ftell(fio) + ((nbytes + c_xdrUnitSize - 1)/c_xdrUnitSize)*c_xdrUnitSize;
+    }
+
+    return (gmx_fio_seek(fio, pos) == 0);
+}
+
+/*! \brief Reads the step and time from the TRR frame header at the current position and skips the frame data
+ *
+ * Returns FALSE when no complete header could be read.
+ */
+static gmx_bool trr_read_header_and_skip(t_fileio *fio, gmx_int64_t *step, double *time)
+{
+    gmx_trr_header_t sh;
+    gmx_bool         bOK;
+    gmx_off_t        pos;
+
+    if (!gmx_trr_read_frame_header(fio, &sh, &bOK) || !bOK)
+    {
+        return FALSE;
+    }
+    *step = sh.step;
+    *time = sh.t;
+
+    pos = gmx_fio_ftell(fio) + sh.box_size + sh.vir_size + sh.pres_size +
+        sh.x_size + sh.v_size + sh.f_size;
+
+    return (gmx_fio_seek(fio, pos) == 0);
+}
+
+static gmx_bool read_header_and_skip(t_fileio *fio, gmx_int64_t *step, double *time)
+{
+    switch (gmx_fio_getftp(fio))
+    {
+        case efXTC:
+            return xtc_read_header_and_skip(fio, step, time);
+        case efTRR:
+            return trr_read_header_and_skip(fio, step, time);
+        default:
+            gmx_incons("Frame indices are only supported for XTC and TRR files");
+    }
+
+    return FALSE;
+}
+
+t_trxindex *gmx_trxindex_build(const char *fn, t_trxindex *index)
+{
+    t_fileio   *fio;
+    gmx_off_t   trajectorySize, start, end;
+    gmx_int64_t step;
+    double      time;
+
+    if (fn2ftp(fn) != efXTC && fn2ftp(fn) != efTRR)
+    {
+        gmx_fatal(FARGS, "Can only index XTC and TRR trajectories, not '%s'", fn);
+    }
+    if (index == nullptr)
+    {
+        snew(index, 1);
+    }
+
+    trajectorySize = file_size(fn);
+    fio            = gmx_fio_open(fn, "r");
+    start          = trxindex_end(index);
+    if (start > 0 && gmx_fio_seek(fio, start) != 0)
+    {
+        gmx_fatal(FARGS, "Could not seek to position %" GMX_PRId64 " in '%s'",
+                  static_cast<gmx_int64_t>(start), fn);
+    }
+    while (start < trajectorySize && read_header_and_skip(fio, &step, &time))
+    {
+        end = gmx_fio_ftell(fio);
+        if (end > trajectorySize)
+        {
+            /* The last frame is incomplete */
+            break;
+        }
+        trxindex_add(index, start, end - start, step, time);
+        start = end;
+    }
+    gmx_fio_close(fio);
+
+    return index;
+}
+
+void gmx_trxindex_write_frame(FILE *fp, gmx_off_t offset, gmx_off_t size,
+                              gmx_int64_t step, double time)
+{
+    fprintf(fp, "%" GMX_PRId64 " %" GMX_PRId64 " %" GMX_PRId64 " %.17g\n",
+            static_cast<gmx_int64_t>(offset), static_cast<gmx_int64_t>(size),
+            step, time);
+}
+
+/*! \brief Creates index file \p fn with the entries in \p index, returns the open file */
+static FILE *write_index_file(const char *fn, const t_trxindex *index)
+{
+    FILE *fp;
+
+    fp = fopen(fn, "w");
+    if (fp == nullptr)
+    {
+        return nullptr;
+    }
+    fprintf(fp, "%s\n", c_trxindexHeader);
+    fprintf(fp, "# offset size step time\n");
+    if (index != nullptr)
+    {
+        for (int i = 0; i < index->nframes; i++)
+        {
+            gmx_trxindex_write_frame(fp, index->offset[i], index->size[i],
+                                     index->step[i], index->time[i]);
+        }
+    }
+
+    return fp;
+}
+
+void gmx_trxindex_write(const char *fn, const t_trxindex *index)
+{
+    std::string indexFn = gmx_trxindex_filename(fn);
+    FILE       *fp;
+
+    fp = write_index_file(indexFn.c_str(), index);
+    if (fp == nullptr || fclose(fp) != 0)
+    {
+        gmx_file(indexFn.c_str());
+    }
+}
+
+FILE *gmx_trxindex_open_for_writing(const char *fn, gmx_bool bAppend,
+                                    gmx_off_t trajectorySize)
+{
+    std::string indexFn = gmx_trxindex_filename(fn);
+    t_trxindex *index   = nullptr;
+    FILE       *fp;
+
+    if (!gmx_trxindex_enabled())
+    {
+        return nullptr;
+    }
+
+    if (bAppend && trajectorySize > 0)
+    {
+        index = read_index_file(indexFn.c_str());
+        if (index != nullptr)
+        {
+            while (index->nframes > 0 && trxindex_end(index) > trajectorySize)
+            {
+                index->nframes--;
+            }
+        }
+        if (index == nullptr || trxindex_end(index) != trajectorySize)
+        {
+            /* We can not index the appended frames without the earlier ones */
+            gmx_trxindex_done(index);
+            remove(indexFn.c_str());
+            return nullptr;
+        }
+    }
+
+    fp = write_index_file(indexFn.c_str(), index);
+    gmx_trxindex_done(index);
+    if (fp == nullptr && debug)
+    {
+        fprintf(debug, "Could not create frame index file '%s'\n", indexFn.c_str());
+    }
+
+    return fp;
+}
+
+void gmx_trxindex_done(t_trxindex *index)
+{
+    if (index == nullptr)
+    {
+        return;
+    }
+    sfree(index->offset);
+    sfree(index->size);
+    sfree(index->step);
+    sfree(index->time);
+    sfree(index);
+}
+
+int gmx_trxindex_find_offset(const t_trxindex *index, gmx_off_t offset)
+{
+    int low  = 0;
+    int high = index->nframes - 1;
+
+    while (low <= high)
+    {
+        int mid = low + (high - low)/2;
+        if (index->offset[mid] == offset)
+        {
+            return mid;
+        }
+        else if (index->offset[mid] < offset)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+gmx_bool gmx_trxindex_seek_frame(t_fileio *fio, const t_trxindex *index, int frame)
+{
+    gmx_int64_t step;
+    double      time;
+
+    GMX_RELEASE_ASSERT(frame >= 0 && frame < index->nframes, "Frame should be in the index");
+
+    if (gmx_fio_seek(fio, index->offset[frame]) != 0 ||
+        !read_header_and_skip(fio, &step, &time) ||
+        gmx_fio_ftell(fio) != index->offset[frame] + index->size[frame])
+    {
+        return FALSE;
+    }
+    /* XTC and TRR store the step as a 32-bit integer */
+    if (static_cast<int>(step) != static_cast<int>(index->step[frame]))
+    {
+        return FALSE;
+    }
+
+    return (gmx_fio_seek(fio, index->offset[frame]) == 0);
+}
+
+void gmx_trxindex_partition(int nframes, int nparts, int part, int *begin, int *end)
+{
+    GMX_RELEASE_ASSERT(nparts > 0 && part >= 0 && part < nparts, "Invalid part");
+
+    *begin = static_cast<int>((static_cast<gmx_int64_t>(nframes)*part)/nparts);
+    *end   = static_cast<int>((static_cast<gmx_int64_t>(nframes)*(part + 1))/nparts);
+}
@@ -0,0 +1,145 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+/*! \libinternal \file
+ * \brief
+ * Declares the frame index sidecar files for XTC and TRR trajectories.
+ *
+ * XTC and TRR files have no table of contents, so finding a frame
+ * normally requires reading or searching the file. mdrun maintains
+ * a small text file next to the trajectories it writes, named by
+ * appending ".fidx" to the trajectory file name, that lists the
+ * offset, size, step and time of each frame; gmx trjindex creates
+ * it for other trajectories. Other tools do not write an index, so
+ * their output is unchanged. Readers use the index to jump directly
+ * to frames and to split a trajectory over workers.
+ * The index is only trusted as far as it is consistent with the
+ * trajectory, so a missing, stale or partial index never affects
+ * the correctness of reading. Setting the environment variable
+ * GMX_NO_TRAJECTORY_INDEX disables both writing and using the index.
+ *
+ * \inlibraryapi
+ * \ingroup module_fileio
+ */
+#ifndef GMX_FILEIO_TRAJECTORYINDEX_H
+#define GMX_FILEIO_TRAJECTORYINDEX_H
+
+#include <cstdio>
+
+#include <string>
+
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/futil.h"
+
+struct t_fileio;
+
+/*! \libinternal \brief
+ * Offsets, sizes, steps and times of the frames of a trajectory file
+ *
+ * Frames are stored consecutively from the start of the file, so
+ * offset[i+1] = offset[i] + size[i].
+ */
+struct t_trxindex
+{
+    int          nframes; //!< The number of indexed frames
+    int          nalloc;  //!< Allocation size of the arrays
+    gmx_off_t   *offset;  //!< File offset of the start of each frame
+    gmx_off_t   *size;    //!< Size of each frame in bytes
+    gmx_int64_t *step;    //!< The step of each frame
+    double      *time;    //!< The time of each frame
+};
+
+/*! \brief Returns whether frame indices should be written and used */
+gmx_bool gmx_trxindex_enabled();
+
+/*! \brief Returns the name of the frame index file for trajectory \p fn */
+std::string gmx_trxindex_filename(const char *fn);
+
+/*! \brief Reads the frame index of trajectory \p fn
+ *
+ * Returns nullptr when there is no index, when indexing is disabled
+ * or when the index is not consistent with the trajectory.
+ * Entries beyond the end of the trajectory are ignored.
+ */
+t_trxindex *gmx_trxindex_read(const char *fn);
+
+/*! \brief Builds the frame index of XTC or TRR trajectory \p fn
+ *
+ * Only the frame headers are read. When \p index is not nullptr,
+ * the file is scanned from the end of the last frame in \p index
+ * and the new frames are appended to \p index, which is returned.
+ * Scanning stops at the first incomplete or corrupt frame.
+ */
+t_trxindex *gmx_trxindex_build(const char *fn, t_trxindex *index);
+
+/*! \brief Writes \p index as the frame index of trajectory \p fn */
+void gmx_trxindex_write(const char *fn, const t_trxindex *index);
+
+/*! \brief Frees all memory of \p index, which can be nullptr */
+void gmx_trxindex_done(t_trxindex *index);
+
+/*! \brief Returns the frame that starts at file offset \p offset, -1 when none does */
+int gmx_trxindex_find_offset(const t_trxindex *index, gmx_off_t offset);
+
+/*! \brief Positions \p fio at the start of \p frame and checks the frame header
+ *
+ * Returns FALSE when the header at the indexed offset does not match
+ * the index, the file position is then undefined.
+ */
+gmx_bool gmx_trxindex_seek_frame(t_fileio *fio, const t_trxindex *index, int frame);
+
+/*! \brief Returns in \p begin and \p end the range of frames for part \p part out of \p nparts
+ *
+ * The frames are divided as evenly as possible over the parts.
+ */
+void gmx_trxindex_partition(int nframes, int nparts, int part, int *begin, int *end);
+
+/*! \brief Opens the frame index of trajectory \p fn for writing
+ *
+ * \p trajectorySize is the current size of the trajectory. When
+ * \p bAppend is TRUE, the entries in the existing index for frames
+ * within the first \p trajectorySize bytes are kept and new entries
+ * are appended. When the existing index does not cover exactly those
+ * bytes, it is removed and nullptr is returned, since an index with
+ * missing frames can not be used. Also returns nullptr when indexing
+ * is disabled or the index file can not be created.
+ */
+FILE *gmx_trxindex_open_for_writing(const char *fn, gmx_bool bAppend,
+                                    gmx_off_t trajectorySize);
+
+/*! \brief Writes the index entry for a frame of \p size bytes at \p offset to \p fp */
+void gmx_trxindex_write_frame(FILE *fp, gmx_off_t offset, gmx_off_t size,
+                              gmx_int64_t step, double time);
+
+#endif
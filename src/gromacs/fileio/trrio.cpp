@@ -208,10 +208,12 @@ do_trr_frame(t_fileio *fio, bool bRead, gmx_int64_t *step, real *t, real *lambda
 {
     gmx_trr_header_t *sh;
     gmx_bool          bOK;
+    gmx_off_t         start = 0;
 
     snew(sh, 1);
     if (!bRead)
     {
+        start        = gmx_fio_ftell(fio);
         sh->box_size = (box) ? sizeof(matrix) : 0;
         sh->x_size   = ((x) ? (*natoms*sizeof(x[0])) : 0);
         sh->v_size   = ((v) ? (*natoms*sizeof(v[0])) : 0);
@@ -250,6 +252,10 @@ do_trr_frame(t_fileio *fio, bool bRead, gmx_int64_t *step, real *t, real *lambda
         }
     }
     bOK = do_trr_frame_data(fio, sh, box, x, v, f);
+    if (bOK && !bRead)
+    {
+        gmx_fio_add_frame_to_index(fio, start, *step, *t);
+    }
 
     sfree(sh);
 
@@ -56,6 +56,7 @@
 #include "gromacs/fileio/timecontrol.h"
 #include "gromacs/fileio/tngio.h"
 #include "gromacs/fileio/tpxio.h"
+#include "gromacs/fileio/trajectoryindex.h"
 #include "gromacs/fileio/trrio.h"
 #include "gromacs/fileio/xdrf.h"
 #include "gromacs/fileio/xtcio.h"
@@ -68,6 +69,7 @@
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
 #include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 #if GMX_USE_PLUGINS
@@ -79,6 +81,21 @@
 #define SKIP2  100
 #define SKIP3 1000
 
+/* Buffer of XTC frames that are decoded ahead of read_next_frame */
+struct t_xtcbatch
+{
+    int                     nalloc;           /* number of frames the buffers can hold */
+    int                     natoms;           /* number of atoms each x buffer can hold */
+    int                     nread;            /* number of frames in the buffers  */
+    int                     next;             /* index of the next frame to return */
+    gmx_bool                bOK;              /* FALSE when reading stopped at a corrupt frame */
+    gmx_int64_t            *step;
+    real                   *time;
+    matrix                 *box;
+    rvec                  **x;
+    real                   *prec;
+};
+
 struct t_trxstatus
 {
     int                     flags;            /* flags for read_first/next_frame  */
@@ -93,6 +110,8 @@ struct t_trxstatus
     double                  DT, BOX[3];
     gmx_bool                bReadBox;
     char                   *persistent_line; /* Persistent line for reading g96 trajectories */
+    t_trxindex             *frameIndex;      /* Frame index of XTC and TRR files, can be NULL */
+    t_xtcbatch             *xtcBatch;        /* XTC frames decoded in parallel, can be NULL */
 #if GMX_USE_PLUGINS
     gmx_vmdplugin_t        *vmdplugin;
 #endif
@@ -175,6 +194,37 @@ static void status_init(t_trxstatus *status)
     status->tf              = 0;
     status->persistent_line = nullptr;
     status->tng             = nullptr;
+    status->frameIndex      = nullptr;
+    status->xtcBatch        = nullptr;
+}
+
+static void xtcbatch_done(t_xtcbatch *batch)
+{
+    if (batch == nullptr)
+    {
+        return;
+    }
+    for (int f = 0; f < batch->nalloc; f++)
+    {
+        sfree(batch->x[f]);
+    }
+    sfree(batch->step);
+    sfree(batch->time);
+    sfree(batch->box);
+    sfree(batch->x);
+    sfree(batch->prec);
+    sfree(batch);
+}
+
+/*! \brief Discards the XTC frames that were decoded ahead, needed before moving the file position */
+static void xtcbatch_discard(t_trxstatus *status)
+{
+    if (status->xtcBatch != nullptr)
+    {
+        status->xtcBatch->nread = 0;
+        status->xtcBatch->next  = 0;
+        status->xtcBatch->bOK   = TRUE;
+    }
 }
 
 
@@ -249,15 +299,12 @@ float trx_get_time_of_final_frame(t_trxstatus *status)
 {
     t_fileio *stfio    = trx_get_fileio(status);
     int       filetype = gmx_fio_getftp(stfio);
-    int       bOK;
+    gmx_bool  bOK;
     float     lasttime = -1;
 
     if (filetype == efXTC)
     {
-        lasttime =
-            xdr_xtc_get_last_frame_time(gmx_fio_getfp(stfio),
-                                        gmx_fio_getxdr(stfio),
-                                        status->natoms, &bOK);
+        lasttime = xtc_get_last_frame_time(stfio, status->natoms, &bOK);
         if (!bOK)
         {
             gmx_fatal(FARGS, "Error reading last frame. Maybe seek not supported." );
@@ -630,6 +677,8 @@ void close_trx(t_trxstatus *status)
         gmx_fio_close(status->fio);
     }
     sfree(status->persistent_line);
+    gmx_trxindex_done(status->frameIndex);
+    xtcbatch_done(status->xtcBatch);
 #if GMX_USE_PLUGINS
     sfree(status->vmdplugin);
 #endif
@@ -806,11 +855,129 @@ static int pdb_first_x(t_trxstatus *status, FILE *fp, t_trxframe *fr)
     return fr->natoms;
 }
 
+/*! \brief Discards the frame index of \p status after a mismatch with the trajectory */
+static void discard_frame_index(t_trxstatus *status)
+{
+    fprintf(stderr, "\nWARNING: The frame index %s does not match the trajectory, it will not be used\n",
+            gmx_trxindex_filename(gmx_fio_getname(status->fio)).c_str());
+    gmx_trxindex_done(status->frameIndex);
+    status->frameIndex = nullptr;
+}
+
+/*! \brief Uses the frame index to jump over frames that would be skipped with -b or -dt
+ *
+ * Returns TRUE when the index covers the current file position,
+ * the file is then positioned at the next frame that will be used,
+ * or at the last indexed frame.
+ */
+static gmx_bool skip_indexed_frames(t_trxstatus *status, gmx_bool bDouble)
+{
+    const t_trxindex *index = status->frameIndex;
+    gmx_off_t         pos;
+    int               frame, next;
+
+    if (index == nullptr || (status->flags & TRX_DONT_SKIP) ||
+        !(bTimeSet(TBEGIN) || bTimeSet(TDELTA)))
+    {
+        return FALSE;
+    }
+
+    pos   = gmx_fio_ftell(status->fio);
+    frame = gmx_trxindex_find_offset(index, pos);
+    if (frame < 0)
+    {
+        return FALSE;
+    }
+    next = frame;
+    while (next < index->nframes - 1 &&
+           check_times2(index->time[next], status->t0, bDouble) < 0)
+    {
+        next++;
+    }
+    if (next > frame)
+    {
+        if (!gmx_trxindex_seek_frame(status->fio, index, next))
+        {
+            discard_frame_index(status);
+            gmx_fio_seek(status->fio, pos);
+
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*! \brief Reads the next XTC frame from a buffer of frames that are decoded in parallel
+ *
+ * With multiple OpenMP threads, as many frames as there are threads
+ * are read at once with read_next_xtc_frames(). Decompression is
+ * the most expensive part of reading an XTC file, so this speeds up
+ * analysis tools that spend little time per frame. Returns FALSE
+ * at the end of the file or at a corrupt frame, in the latter case
+ * *bOK is set to FALSE.
+ */
+static gmx_bool read_next_xtc_batched(t_trxstatus *status, int nthreads, t_trxframe *fr,
+                                      gmx_bool *bOK)
+{
+    t_xtcbatch *batch = status->xtcBatch;
+
+    if (batch != nullptr && batch->natoms != fr->natoms)
+    {
+        xtcbatch_done(batch);
+        batch = nullptr;
+    }
+    if (batch == nullptr)
+    {
+        snew(batch, 1);
+        batch->nalloc = nthreads;
+        batch->natoms = fr->natoms;
+        batch->bOK    = TRUE;
+        snew(batch->step, batch->nalloc);
+        snew(batch->time, batch->nalloc);
+        snew(batch->box, batch->nalloc);
+        snew(batch->x, batch->nalloc);
+        snew(batch->prec, batch->nalloc);
+        for (int f = 0; f < batch->nalloc; f++)
+        {
+            snew(batch->x[f], batch->natoms);
+        }
+        status->xtcBatch = batch;
+    }
+
+    if (batch->next == batch->nread && batch->bOK)
+    {
+        batch->nread = read_next_xtc_frames(status->fio, batch->natoms, batch->nalloc,
+                                            batch->step, batch->time, batch->box,
+                                            batch->x, batch->prec, &batch->bOK);
+        batch->next  = 0;
+    }
+    if (batch->next == batch->nread)
+    {
+        *bOK = batch->bOK;
+
+        return FALSE;
+    }
+
+    int f = batch->next++;
+    fr->step = batch->step[f];
+    fr->time = batch->time[f];
+    fr->prec = batch->prec[f];
+    copy_mat(batch->box[f], fr->box);
+    for (int i = 0; i < fr->natoms; i++)
+    {
+        copy_rvec(batch->x[f][i], fr->x[i]);
+    }
+    *bOK = TRUE;
+
+    return TRUE;
+}
+
 gmx_bool read_next_frame(const gmx_output_env_t *oenv, t_trxstatus *status, t_trxframe *fr)
 {
     real     pt;
     int      ct;
-    gmx_bool bOK, bRet, bMissingData = FALSE, bSkip = FALSE;
+    gmx_bool bOK, bRet, bMissingData = FALSE, bSkip = FALSE, bIndexed;
     int      ftp;
 
     bRet = FALSE;
@@ -829,6 +996,11 @@ gmx_bool read_next_frame(const gmx_output_env_t *oenv, t_trxstatus *status, t_tr
         {
             ftp = gmx_fio_getftp(status->fio);
         }
+        bIndexed = FALSE;
+        if (ftp == efXTC || ftp == efTRR)
+        {
+            bIndexed = skip_indexed_frames(status, fr->bDouble);
+        }
         switch (ftp)
         {
             case efTRR:
@@ -849,17 +1021,26 @@ gmx_bool read_next_frame(const gmx_output_env_t *oenv, t_trxstatus *status, t_tr
                 break;
             }
             case efXTC:
-                if (bTimeSet(TBEGIN) && (status->tf < rTimeValue(TBEGIN)))
+                if (!bIndexed && bTimeSet(TBEGIN) && (status->tf < rTimeValue(TBEGIN)))
                 {
                     if (xtc_seek_time(status->fio, rTimeValue(TBEGIN), fr->natoms, TRUE))
                     {
                         gmx_fatal(FARGS, "Specified frame (time %f) doesn't exist or file corrupt/inconsistent.",
                                   rTimeValue(TBEGIN));
                     }
+                    xtcbatch_discard(status);
                     initcount(status);
                 }
-                bRet = read_next_xtc(status->fio, fr->natoms, &fr->step, &fr->time, fr->box,
-                                     fr->x, &fr->prec, &bOK);
+                /* Batches would move the file position past the frame index */
+                if (status->frameIndex == nullptr && gmx_omp_get_max_threads() > 1)
+                {
+                    bRet = read_next_xtc_batched(status, gmx_omp_get_max_threads(), fr, &bOK);
+                }
+                else
+                {
+                    bRet = read_next_xtc(status->fio, fr->natoms, &fr->step, &fr->time, fr->box,
+                                         fr->x, &fr->prec, &bOK);
+                }
                 fr->bPrec = (bRet && fr->prec > 0);
                 fr->bStep = bRet;
                 fr->bTime = bRet;
@@ -958,6 +1139,10 @@ int read_first_frame(const gmx_output_env_t *oenv, t_trxstatus **status,
     {
         fio = (*status)->fio = gmx_fio_open(fn, "r");
     }
+    if (ftp == efXTC || ftp == efTRR)
+    {
+        (*status)->frameIndex = gmx_trxindex_read(fn);
+    }
     switch (ftp)
     {
         case efTRR:
@@ -1090,6 +1275,27 @@ int read_first_frame(const gmx_output_env_t *oenv, t_trxstatus **status,
     return (fr->natoms > 0);
 }
 
+int trx_indexed_frame_count(t_trxstatus *status)
+{
+    return (status->frameIndex != nullptr ? status->frameIndex->nframes : 0);
+}
+
+gmx_bool trx_seek_indexed_frame(t_trxstatus *status, int frame)
+{
+    if (status->frameIndex == nullptr || frame < 0 || frame >= status->frameIndex->nframes)
+    {
+        return FALSE;
+    }
+    if (!gmx_trxindex_seek_frame(status->fio, status->frameIndex, frame))
+    {
+        discard_frame_index(status);
+
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /***** C O O R D I N A T E   S T U F F *****/
 
 int read_first_x(const gmx_output_env_t *oenv, t_trxstatus **status, const char *fn,
@@ -1134,6 +1340,8 @@ void close_trj(t_trxstatus *status)
         gmx_fio_close(status->fio);
     }
 
+    xtcbatch_done(status->xtcBatch);
+
     /* The memory in status->xframe is lost here,
      * but the read_first_x/read_next_x functions are deprecated anyhow.
      * read_first_frame/read_next_frame and close_trx should be used.
@@ -1144,6 +1352,7 @@ void close_trj(t_trxstatus *status)
 void rewind_trj(t_trxstatus *status)
 {
     initcount(status);
+    xtcbatch_discard(status);
 
     gmx_fio_rewind(status->fio);
 }
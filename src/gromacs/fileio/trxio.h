@@ -213,6 +213,20 @@ gmx_bool read_next_frame(const gmx_output_env_t *oenv, t_trxstatus *status,
  * Returns TRUE when succeeded, FALSE otherwise.
  */
 
+int trx_indexed_frame_count(t_trxstatus *status);
+/* Returns the number of frames in the frame index of an XTC or TRR
+ * trajectory opened with read_first_frame, 0 when there is no index.
+ * The index is written along with the trajectory or with gmx trjindex.
+ */
+
+gmx_bool trx_seek_indexed_frame(t_trxstatus *status, int frame);
+/* Positions the trajectory such that the next call to read_next_frame
+ * reads frame number frame of the frame index. Together with
+ * gmx_trxindex_partition this allows splitting a trajectory over
+ * workers. Returns FALSE when there is no index, frame is out of range
+ * or the index does not match the trajectory.
+ */
+
 int read_first_x(const gmx_output_env_t *oenv, t_trxstatus **status,
                  const char *fn, real *t, rvec **x, matrix box);
 /* These routines read first coordinates and box, and allocates
@@ -62,6 +62,45 @@ extern "C" {
 /* Read or write reduced precision *float* coordinates */
 int xdr3dfcoord(XDR *xdrs, float *fp, int *size, float *precision);
 
+/* The still compressed coordinates of one xdr3dfcoord call */
+typedef struct {
+    int            natoms;    /* the number of coordinate triplets */
+    float          precision; /* the precision, -1 for uncompressed coordinates */
+    int            minint[3]; /* the minimum integer coordinates */
+    int            maxint[3]; /* the maximum integer coordinates */
+    int            smallidx;  /* the initial index in the table of small sizes */
+    int            nbytes;    /* the number of compressed bytes */
+    unsigned char *bytes;     /* the compressed bytes, or the floats when uncompressed */
+    int            nalloc;    /* the allocation size of bytes */
+} t_xdr3dfcoord_data;
+
+/* Read compressed coordinates written by xdr3dfcoord without decoding them.
+ * data->bytes is reallocated with realloc() when needed and should be
+ * freed with free(). Returns 0 on error.
+ * Reading and decoding separately allows decoding frames in parallel.
+ */
+int xdr3dfcoord_read(XDR *xdrs, t_xdr3dfcoord_data *data);
+
+/* Decode the coordinates in data into fp, which should hold 3*data->natoms
+ * floats. Does not access any global state, so it can be called from
+ * multiple threads. Returns 0 when the data is corrupt.
+ */
+int xdr3dfcoord_decode(const t_xdr3dfcoord_data *data, float *fp);
+
+/* Compress the natoms coordinate triplets in fp with precision into data,
+ * data->bytes is reallocated as for xdr3dfcoord_read. Does not access any
+ * global state, so frames can be encoded on other threads than the one
+ * writing them. Returns 0 when the coordinates do not fit the precision,
+ * the data is then still filled as xdr3dfcoord would write it.
+ */
+int xdr3dfcoord_encode(const float *fp, int natoms, float precision,
+                       t_xdr3dfcoord_data *data);
+
+/* Write the compressed coordinates in data, returns 0 on error.
+ * Together with xdr3dfcoord_encode this gives the same output as xdr3dfcoord.
+ */
+int xdr3dfcoord_write(XDR *xdrs, t_xdr3dfcoord_data *data);
+
 
 /* Read or write a *real* value (stored as float) */
 int xdr_real(XDR *xdrs, real *r);
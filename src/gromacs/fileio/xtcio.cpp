@@ -44,8 +44,10 @@
 #include "gromacs/fileio/gmxfio-xdr.h"
 #include "gromacs/fileio/xdrf.h"
 #include "gromacs/math/vec.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxomp.h"
 #include "gromacs/utility/smalloc.h"
 
 #define XTC_MAGIC 1995
@@ -202,10 +204,11 @@ int write_xtc(t_fileio *fio,
               int natoms, gmx_int64_t step, real time,
               const rvec *box, const rvec *x, real prec)
 {
-    int      magic_number = XTC_MAGIC;
-    XDR     *xd;
-    gmx_bool bDum;
-    int      bOK;
+    int       magic_number = XTC_MAGIC;
+    XDR      *xd;
+    gmx_bool  bDum;
+    int       bOK;
+    gmx_off_t start;
 
     if (!fio)
     {
@@ -215,7 +218,8 @@ int write_xtc(t_fileio *fio,
         return 1;
     }
 
-    xd = gmx_fio_getxdr(fio);
+    xd    = gmx_fio_getxdr(fio);
+    start = gmx_fio_ftell(fio);
     /* write magic number and xtc identidier */
     if (xtc_header(xd, &magic_number, &natoms, &step, &time, FALSE, &bDum) == 0)
     {
@@ -227,6 +231,7 @@ int write_xtc(t_fileio *fio,
 
     if (bOK)
     {
+        gmx_fio_add_frame_to_index(fio, start, step, time);
         if (gmx_fio_flush(fio) != 0)
         {
             bOK = 0;
@@ -290,3 +295,96 @@ int read_next_xtc(t_fileio* fio,
 
     return *bOK;
 }
+
+int read_next_xtc_frames(t_fileio *fio, int natoms, int maxframes,
+                         gmx_int64_t step[], real time[], matrix box[],
+                         rvec *x[], real prec[], gmx_bool *bOK)
+{
+    t_xdr3dfcoord_data *data;
+    int                *decodeOK;
+    XDR                *xd;
+    int                 magic, n, nread, nframes, i, j;
+
+    *bOK = TRUE;
+    xd   = gmx_fio_getxdr(fio);
+
+    snew(data, maxframes);
+    snew(decodeOK, maxframes);
+
+    /* Reading is serial, only the compressed data is stored */
+    for (nread = 0; nread < maxframes; nread++)
+    {
+        if (!xtc_header(xd, &magic, &n, &step[nread], &time[nread], TRUE, bOK))
+        {
+            break;
+        }
+        check_xtc_magic(magic);
+        if (n > natoms)
+        {
+            gmx_fatal(FARGS, "Frame contains more atoms (%d) than expected (%d)",
+                      n, natoms);
+        }
+        for (i = 0; i < DIM && *bOK; i++)
+        {
+            for (j = 0; j < DIM && *bOK; j++)
+            {
+                *bOK = XTC_CHECK("box", xdr_r2f(xd, &(box[nread][i][j]), TRUE));
+            }
+        }
+        if (*bOK)
+        {
+            *bOK = (XTC_CHECK("x", xdr3dfcoord_read(xd, &data[nread])) &&
+                    data[nread].natoms <= natoms);
+        }
+        if (!*bOK)
+        {
+            break;
+        }
+    }
+
+    /* Decoding of the frames is independent and the most expensive part */
+    int gmx_unused nthreads = gmx_omp_get_max_threads();
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+    for (int f = 0; f < nread; f++)
+    {
+        try
+        {
+#if GMX_DOUBLE
+            float *ftmp;
+
+            snew(ftmp, data[f].natoms*DIM);
+            decodeOK[f] = xdr3dfcoord_decode(&data[f], ftmp);
+            for (int a = 0; a < data[f].natoms; a++)
+            {
+                x[f][a][XX] = ftmp[DIM*a+XX];
+                x[f][a][YY] = ftmp[DIM*a+YY];
+                x[f][a][ZZ] = ftmp[DIM*a+ZZ];
+            }
+            sfree(ftmp);
+#else
+            decodeOK[f] = xdr3dfcoord_decode(&data[f], reinterpret_cast<float *>(x[f]));
+#endif
+            prec[f] = data[f].precision;
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    nframes = 0;
+    while (nframes < nread && decodeOK[nframes])
+    {
+        nframes++;
+    }
+    if (nframes < nread)
+    {
+        *bOK = FALSE;
+    }
+
+    for (int f = 0; f < maxframes; f++)
+    {
+        free(data[f].bytes);
+    }
+    sfree(data);
+    sfree(decodeOK);
+
+    return nframes;
+}
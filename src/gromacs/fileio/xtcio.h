@@ -75,6 +75,17 @@ int read_next_xtc(struct t_fileio *fio,
                   matrix box, rvec *x, real *prec, gmx_bool *bOK);
 /* Read subsequent frames */
 
+int read_next_xtc_frames(struct t_fileio *fio, int natoms, int maxframes,
+                         gmx_int64_t step[], real time[], matrix box[],
+                         rvec *x[], real prec[], gmx_bool *bOK);
+/* Read up to maxframes subsequent frames into step[f], time[f], box[f],
+ * x[f] and prec[f], each x[f] should have space for natoms atoms.
+ * The frames are read serially and decompressed in parallel using
+ * OpenMP threads. Returns the number of frames read, which is less
+ * than maxframes at the end of the file or at a corrupt frame,
+ * in the latter case *bOK is set to FALSE.
+ */
+
 int write_xtc(struct t_fileio *fio,
               int natoms, gmx_int64_t step, real time,
               const rvec *box, const rvec *x, real prec);
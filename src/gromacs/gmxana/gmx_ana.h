@@ -111,6 +111,9 @@ gmx_editconf(int argc, char *argv[]);
 int
 gmx_eneconv(int argc, char *argv[]);
 
+int
+gmx_enecolumns(int argc, char *argv[]);
+
 int
 gmx_enemat(int argc, char *argv[]);
 
@@ -234,6 +237,9 @@ gmx_trjcat(int argc, char *argv[]);
 int
 gmx_trjconv(int argc, char *argv[]);
 
+int
+gmx_trjindex(int argc, char *argv[]);
+
 int
 gmx_trjorder(int argc, char *argv[]);
 
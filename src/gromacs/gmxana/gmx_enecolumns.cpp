@@ -0,0 +1,105 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include <cstdio>
+
+#include <string>
+
+#include "gromacs/commandline/pargs.h"
+#include "gromacs/fileio/enxcolumns.h"
+#include "gromacs/fileio/filetypes.h"
+#include "gromacs/fileio/oenv.h"
+#include "gromacs/gmxana/gmx_ana.h"
+#include "gromacs/utility/arraysize.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/cstringutil.h"
+
+int gmx_enecolumns(int argc, char *argv[])
+{
+    const char       *desc[] = {
+        "[THISMODULE] creates or updates the columnar copy of an energy",
+        "file. The copy is stored next to the energy file in a file with",
+        "the extension [TT].ecol[tt] appended to the name of the energy",
+        "file. It contains the time, step and energy terms of each frame,",
+        "with the values of each term compressed and stored together in",
+        "chunks of frames.[PAR]",
+        "[gmx-energy] reads only the selected terms from this file,",
+        "instead of decoding all terms of every frame of the energy file.",
+        "Frames that were appended to the energy file after the copy was",
+        "made are read from the energy file, running this tool again adds",
+        "them to the copy. The data blocks with restraint and free-energy",
+        "data are not stored, tools that need these read the energy file.[PAR]",
+        "By default an existing copy is extended with the new frames, with",
+        "[TT]-rebuild[tt] the whole energy file is read. A copy that does",
+        "not match the energy file is rebuilt automatically.[PAR]",
+        "Setting the environment variable [TT]GMX_NO_ENERGY_COLUMNS[tt]",
+        "disables using columnar copies."
+    };
+    static gmx_bool   bRebuild = FALSE;
+    t_pargs           pa[]     = {
+        { "-rebuild", FALSE, etBOOL, {&bRebuild},
+          "Read the whole energy file instead of extending an existing copy" }
+    };
+    t_filenm          fnm[] = {
+        { efEDR, "-f", nullptr, ffREAD }
+    };
+#define NFILE asize(fnm)
+    gmx_output_env_t *oenv;
+    const char       *fn;
+    gmx_int64_t       nframes, nnew;
+    char              buf1[STEPSTRSIZE], buf2[STEPSTRSIZE];
+
+    if (!parse_common_args(&argc, argv, 0, NFILE, fnm, asize(pa), pa,
+                           asize(desc), desc, 0, nullptr, &oenv))
+    {
+        return 0;
+    }
+
+    fn = opt2fn("-f", NFILE, fnm);
+    if (!gmx_enxcol_enabled())
+    {
+        fprintf(stderr, "NOTE: GMX_NO_ENERGY_COLUMNS is set, the columnar copy will not be used\n");
+    }
+
+    nframes = gmx_enxcol_update(fn, bRebuild, &nnew);
+    fprintf(stderr, "\nWrote %s with %s frames, %s of which were new\n",
+            gmx_enxcol_filename(fn).c_str(),
+            gmx_step_str(nframes, buf1), gmx_step_str(nnew, buf2));
+
+    output_env_done(oenv);
+
+    return 0;
+}
@@ -45,6 +45,7 @@
 #include "gromacs/commandline/pargs.h"
 #include "gromacs/commandline/viewit.h"
 #include "gromacs/correlationfunctions/autocorr.h"
+#include "gromacs/fileio/enxcolumns.h"
 #include "gromacs/fileio/enxio.h"
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/fileio/tpxio.h"
@@ -1479,6 +1480,31 @@ static void print1(FILE *fp, gmx_bool bDp, real e)
     }
 }
 
+/*! \brief Reads the next energy frame, from \p columns while it has frames
+ *
+ * When all frames of \p columns have been read, it is closed and set to
+ * nullptr, and reading continues with the frames that were appended to
+ * the energy file afterwards.
+ */
+static gmx_bool read_energy_frame(ener_file_t fp, t_enxcolumns **columns, t_enxframe *fr)
+{
+    if (*columns != nullptr)
+    {
+        if (gmx_enxcol_read_frame(*columns, fr))
+        {
+            return TRUE;
+        }
+        if (gmx_fio_seek(enx_file_pointer(fp), gmx_enxcol_energy_file_end(*columns)) != 0)
+        {
+            gmx_file("Cannot seek in the energy file");
+        }
+        gmx_enxcol_close(*columns);
+        *columns = nullptr;
+    }
+
+    return do_enx(fp, fr);
+}
+
 static void fec(const char *ene2fn, const char *runavgfn,
                 real reftemp, int nset, int set[], char *leg[],
                 enerdata_t *edat, double time[],
@@ -1948,7 +1974,11 @@ int gmx_energy(int argc, char *argv[])
         "where E[SUB]A[sub] and E[SUB]B[sub] are the energies from the first and second energy",
         "files, and the average is over the ensemble A. The running average",
         "of the free energy difference is printed to a file specified by [TT]-ravg[tt].",
-        "[BB]Note[bb] that the energies must both be calculated from the same trajectory."
+        "[BB]Note[bb] that the energies must both be calculated from the same trajectory.[PAR]",
+
+        "When a columnar copy of the energy file written by [gmx-enecolumns]",
+        "is present, only the selected terms are read from it, unless",
+        "restraint, free-energy or orientation data is requested."
 
     };
     static gmx_bool    bSum    = FALSE, bFee = FALSE, bPrAll = FALSE, bFluct = FALSE, bDriftCorr = FALSE;
@@ -2002,6 +2032,7 @@ int gmx_energy(int argc, char *argv[])
     FILE              *out     = nullptr, *fp_pairs = nullptr, *fort = nullptr, *fodt = nullptr, *foten = nullptr;
     FILE              *fp_dhdl = nullptr;
     ener_file_t        fp;
+    t_enxcolumns      *columns;
     int                timecheck = 0;
     gmx_mtop_t         mtop;
     gmx_localtop_t    *top = nullptr;
@@ -2348,6 +2379,22 @@ int gmx_energy(int argc, char *argv[])
     edat.bHaveSums = TRUE;
     snew(edat.s, nset);
 
+    /* The columnar energy file only stores the energy terms, not the
+     * blocks with restraint, free-energy or orientation data.
+     */
+    columns = nullptr;
+    if (!bDisRe && !bDHDL && !bORIRE && !bOTEN)
+    {
+        columns = gmx_enxcol_open(ftp2fn(efEDR, NFILE, fnm), fp, nre, enm);
+        if (columns != nullptr)
+        {
+            gmx_enxcol_select(columns, nset, set);
+            fprintf(stderr, "Reading %s frames from the columnar energy file %s\n",
+                    gmx_step_str(gmx_enxcol_nframes(columns), buf),
+                    gmx_enxcol_filename(ftp2fn(efEDR, NFILE, fnm)).c_str());
+        }
+    }
+
     /* Initiate counters */
     teller       = 0;
     teller_disre = 0;
@@ -2361,7 +2408,7 @@ int gmx_energy(int argc, char *argv[])
          */
         do
         {
-            bCont = do_enx(fp, &(frame[NEXT]));
+            bCont = read_energy_frame(fp, &columns, &(frame[NEXT]));
             if (bCont)
             {
                 timecheck = check_times(frame[NEXT].t);
@@ -2727,6 +2774,7 @@ int gmx_energy(int argc, char *argv[])
         }
     }
     while (bCont && (timecheck == 0));
+    gmx_enxcol_close(columns);
 
     fprintf(stderr, "\n");
     done_ener_file(fp);
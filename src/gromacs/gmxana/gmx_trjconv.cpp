@@ -505,11 +505,11 @@ void do_trunc(const char *fn, real t0)
         while (!bStop && gmx_trr_read_frame_header(in, &sh, &bOK))
         {
             gmx_trr_read_frame_data(in, &sh, nullptr, nullptr, nullptr, nullptr);
-            fpos = gmx_ftell(fp);
+            fpos = gmx_fio_ftell(in);
             t    = sh.t;
             if (t >= t0)
             {
-                gmx_fseek(fp, fpos, SEEK_SET);
+                gmx_fio_seek(in, fpos);
                 bStop = TRUE;
             }
         }
@@ -0,0 +1,191 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+#include "gmxpre.h"
+
+#include <cstdio>
+
+#include <string>
+
+#include "gromacs/commandline/pargs.h"
+#include "gromacs/fileio/filetypes.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/fileio/trajectoryindex.h"
+#include "gromacs/gmxana/gmx_ana.h"
+#include "gromacs/utility/arraysize.h"
+#include "gromacs/utility/basedefinitions.h"
+#include "gromacs/utility/fatalerror.h"
+
+/*! \brief Checks the header of every frame in \p index, returns the number of matching frames */
+static int check_index(const char *fn, const t_trxindex *index)
+{
+    t_fileio *fio = gmx_fio_open(fn, "r");
+    int       i;
+
+    for (i = 0; i < index->nframes; i++)
+    {
+        if (!gmx_trxindex_seek_frame(fio, index, i))
+        {
+            break;
+        }
+    }
+    gmx_fio_close(fio);
+
+    return i;
+}
+
+int gmx_trjindex(int argc, char *argv[])
+{
+    const char       *desc[] = {
+        "[THISMODULE] creates or updates the frame index of an XTC or TRR",
+        "trajectory. The index is stored next to the trajectory in a",
+        "file with the extension [TT].fidx[tt] appended to the name of the",
+        "trajectory and lists the file offset, size, step and time of",
+        "each frame.[PAR]",
+        "[TT]gmx mdrun[tt] maintains the index of the XTC and TRR files",
+        "it writes, so this tool is only needed for trajectories written",
+        "otherwise, e.g. by other tools such as [TT]gmx trjconv[tt], by",
+        "other programs or by older versions. Tools that read",
+        "trajectories use the index to jump directly to the frames",
+        "selected with [TT]-b[tt] and [TT]-dt[tt], instead of reading or",
+        "searching through the file.[PAR]",
+        "By default an existing index is extended with the frames that",
+        "were added to the trajectory since it was written, with",
+        "[TT]-rebuild[tt] the whole trajectory is scanned. Only the frame",
+        "headers are read, so this takes a fraction of the time needed",
+        "to read the trajectory. With [TT]-check[tt] the header of every",
+        "indexed frame is compared with the index, without modifying it.[PAR]",
+        "With [TT]-nparts[tt] the frame and time ranges for dividing the",
+        "trajectory evenly over that many parts are printed, which can",
+        "be used to analyze parts of a trajectory in parallel.[PAR]",
+        "Setting the environment variable [TT]GMX_NO_TRAJECTORY_INDEX[tt]",
+        "disables writing and using frame indices."
+    };
+    static gmx_bool   bRebuild = FALSE, bCheck = FALSE;
+    static int        nparts   = 1;
+    t_pargs           pa[]     = {
+        { "-rebuild", FALSE, etBOOL, {&bRebuild},
+          "Scan the whole trajectory instead of extending an existing index" },
+        { "-check", FALSE, etBOOL, {&bCheck},
+          "Only check an existing index against the trajectory" },
+        { "-nparts", FALSE, etINT, {&nparts},
+          "Print the frame ranges for dividing the trajectory over this number of parts" }
+    };
+    t_filenm          fnm[] = {
+        { efTRX, "-f", nullptr, ffREAD }
+    };
+#define NFILE asize(fnm)
+    gmx_output_env_t *oenv;
+    const char       *fn;
+    t_trxindex       *index;
+    int               nold, nvalid;
+
+    if (!parse_common_args(&argc, argv, 0, NFILE, fnm, asize(pa), pa,
+                           asize(desc), desc, 0, nullptr, &oenv))
+    {
+        return 0;
+    }
+
+    fn = opt2fn("-f", NFILE, fnm);
+    if (fn2ftp(fn) != efXTC && fn2ftp(fn) != efTRR)
+    {
+        gmx_fatal(FARGS, "Frame indices are only supported for XTC and TRR files, not for '%s'", fn);
+    }
+    if (!gmx_trxindex_enabled())
+    {
+        fprintf(stderr, "NOTE: GMX_NO_TRAJECTORY_INDEX is set, the frame index will not be used\n");
+    }
+    if (nparts < 1)
+    {
+        gmx_fatal(FARGS, "The number of parts should be at least 1");
+    }
+
+    index = (bRebuild ? nullptr : gmx_trxindex_read(fn));
+    nold  = (index != nullptr ? index->nframes : 0);
+    if (bCheck)
+    {
+        if (index == nullptr)
+        {
+            gmx_fatal(FARGS, "Trajectory '%s' has no usable frame index", fn);
+        }
+        nvalid = check_index(fn, index);
+        if (nvalid < index->nframes)
+        {
+            gmx_fatal(FARGS, "Frame %d of %d in the index of '%s' does not match the trajectory, rebuild the index with -rebuild",
+                      nvalid, index->nframes, fn);
+        }
+        fprintf(stderr, "All %d frames in the index of '%s' match the trajectory\n",
+                index->nframes, fn);
+    }
+    else
+    {
+        if (index != nullptr && check_index(fn, index) < index->nframes)
+        {
+            fprintf(stderr, "The existing frame index does not match the trajectory, rebuilding it\n");
+            gmx_trxindex_done(index);
+            index = nullptr;
+            nold  = 0;
+        }
+        index = gmx_trxindex_build(fn, index);
+        gmx_trxindex_write(fn, index);
+        fprintf(stderr, "Wrote index %s with %d frames, %d of which were new\n",
+                gmx_trxindex_filename(fn).c_str(), index->nframes, index->nframes - nold);
+    }
+
+    if (index->nframes > 0)
+    {
+        fprintf(stdout, "Frames %d, first time %g, last time %g\n",
+                index->nframes, index->time[0], index->time[index->nframes - 1]);
+    }
+    if (nparts > 1)
+    {
+        fprintf(stdout, "%6s %10s %10s %12s %12s\n",
+                "part", "frame-b", "frame-e", "time-b", "time-e");
+        for (int p = 0; p < nparts; p++)
+        {
+            int begin, end;
+
+            gmx_trxindex_partition(index->nframes, nparts, p, &begin, &end);
+            if (end > begin)
+            {
+                fprintf(stdout, "%6d %10d %10d %12g %12g\n",
+                        p, begin, end - 1, index->time[begin], index->time[end - 1]);
+            }
+        }
+    }
+
+    gmx_trxindex_done(index);
+
+    return 0;
+}
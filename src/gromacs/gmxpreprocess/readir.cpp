@@ -101,6 +101,7 @@ typedef struct t_inputrec_strings
          imd_grp[STRLEN];
     char   fep_lambda[efptNR][STRLEN];
     char   lambda_weights[STRLEN];
+    char **x_stream_grps;
     char **pull_grp;
     char **rot_grp;
     char   anneal[STRLEN], anneal_npoints[STRLEN],
@@ -1938,6 +1939,35 @@ void get_ir(const char *mdparin, const char *mdparout,
     CTYPE ("trajectory file. You can select multiple groups. By");
     CTYPE ("default, all atoms will be written.");
     STYPE ("compressed-x-grps", is->x_compressed_groups, nullptr);
+    CTYPE ("Additional compressed trajectory files, each with its own");
+    CTYPE ("groups, output frequency and precision");
+    ITYPE ("compressed-x-streams", ir->n_x_streams, 0);
+    if (ir->n_x_streams < 0)
+    {
+        warning_error(wi, "compressed-x-streams should be >= 0");
+        ir->n_x_streams = 0;
+    }
+    snew(ir->x_streams, ir->n_x_streams);
+    snew(is->x_stream_grps, ir->n_x_streams);
+    for (i = 0; i < ir->n_x_streams; i++)
+    {
+        t_compressed_x_stream *xs = &ir->x_streams[i];
+        char                   buf[STRLEN];
+
+        snew(is->x_stream_grps[i], STRLEN);
+        sprintf(buf, "compressed-x-stream%d-grps", i + 1);
+        STYPE (buf, is->x_stream_grps[i], nullptr);
+        sprintf(buf, "compressed-x-stream%d-nstxout", i + 1);
+        ITYPE (buf, xs->nstxout, 0);
+        sprintf(buf, "compressed-x-stream%d-precision", i + 1);
+        RTYPE (buf, xs->precision, 1000.0);
+        if (xs->nstxout <= 0 || xs->precision <= 0)
+        {
+            sprintf(warn_buf, "compressed-x-stream%d-nstxout and compressed-x-stream%d-precision should be > 0",
+                    i + 1, i + 1);
+            warning_error(wi, warn_buf);
+        }
+    }
     CTYPE ("Selection of energy groups");
     STYPE ("energygrps",  is->energy,         nullptr);
 
@@ -3205,6 +3235,57 @@ void make_IMD_group(t_IMD *IMDgroup, char *IMDgname, t_blocka *grps, char **gnam
 }
 
 
+static void make_x_stream_groups(t_inputrec *ir, char **x_stream_grps, int natoms,
+                                 t_blocka *grps, char **gnames)
+{
+    gmx_bool *bInStream;
+    char     *ptr[MAXPTR];
+
+    snew(bInStream, natoms);
+    for (int s = 0; s < ir->n_x_streams; s++)
+    {
+        t_compressed_x_stream *xs   = &ir->x_streams[s];
+        int                    ngrp = str_nelem(x_stream_grps[s], MAXPTR, ptr);
+
+        /* As for compressed-x-grps, no groups selects the whole system */
+        for (int a = 0; a < natoms; a++)
+        {
+            bInStream[a] = (ngrp == 0);
+        }
+        for (int g = 0; g < ngrp; g++)
+        {
+            int ig = search_string(ptr[g], grps->nr, gnames);
+            for (int j = grps->index[ig]; j < grps->index[ig + 1]; j++)
+            {
+                bInStream[grps->a[j]] = TRUE;
+            }
+        }
+
+        /* Write the atoms in the order of the system, as for compressed-x-grps */
+        xs->nat = 0;
+        for (int a = 0; a < natoms; a++)
+        {
+            if (bInStream[a])
+            {
+                xs->nat++;
+            }
+        }
+        snew(xs->ind, xs->nat);
+        xs->nat = 0;
+        for (int a = 0; a < natoms; a++)
+        {
+            if (bInStream[a])
+            {
+                xs->ind[xs->nat++] = a;
+            }
+        }
+        fprintf(stderr, "Compressed x stream %d writes %d atoms every %d steps with precision %g\n",
+                s + 1, xs->nat, xs->nstxout, xs->precision);
+    }
+    sfree(bInStream);
+}
+
+
 void do_index(const char* mdparin, const char *ndx,
               gmx_mtop_t *mtop,
               gmx_bool bVerbose,
@@ -3565,6 +3646,8 @@ void do_index(const char* mdparin, const char *ndx,
         make_IMD_group(ir->imd, is->imd_grp, grps, gnames);
     }
 
+    make_x_stream_groups(ir, is->x_stream_grps, natoms, grps, gnames);
+
     nacc = str_nelem(is->acc, MAXPTR, ptr1);
     nacg = str_nelem(is->accgrps, MAXPTR, ptr2);
     if (nacg*DIM != nacc)
@@ -170,5 +170,21 @@ TEST_F(GetIrTest, ProducesOutputFromElectricField)
     runTest(inputMdpFile);
 }
 
+TEST_F(GetIrTest, HandlesCompressedXStreams)
+{
+    const char *inputMdpFile[] = {
+        "compressed-x-streams = 2",
+        "compressed-x-stream1-grps = Protein",
+        "compressed-x-stream1-nstxout = 5000",
+        "compressed-x-stream1-precision = 1000",
+        "compressed-x-stream2-nstxout = 500000",
+        "compressed-x-stream2-precision = 100"
+    };
+    runTest(joinStrings(inputMdpFile, "\n"));
+    ASSERT_EQ(2, ir_.n_x_streams);
+    EXPECT_EQ(5000, ir_.x_streams[0].nstxout);
+    EXPECT_EQ(100, ir_.x_streams[1].precision);
+}
+
 } // namespace
 } // namespace
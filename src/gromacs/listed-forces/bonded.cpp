@@ -419,6 +419,92 @@ real bonds(int nbonds,
     return vtot;
 }
 
+#if GMX_SIMD_HAVE_REAL
+
+/* As bonds, but using SIMD to calculate many bonds at once.
+ * This routines does not calculate energies and shift forces.
+ */
+void
+bonds_noener_simd(int nbonds,
+                  const t_iatom forceatoms[], const t_iparams forceparams[],
+                  const rvec x[], rvec4 f[],
+                  const t_pbc *pbc, const t_graph gmx_unused *g,
+                  real gmx_unused lambda,
+                  const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                  int gmx_unused *global_atom_index)
+{
+    const int            nfa1 = 3;
+    int                  i, iu, s;
+    int                  type;
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)    ai[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)    aj[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH)   coeff[2*GMX_SIMD_REAL_WIDTH];
+    SimdReal             xi_S, yi_S, zi_S;
+    SimdReal             xj_S, yj_S, zj_S;
+    SimdReal             k_S, r0_S;
+    SimdReal             dx_S, dy_S, dz_S;
+    SimdReal             dr2_S, invdr_S, dr_S, fscal_S;
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH)    pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+
+    set_pbc_simd(pbc, pbc_simd);
+
+    /* nbonds is the number of bonds times nfa1, here we step GMX_SIMD_REAL_WIDTH bonds */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms for GMX_SIMD_REAL_WIDTH bonds.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+
+            /* At the end fill the arrays with the last atoms and 0 params */
+            if (i + s*nfa1 < nbonds)
+            {
+                coeff[s]                     = forceparams[type].harmonic.krA;
+                coeff[GMX_SIMD_REAL_WIDTH+s] = forceparams[type].harmonic.rA;
+
+                if (iu + nfa1 < nbonds)
+                {
+                    iu += nfa1;
+                }
+            }
+            else
+            {
+                coeff[s]                     = 0;
+                coeff[GMX_SIMD_REAL_WIDTH+s] = 0;
+            }
+        }
+
+        gatherLoadUTranspose<3>(reinterpret_cast<const real *>(x), ai, &xi_S, &yi_S, &zi_S);
+        gatherLoadUTranspose<3>(reinterpret_cast<const real *>(x), aj, &xj_S, &yj_S, &zj_S);
+        dx_S = xi_S - xj_S;
+        dy_S = yi_S - yj_S;
+        dz_S = zi_S - zj_S;
+
+        k_S  = load(coeff);
+        r0_S = load(coeff+GMX_SIMD_REAL_WIDTH);
+
+        pbc_correct_dx_simd(&dx_S, &dy_S, &dz_S, pbc_simd);
+
+        dr2_S   = norm2(dx_S, dy_S, dz_S);
+        /* As in the plain-C code, bonds of zero length do not contribute */
+        invdr_S = maskzInvsqrt(dr2_S, setZero() < dr2_S);
+        dr_S    = dr2_S * invdr_S;
+
+        /* Harmonic force, divided by the distance */
+        fscal_S = k_S * (r0_S - dr_S) * invdr_S;
+
+        transposeScatterIncrU<4>(reinterpret_cast<real *>(f), ai, fscal_S * dx_S, fscal_S * dy_S, fscal_S * dz_S);
+        transposeScatterDecrU<4>(reinterpret_cast<real *>(f), aj, fscal_S * dx_S, fscal_S * dy_S, fscal_S * dz_S);
+    }
+}
+
+#endif // GMX_SIMD_HAVE_REAL
+
 real restraint_bonds(int nbonds,
                      const t_iatom forceatoms[], const t_iparams forceparams[],
                      const rvec x[], rvec4 f[], rvec fshift[],
@@ -1295,6 +1381,174 @@ real urey_bradley(int nbonds,
     return vtot;
 }
 
+#if GMX_SIMD_HAVE_REAL
+
+/* As urey_bradley, but using SIMD to calculate many potentials at once.
+ * This routines does not calculate energies and shift forces.
+ */
+void
+urey_bradley_noener_simd(int nbonds,
+                         const t_iatom forceatoms[], const t_iparams forceparams[],
+                         const rvec x[], rvec4 f[],
+                         const t_pbc *pbc, const t_graph gmx_unused *g,
+                         real gmx_unused lambda,
+                         const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                         int gmx_unused *global_atom_index)
+{
+    const int                nfa1 = 4;
+    int                      i, iu, s;
+    int                      type;
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)    ai[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)    aj[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)    ak[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH)   coeff[4*GMX_SIMD_REAL_WIDTH];
+    SimdReal                 deg2rad_S(DEG2RAD);
+    SimdReal                 xi_S, yi_S, zi_S;
+    SimdReal                 xj_S, yj_S, zj_S;
+    SimdReal                 xk_S, yk_S, zk_S;
+    SimdReal                 kth_S, theta0_S, kUB_S, r13_S;
+    SimdReal                 rijx_S, rijy_S, rijz_S;
+    SimdReal                 rkjx_S, rkjy_S, rkjz_S;
+    SimdReal                 rikx_S, riky_S, rikz_S;
+    SimdReal                 one_S(1.0);
+    SimdReal                 min_one_plus_eps_S(-1.0 + 2.0*GMX_REAL_EPS); // Smallest number > -1
+
+    SimdReal                 rij_rkj_S;
+    SimdReal                 nrij2_S, nrij_1_S;
+    SimdReal                 nrkj2_S, nrkj_1_S;
+    SimdReal                 nrik2_S, nrik_1_S, nrik_S;
+    SimdReal                 cos_S, invsin_S;
+    SimdReal                 theta_S;
+    SimdReal                 st_S, sth_S;
+    SimdReal                 cik_S, cii_S, ckk_S;
+    SimdReal                 fbond_S;
+    SimdReal                 f_ix_S, f_iy_S, f_iz_S;
+    SimdReal                 f_kx_S, f_ky_S, f_kz_S;
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH)    pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+
+    set_pbc_simd(pbc, pbc_simd);
+
+    /* nbonds is the number of angles times nfa1, here we step GMX_SIMD_REAL_WIDTH angles */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms for GMX_SIMD_REAL_WIDTH angles.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+            ak[s] = forceatoms[iu+3];
+
+            /* At the end fill the arrays with the last atoms and 0 params */
+            if (i + s*nfa1 < nbonds)
+            {
+                coeff[s]                       = forceparams[type].u_b.kthetaA;
+                coeff[GMX_SIMD_REAL_WIDTH+s]   = forceparams[type].u_b.thetaA;
+                coeff[2*GMX_SIMD_REAL_WIDTH+s] = forceparams[type].u_b.kUBA;
+                coeff[3*GMX_SIMD_REAL_WIDTH+s] = forceparams[type].u_b.r13A;
+
+                if (iu + nfa1 < nbonds)
+                {
+                    iu += nfa1;
+                }
+            }
+            else
+            {
+                coeff[s]                       = 0;
+                coeff[GMX_SIMD_REAL_WIDTH+s]   = 0;
+                coeff[2*GMX_SIMD_REAL_WIDTH+s] = 0;
+                coeff[3*GMX_SIMD_REAL_WIDTH+s] = 0;
+            }
+        }
+
+        gatherLoadUTranspose<3>(reinterpret_cast<const real *>(x), ai, &xi_S, &yi_S, &zi_S);
+        gatherLoadUTranspose<3>(reinterpret_cast<const real *>(x), aj, &xj_S, &yj_S, &zj_S);
+        gatherLoadUTranspose<3>(reinterpret_cast<const real *>(x), ak, &xk_S, &yk_S, &zk_S);
+        rijx_S = xi_S - xj_S;
+        rijy_S = yi_S - yj_S;
+        rijz_S = zi_S - zj_S;
+        rkjx_S = xk_S - xj_S;
+        rkjy_S = yk_S - yj_S;
+        rkjz_S = zk_S - zj_S;
+        rikx_S = xi_S - xk_S;
+        riky_S = yi_S - yk_S;
+        rikz_S = zi_S - zk_S;
+
+        kth_S     = load(coeff);
+        theta0_S  = load(coeff+GMX_SIMD_REAL_WIDTH) * deg2rad_S;
+        kUB_S     = load(coeff+2*GMX_SIMD_REAL_WIDTH);
+        r13_S     = load(coeff+3*GMX_SIMD_REAL_WIDTH);
+
+        pbc_correct_dx_simd(&rijx_S, &rijy_S, &rijz_S, pbc_simd);
+        pbc_correct_dx_simd(&rkjx_S, &rkjy_S, &rkjz_S, pbc_simd);
+        pbc_correct_dx_simd(&rikx_S, &riky_S, &rikz_S, pbc_simd);
+
+        rij_rkj_S = iprod(rijx_S, rijy_S, rijz_S,
+                          rkjx_S, rkjy_S, rkjz_S);
+
+        nrij2_S   = norm2(rijx_S, rijy_S, rijz_S);
+        nrkj2_S   = norm2(rkjx_S, rkjy_S, rkjz_S);
+
+        nrij_1_S  = invsqrt(nrij2_S);
+        nrkj_1_S  = invsqrt(nrkj2_S);
+
+        cos_S     = rij_rkj_S * nrij_1_S * nrkj_1_S;
+
+        /* As in angles_noener_simd, we avoid cos=-1 to be able to
+         * compute 1/sin safely.
+         */
+        cos_S     = max(cos_S, min_one_plus_eps_S);
+
+        theta_S   = acos(cos_S);
+
+        invsin_S  = invsqrt( one_S - cos_S * cos_S );
+
+        st_S      = kth_S * (theta0_S - theta_S) * invsin_S;
+        sth_S     = st_S * cos_S;
+
+        cik_S     = st_S  * nrij_1_S * nrkj_1_S;
+        cii_S     = sth_S * nrij_1_S * nrij_1_S;
+        ckk_S     = sth_S * nrkj_1_S * nrkj_1_S;
+
+        /* The Urey-Bradley bond between atoms i and k */
+        nrik2_S   = norm2(rikx_S, riky_S, rikz_S);
+        nrik_1_S  = maskzInvsqrt(nrik2_S, setZero() < nrik2_S);
+        nrik_S    = nrik2_S * nrik_1_S;
+        fbond_S   = kUB_S * (r13_S - nrik_S) * nrik_1_S;
+
+        f_ix_S    = cii_S * rijx_S;
+        f_ix_S    = fnma(cik_S, rkjx_S, f_ix_S);
+        f_iy_S    = cii_S * rijy_S;
+        f_iy_S    = fnma(cik_S, rkjy_S, f_iy_S);
+        f_iz_S    = cii_S * rijz_S;
+        f_iz_S    = fnma(cik_S, rkjz_S, f_iz_S);
+        f_kx_S    = ckk_S * rkjx_S;
+        f_kx_S    = fnma(cik_S, rijx_S, f_kx_S);
+        f_ky_S    = ckk_S * rkjy_S;
+        f_ky_S    = fnma(cik_S, rijy_S, f_ky_S);
+        f_kz_S    = ckk_S * rkjz_S;
+        f_kz_S    = fnma(cik_S, rijz_S, f_kz_S);
+
+        /* The force on j only comes from the angle term */
+        transposeScatterDecrU<4>(reinterpret_cast<real *>(f), aj, f_ix_S + f_kx_S, f_iy_S + f_ky_S, f_iz_S + f_kz_S);
+
+        f_ix_S    = fma(fbond_S, rikx_S, f_ix_S);
+        f_iy_S    = fma(fbond_S, riky_S, f_iy_S);
+        f_iz_S    = fma(fbond_S, rikz_S, f_iz_S);
+        f_kx_S    = fnma(fbond_S, rikx_S, f_kx_S);
+        f_ky_S    = fnma(fbond_S, riky_S, f_ky_S);
+        f_kz_S    = fnma(fbond_S, rikz_S, f_kz_S);
+
+        transposeScatterIncrU<4>(reinterpret_cast<real *>(f), ai, f_ix_S, f_iy_S, f_iz_S);
+        transposeScatterIncrU<4>(reinterpret_cast<real *>(f), ak, f_kx_S, f_ky_S, f_kz_S);
+    }
+}
+
+#endif // GMX_SIMD_HAVE_REAL
+
 real quartic_angles(int nbonds,
                     const t_iatom forceatoms[], const t_iparams forceparams[],
                     const rvec x[], rvec4 f[], rvec fshift[],
@@ -2086,6 +2340,118 @@ rbdihs_noener_simd(int nbonds,
     }
 }
 
+/* As pdihs_noener_simd above, but with the harmonic improper dihedral
+ * potential of idihs(). This function can replace idihs() when no energy,
+ * virial and free-energy derivative are needed.
+ */
+void
+idihs_noener_simd(int nbonds,
+                  const t_iatom forceatoms[], const t_iparams forceparams[],
+                  const rvec x[], rvec4 f[],
+                  const t_pbc *pbc, const t_graph gmx_unused *g,
+                  real gmx_unused lambda,
+                  const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                  int gmx_unused *global_atom_index)
+{
+    const int             nfa1 = 5;
+    int                   i, iu, s;
+    int                   type;
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)    ai[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)    aj[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)    ak[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)    al[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH)  buf[2*GMX_SIMD_REAL_WIDTH];
+    real                 *kr, *phi0;
+    SimdReal              deg2rad_S(DEG2RAD);
+    SimdReal              twopi_S(2*M_PI);
+    SimdReal              inv_twopi_S(1.0/(2*M_PI));
+    SimdReal              p_S, q_S;
+    SimdReal              phi0_S, phi_S, dphi_S;
+    SimdReal              mx_S, my_S, mz_S;
+    SimdReal              nx_S, ny_S, nz_S;
+    SimdReal              nrkj_m2_S, nrkj_n2_S;
+    SimdReal              kr_S;
+    SimdReal              mddphi_S;
+    SimdReal              sf_i_S, msf_l_S;
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH)    pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+
+    /* Extract aligned pointer for parameters and variables */
+    kr    = buf + 0*GMX_SIMD_REAL_WIDTH;
+    phi0  = buf + 1*GMX_SIMD_REAL_WIDTH;
+
+    set_pbc_simd(pbc, pbc_simd);
+
+    /* nbonds is the number of dihedrals times nfa1, here we step GMX_SIMD_REAL_WIDTH dihs */
+    for (i = 0; (i < nbonds); i += GMX_SIMD_REAL_WIDTH*nfa1)
+    {
+        /* Collect atoms quadruplets for GMX_SIMD_REAL_WIDTH dihedrals.
+         * iu indexes into forceatoms, we should not let iu go beyond nbonds.
+         */
+        iu = i;
+        for (s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            type  = forceatoms[iu];
+            ai[s] = forceatoms[iu+1];
+            aj[s] = forceatoms[iu+2];
+            ak[s] = forceatoms[iu+3];
+            al[s] = forceatoms[iu+4];
+
+            /* At the end fill the arrays with the last atoms and 0 params */
+            if (i + s*nfa1 < nbonds)
+            {
+                kr[s]   = forceparams[type].harmonic.krA;
+                phi0[s] = forceparams[type].harmonic.rA;
+
+                if (iu + nfa1 < nbonds)
+                {
+                    iu += nfa1;
+                }
+            }
+            else
+            {
+                kr[s]   = 0;
+                phi0[s] = 0;
+            }
+        }
+
+        /* Caclulate GMX_SIMD_REAL_WIDTH dihedral angles at once */
+        dih_angle_simd(x, ai, aj, ak, al, pbc_simd,
+                       &phi_S,
+                       &mx_S, &my_S, &mz_S,
+                       &nx_S, &ny_S, &nz_S,
+                       &nrkj_m2_S,
+                       &nrkj_n2_S,
+                       &p_S, &q_S);
+
+        kr_S     = load(kr);
+        phi0_S   = load(phi0) * deg2rad_S;
+
+        /* As make_dp_periodic(), put phi-phi0 in the range (-pi,pi) */
+        dphi_S   = phi_S - phi0_S;
+        dphi_S   = fnma(twopi_S, round(dphi_S * inv_twopi_S), dphi_S);
+
+        mddphi_S = -kr_S * dphi_S;
+        sf_i_S   = mddphi_S * nrkj_m2_S;
+        msf_l_S  = mddphi_S * nrkj_n2_S;
+
+        /* After this m?_S will contain f[i] */
+        mx_S     = sf_i_S * mx_S;
+        my_S     = sf_i_S * my_S;
+        mz_S     = sf_i_S * mz_S;
+
+        /* After this m?_S will contain -f[l] */
+        nx_S     = msf_l_S * nx_S;
+        ny_S     = msf_l_S * ny_S;
+        nz_S     = msf_l_S * nz_S;
+
+        do_dih_fup_noshiftf_simd(ai, aj, ak, al,
+                                 p_S, q_S,
+                                 mx_S, my_S, mz_S,
+                                 nx_S, ny_S, nz_S,
+                                 f);
+    }
+}
+
 #endif // GMX_SIMD_HAVE_REAL
 
 
@@ -128,6 +128,19 @@ void
 
 /* TODO these declarations should be internal to the module */
 
+/* As bonds(), but using SIMD to calculate many bonds at once.
+ * This routines does not calculate energies and shift forces.
+ */
+void
+    bonds_noener_simd(int nbonds,
+                      const t_iatom forceatoms[], const t_iparams forceparams[],
+                      const rvec x[], rvec4 f[],
+                      const struct t_pbc *pbc,
+                      const struct t_graph gmx_unused *g,
+                      real gmx_unused lambda,
+                      const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                      int gmx_unused *global_atom_index);
+
 /* As angles(), but using SIMD to calculate many angles at once.
  * This routines does not calculate energies and shift forces.
  */
@@ -141,6 +154,19 @@ void
                        const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
                        int gmx_unused *global_atom_index);
 
+/* As urey_bradley(), but using SIMD to calculate many potentials at once.
+ * This routines does not calculate energies and shift forces.
+ */
+void
+    urey_bradley_noener_simd(int nbonds,
+                             const t_iatom forceatoms[], const t_iparams forceparams[],
+                             const rvec x[], rvec4 f[],
+                             const struct t_pbc *pbc,
+                             const struct t_graph gmx_unused *g,
+                             real gmx_unused lambda,
+                             const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                             int gmx_unused *global_atom_index);
+
 /* As pdihs_noener(), but using SIMD to calculate many dihedrals at once. */
 void
     pdihs_noener_simd(int nbonds,
@@ -163,6 +189,17 @@ void
                        const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
                        int gmx_unused *global_atom_index);
 
+/* As idihs(), when not needing energy or shift force, using SIMD to calculate many dihedrals at once. */
+void
+    idihs_noener_simd(int nbonds,
+                      const t_iatom forceatoms[], const t_iparams forceparams[],
+                      const rvec x[], rvec4 f[],
+                      const struct t_pbc *pbc,
+                      const struct t_graph gmx_unused *g,
+                      real gmx_unused lambda,
+                      const t_mdatoms gmx_unused *md, t_fcdata gmx_unused *fcd,
+                      int gmx_unused *global_atom_index);
+
 //! \endcond
 
 #ifdef __cplusplus
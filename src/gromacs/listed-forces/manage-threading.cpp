@@ -53,6 +53,7 @@
 
 #include <algorithm>
 
+#include "gromacs/gmxlib/nrnb.h"
 #include "gromacs/listed-forces/listed-forces.h"
 #include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/pbcutil/ishift.h"
@@ -69,8 +70,40 @@ typedef struct {
     int      ftype; /**< the function type index */
     t_ilist *il;    /**< pointer to t_ilist entry corresponding to ftype */
     int      nat;   /**< nr of atoms involved in a single ftype interaction */
+    int      cost;  /**< estimated relative cost of a single ftype interaction */
 } ilist_data_t;
 
+/*! \brief Rough estimate of the flop count of a CMAP interaction
+ *
+ * CMAP has no flop count in the nrnb table. Its cost is dominated by
+ * the two dihedrals and the bicubic interpolation, which together
+ * amount to roughly six proper dihedrals.
+ */
+static const int c_cmapCost = 1400;
+
+/*! \brief Returns the estimated cost of one interaction of type \p ftype
+ *
+ * We use the flop counts from the nrnb accounting as a cost model.
+ * When no flop count is available, we assume the cost is proportional
+ * to the number of atoms, with a per-atom cost close to that of angles
+ * and dihedrals.
+ */
+static int bonded_interaction_cost(int ftype)
+{
+    if (ftype == F_CMAP)
+    {
+        return c_cmapCost;
+    }
+
+    int nrnbIndex = interaction_function[ftype].nrnb_ind;
+    if (nrnbIndex >= 0 && cost_nrnb(nrnbIndex) > 0)
+    {
+        return cost_nrnb(nrnbIndex);
+    }
+
+    return 50*NRAL(ftype);
+}
+
 /*! \brief Divides listed interactions over threads
  *
  * This routine attempts to divide all interactions of the ntype bondeds
@@ -83,18 +116,18 @@ static void divide_bondeds_by_locality(int                 ntype,
                                        int                 nthread,
                                        t_idef             *idef)
 {
-    int nat_tot, nat_sum;
-    int ind[F_NRE];    /* index into the ild[].il->iatoms */
-    int at_ind[F_NRE]; /* index of the first atom of the interaction at ind */
-    int f, t;
+    gmx_int64_t cost_tot, cost_sum;
+    int         ind[F_NRE];    /* index into the ild[].il->iatoms */
+    int         at_ind[F_NRE]; /* index of the first atom of the interaction at ind */
+    int         f, t;
 
     assert(ntype <= F_NRE);
 
-    nat_tot = 0;
+    cost_tot = 0;
     for (f = 0; f < ntype; f++)
     {
-        /* Sum #bondeds*#atoms_per_bond over all bonded types */
-        nat_tot  += ild[f].il->nr/(ild[f].nat + 1)*ild[f].nat;
+        /* Sum #bondeds*cost_per_bond over all bonded types */
+        cost_tot += static_cast<gmx_int64_t>(ild[f].il->nr/(ild[f].nat + 1))*ild[f].cost;
         /* The start bound for thread 0 is 0 for all interactions */
         ind[f]    = 0;
         /* Initialize the next atom index array */
@@ -102,7 +135,7 @@ static void divide_bondeds_by_locality(int                 ntype,
         at_ind[f] = ild[f].il->iatoms[1];
     }
 
-    nat_sum = 0;
+    cost_sum = 0;
     /* Loop over the end bounds of the nthread threads to determine
      * which interactions threads 0 to nthread shall calculate.
      *
@@ -116,18 +149,17 @@ static void divide_bondeds_by_locality(int                 ntype,
      */
     for (t = 1; t <= nthread; t++)
     {
-        int nat_thread;
-
-        /* Here we assume that the computational cost is proportional
-         * to the number of atoms in the interaction. This is a rough
-         * measure, but roughly correct. Usually there are very few
-         * interactions anyhow and there are distributed relatively
-         * uniformly. Proper and RB dihedrals are often distributed
-         * non-uniformly, but their cost is roughly equal.
+        gmx_int64_t cost_thread;
+
+        /* We balance the estimated computational cost, which is taken
+         * from the flop counts of the interactions. Types with very
+         * different costs, such as CMAP and bonds, are distributed
+         * non-uniformly in many systems, so assuming a cost proportional
+         * to the number of atoms can lead to significant imbalance.
          */
-        nat_thread = (nat_tot*t)/nthread;
+        cost_thread = (cost_tot*t)/nthread;
 
-        while (nat_sum < nat_thread)
+        while (cost_sum < cost_thread)
         {
             /* To divide bonds based on atom order, we compare
              * the index of the first atom in the bonded interaction.
@@ -157,7 +189,7 @@ static void divide_bondeds_by_locality(int                 ntype,
              * index f_min) to thread t-1 by increasing ind.
              */
             ind[f_min] += ild[f_min].nat + 1;
-            nat_sum    += ild[f_min].nat;
+            cost_sum   += ild[f_min].cost;
 
             /* Update the first unassigned atom index for this type */
             if (ind[f_min] < ild[f_min].il->nr)
@@ -272,6 +304,7 @@ static void divide_bondeds_over_threads(t_idef *idef,
             ild[ntype].ftype = f;
             ild[ntype].il    = &idef->il[f];
             ild[ntype].nat   = nat;
+            ild[ntype].cost  = bonded_interaction_cost(f);
 
             /* The first index for the thread division is always 0 */
             idef->il_thread_division[f*(nthread + 1)] = 0;
@@ -45,6 +45,7 @@
 
 #include <cmath>
 
+#include <algorithm>
 #include <memory>
 
 #include <gtest/gtest.h>
@@ -52,6 +53,7 @@
 #include "gromacs/math/units.h"
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/simd/simd.h"
 
 #include "testutils/refdata.h"
 #include "testutils/testasserts.h"
@@ -154,7 +156,6 @@ class BondedTest : public ::testing::Test
                                                                  &ddgatindex);
             checker_.checkReal(energy, interaction_function[ftype].longname);
         }
-
 };
 
 TEST_F (BondedTest, BondAnglePbcNone)
@@ -214,6 +215,130 @@ TEST_F (BondedTest, IfuncBondsPbcXyz)
     testIfunc(F_BONDS, iatoms, &iparams, epbcXYZ);
 }
 
+#if GMX_SIMD_HAVE_REAL
+/*! \brief Compares the SIMD no-energy bonded kernels with the plain-C ones
+ *
+ * The plain-C functions are the reference, so these tests do not use
+ * reference data.
+ */
+class BondedSimdTest : public ::testing::Test
+{
+    protected:
+        rvec   x[NATOMS];
+        matrix box;
+        BondedSimdTest( )
+        {
+            clear_rvecs(NATOMS, x);
+            x[1][2] = 1;
+            x[2][1] = x[2][2] = 1;
+            x[3][0] = x[3][1] = x[3][2] = 1;
+
+            clear_mat(box);
+            box[0][0] = box[1][1] = box[2][2] = 1.5;
+        }
+
+        //! Signature of the SIMD no-energy bonded functions
+        typedef void (*SimdNoenerFunction)(int, const t_iatom[], const t_iparams[],
+                                           const rvec[], rvec4[],
+                                           const t_pbc *, const t_graph *,
+                                           real, const t_mdatoms *, t_fcdata *,
+                                           int *);
+
+        //! Checks that a SIMD no-energy function gives the same forces as the plain-C function
+        void testSimdNoener(int                         ftype,
+                            SimdNoenerFunction          simdFunction,
+                            const std::vector<t_iatom> &iatoms,
+                            const t_iparams             iparams[],
+                            int                         epbc)
+        {
+            /* The SIMD gathers can read one real beyond the last coordinate */
+            rvec  xPadded[NATOMS + 1];
+            rvec4 fRef[NATOMS], fSimd[NATOMS];
+            for (int i = 0; i < NATOMS + 1; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    xPadded[i][d] = (i < NATOMS ? x[i][d] : 0);
+                }
+            }
+            for (int i = 0; i < NATOMS; i++)
+            {
+                for (int j = 0; j < 4; j++)
+                {
+                    fRef[i][j]  = 0;
+                    fSimd[i][j] = 0;
+                }
+            }
+            rvec  fshift[N_IVEC];
+            clear_rvecs(N_IVEC, fshift);
+            t_pbc pbc;
+            set_pbc(&pbc, epbc, box);
+            real  dvdlambda  = 0;
+            int   ddgatindex = 0;
+            interaction_function[ftype].ifunc(iatoms.size(), iatoms.data(), iparams,
+                                              xPadded, fRef, fshift, &pbc, nullptr,
+                                              0, &dvdlambda, nullptr, nullptr, &ddgatindex);
+            simdFunction(iatoms.size(), iatoms.data(), iparams,
+                         xPadded, fSimd, &pbc, nullptr,
+                         0, nullptr, nullptr, &ddgatindex);
+
+            /* Cancellation makes the error of small components scale
+             * with the largest force, not with the component itself.
+             */
+            real fMax = 0;
+            for (int i = 0; i < NATOMS; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    fMax = std::max(fMax, std::abs(fRef[i][d]));
+                }
+            }
+            test::FloatingPointTolerance tolerance(test::relativeToleranceAsFloatingPoint(fMax, 1e-5));
+            for (int i = 0; i < NATOMS; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    EXPECT_REAL_EQ_TOL(fRef[i][d], fSimd[i][d], tolerance) << "atom " << i << " dim " << d;
+                }
+            }
+        }
+};
+
+TEST_F (BondedSimdTest, SimdBondsMatchPlainC)
+{
+    std::vector<t_iatom> iatoms = { 0, 0, 1, 0, 1, 2, 0, 2, 3 };
+    t_iparams            iparams;
+    iparams.harmonic.rA  = iparams.harmonic.rB  = 0.8;
+    iparams.harmonic.krA = iparams.harmonic.krB = 50;
+    testSimdNoener(F_BONDS, bonds_noener_simd, iatoms, &iparams, epbcXYZ);
+}
+
+TEST_F (BondedSimdTest, SimdUreyBradleyMatchPlainC)
+{
+    std::vector<t_iatom> iatoms = { 0, 0, 1, 2, 0, 1, 2, 3 };
+    t_iparams            iparams;
+    iparams.u_b.thetaA  = iparams.u_b.thetaB  = 100;
+    iparams.u_b.kthetaA = iparams.u_b.kthetaB = 50;
+    iparams.u_b.r13A    = iparams.u_b.r13B    = 1.2;
+    iparams.u_b.kUBA    = iparams.u_b.kUBB    = 30;
+    testSimdNoener(F_UREY_BRADLEY, urey_bradley_noener_simd, iatoms, &iparams, epbcXYZ);
+}
+
+TEST_F (BondedSimdTest, SimdImproperDihedralsMatchPlainC)
+{
+    /* The second type has phi0 close to 180 degrees, so phi-phi0
+     * needs to be put back in the periodic range.
+     */
+    std::vector<t_iatom> iatoms = { 0, 0, 1, 2, 3, 1, 1, 2, 3, 0 };
+    t_iparams            iparams[2];
+    iparams[0].harmonic.rA  = iparams[0].harmonic.rB  = 0;
+    iparams[0].harmonic.krA = iparams[0].harmonic.krB = 40;
+    iparams[1].harmonic.rA  = iparams[1].harmonic.rB  = 170;
+    iparams[1].harmonic.krA = iparams[1].harmonic.krB = 40;
+    testSimdNoener(F_IDIHS, idihs_noener_simd, iatoms, iparams, epbcXYZ);
+}
+#endif
+
 TEST_F (BondedTest, IfuncAnglesPbcNo)
 {
     std::vector<t_iatom> iatoms = { 0, 0, 1, 2, 0, 1, 2, 3 };
@@ -556,6 +556,13 @@ static void bc_imd(const t_commrec *cr, t_IMD *imd)
     nblock_bc(cr, imd->nat, imd->ind);
 }
 
+static void bc_x_stream(const t_commrec *cr, t_compressed_x_stream *xs)
+{
+    block_bc(cr, *xs);
+    snew_bc(cr, xs->ind, xs->nat);
+    nblock_bc(cr, xs->nat, xs->ind);
+}
+
 static void bc_fepvals(const t_commrec *cr, t_lambda *fep)
 {
     int      i;
@@ -716,6 +723,11 @@ static void bc_inputrec(const t_commrec *cr, t_inputrec *inputrec)
     {
         bc_simtempvals(cr, inputrec->simtempvals, inputrec->fepvals->n_lambda);
     }
+    snew_bc(cr, inputrec->x_streams, inputrec->n_x_streams);
+    for (int s = 0; s < inputrec->n_x_streams; s++)
+    {
+        bc_x_stream(cr, &inputrec->x_streams[s]);
+    }
     if (inputrec->bPull)
     {
         snew_bc(cr, inputrec->pull, 1);
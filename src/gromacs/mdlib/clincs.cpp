@@ -74,6 +74,8 @@
 #include "gromacs/utility/pleasecite.h"
 #include "gromacs/utility/smalloc.h"
 
+#include "thread_mpi/atomic.h"
+
 using namespace gmx; // TODO: Remove when this file is moved into gmx namespace
 
 typedef struct {
@@ -88,6 +90,8 @@ typedef struct {
     int    nind_r;     /* number of indices */
     int   *ind_r;      /* constraint index for updating atom data */
     int    ind_nalloc; /* allocation size of ind and ind_r */
+    int    ndep;       /* number of other tasks with coupled constraints */
+    int   *dep;        /* the tasks with constraints coupled to this task */
     tensor vir_r_m_dr; /* temporary variable for virial calculation */
     real   dhdlambda;  /* temporary variable for lambda derivative */
 } lincs_task_t;
@@ -128,6 +132,7 @@ typedef struct gmx_lincsdata {
     int             atf_nalloc;   /* allocation size of atf */
     gmx_bool        bTaskDep;     /* are the LINCS tasks interdependent? */
     gmx_bool        bTaskDepTri;  /* are there triangle constraints that cross task borders? */
+    tMPI_Atomic    *syncStep;     /* per task progress of the matrix expansion */
     /* arrays for temporary storage in the LINCS algorithm */
     rvec           *tmpv;
     real           *tmpncc;
@@ -168,6 +173,39 @@ real lincs_rmsd(struct gmx_lincsdata *lincsd)
     }
 }
 
+#ifdef TMPI_ATOMICS
+/*! \brief Marks that task \p th has reached synchronization step \p step */
+static void lincs_sync_mark(const struct gmx_lincsdata *lincsd,
+                            int th, int step)
+{
+    /* Guarantee that our data is stored before marking the step as done */
+    tMPI_Atomic_memory_barrier();
+    tMPI_Atomic_set(&lincsd->syncStep[th], step);
+}
+
+/*! \brief Waits until all tasks coupled to \p li_task have reached \p step
+ *
+ * The difference is taken in unsigned arithmetic, so the step counters
+ * can safely wrap around in long simulations.
+ */
+static void lincs_sync_wait(const struct gmx_lincsdata *lincsd,
+                            const lincs_task_t *li_task, int step)
+{
+    for (int d = 0; d < li_task->ndep; d++)
+    {
+        volatile tMPI_Atomic_t *sync = &lincsd->syncStep[li_task->dep[d]];
+
+        while (static_cast<int>(static_cast<unsigned int>(tMPI_Atomic_get(sync)) -
+                                static_cast<unsigned int>(step)) < 0)
+        {
+            gmx_pause();
+        }
+    }
+    /* Guarantee that no later load happens before the wait is finished */
+    tMPI_Atomic_memory_barrier();
+}
+#endif
+
 /* Do a set of nrec LINCS matrix multiplications.
  * This function will return with up to date thread-local
  * constraint data, without an OpenMP barrier.
@@ -185,13 +223,40 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
     b1   = li_task->b1;
     nrec = lincsd->nOrder;
 
+#ifdef TMPI_ATOMICS
+    /* With dependent tasks we only need to wait for the tasks that own
+     * constraints coupled to ours, instead of for all threads.
+     * The step counters only increase, all tasks pass through
+     * this function the same number of times, so our own counter
+     * gives the common reference step.
+     */
+    int syncBase = 0;
+
+    if (lincsd->bTaskDep)
+    {
+        int th = li_task - lincsd->task;
+
+        syncBase = tMPI_Atomic_get(&lincsd->syncStep[th]);
+        /* Mark that our part of rhs1 is set */
+        lincs_sync_mark(lincsd, th, syncBase + 1);
+    }
+#endif
+
     for (rec = 0; rec < nrec; rec++)
     {
         int b;
 
         if (lincsd->bTaskDep)
         {
+#ifdef TMPI_ATOMICS
+            /* Wait for the coupled tasks to finish recursion rec-1.
+             * This ensures both that their part of rhs1 is up to date
+             * and that they are done reading our part of rhs2.
+             */
+            lincs_sync_wait(lincsd, li_task, syncBase + rec + 1);
+#else
 #pragma omp barrier
+#endif
         }
         for (b = b0; b < b1; b++)
         {
@@ -212,6 +277,13 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
         swap = rhs1;
         rhs1 = rhs2;
         rhs2 = swap;
+
+#ifdef TMPI_ATOMICS
+        if (lincsd->bTaskDep)
+        {
+            lincs_sync_mark(lincsd, li_task - lincsd->task, syncBase + rec + 2);
+        }
+#endif
     } /* nrec*(ncons+2*nrtot) flops */
 
     if (lincsd->ntriangle > 0)
@@ -226,12 +298,16 @@ static void lincs_matrix_expand(const struct gmx_lincsdata *lincsd,
 
         if (lincsd->bTaskDep)
         {
-            /* We need a barrier here, since other threads might still be
+            /* We need to synchronize here, since other threads might still be
              * reading the contents of rhs1 and/o rhs2.
-             * We could avoid this barrier by introducing two extra rhs
+             * We could avoid this by introducing two extra rhs
              * arrays for the triangle constraints only.
              */
+#ifdef TMPI_ATOMICS
+            lincs_sync_wait(lincsd, li_task, syncBase + nrec + 1);
+#else
 #pragma omp barrier
+#endif
         }
 
         /* Constraints involved in a triangle are ensured to be in the same
@@ -1496,6 +1572,10 @@ gmx_lincsdata_t init_lincs(FILE *fplog, const gmx_mtop_t *mtop,
         /* Allocate an extra elements for "task-overlap" constraints */
         snew(li->task, li->ntask + 1);
     }
+    if (li->bTaskDep)
+    {
+        snew(li->syncStep, li->ntask);
+    }
 
     if (bPLINCS || li->ncg_triangle > 0)
     {
@@ -1649,6 +1729,72 @@ static void lincs_thread_setup(struct gmx_lincsdata *li, int natoms)
     }
 }
 
+/*! \brief Sets up for each task the list of tasks with coupled constraints
+ *
+ * With dependent tasks, this allows the matrix expansion to synchronize
+ * only with the tasks we exchange data with, instead of with all threads.
+ */
+static void lincs_task_dep_setup(struct gmx_lincsdata *li)
+{
+    int th;
+
+#pragma omp parallel for num_threads(li->ntask) schedule(static)
+    for (th = 0; th < li->ntask; th++)
+    {
+        try
+        {
+            lincs_task_t  *li_task;
+            gmx_bitmask_t  mask;
+            int            b, n, t;
+
+            li_task = &li->task[th];
+
+            bitmask_clear(&mask);
+            for (b = li_task->b0; b < li_task->b1; b++)
+            {
+                for (n = li->blnr[b]; n < li->blnr[b + 1]; n++)
+                {
+                    int bc = li->blbnb[n];
+
+                    if (bc < li_task->b0 || bc >= li_task->b1)
+                    {
+                        /* The task ranges are ordered, find the owner */
+                        t = 0;
+                        while (t < li->ntask - 1 && bc >= li->task[t + 1].b0)
+                        {
+                            t++;
+                        }
+                        bitmask_set_bit(&mask, t);
+                    }
+                }
+            }
+
+            if (li_task->dep == nullptr)
+            {
+                snew(li_task->dep, li->ntask);
+            }
+            li_task->ndep = 0;
+            for (t = 0; t < li->ntask; t++)
+            {
+                if (bitmask_is_set(mask, t))
+                {
+                    li_task->dep[li_task->ndep++] = t;
+                }
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    if (debug)
+    {
+        for (th = 0; th < li->ntask; th++)
+        {
+            fprintf(debug, "LINCS task %d depends on %d tasks\n",
+                    th, li->task[th].ndep);
+        }
+    }
+}
+
 /* There is no realloc with alignment, so here we make one for reals.
  * Note that this function does not preserve the contents of the memory.
  */
@@ -2194,6 +2340,10 @@ void set_lincs(const t_idef         *idef,
     {
         lincs_thread_setup(li, md->nr);
     }
+    if (li->bTaskDep)
+    {
+        lincs_task_dep_setup(li);
+    }
 
     set_lincs_matrix(li, md->invmass, md->lambda);
 }
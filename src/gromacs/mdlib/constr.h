@@ -112,6 +112,7 @@ gmx_bool bshakef(FILE           *log,          /* Log file			*/
  * starting
  * at sblock[0] and running to ( < ) sblock[1], block n running from
  * sblock[n] to sblock[n+1]. Array sblock should be large enough.
+ * The blocks are distributed over the LINCS OpenMP threads.
  * Return TRUE when OK, FALSE when shake-error
  */
 
@@ -654,50 +654,85 @@ void berendsen_pcoupl(FILE *fplog, gmx_int64_t step,
     }
 }
 
-void berendsen_pscale(const t_inputrec *ir, const matrix mu,
-                      matrix box, matrix box_rel,
-                      int start, int nr_atoms,
-                      rvec x[], const unsigned short cFREEZE[],
-                      t_nrnb *nrnb)
+void scale_coordinates_ur0(const matrix mu,
+                           int start, int nr_atoms, rvec x[],
+                           const ivec *nFreeze, const unsigned short cFREEZE[])
 {
-    ivec   *nFreeze = ir->opts.nFreeze;
-    int     n, d;
-    int     nthreads gmx_unused;
+    int nthreads gmx_unused;
 
 #ifndef __clang_analyzer__
     // cppcheck-suppress unreadVariable
     nthreads = gmx_omp_nthreads_get(emntUpdate);
 #endif
 
-    /* Scale the positions */
-#pragma omp parallel for num_threads(nthreads) schedule(static)
-    for (n = start; n < start+nr_atoms; n++)
+    if (nFreeze == nullptr)
     {
-        // Trivial OpenMP region that does not throw
-        int g;
-
-        if (cFREEZE == nullptr)
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (int n = start; n < start + nr_atoms; n++)
         {
-            g = 0;
+            // Trivial OpenMP region that does not throw
+            tmvmul_ur0(mu, x[n], x[n]);
         }
-        else
+    }
+    else
+    {
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+        for (int n = start; n < start + nr_atoms; n++)
         {
-            g = cFREEZE[n];
-        }
+            // Trivial OpenMP region that does not throw
+            int g;
 
-        if (!nFreeze[g][XX])
-        {
-            x[n][XX] = mu[XX][XX]*x[n][XX]+mu[YY][XX]*x[n][YY]+mu[ZZ][XX]*x[n][ZZ];
-        }
-        if (!nFreeze[g][YY])
-        {
-            x[n][YY] = mu[YY][YY]*x[n][YY]+mu[ZZ][YY]*x[n][ZZ];
+            if (cFREEZE == nullptr)
+            {
+                g = 0;
+            }
+            else
+            {
+                g = cFREEZE[n];
+            }
+
+            if (!nFreeze[g][XX])
+            {
+                x[n][XX] = mu[XX][XX]*x[n][XX]+mu[YY][XX]*x[n][YY]+mu[ZZ][XX]*x[n][ZZ];
+            }
+            if (!nFreeze[g][YY])
+            {
+                x[n][YY] = mu[YY][YY]*x[n][YY]+mu[ZZ][YY]*x[n][ZZ];
+            }
+            if (!nFreeze[g][ZZ])
+            {
+                x[n][ZZ] = mu[ZZ][ZZ]*x[n][ZZ];
+            }
         }
-        if (!nFreeze[g][ZZ])
+    }
+}
+
+void berendsen_pscale(const t_inputrec *ir, const matrix mu,
+                      matrix box, matrix box_rel,
+                      int start, int nr_atoms,
+                      rvec x[], const unsigned short cFREEZE[],
+                      t_nrnb *nrnb)
+{
+    ivec   *nFreeze = ir->opts.nFreeze;
+    int     d;
+
+    /* Only check the freeze groups per atom when some are frozen */
+    bool    haveFrozenDims = false;
+    for (int g = 0; g < ir->opts.ngfrz; g++)
+    {
+        for (d = 0; d < DIM; d++)
         {
-            x[n][ZZ] = mu[ZZ][ZZ]*x[n][ZZ];
+            if (nFreeze[g][d])
+            {
+                haveFrozenDims = true;
+            }
         }
     }
+
+    /* Scale the positions */
+    scale_coordinates_ur0(mu, start, nr_atoms, x,
+                          haveFrozenDims ? nFreeze : nullptr, cFREEZE);
+
     /* compute final boxlengths */
     for (d = 0; d < DIM; d++)
     {
@@ -830,7 +865,7 @@ void trotter_update(t_inputrec *ir, gmx_int64_t step, gmx_ekindata_t *ekind,
                     t_extmass *MassQ, int **trotter_seqlist, int trotter_seqno)
 {
 
-    int             n, i, d, ngtc, gc = 0, t;
+    int             n, i, d, ngtc, t;
     t_grp_tcstat   *tcstat;
     t_grpopts      *opts;
     gmx_int64_t     step_eff;
@@ -915,18 +950,31 @@ void trotter_update(t_inputrec *ir, gmx_int64_t step, gmx_ekindata_t *ekind,
                 /* but do we actually need the total? */
 
                 /* modify the velocities as well */
-                for (n = 0; n < md->homenr; n++)
                 {
-                    if (md->cTC) /* does this conditional need to be here? is this always true?*/
-                    {
-                        gc = md->cTC[n];
-                    }
-                    for (d = 0; d < DIM; d++)
+                    rvec *v = as_rvec_array(state->v.data());
+                    int   nthreads gmx_unused;
+
+#ifndef __clang_analyzer__
+                    // cppcheck-suppress unreadVariable
+                    nthreads = gmx_omp_nthreads_get(emntUpdate);
+#endif
+
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+                    for (int a = 0; a < md->homenr; a++)
                     {
-                        state->v[n][d] *= scalefac[gc];
+                        // Trivial OpenMP region that does not throw
+                        /* does this conditional need to be here? is this always true?*/
+                        int g = (md->cTC ? md->cTC[a] : 0);
+                        for (int m = 0; m < DIM; m++)
+                        {
+                            v[a][m] *= scalefac[g];
+                        }
                     }
+                }
 
-                    if (debug)
+                if (debug)
+                {
+                    for (n = 0; n < md->homenr; n++)
                     {
                         for (d = 0; d < DIM; d++)
                         {
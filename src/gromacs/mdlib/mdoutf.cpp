@@ -36,6 +36,13 @@
 
 #include "mdoutf.h"
 
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+
+#include "thread_mpi/threads.h"
+
 #include "gromacs/commandline/filenm.h"
 #include "gromacs/domdec/domdec.h"
 #include "gromacs/domdec/domdec_struct.h"
@@ -45,24 +52,94 @@
 #include "gromacs/fileio/trrio.h"
 #include "gromacs/fileio/xtcio.h"
 #include "gromacs/fileio/xvgr.h"
+#include "gromacs/gmxlib/network.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/mdlib/mdrun.h"
+#include "gromacs/mdlib/sim_util.h"
 #include "gromacs/mdlib/trajectory_writing.h"
+#include "gromacs/mdrunutility/threadaffinity.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/mdtypes/imdoutputprovider.h"
 #include "gromacs/mdtypes/inputrec.h"
 #include "gromacs/mdtypes/md_enums.h"
 #include "gromacs/mdtypes/state.h"
+#include "gromacs/timing/walltime_accounting.h"
 #include "gromacs/timing/wallcycle.h"
 #include "gromacs/utility/fatalerror.h"
+#include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxassert.h"
+#include "gromacs/utility/path.h"
 #include "gromacs/utility/pleasecite.h"
 #include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+/*! \brief The number of frames that can be queued for the output thread
+ *
+ * Each queued frame holds a copy of the coordinates, and for TRR and TNG
+ * frames also of the velocities and forces, so this is kept small.
+ * Two frames allow an XTC and a TRR frame of the same step to be
+ * queued without waiting.
+ */
+static const int c_outputQueueSize = 2;
+
+/*! \brief The trajectory file a queued frame is written to */
+enum {
+    eofTRR, eofXTC, eofXSTREAM, eofTNG, eofTNGLowPrec
+};
+
+/*! \brief Copy of the data of a frame that is queued for writing */
+typedef struct {
+    int          file;              /* one of the eof enum values */
+    int          stream;            /* the index of the x stream, eofXSTREAM only */
+    gmx_int64_t  step;
+    double       t;
+    real         lambda;
+    matrix       box;
+    int          natoms;
+    gmx_bool     bX, bV, bF;        /* which vectors are written, TRR and TNG only */
+    gmx_bool     bLossy;            /* lossy compression of x and v, TNG only */
+    rvec        *x, *v, *f;
+    int          nalloc;            /* allocation size of x, v and f */
+} t_mdoutf_frame;
+
+/*! \brief Statistics of writing a TNG file, reported in the log file when closing it */
+typedef struct {
+    const char  *fn;                /* the name of the file */
+    gmx_off_t    initialSize;       /* the size of the file before opening it */
+    double       rawBytes;          /* the size of the written data before compression */
+    double       writeTime;         /* the time spent on compressing and writing, in seconds */
+} t_mdoutf_tng_stats;
+
+/*! \brief Thread that writes trajectory frames while the simulation continues
+ *
+ * This also moves the compression of TNG frame sets, which the TNG
+ * library buffers in memory and compresses when a frame set is
+ * complete, off the simulation thread.
+ *
+ * The frames are copied into a ring buffer of c_outputQueueSize frames.
+ * Only the output thread accesses the XTC and TRR files while frames
+ * are queued, so all queued frames have to be written, using
+ * mdoutf_wait_for_output(), before the files are used otherwise,
+ * as for writing a checkpoint.
+ */
+typedef struct {
+    tMPI_Thread_t        thread;
+    tMPI_Thread_mutex_t  mutex;
+    tMPI_Thread_cond_t   cond;      /* signaled when a frame is queued or written */
+    t_mdoutf_frame       frame[c_outputQueueSize];
+    int                  first;     /* index of the first queued frame */
+    int                  nqueued;   /* the number of queued frames */
+    gmx_bool             bStop;     /* tells the thread to finish */
+    int                  errorFile; /* the file that could not be written, -1 if none */
+} t_mdoutf_writer;
 
 struct gmx_mdoutf {
     t_fileio               *fp_trn;
     t_fileio               *fp_xtc;
     tng_trajectory_t        tng;
     tng_trajectory_t        tng_low_prec;
+    t_mdoutf_tng_stats      tngStats[2]; /* for tng and tng_low_prec */
+    FILE                   *fplog;
     int                     x_compression_precision; /* only used by XTC output */
     ener_file_t             fp_ene;
     const char             *fn_cpt;
@@ -75,11 +152,379 @@ struct gmx_mdoutf {
     int                     natoms_global;
     int                     natoms_x_compressed;
     gmx_groups_t           *groups; /* for compressed position writing */
+    int                     n_x_streams;    /* the number of additional compressed x streams */
+    t_compressed_x_stream  *x_streams;      /* the additional compressed x streams */
+    t_fileio              **fp_x_stream;    /* the XTC files of the x streams */
     gmx_wallcycle_t         wcycle;
     rvec                   *f_global;
     gmx::IMDOutputProvider *outputProvider;
+    t_mdoutf_writer        *writer; /* writes XTC and TRR frames in the background, can be NULL */
+    gmx_bool                bCptParts;      /* each PP rank writes its atoms to a checkpoint part file */
+    gmx_int64_t             cptPartStep[3]; /* steps of the last three checkpoints with parts, -1 if none */
+    int                     nCptPartsPrevRun; /* largest number of parts of the checkpoints we restart from */
 };
 
+/*! \brief Returns the size of file \p fn, 0 when it does not exist */
+static gmx_off_t file_size(const char *fn)
+{
+    FILE     *fp   = fopen(fn, "rb");
+    gmx_off_t size = 0;
+
+    if (fp != nullptr)
+    {
+        if (gmx_fseek(fp, 0, SEEK_END) == 0)
+        {
+            size = gmx_ftell(fp);
+        }
+        fclose(fp);
+    }
+
+    return size;
+}
+
+/*! \brief Writes a frame to TNG file \p file, eofTNG or eofTNGLowPrec, and updates its statistics */
+static void write_tng_frame(gmx_mdoutf_t of, int file, gmx_bool bLossy,
+                            gmx_int64_t step, double t, real lambda, const rvec *box,
+                            int natoms, const rvec *x, const rvec *v, const rvec *f)
+{
+    t_mdoutf_tng_stats *stats = &of->tngStats[file == eofTNG ? 0 : 1];
+    double              start = gmx_gettime();
+    int                 nvec  = (x != nullptr) + (v != nullptr) + (f != nullptr);
+
+    gmx_fwrite_tng(file == eofTNG ? of->tng : of->tng_low_prec, bLossy,
+                   step, t, lambda, box, natoms, x, v, f);
+    stats->writeTime += gmx_gettime() - start;
+    stats->rawBytes  += nvec*natoms*sizeof(rvec) + (DIM*DIM + 1)*sizeof(real);
+}
+
+/*! \brief Writes \p fr to the file of \p of it is queued for, returns whether this succeeded */
+static gmx_bool write_queued_frame(gmx_mdoutf_t of, const t_mdoutf_frame *fr)
+{
+    if (fr->file == eofTRR)
+    {
+        gmx_trr_write_frame(of->fp_trn, fr->step, fr->t, fr->lambda, fr->box, fr->natoms,
+                            fr->bX ? fr->x : nullptr,
+                            fr->bV ? fr->v : nullptr,
+                            fr->bF ? fr->f : nullptr);
+        return (gmx_fio_flush(of->fp_trn) == 0);
+    }
+    else if (fr->file == eofTNG || fr->file == eofTNGLowPrec)
+    {
+        /* gmx_fwrite_tng calls gmx_file when writing fails */
+        write_tng_frame(of, fr->file, fr->bLossy, fr->step, fr->t, fr->lambda, fr->box, fr->natoms,
+                        fr->bX ? fr->x : nullptr,
+                        fr->bV ? fr->v : nullptr,
+                        fr->bF ? fr->f : nullptr);
+        return TRUE;
+    }
+    else if (fr->file == eofXTC)
+    {
+        return (write_xtc(of->fp_xtc, fr->natoms, fr->step, fr->t,
+                          fr->box, fr->x, of->x_compression_precision) != 0);
+    }
+    else
+    {
+        return (write_xtc(of->fp_x_stream[fr->stream], fr->natoms, fr->step, fr->t,
+                          fr->box, fr->x, of->x_streams[fr->stream].precision) != 0);
+    }
+}
+
+/*! \brief Calls gmx_fatal when the output thread failed to write a frame */
+static void check_output_error(const t_mdoutf_writer *writer)
+{
+    if (writer->errorFile == eofTRR)
+    {
+        gmx_file("Cannot write trajectory; maybe you are out of disk space?");
+    }
+    else if (writer->errorFile == eofXTC || writer->errorFile == eofXSTREAM)
+    {
+        gmx_fatal(FARGS, "XTC error - maybe you are out of disk space?");
+    }
+}
+
+/*! \brief The main function of the output thread */
+static void *mdoutf_writer_thread(void *arg)
+{
+    gmx_mdoutf_t     of     = static_cast<gmx_mdoutf_t>(arg);
+    t_mdoutf_writer *writer = of->writer;
+
+    /* This thread inherits the affinity of the master thread, which can
+     * be pinned to a single core. Writing and compressing frames would
+     * then take time from the simulation, so we run on any core that
+     * the process was allowed to run on.
+     */
+    gmx_reset_thread_affinity();
+
+    tMPI_Thread_mutex_lock(&writer->mutex);
+    while (TRUE)
+    {
+        while (writer->nqueued == 0 && !writer->bStop)
+        {
+            tMPI_Thread_cond_wait(&writer->cond, &writer->mutex);
+        }
+        if (writer->nqueued == 0)
+        {
+            break;
+        }
+        t_mdoutf_frame *fr = &writer->frame[writer->first];
+        tMPI_Thread_mutex_unlock(&writer->mutex);
+
+        /* The frame is not modified by the master thread while it is queued */
+        gmx_bool        bOK = write_queued_frame(of, fr);
+
+        tMPI_Thread_mutex_lock(&writer->mutex);
+        if (!bOK && writer->errorFile < 0)
+        {
+            writer->errorFile = fr->file;
+        }
+        writer->first = (writer->first + 1) % c_outputQueueSize;
+        writer->nqueued--;
+        tMPI_Thread_cond_broadcast(&writer->cond);
+    }
+    tMPI_Thread_mutex_unlock(&writer->mutex);
+
+    return nullptr;
+}
+
+/*! \brief Starts the output thread, unless disabled by the user or when threads are not supported */
+static void mdoutf_start_writer(gmx_mdoutf_t of)
+{
+    t_mdoutf_writer *writer;
+
+    if (getenv("GMX_NO_ASYNC_OUTPUT") != nullptr ||
+        (of->fp_xtc == nullptr && of->fp_trn == nullptr && of->n_x_streams == 0 &&
+         of->tng == nullptr && of->tng_low_prec == nullptr))
+    {
+        return;
+    }
+
+    snew(writer, 1);
+    tMPI_Thread_mutex_init(&writer->mutex);
+    tMPI_Thread_cond_init(&writer->cond);
+    writer->errorFile = -1;
+    of->writer        = writer;
+    if (tMPI_Thread_create(&writer->thread, mdoutf_writer_thread, of) != 0)
+    {
+        tMPI_Thread_cond_destroy(&writer->cond);
+        tMPI_Thread_mutex_destroy(&writer->mutex);
+        sfree(writer);
+        of->writer = nullptr;
+    }
+}
+
+/*! \brief Waits until all queued frames have been written */
+static void mdoutf_wait_for_output(gmx_mdoutf_t of)
+{
+    t_mdoutf_writer *writer = of->writer;
+
+    if (writer == nullptr)
+    {
+        return;
+    }
+    tMPI_Thread_mutex_lock(&writer->mutex);
+    while (writer->nqueued > 0)
+    {
+        tMPI_Thread_cond_wait(&writer->cond, &writer->mutex);
+    }
+    tMPI_Thread_mutex_unlock(&writer->mutex);
+    check_output_error(writer);
+}
+
+/*! \brief Writes all queued frames, stops the output thread and frees it */
+static void mdoutf_stop_writer(gmx_mdoutf_t of)
+{
+    t_mdoutf_writer *writer = of->writer;
+
+    if (writer == nullptr)
+    {
+        return;
+    }
+    tMPI_Thread_mutex_lock(&writer->mutex);
+    writer->bStop = TRUE;
+    tMPI_Thread_cond_broadcast(&writer->cond);
+    tMPI_Thread_mutex_unlock(&writer->mutex);
+    tMPI_Thread_join(writer->thread, nullptr);
+    check_output_error(writer);
+
+    for (int i = 0; i < c_outputQueueSize; i++)
+    {
+        sfree(writer->frame[i].x);
+        sfree(writer->frame[i].v);
+        sfree(writer->frame[i].f);
+    }
+    tMPI_Thread_cond_destroy(&writer->cond);
+    tMPI_Thread_mutex_destroy(&writer->mutex);
+    sfree(writer);
+    of->writer = nullptr;
+}
+
+/*! \brief Returns a free frame in the queue, waits for the output thread when the queue is full */
+static t_mdoutf_frame *mdoutf_get_free_frame(gmx_mdoutf_t of, int natoms)
+{
+    t_mdoutf_writer *writer = of->writer;
+    t_mdoutf_frame  *fr;
+
+    tMPI_Thread_mutex_lock(&writer->mutex);
+    while (writer->nqueued == c_outputQueueSize)
+    {
+        tMPI_Thread_cond_wait(&writer->cond, &writer->mutex);
+    }
+    fr = &writer->frame[(writer->first + writer->nqueued) % c_outputQueueSize];
+    tMPI_Thread_mutex_unlock(&writer->mutex);
+    check_output_error(writer);
+
+    if (natoms > fr->nalloc)
+    {
+        /* Only the vectors that are used are allocated, see below */
+        fr->nalloc = natoms;
+        sfree(fr->x);
+        sfree(fr->v);
+        sfree(fr->f);
+        fr->x = nullptr;
+        fr->v = nullptr;
+        fr->f = nullptr;
+    }
+    fr->natoms = natoms;
+
+    return fr;
+}
+
+/*! \brief Copies \p n vectors from \p src to the frame vector \p dest, allocating it when needed */
+static void copy_frame_vector(int nalloc, const rvec *src, int n, rvec **dest)
+{
+    if (*dest == nullptr)
+    {
+        snew(*dest, nalloc);
+    }
+    std::memcpy(*dest, src, n*sizeof(rvec));
+}
+
+/*! \brief Hands the last frame obtained with mdoutf_get_free_frame() to the output thread */
+static void mdoutf_queue_frame(gmx_mdoutf_t of)
+{
+    t_mdoutf_writer *writer = of->writer;
+
+    tMPI_Thread_mutex_lock(&writer->mutex);
+    writer->nqueued++;
+    tMPI_Thread_cond_broadcast(&writer->cond);
+    tMPI_Thread_mutex_unlock(&writer->mutex);
+}
+
+/*! \brief Copies the vectors of \p x, \p v and \p f that are not nullptr and queues them for \p file */
+static void mdoutf_queue_vectors(gmx_mdoutf_t of, int file, gmx_bool bLossy,
+                                 gmx_int64_t step, double t, real lambda, const matrix box,
+                                 int natoms, const rvec *x, const rvec *v, const rvec *f)
+{
+    t_mdoutf_frame *fr = mdoutf_get_free_frame(of, natoms);
+
+    fr->file   = file;
+    fr->bLossy = bLossy;
+    fr->step   = step;
+    fr->t      = t;
+    fr->lambda = lambda;
+    copy_mat(box, fr->box);
+    fr->bX     = (x != nullptr);
+    fr->bV     = (v != nullptr);
+    fr->bF     = (f != nullptr);
+    if (fr->bX)
+    {
+        copy_frame_vector(fr->nalloc, x, fr->natoms, &fr->x);
+    }
+    if (fr->bV)
+    {
+        copy_frame_vector(fr->nalloc, v, fr->natoms, &fr->v);
+    }
+    if (fr->bF)
+    {
+        copy_frame_vector(fr->nalloc, f, fr->natoms, &fr->f);
+    }
+    mdoutf_queue_frame(of);
+}
+
+/*! \brief Queues a frame for TNG file \p file, or writes it when there is no output thread */
+static void mdoutf_output_tng(gmx_mdoutf_t of, int file, gmx_bool bLossy,
+                              gmx_int64_t step, double t, real lambda, const matrix box,
+                              int natoms, const rvec *x, const rvec *v, const rvec *f)
+{
+    if (of->writer)
+    {
+        mdoutf_queue_vectors(of, file, bLossy, step, t, lambda, box, natoms, x, v, f);
+    }
+    else
+    {
+        write_tng_frame(of, file, bLossy, step, t, lambda, box, natoms, x, v, f);
+    }
+}
+
+/*! \brief Writes the frames of the current TNG frame sets, which a checkpoint refers to */
+static void mdoutf_flush_tng(gmx_mdoutf_t of)
+{
+    tng_trajectory_t *tng[2] = { &of->tng, &of->tng_low_prec };
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (*tng[i] != nullptr)
+        {
+            double start = gmx_gettime();
+            fflush_tng(*tng[i]);
+            of->tngStats[i].writeTime += gmx_gettime() - start;
+        }
+    }
+}
+
+/*! \brief Closes TNG file \p i of \p of, when open, and reports its write statistics in the log file */
+static void mdoutf_close_tng_file(gmx_mdoutf_t of, int i)
+{
+    tng_trajectory_t   *tng   = (i == 0 ? &of->tng : &of->tng_low_prec);
+    t_mdoutf_tng_stats *stats = &of->tngStats[i];
+    double              start, written;
+
+    if (*tng == nullptr)
+    {
+        return;
+    }
+    start = gmx_gettime();
+    gmx_tng_close(tng);
+    stats->writeTime += gmx_gettime() - start;
+
+    if (of->fplog != nullptr && stats->rawBytes > 0)
+    {
+        const double mb = 1024*1024;
+
+        written = file_size(stats->fn) - stats->initialSize;
+        fprintf(of->fplog,
+                "\nTNG output %s: %.2f MB of data written as %.2f MB, compression ratio %.2f\n"
+                "Compressing and writing took %.2f s, %.1f MB/s of data, %.1f MB/s to disk\n",
+                stats->fn, stats->rawBytes/mb, written/mb,
+                written > 0 ? stats->rawBytes/written : 0,
+                stats->writeTime,
+                stats->writeTime > 0 ? stats->rawBytes/mb/stats->writeTime : 0,
+                stats->writeTime > 0 ? written/mb/stats->writeTime : 0);
+    }
+}
+
+/*! \brief Returns the file name of additional compressed x stream \p s */
+static std::string x_stream_filename(const char *fn_compressed, int s)
+{
+    return gmx::Path::stripExtension(fn_compressed) + gmx::formatString("_stream%d.xtc", s + 1);
+}
+
+gmx_bool mdoutf_is_x_stream_filename(const char *fn, int nfile, const t_filenm fnm[])
+{
+    std::string prefix = gmx::Path::stripExtension(ftp2fn(efCOMPRESSED, nfile, fnm)) + "_stream";
+
+    return (std::strncmp(fn, prefix.c_str(), prefix.size()) == 0 && fn2ftp(fn) == efXTC);
+}
+
+/*! \brief Copies the atoms \p ind of \p x to \p xs */
+static void copy_x_stream_atoms(int nat, const int *ind, const rvec *x, rvec *xs)
+{
+    for (int i = 0; i < nat; i++)
+    {
+        copy_rvec(x[ind[i]], xs[i]);
+    }
+}
+
 
 gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
                          int mdrun_flags, const t_commrec *cr,
@@ -100,22 +545,47 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
     of->tng          = nullptr;
     of->tng_low_prec = nullptr;
     of->fp_dhdl      = nullptr;
+    of->fplog        = fplog;
 
     of->eIntegrator             = ir->eI;
     of->bExpanded               = ir->bExpanded;
     of->elamstats               = ir->expandedvals->elamstats;
     of->simulation_part         = ir->simulation_part;
     of->x_compression_precision = static_cast<int>(ir->x_compression_precision);
+    of->fn_cpt                  = opt2fn("-cpo", nfile, fnm);
+    of->bKeepAndNumCPT          = (mdrun_flags & MD_KEEPANDNUMCPT);
     of->wcycle                  = wcycle;
     of->f_global                = nullptr;
     of->outputProvider          = outputProvider;
+    of->writer                  = nullptr;
+    of->n_x_streams             = 0;
+    of->x_streams               = ir->x_streams;
+    of->fp_x_stream             = nullptr;
+    of->bCptParts               = (DOMAINDECOMP(cr) && EI_DYNAMICS(ir->eI) &&
+                                   getenv("GMX_CHECKPOINT_PARTS") != nullptr);
+    for (i = 0; i < 3; i++)
+    {
+        of->cptPartStep[i]      = -1;
+    }
+    of->nCptPartsPrevRun        = 0;
+    if (of->bCptParts && !of->bKeepAndNumCPT)
+    {
+        /* Remove the parts an earlier run left behind, and continue
+         * removing the parts of the checkpoints we restart from.
+         */
+        if (MASTER(cr))
+        {
+            remove_unreferenced_checkpoint_parts(of->fn_cpt,
+                                                 &of->cptPartStep[1], &of->cptPartStep[2],
+                                                 &of->nCptPartsPrevRun);
+        }
+        gmx_bcast(2*sizeof(of->cptPartStep[0]), &of->cptPartStep[1], cr);
+    }
 
     if (MASTER(cr))
     {
         bAppendFiles = (mdrun_flags & MD_APPENDFILES);
 
-        of->bKeepAndNumCPT = (mdrun_flags & MD_KEEPANDNUMCPT);
-
         filemode = bAppendFiles ? appendMode : writeMode;
 
         if (EI_DYNAMICS(ir->eI) &&
@@ -127,8 +597,11 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
             {
                 case efXTC:
                     of->fp_xtc                  = open_xtc(filename, filemode);
+                    gmx_fio_open_frame_index(of->fp_xtc, bAppendFiles);
                     break;
                 case efTNG:
+                    of->tngStats[1].fn          = filename;
+                    of->tngStats[1].initialSize = bAppendFiles ? file_size(filename) : 0;
                     gmx_tng_open(filename, filemode[0], &of->tng_low_prec);
                     if (filemode[0] == 'w')
                     {
@@ -140,6 +613,19 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
                     gmx_incons("Invalid reduced precision file format");
             }
         }
+        if (EI_DYNAMICS(ir->eI) && ir->n_x_streams > 0)
+        {
+            /* Each additional stream is written to its own XTC file */
+            const char *fn_compressed = ftp2fn(efCOMPRESSED, nfile, fnm);
+
+            of->n_x_streams = ir->n_x_streams;
+            snew(of->fp_x_stream, of->n_x_streams);
+            for (i = 0; i < of->n_x_streams; i++)
+            {
+                of->fp_x_stream[i] = open_xtc(x_stream_filename(fn_compressed, i).c_str(), filemode);
+                gmx_fio_open_frame_index(of->fp_x_stream[i], bAppendFiles);
+            }
+        }
         if ((EI_DYNAMICS(ir->eI) || EI_ENERGY_MINIMIZATION(ir->eI))
 #ifndef GMX_FAHCORE
             &&
@@ -163,9 +649,12 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
                         !of->tng_low_prec)
                     {
                         of->fp_trn = gmx_trr_open(filename, filemode);
+                        gmx_fio_open_frame_index(of->fp_trn, bAppendFiles);
                     }
                     break;
                 case efTNG:
+                    of->tngStats[0].fn          = filename;
+                    of->tngStats[0].initialSize = bAppendFiles ? file_size(filename) : 0;
                     gmx_tng_open(filename, filemode[0], &of->tng);
                     if (filemode[0] == 'w')
                     {
@@ -181,7 +670,6 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
         {
             of->fp_ene = open_enx(ftp2fn(efEDR, nfile, fnm), filemode);
         }
-        of->fn_cpt = opt2fn("-cpo", nfile, fnm);
 
         if ((ir->efep != efepNO || ir->bSimTemp) && ir->fepvals->nstdhdl > 0 &&
             (ir->fepvals->separate_dhdl_file == esepdhdlfileYES ) &&
@@ -218,6 +706,8 @@ gmx_mdoutf_t init_mdoutf(FILE *fplog, int nfile, const t_filenm fnm[],
         {
             snew(of->f_global, top_global->natoms);
         }
+
+        mdoutf_start_writer(of);
     }
 
     if (bCiteTng)
@@ -256,18 +746,23 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
 
     if (DOMAINDECOMP(cr))
     {
-        if (mdof_flags & MDOF_CPT)
+        if ((mdof_flags & MDOF_CPT) && !of->bCptParts)
         {
             dd_collect_state(cr->dd, state_local, state_global);
         }
         else
         {
-            if (mdof_flags & (MDOF_X | MDOF_X_COMPRESSED))
+            if (mdof_flags & MDOF_CPT)
+            {
+                /* Each rank writes its own atoms, see below */
+                dd_collect_state_without_atoms(cr->dd, state_local, state_global);
+            }
+            if (mdof_flags & (MDOF_X | MDOF_X_COMPRESSED | MDOF_X_STREAMS | MDOF_CONFOUT))
             {
                 dd_collect_vec(cr->dd, state_local, &state_local->x,
                                &state_global->x);
             }
-            if (mdof_flags & MDOF_V)
+            if (mdof_flags & (MDOF_V | MDOF_CONFOUT))
             {
                 dd_collect_vec(cr->dd, state_local, &state_local->v,
                                &state_global->v);
@@ -287,12 +782,42 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
         f_global     = as_rvec_array(f_local->data());
     }
 
+    if ((mdof_flags & MDOF_CPT) && of->bCptParts)
+    {
+        /* Write the home atoms of each rank in parallel, the master
+         * writes the checkpoint referring to these files after all
+         * ranks have finished.
+         */
+        write_checkpoint_part(of->fn_cpt, step, cr->dd->rank, top_global->natoms,
+                              cr->dd->nat_home, cr->dd->gatindex, state_local->flags,
+                              as_rvec_array(state_local->x.data()),
+                              as_rvec_array(state_local->v.data()));
+        gmx_barrier(cr);
+
+        /* The master has finished the previous checkpoint and moved it to
+         * <fn>_prev.cpt, so the parts of the one before are not referenced.
+         */
+        if (!of->bKeepAndNumCPT && of->cptPartStep[0] >= 0)
+        {
+            remove_checkpoint_part(of->fn_cpt, of->cptPartStep[0], cr->dd->rank);
+            /* An earlier run may have used more ranks */
+            for (int p = cr->dd->nnodes; MASTER(cr) && p < of->nCptPartsPrevRun; p++)
+            {
+                remove_checkpoint_part(of->fn_cpt, of->cptPartStep[0], p);
+            }
+        }
+        of->cptPartStep[0] = of->cptPartStep[1];
+        of->cptPartStep[1] = of->cptPartStep[2];
+        of->cptPartStep[2] = step;
+    }
+
     if (MASTER(cr))
     {
         if (mdof_flags & MDOF_CPT)
         {
-            fflush_tng(of->tng);
-            fflush_tng(of->tng_low_prec);
+            /* The checkpoint stores the positions of, and syncs, the output files */
+            mdoutf_wait_for_output(of);
+            mdoutf_flush_tng(of);
             ivec one_ivec = { 1, 1, 1 };
             write_checkpoint(of->fn_cpt, of->bKeepAndNumCPT,
                              fplog, cr,
@@ -300,7 +825,8 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
                              DOMAINDECOMP(cr) ? cr->dd->nnodes : cr->nnodes,
                              of->eIntegrator, of->simulation_part,
                              of->bExpanded, of->elamstats, step, t,
-                             state_global, energyHistory);
+                             state_global, energyHistory,
+                             of->bCptParts ? cr->dd->nnodes : 0);
         }
 
         if (mdof_flags & (MDOF_X | MDOF_V | MDOF_F))
@@ -309,7 +835,12 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
             const rvec *v = (mdof_flags & MDOF_V) ? as_rvec_array(state_global->v.data()) : nullptr;
             const rvec *f = (mdof_flags & MDOF_F) ? f_global : nullptr;
 
-            if (of->fp_trn)
+            if (of->fp_trn && of->writer)
+            {
+                mdoutf_queue_vectors(of, eofTRR, FALSE, step, t, state_local->lambda[efptFEP],
+                                     state_local->box, top_global->natoms, x, v, f);
+            }
+            else if (of->fp_trn)
             {
                 gmx_trr_write_frame(of->fp_trn, step, t, state_local->lambda[efptFEP],
                                     state_local->box, top_global->natoms,
@@ -324,22 +855,50 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
                velocities and forces to it. */
             else if (of->tng)
             {
-                gmx_fwrite_tng(of->tng, FALSE, step, t, state_local->lambda[efptFEP],
-                               state_local->box,
-                               top_global->natoms,
-                               x, v, f);
+                mdoutf_output_tng(of, eofTNG, FALSE, step, t, state_local->lambda[efptFEP],
+                                  state_local->box,
+                                  top_global->natoms,
+                                  x, v, f);
             }
             /* If only a TNG file is open for compressed coordinate output (no uncompressed
                coordinate output) also write forces and velocities to it. */
             else if (of->tng_low_prec)
             {
-                gmx_fwrite_tng(of->tng_low_prec, FALSE, step, t, state_local->lambda[efptFEP],
-                               state_local->box,
-                               top_global->natoms,
-                               x, v, f);
+                mdoutf_output_tng(of, eofTNGLowPrec, FALSE, step, t, state_local->lambda[efptFEP],
+                                  state_local->box,
+                                  top_global->natoms,
+                                  x, v, f);
+            }
+        }
+        if ((mdof_flags & MDOF_X_COMPRESSED) && of->fp_xtc && of->writer)
+        {
+            t_mdoutf_frame *fr = mdoutf_get_free_frame(of, of->natoms_x_compressed);
+
+            fr->file = eofXTC;
+            fr->step = step;
+            fr->t    = t;
+            copy_mat(state_local->box, fr->box);
+            if (of->natoms_x_compressed == of->natoms_global)
+            {
+                copy_frame_vector(fr->nalloc, as_rvec_array(state_global->x.data()), fr->natoms, &fr->x);
+            }
+            else
+            {
+                if (fr->x == nullptr)
+                {
+                    snew(fr->x, fr->nalloc);
+                }
+                for (int i = 0, j = 0; i < of->natoms_global; i++)
+                {
+                    if (ggrpnr(of->groups, egcCompressedX, i) == 0)
+                    {
+                        copy_rvec(state_global->x[i], fr->x[j++]);
+                    }
+                }
             }
+            mdoutf_queue_frame(of);
         }
-        if (mdof_flags & MDOF_X_COMPRESSED)
+        else if (mdof_flags & MDOF_X_COMPRESSED)
         {
             rvec *xxtc = nullptr;
 
@@ -370,21 +929,64 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
             {
                 gmx_fatal(FARGS, "XTC error - maybe you are out of disk space?");
             }
-            gmx_fwrite_tng(of->tng_low_prec,
-                           TRUE,
-                           step,
-                           t,
-                           state_local->lambda[efptFEP],
-                           state_local->box,
-                           of->natoms_x_compressed,
-                           xxtc,
-                           nullptr,
-                           nullptr);
+            if (of->tng_low_prec)
+            {
+                mdoutf_output_tng(of, eofTNGLowPrec, TRUE, step, t,
+                                  state_local->lambda[efptFEP],
+                                  state_local->box,
+                                  of->natoms_x_compressed,
+                                  xxtc,
+                                  nullptr,
+                                  nullptr);
+            }
             if (of->natoms_x_compressed != of->natoms_global)
             {
                 sfree(xxtc);
             }
         }
+        if (mdof_flags & MDOF_X_STREAMS)
+        {
+            const rvec *x = as_rvec_array(state_global->x.data());
+
+            for (int s = 0; s < of->n_x_streams; s++)
+            {
+                const t_compressed_x_stream *xs = &of->x_streams[s];
+
+                if (!do_per_step(step, xs->nstxout))
+                {
+                    continue;
+                }
+                if (of->writer)
+                {
+                    t_mdoutf_frame *fr = mdoutf_get_free_frame(of, xs->nat);
+
+                    fr->file   = eofXSTREAM;
+                    fr->stream = s;
+                    fr->step   = step;
+                    fr->t      = t;
+                    copy_mat(state_local->box, fr->box);
+                    if (fr->x == nullptr)
+                    {
+                        snew(fr->x, fr->nalloc);
+                    }
+                    copy_x_stream_atoms(xs->nat, xs->ind, x, fr->x);
+                    mdoutf_queue_frame(of);
+                }
+                else
+                {
+                    rvec *xxtc;
+
+                    snew(xxtc, xs->nat);
+                    copy_x_stream_atoms(xs->nat, xs->ind, x, xxtc);
+                    if (write_xtc(of->fp_x_stream[s], xs->nat, step, t,
+                                  state_local->box, xxtc, xs->precision) == 0)
+                    {
+                        gmx_fatal(FARGS, "XTC error - maybe you are out of disk space?");
+                    }
+                    sfree(xxtc);
+                }
+            }
+        }
     }
 }
 
@@ -393,14 +995,17 @@ void mdoutf_tng_close(gmx_mdoutf_t of)
     if (of->tng || of->tng_low_prec)
     {
         wallcycle_start(of->wcycle, ewcTRAJ);
-        gmx_tng_close(&of->tng);
-        gmx_tng_close(&of->tng_low_prec);
+        /* The output thread might still be compressing frames */
+        mdoutf_wait_for_output(of);
+        mdoutf_close_tng_file(of, 0);
+        mdoutf_close_tng_file(of, 1);
         wallcycle_stop(of->wcycle, ewcTRAJ);
     }
 }
 
 void done_mdoutf(gmx_mdoutf_t of)
 {
+    mdoutf_stop_writer(of);
     if (of->fp_ene != nullptr)
     {
         close_enx(of->fp_ene);
@@ -409,6 +1014,11 @@ void done_mdoutf(gmx_mdoutf_t of)
     {
         close_xtc(of->fp_xtc);
     }
+    for (int s = 0; s < of->n_x_streams; s++)
+    {
+        close_xtc(of->fp_x_stream[s]);
+    }
+    sfree(of->fp_x_stream);
     if (of->fp_trn)
     {
         gmx_trr_close(of->fp_trn);
@@ -423,8 +1033,8 @@ void done_mdoutf(gmx_mdoutf_t of)
         sfree(of->f_global);
     }
 
-    gmx_tng_close(&of->tng);
-    gmx_tng_close(&of->tng_low_prec);
+    mdoutf_close_tng_file(of, 0);
+    mdoutf_close_tng_file(of, 1);
 
     sfree(of);
 }
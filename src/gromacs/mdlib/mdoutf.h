@@ -73,6 +73,13 @@ gmx_mdoutf_t init_mdoutf(FILE                   *fplog,
                          const gmx_output_env_t *oenv,
                          gmx_wallcycle_t         wcycle);
 
+/*! \brief Returns whether \p fn is the file of an additional compressed x stream
+ *
+ * The stream files are named after the compressed trajectory file
+ * in \p fnm, with _stream<n>.xtc replacing the extension, n starting at 1.
+ */
+gmx_bool mdoutf_is_x_stream_filename(const char *fn, int nfile, const t_filenm fnm[]);
+
 /*! \brief Getter for file pointer */
 ener_file_t mdoutf_get_fp_ene(gmx_mdoutf_t of);
 
@@ -114,5 +121,8 @@ void mdoutf_write_to_trajectory_files(FILE *fplog, t_commrec *cr,
 #define MDOF_X_COMPRESSED (1<<3)
 #define MDOF_CPT          (1<<4)
 #define MDOF_IMD          (1<<5)
+#define MDOF_X_STREAMS    (1<<6)
+/* Collect x and v for writing the final configuration, without writing them */
+#define MDOF_CONFOUT      (1<<7)
 
 #endif
@@ -42,21 +42,39 @@
 #include "gromacs/math/functions.h"
 #include "gromacs/math/vec.h"
 #include "gromacs/mdlib/constr.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
 #include "gromacs/mdtypes/inputrec.h"
 #include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/smalloc.h"
 
+typedef struct
+{
+    rvec    *rij;
+    real    *half_of_reduced_mass;
+    real    *distance_squared_tolerance;
+    real    *constraint_distance_squared;
+    int      nalloc;
+    /* Thread-local output, reduced in bshakef */
+    tensor   vir_r_m_dr; /* The constraint virial contribution */
+    int      tnit;       /* The number of iterations times block sizes */
+    int      trij;       /* The number of constraints */
+    int      failBlock;  /* The first block for which SHAKE failed, -1 if none */
+    int      failError;  /* 0 when SHAKE did not converge for failBlock, otherwise
+                            one more than the constraint with a negative inner product */
+} shake_task_t;
+
+/* The maximum number of SHAKE iterations */
+static const int c_shakeMaxIterations = 1000;
+
 typedef struct gmx_shakedata
 {
-    rvec *rij;
-    real *half_of_reduced_mass;
-    real *distance_squared_tolerance;
-    real *constraint_distance_squared;
-    int   nalloc;
+    int           ntask; /* The number of tasks = #threads for SHAKE */
+    shake_task_t *task;  /* Per task work data */
     /* SOR stuff */
-    real  delta;
-    real  omega;
-    real  gamma;
+    real          delta;
+    real          omega;
+    real          gamma;
 } t_gmx_shakedata;
 
 gmx_shakedata_t shake_init()
@@ -65,11 +83,19 @@ gmx_shakedata_t shake_init()
 
     snew(d, 1);
 
-    d->nalloc                      = 0;
-    d->rij                         = nullptr;
-    d->half_of_reduced_mass        = nullptr;
-    d->distance_squared_tolerance  = nullptr;
-    d->constraint_distance_squared = nullptr;
+    /* The SHAKE blocks are independent, so they can be distributed
+     * over threads. We use the same number of threads as for LINCS.
+     */
+    d->ntask = gmx_omp_nthreads_get(emntLINCS);
+    snew(d->task, d->ntask);
+    for (int th = 0; th < d->ntask; th++)
+    {
+        d->task[th].nalloc                      = 0;
+        d->task[th].rij                         = nullptr;
+        d->task[th].half_of_reduced_mass        = nullptr;
+        d->task[th].distance_squared_tolerance  = nullptr;
+        d->task[th].constraint_distance_squared = nullptr;
+    }
 
     /* SOR initialization */
     d->delta = 0.1;
@@ -202,17 +228,24 @@ void cshake(const int iatom[], int ncon, int *nnit, int maxnit,
     *nerror = error;
 }
 
-int vec_shakef(FILE *fplog, gmx_shakedata_t shaked,
-               real invmass[], int ncon,
-               t_iparams ip[], t_iatom *iatom,
-               real tol, rvec x[], rvec prime[], real omega,
-               gmx_bool bFEP, real lambda, real scaled_lagrange_multiplier[],
-               real invdt, rvec *v,
-               gmx_bool bCalcVir, tensor vir_r_m_dr, int econq)
+/*! \brief Constrains one SHAKE block, returns the number of iterations
+ *
+ * Returns 0 on failure, then \p nerror is 0 when SHAKE did not converge
+ * and otherwise one more than the index of the problematic constraint.
+ * Messages are not printed here, since this is called from OpenMP threads.
+ */
+static int vec_shakef(shake_task_t *task,
+                      real invmass[], int ncon,
+                      t_iparams ip[], t_iatom *iatom,
+                      real tol, rvec x[], rvec prime[], real omega,
+                      gmx_bool bFEP, real lambda, real scaled_lagrange_multiplier[],
+                      real invdt, rvec *v,
+                      gmx_bool bCalcVir, tensor vir_r_m_dr, int econq,
+                      int *nerror)
 {
     rvec    *rij;
     real    *half_of_reduced_mass, *distance_squared_tolerance, *constraint_distance_squared;
-    int      maxnit = 1000;
+    int      maxnit = c_shakeMaxIterations;
     int      nit    = 0, ll, i, j, d, d2, type;
     t_iatom *ia;
     real     L1;
@@ -220,18 +253,18 @@ int vec_shakef(FILE *fplog, gmx_shakedata_t shaked,
     int      error = 0;
     real     constraint_distance;
 
-    if (ncon > shaked->nalloc)
+    if (ncon > task->nalloc)
     {
-        shaked->nalloc = over_alloc_dd(ncon);
-        srenew(shaked->rij, shaked->nalloc);
-        srenew(shaked->half_of_reduced_mass, shaked->nalloc);
-        srenew(shaked->distance_squared_tolerance, shaked->nalloc);
-        srenew(shaked->constraint_distance_squared, shaked->nalloc);
+        task->nalloc = over_alloc_dd(ncon);
+        srenew(task->rij, task->nalloc);
+        srenew(task->half_of_reduced_mass, task->nalloc);
+        srenew(task->distance_squared_tolerance, task->nalloc);
+        srenew(task->constraint_distance_squared, task->nalloc);
     }
-    rij                          = shaked->rij;
-    half_of_reduced_mass         = shaked->half_of_reduced_mass;
-    distance_squared_tolerance   = shaked->distance_squared_tolerance;
-    constraint_distance_squared  = shaked->constraint_distance_squared;
+    rij                          = task->rij;
+    half_of_reduced_mass         = task->half_of_reduced_mass;
+    distance_squared_tolerance   = task->distance_squared_tolerance;
+    constraint_distance_squared  = task->constraint_distance_squared;
 
     L1   = 1.0-lambda;
     ia   = iatom;
@@ -268,26 +301,14 @@ int vec_shakef(FILE *fplog, gmx_shakedata_t shaked,
             break;
     }
 
+    *nerror = error;
     if (nit >= maxnit)
     {
-        if (fplog)
-        {
-            fprintf(fplog, "Shake did not converge in %d steps\n", maxnit);
-        }
-        fprintf(stderr, "Shake did not converge in %d steps\n", maxnit);
-        nit = 0;
+        *nerror = 0;
+        nit     = 0;
     }
     else if (error != 0)
     {
-        if (fplog)
-        {
-            fprintf(fplog, "Inner product between old and new vector <= 0.0!\n"
-                    "constraint #%d atoms %d and %d\n",
-                    error-1, iatom[3*(error-1)+1]+1, iatom[3*(error-1)+2]+1);
-        }
-        fprintf(stderr, "Inner product between old and new vector <= 0.0!\n"
-                "constraint #%d atoms %d and %d\n",
-                error-1, iatom[3*(error-1)+1]+1, iatom[3*(error-1)+2]+1);
         nit = 0;
     }
 
@@ -390,6 +411,26 @@ static void check_cons(FILE *log, int nc, rvec x[], rvec prime[], rvec v[],
     }
 }
 
+/*! \brief Returns the first SHAKE block of task \p th
+ *
+ * The blocks are divided over the tasks such that each task
+ * gets a contiguous range of blocks with roughly equal numbers
+ * of constraints.
+ */
+static int shake_task_block_start(int nblocks, const int sblock[],
+                                  int th, int ntask)
+{
+    int ncon3 = sblock[nblocks] - sblock[0];
+    int b     = 0;
+    while (b < nblocks &&
+           static_cast<gmx_int64_t>(sblock[b] - sblock[0])*ntask < static_cast<gmx_int64_t>(ncon3)*th)
+    {
+        b++;
+    }
+
+    return b;
+}
+
 gmx_bool bshakef(FILE *log, gmx_shakedata_t shaked,
                  real invmass[], int nblocks, int sblock[],
                  t_idef *idef, t_inputrec *ir, rvec x_s[], rvec prime[],
@@ -397,9 +438,8 @@ gmx_bool bshakef(FILE *log, gmx_shakedata_t shaked,
                  real invdt, rvec *v, gmx_bool bCalcVir, tensor vir_r_m_dr,
                  gmx_bool bDumpOnError, int econq)
 {
-    t_iatom *iatoms;
     real     dt_2, dvdl;
-    int      i, n0, ncon, blen, type, ll;
+    int      ncon, type, ll, th;
     int      tnit = 0, trij = 0;
 
 #ifdef DEBUG
@@ -413,36 +453,117 @@ gmx_bool bshakef(FILE *log, gmx_shakedata_t shaked,
         scaled_lagrange_multiplier[ll] = 0;
     }
 
-    iatoms = &(idef->il[F_CONSTR].iatoms[sblock[0]]);
-    for (i = 0; (i < nblocks); )
+    /* The SHAKE blocks do not share atoms, so we can process them
+     * in parallel. Only the virial needs to be reduced over the tasks.
+     */
+#pragma omp parallel for num_threads(shaked->ntask) schedule(static)
+    for (th = 0; th < shaked->ntask; th++)
     {
-        blen  = (sblock[i+1]-sblock[i]);
-        blen /= 3;
-        n0    = vec_shakef(log, shaked, invmass, blen, idef->iparams,
-                           iatoms, ir->shake_tol, x_s, prime, shaked->omega,
-                           ir->efep != efepNO, lambda, scaled_lagrange_multiplier, invdt, v, bCalcVir, vir_r_m_dr,
-                           econq);
+        try
+        {
+            shake_task_t *task = &shaked->task[th];
+            int           b0, b1;
+            rvec         *vir_task;
+
+            b0 = shake_task_block_start(nblocks, sblock, th, shaked->ntask);
+            b1 = shake_task_block_start(nblocks, sblock, th + 1, shaked->ntask);
+
+            task->tnit      = 0;
+            task->trij      = 0;
+            task->failBlock = -1;
+            task->failError = 0;
+            if (th == 0)
+            {
+                vir_task = vir_r_m_dr;
+            }
+            else
+            {
+                clear_mat(task->vir_r_m_dr);
+                vir_task = task->vir_r_m_dr;
+            }
+
+            for (int i = b0; i < b1 && task->failBlock < 0; i++)
+            {
+                t_iatom *iatoms;
+                int      blen, n0, nerror;
+
+                iatoms = &(idef->il[F_CONSTR].iatoms[sblock[i]]);
+                blen   = (sblock[i+1]-sblock[i]);
+                blen  /= 3;
+                n0     = vec_shakef(task, invmass, blen, idef->iparams,
+                                    iatoms, ir->shake_tol, x_s, prime, shaked->omega,
+                                    ir->efep != efepNO, lambda,
+                                    scaled_lagrange_multiplier + (sblock[i] - sblock[0])/3,
+                                    invdt, v, bCalcVir, vir_task, econq, &nerror);
 
 #ifdef DEBUGSHAKE
-        check_cons(log, blen, x_s, prime, v, idef->iparams, iatoms, invmass, econq);
+                check_cons(log, blen, x_s, prime, v, idef->iparams, iatoms, invmass, econq);
 #endif
 
-        if (n0 == 0)
+                if (n0 == 0)
+                {
+                    task->failBlock = i;
+                    task->failError = nerror;
+                }
+                task->tnit += n0*blen;
+                task->trij += blen;
+            }
+        }
+        GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
+    }
+
+    /* Report failures outside the parallel region, for the first failing
+     * block in block order, as the serial code would.
+     */
+    for (th = 0; th < shaked->ntask; th++)
+    {
+        const shake_task_t *task = &shaked->task[th];
+
+        if (task->failBlock >= 0)
         {
-            if (bDumpOnError && log)
+            t_iatom       *iatoms = &(idef->il[F_CONSTR].iatoms[sblock[task->failBlock]]);
+            int            blen   = (sblock[task->failBlock+1] - sblock[task->failBlock])/3;
+            int            error  = task->failError;
+
+            if (error == 0)
             {
+                if (log)
                 {
-                    check_cons(log, blen, x_s, prime, v, idef->iparams, iatoms, invmass, econq);
+                    fprintf(log, "Shake did not converge in %d steps\n", c_shakeMaxIterations);
                 }
+                fprintf(stderr, "Shake did not converge in %d steps\n", c_shakeMaxIterations);
             }
+            else
+            {
+                if (log)
+                {
+                    fprintf(log, "Inner product between old and new vector <= 0.0!\n"
+                            "constraint #%d atoms %d and %d\n",
+                            error-1, iatoms[3*(error-1)+1]+1, iatoms[3*(error-1)+2]+1);
+                }
+                fprintf(stderr, "Inner product between old and new vector <= 0.0!\n"
+                        "constraint #%d atoms %d and %d\n",
+                        error-1, iatoms[3*(error-1)+1]+1, iatoms[3*(error-1)+2]+1);
+            }
+            if (bDumpOnError && log)
+            {
+                check_cons(log, blen, x_s, prime, v, idef->iparams, iatoms, invmass, econq);
+            }
+
             return FALSE;
         }
-        tnit                       += n0*blen;
-        trij                       += blen;
-        iatoms                     += 3*blen; /* Increment pointer! */
-        scaled_lagrange_multiplier += blen;
-        i++;
     }
+
+    for (th = 0; th < shaked->ntask; th++)
+    {
+        if (th > 0 && bCalcVir)
+        {
+            m_add(vir_r_m_dr, shaked->task[th].vir_r_m_dr, vir_r_m_dr);
+        }
+        tnit += shaked->task[th].tnit;
+        trij += shaked->task[th].trij;
+    }
+
     /* only for position part? */
     if (econq == econqCoord)
     {
@@ -41,10 +41,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <cmath>
 #include <cstdint>
 
 #include <algorithm>
 #include <array>
+#include <vector>
 
 #include "gromacs/domdec/domdec.h"
 #include "gromacs/domdec/domdec_struct.h"
@@ -72,18 +74,59 @@
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
+/* The maximum number of previous shell displacements used for prediction */
+static const int c_shellHistoryMax = 5;
+
+/* The default extrapolation order k for the shell position predictor */
+static const int c_shellPredictOrderDefault = 2;
+
 typedef struct {
-    int     nnucl;
-    int     shell;               /* The shell id				*/
-    int     nucl1, nucl2, nucl3; /* The nuclei connected to the shell	*/
+    int         nnucl;
+    int         shell;                   /* The shell id				*/
+    int         nucl1, nucl2, nucl3;     /* The nuclei connected to the shell	*/
     /* gmx_bool    bInterCG; */       /* Coupled to nuclei outside cg?        */
-    real    k;                   /* force constant		        */
-    real    k_1;                 /* 1 over force constant		*/
-    rvec    xold;
-    rvec    fold;
-    rvec    step;
+    real        k;                       /* force constant		        */
+    real        k_1;                     /* 1 over force constant		*/
+    rvec        xold;
+    rvec        fold;
+    rvec        step;
+    int         nhist;                   /* Number of stored displacements       */
+    gmx_int64_t histStep;                /* MD step of the newest displacement   */
+    rvec        dhist[c_shellHistoryMax]; /* Converged shell-nuclei displacements, newest first */
 } t_shell;
 
+/*! \brief Work data for Anderson acceleration of the shell relaxation
+ *
+ * The fixed-point iteration x -> x + f/k, which is exact for a harmonic
+ * shell in a fixed field, is accelerated by mixing in the last \p depth
+ * iterates.
+ */
+struct ShellAnderson
+{
+    //! The maximum number of history vectors
+    int                                  depth;
+    //! The number of history vectors in use
+    int                                  nhist;
+    //! The next history vector to overwrite
+    int                                  head;
+    //! Tells whether xprev and rprev contain the previous iterate
+    bool                                 havePrevious;
+    //! Tells whether the last update was a plain, unmixed, step
+    bool                                 lastStepWasPlain;
+    //! Factor for the residual in the update, reduced when a plain step fails
+    real                                 beta;
+    //! The shell positions of the previous iterate
+    std::vector<gmx::RVec>               xprev;
+    //! The residuals of the previous iterate
+    std::vector<gmx::RVec>               rprev;
+    //! The residuals of the current iterate
+    std::vector<gmx::RVec>               rcur;
+    //! History of differences of the shell positions between iterates
+    std::vector<std::vector<gmx::RVec> > dx;
+    //! History of differences of the residuals between iterates
+    std::vector<std::vector<gmx::RVec> > dr;
+};
+
 struct gmx_shellfc_t {
     /* Shell counts, indices, parameters and working data */
     int          nshell_gl;              /* The number of shells in the system        */
@@ -95,7 +138,9 @@ struct gmx_shellfc_t {
     int          shell_nalloc;           /* The allocation size of shell              */
     gmx_bool     bPredict;               /* Predict shell positions                   */
     gmx_bool     bRequireInit;           /* Require initialization of shell positions */
+    int          predictOrder;           /* Order of history prediction, -1: off      */
     int          nflexcon;               /* The number of flexible constraints        */
+    ShellAnderson *anderson;             /* Anderson acceleration data, NULL when off */
 
     /* Temporary arrays, should be fixed size 2 when fully converted to C++ */
     PaddedRVecVector *x;                 /* Array for iterative minimization          */
@@ -240,6 +285,151 @@ static void predict_shells(FILE *fplog, rvec x[], rvec v[], real dt,
     }
 }
 
+/*! \brief The always stable predictor coefficients of Kolafa
+ *
+ * Row k contains the k+2 coefficients B_j for extrapolation order k,
+ * B_j = (-1)^(j+1) j binom(2k+4, k+2-j)/binom(2k+2, k+1).
+ * See J. Kolafa, J. Comput. Chem. 25, 335 (2004).
+ */
+static const real c_shellPredictCoeff[c_shellHistoryMax - 1][c_shellHistoryMax] = {
+    { 2.0, -1.0 },
+    { 5.0/2.0, -2.0, 1.0/2.0 },
+    { 14.0/5.0, -14.0/5.0, 6.0/5.0, -1.0/5.0 },
+    { 3.0, -24.0/7.0, 27.0/14.0, -4.0/7.0, 1.0/14.0 }
+};
+
+/*! \brief Computes the center of mass of the nuclei of shell \p s
+ *
+ * The positions of the nuclei are made whole with respect to the first
+ * nucleus when \p pbc is not NULL.
+ */
+static void shell_nuclei_center(const t_shell *s, const rvec x[], const real mass[],
+                                const t_pbc *pbc, rvec center)
+{
+    int  nucl[3] = { s->nucl1, s->nucl2, s->nucl3 };
+    real mtot    = 0;
+    rvec dsum;
+
+    clear_rvec(dsum);
+    for (int n = 0; n < s->nnucl; n++)
+    {
+        rvec dx;
+        if (pbc)
+        {
+            pbc_dx_aiuc(pbc, x[nucl[n]], x[nucl[0]], dx);
+        }
+        else
+        {
+            rvec_sub(x[nucl[n]], x[nucl[0]], dx);
+        }
+        real m = (s->nnucl == 1 ? 1 : mass[nucl[n]]);
+        for (int d = 0; d < DIM; d++)
+        {
+            dsum[d] += m*dx[d];
+        }
+        mtot += m;
+    }
+    for (int d = 0; d < DIM; d++)
+    {
+        center[d] = x[nucl[0]][d] + dsum[d]/mtot;
+    }
+}
+
+/*! \brief Returns the displacement of shell \p s from the center of its nuclei */
+static void shell_displacement(const t_shell *s, const rvec x[], const real mass[],
+                               const t_pbc *pbc, rvec dx)
+{
+    rvec center;
+
+    shell_nuclei_center(s, x, mass, pbc, center);
+    if (pbc)
+    {
+        pbc_dx_aiuc(pbc, x[s->shell], center, dx);
+    }
+    else
+    {
+        rvec_sub(x[s->shell], center, dx);
+    }
+}
+
+/*! \brief Predicts shell positions by extrapolating the shell-nuclei displacements
+ *
+ * Shells without a complete history of the previous steps keep
+ * the velocity-based prediction of predict_shells.
+ */
+static void predict_shells_history(rvec x[], int ns, const t_shell s[],
+                                   const real mass[], const t_pbc *pbc,
+                                   gmx_int64_t mdstep, int order)
+{
+    const int   nhistNeeded = order + 2;
+    const real *coeff       = c_shellPredictCoeff[order];
+
+    for (int i = 0; i < ns; i++)
+    {
+        if (s[i].nhist < nhistNeeded || s[i].histStep != mdstep - 1)
+        {
+            continue;
+        }
+
+        rvec center;
+        shell_nuclei_center(&s[i], x, mass, pbc, center);
+        for (int d = 0; d < DIM; d++)
+        {
+            real dx = 0;
+            for (int j = 0; j < nhistNeeded; j++)
+            {
+                dx += coeff[j]*s[i].dhist[j][d];
+            }
+            x[s[i].shell][d] = center[d] + dx;
+        }
+    }
+}
+
+/*! \brief Stores the converged shell-nuclei displacements of step \p mdstep */
+static void store_shell_history(const rvec x[], int ns, t_shell s[],
+                                const real mass[], const t_pbc *pbc,
+                                gmx_int64_t mdstep)
+{
+    for (int i = 0; i < ns; i++)
+    {
+        if (s[i].histStep != mdstep - 1)
+        {
+            /* The history is not contiguous, restart it */
+            s[i].nhist = 0;
+        }
+        for (int j = std::min(s[i].nhist, c_shellHistoryMax - 1); j > 0; j--)
+        {
+            copy_rvec(s[i].dhist[j - 1], s[i].dhist[j]);
+        }
+        shell_displacement(&s[i], x, mass, pbc, s[i].dhist[0]);
+        s[i].nhist    = std::min(s[i].nhist + 1, c_shellHistoryMax);
+        s[i].histStep = mdstep;
+    }
+}
+
+/*! \brief With DD, copies the shell history to the global shell array
+ *
+ * make_local_shells() copies the local shells from shell_gl at every
+ * repartitioning, so this lets shells that stay on this rank keep their
+ * history. Shells that arrive from another rank have an older histStep
+ * in shell_gl on this rank, so their history is restarted.
+ */
+static void save_shell_history_gl(const gmx_domdec_t *dd, gmx_shellfc_t *shfc)
+{
+    for (int i = 0; i < shfc->nshell; i++)
+    {
+        const t_shell *s    = &shfc->shell[i];
+        t_shell       *s_gl = &shfc->shell_gl[shfc->shell_index_gl[dd->gatindex[s->shell]]];
+
+        s_gl->nhist    = s->nhist;
+        s_gl->histStep = s->histStep;
+        for (int j = 0; j < s->nhist; j++)
+        {
+            copy_rvec(s->dhist[j], s_gl->dhist[j]);
+        }
+    }
+}
+
 /*! \brief Count the different particle types in a system
  *
  * Routine prints a warning to stderr in case an unknown particle type
@@ -538,7 +728,8 @@ gmx_shellfc_t *init_shell_flexcon(FILE *fplog,
 
     for (i = 0; (i < ns); i++)
     {
-        shell[i].k_1 = 1.0/shell[i].k;
+        shell[i].k_1   = 1.0/shell[i].k;
+        shell[i].nhist = 0;
     }
 
     if (debug)
@@ -587,6 +778,43 @@ gmx_shellfc_t *init_shell_flexcon(FILE *fplog,
         }
     }
 
+    /* Extrapolating the converged shell displacements with respect
+     * to their nuclei gives a much better initial guess than only
+     * moving the shells along with their nuclei.
+     */
+    shfc->predictOrder = -1;
+    if (shfc->bPredict)
+    {
+        shfc->predictOrder = c_shellPredictOrderDefault;
+        const char *env    = getenv("GMX_SHELL_PREDICT_ORDER");
+        if (env != nullptr)
+        {
+            shfc->predictOrder = strtol(env, nullptr, 10);
+            if (shfc->predictOrder < -1 || shfc->predictOrder > c_shellHistoryMax - 2)
+            {
+                gmx_fatal(FARGS, "GMX_SHELL_PREDICT_ORDER should be between -1 (off) and %d", c_shellHistoryMax - 2);
+            }
+        }
+        if (shfc->predictOrder >= 0 && fplog)
+        {
+            fprintf(fplog, "\nWill predict shell positions by order %d extrapolation over %d steps\n",
+                    shfc->predictOrder, shfc->predictOrder + 2);
+        }
+    }
+
+    shfc->anderson = nullptr;
+    const char *env = getenv("GMX_SHELL_ANDERSON");
+    if (env != nullptr && strtol(env, nullptr, 10) > 0)
+    {
+        shfc->anderson        = new ShellAnderson;
+        shfc->anderson->depth = strtol(env, nullptr, 10);
+        if (fplog)
+        {
+            fprintf(fplog, "\nWill relax shell positions with Anderson acceleration over %d iterates\n",
+                    shfc->anderson->depth);
+        }
+    }
+
     return shfc;
 }
 
@@ -796,6 +1024,181 @@ static void shell_pos_sd(const PaddedRVecVector * gmx_restrict xcur,
 #endif
 }
 
+/*! \brief Clears the Anderson history, sizes the buffers for \p ns shells
+ *
+ * The step factor beta is not changed, as we also reset after a failed step.
+ */
+static void shell_anderson_reset(ShellAnderson *aa, int ns)
+{
+    aa->nhist            = 0;
+    aa->head             = 0;
+    aa->havePrevious     = false;
+    aa->lastStepWasPlain = true;
+    aa->xprev.resize(ns);
+    aa->rprev.resize(ns);
+    aa->rcur.resize(ns);
+    aa->dx.resize(aa->depth);
+    aa->dr.resize(aa->depth);
+    for (int h = 0; h < aa->depth; h++)
+    {
+        aa->dx[h].resize(ns);
+        aa->dr[h].resize(ns);
+    }
+}
+
+/*! \brief Solves the n by n system a x = b by Gaussian elimination
+ *
+ * The solution is returned in b, a is overwritten.
+ * Returns false when the system is (numerically) singular.
+ */
+static bool solve_small_system(int n, std::vector<double> *a, std::vector<double> *b)
+{
+    std::vector<double> &A = *a;
+    std::vector<double> &B = *b;
+
+    for (int c = 0; c < n; c++)
+    {
+        int pivot = c;
+        for (int r = c + 1; r < n; r++)
+        {
+            if (std::abs(A[r*n + c]) > std::abs(A[pivot*n + c]))
+            {
+                pivot = r;
+            }
+        }
+        if (A[pivot*n + c] == 0)
+        {
+            return false;
+        }
+        if (pivot != c)
+        {
+            for (int k = 0; k < n; k++)
+            {
+                std::swap(A[c*n + k], A[pivot*n + k]);
+            }
+            std::swap(B[c], B[pivot]);
+        }
+        for (int r = c + 1; r < n; r++)
+        {
+            double fac = A[r*n + c]/A[c*n + c];
+            for (int k = c; k < n; k++)
+            {
+                A[r*n + k] -= fac*A[c*n + k];
+            }
+            B[r] -= fac*B[c];
+        }
+    }
+    for (int r = n - 1; r >= 0; r--)
+    {
+        for (int k = r + 1; k < n; k++)
+        {
+            B[r] -= A[r*n + k]*B[k];
+        }
+        B[r] /= A[r*n + r];
+    }
+
+    return true;
+}
+
+/*! \brief Sets new shell positions using Anderson acceleration
+ *
+ * The residual of each shell is f/k, the displacement that would zero
+ * the force on a harmonic shell in a fixed field. The new positions
+ * minimize the linearized residual over the span of the previous
+ * iterates, which is much faster than steepest descent when shells
+ * polarize each other.
+ */
+static void shell_pos_anderson(t_commrec *cr,
+                               const PaddedRVecVector *xcur,
+                               PaddedRVecVector *xnew,
+                               const PaddedRVecVector *f,
+                               int ns, const t_shell s[],
+                               ShellAnderson *aa)
+{
+    for (int i = 0; i < ns; i++)
+    {
+        svmul(s[i].k_1, (*f)[s[i].shell], aa->rcur[i]);
+    }
+
+    if (aa->havePrevious)
+    {
+        std::vector<gmx::RVec> &dx = aa->dx[aa->head];
+        std::vector<gmx::RVec> &dr = aa->dr[aa->head];
+        for (int i = 0; i < ns; i++)
+        {
+            rvec_sub((*xcur)[s[i].shell], aa->xprev[i], dx[i]);
+            rvec_sub(aa->rcur[i], aa->rprev[i], dr[i]);
+        }
+        aa->head  = (aa->head + 1) % aa->depth;
+        aa->nhist = std::min(aa->nhist + 1, aa->depth);
+    }
+    for (int i = 0; i < ns; i++)
+    {
+        copy_rvec((*xcur)[s[i].shell], aa->xprev[i]);
+        copy_rvec(aa->rcur[i], aa->rprev[i]);
+    }
+    aa->havePrevious = true;
+
+    /* Set up the normal equations dr^T dr gamma = dr^T r */
+    int                 m = aa->nhist;
+    std::vector<double> buf(m*m + m, 0.0);
+    for (int h = 0; h < m; h++)
+    {
+        for (int l = h; l < m; l++)
+        {
+            double sum = 0;
+            for (int i = 0; i < ns; i++)
+            {
+                sum += iprod(aa->dr[h][i], aa->dr[l][i]);
+            }
+            buf[h*m + l] = sum;
+        }
+        double sum = 0;
+        for (int i = 0; i < ns; i++)
+        {
+            sum += iprod(aa->dr[h][i], aa->rcur[i]);
+        }
+        buf[m*m + h] = sum;
+    }
+    if (m > 0 && PAR(cr))
+    {
+        gmx_sumd(m*m + m, buf.data(), cr);
+    }
+
+    std::vector<double> a(m*m), gamma(m);
+    for (int h = 0; h < m; h++)
+    {
+        for (int l = h; l < m; l++)
+        {
+            a[h*m + l] = buf[h*m + l];
+            a[l*m + h] = buf[h*m + l];
+        }
+        /* Weak regularization to handle nearly linearly dependent iterates */
+        a[h*m + h] *= 1 + 1e-10;
+        gamma[h]    = buf[m*m + h];
+    }
+    if (m > 0 && !solve_small_system(m, &a, &gamma))
+    {
+        std::fill(gamma.begin(), gamma.end(), 0.0);
+    }
+
+    aa->lastStepWasPlain = (m == 0);
+
+    for (int i = 0; i < ns; i++)
+    {
+        int shell = s[i].shell;
+        for (int d = 0; d < DIM; d++)
+        {
+            double x = (*xcur)[shell][d] + aa->beta*aa->rcur[i][d];
+            for (int h = 0; h < m; h++)
+            {
+                x -= gamma[h]*(aa->dx[h][i][d] + aa->beta*aa->dr[h][i][d]);
+            }
+            (*xnew)[shell][d] = x;
+        }
+    }
+}
+
 static void decrease_step_size(int nshell, t_shell s[])
 {
     int i;
@@ -1091,6 +1494,13 @@ void relax_shell_flexcon(FILE *fplog, t_commrec *cr, gmx_bool bVerbose,
         }
     }
 
+    t_pbc  pbc, *pbc_null = nullptr;
+    if (shfc->predictOrder >= 0 && inputrec->ePBC != epbcNONE)
+    {
+        set_pbc(&pbc, inputrec->ePBC, state->box);
+        pbc_null = &pbc;
+    }
+
     /* Do a prediction of the shell positions, when appropriate.
      * Without velocities (EM, NM, BD) we only do initial prediction.
      */
@@ -1098,6 +1508,11 @@ void relax_shell_flexcon(FILE *fplog, t_commrec *cr, gmx_bool bVerbose,
     {
         predict_shells(fplog, as_rvec_array(state->x.data()), as_rvec_array(state->v.data()), inputrec->delta_t, nshell, shell,
                        md->massT, nullptr, bInit);
+        if (shfc->predictOrder >= 0 && !bInit)
+        {
+            predict_shells_history(as_rvec_array(state->x.data()), nshell, shell,
+                                   md->massT, pbc_null, mdstep, shfc->predictOrder);
+        }
     }
 
     /* do_force expected the charge groups to be in the box */
@@ -1178,6 +1593,13 @@ void relax_shell_flexcon(FILE *fplog, t_commrec *cr, gmx_bool bVerbose,
      */
     bConverged = (df[Min] < ftol);
 
+    bool useAnderson = (shfc->anderson != nullptr && nflexcon == 0);
+    if (useAnderson)
+    {
+        shell_anderson_reset(shfc->anderson, nshell);
+        shfc->anderson->beta = 1;
+    }
+
     for (count = 1; (!(bConverged) && (count < number_steps)); count++)
     {
         if (vsite)
@@ -1198,8 +1620,16 @@ void relax_shell_flexcon(FILE *fplog, t_commrec *cr, gmx_bool bVerbose,
             directional_sd(pos[Min], pos[Try], acc_dir, end, fr->fc_stepsize);
         }
 
-        /* New positions, Steepest descent */
-        shell_pos_sd(pos[Min], pos[Try], force[Min], nshell, shell, count);
+        if (useAnderson)
+        {
+            shell_pos_anderson(cr, pos[Min], pos[Try], force[Min], nshell, shell,
+                               shfc->anderson);
+        }
+        else
+        {
+            /* New positions, Steepest descent */
+            shell_pos_sd(pos[Min], pos[Try], force[Min], nshell, shell, count);
+        }
 
         /* do_force expected the charge groups to be in the box */
         if (graph)
@@ -1288,6 +1718,19 @@ void relax_shell_flexcon(FILE *fplog, t_commrec *cr, gmx_bool bVerbose,
             }
             Min  = Try;
         }
+        else if (useAnderson)
+        {
+            /* The step did not reduce the force. Keep the best iterate
+             * and restart the history from it, which gives a plain
+             * fixed-point step next. When a plain step failed,
+             * the next one is damped.
+             */
+            if (shfc->anderson->lastStepWasPlain)
+            {
+                shfc->anderson->beta *= 0.5;
+            }
+            shell_anderson_reset(shfc->anderson, nshell);
+        }
         else
         {
             decrease_step_size(nshell, shell);
@@ -1315,6 +1758,16 @@ void relax_shell_flexcon(FILE *fplog, t_commrec *cr, gmx_bool bVerbose,
     /* Copy back the coordinates and the forces */
     state->x = *pos[Min];
     *f       = *force[Min];
+
+    if (shfc->predictOrder >= 0 && EI_STATE_VELOCITY(inputrec->eI))
+    {
+        store_shell_history(as_rvec_array(state->x.data()), nshell, shell,
+                            md->massT, pbc_null, mdstep);
+        if (DOMAINDECOMP(cr))
+        {
+            save_shell_history_gl(cr->dd, shfc);
+        }
+    }
 }
 
 void done_shellfc(FILE *fplog, gmx_shellfc_t *shfc, gmx_int64_t numSteps)
@@ -36,11 +36,20 @@
 
 #include <assert.h>
 
+#include <cmath>
+
 #include <vector>
 
 #include <gtest/gtest.h>
 
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/vec.h"
 #include "gromacs/mdlib/constr.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/md_enums.h"
+#include "gromacs/topology/idef.h"
+#include "gromacs/topology/ifunc.h"
 
 #include "testutils/refdata.h"
 #include "testutils/testasserts.h"
@@ -343,4 +352,143 @@ TEST_F(ShakeTest, ConstrainsThreeBondsWithCommonAtoms)
     runTest(numAtoms, numConstraints, iatom, constrainedDistances, inverseMasses, positions);
 }
 
+/*! \brief Result of constraining a system of blocks with bshakef() */
+struct ShakeBlocksResult
+{
+    //! Whether SHAKE succeeded
+    gmx_bool          bOK;
+    //! The constrained positions
+    std::vector<real> positions;
+    //! The corrected velocities
+    std::vector<real> velocities;
+    //! The Lagrange multipliers
+    std::vector<real> lagrangeMultipliers;
+    //! The constraint virial
+    tensor            virial;
+};
+
+/*! \brief Constrains \p numMolecules bent triatomic molecules with \p numTasks SHAKE tasks
+ *
+ * Each molecule has two constraints with a common atom and forms
+ * its own SHAKE block. When \p flippedMolecule >= 0, the first bond
+ * of that molecule is flipped in the unconstrained positions,
+ * which SHAKE can not handle.
+ */
+ShakeBlocksResult shakeBlocks(int numMolecules, int numTasks, int flippedMolecule = -1)
+{
+    const int         atomsPerMolecule       = 3;
+    const int         constraintsPerMolecule = 2;
+    const real        bondLength             = 0.1;
+    const real        dt                     = 0.002;
+
+    t_iparams         iparams;
+    iparams.constr.dA = bondLength;
+    iparams.constr.dB = bondLength;
+
+    std::vector<int>  iatoms;
+    std::vector<int>  sblock;
+    std::vector<real> x, xprime, v, invmass;
+    for (int m = 0; m < numMolecules; m++)
+    {
+        sblock.push_back(iatoms.size());
+        for (int c = 0; c < constraintsPerMolecule; c++)
+        {
+            iatoms.push_back(0);
+            iatoms.push_back(m*atomsPerMolecule + c);
+            iatoms.push_back(m*atomsPerMolecule + c + 1);
+        }
+        for (int a = 0; a < atomsPerMolecule; a++)
+        {
+            /* A bent molecule at its reference geometry */
+            real ref[DIM] = { m*0.5f + a*bondLength*std::cos(0.5f*a), 0.1f*m, a == 1 ? bondLength*std::sin(0.5f) : 0 };
+            for (int d = 0; d < DIM; d++)
+            {
+                x.push_back(ref[d]);
+                /* A deterministic displacement of a few percent of the bond length */
+                xprime.push_back(ref[d] + 0.004*std::sin(1.3*(3*(m*atomsPerMolecule + a) + d)));
+                v.push_back(std::cos(0.7*(3*(m*atomsPerMolecule + a) + d)));
+            }
+            invmass.push_back(1/(a == 1 ? 16.0 : 1.0 + m));
+        }
+    }
+    sblock.push_back(iatoms.size());
+    if (flippedMolecule >= 0)
+    {
+        int a0 = flippedMolecule*atomsPerMolecule;
+        for (int d = 0; d < DIM; d++)
+        {
+            xprime[a0*DIM + d] = 2*x[(a0 + 1)*DIM + d] - x[a0*DIM + d];
+        }
+    }
+
+    t_idef idef = {};
+    idef.iparams               = &iparams;
+    idef.il[F_CONSTR].nr       = iatoms.size();
+    idef.il[F_CONSTR].iatoms   = iatoms.data();
+
+    t_inputrec ir;
+    ir.shake_tol = 1e-6;
+    ir.efep      = efepNO;
+    ir.delta_t   = dt;
+
+    t_nrnb     nrnb;
+    init_nrnb(&nrnb);
+
+    /* SHAKE uses as many tasks as there are threads for LINCS */
+    int               numThreadsSaved = gmx_omp_nthreads_get(emntLINCS);
+    gmx_omp_nthreads_set(emntLINCS, numTasks);
+    gmx_shakedata_t   shaked = shake_init();
+    gmx_omp_nthreads_set(emntLINCS, numThreadsSaved);
+
+    ShakeBlocksResult result;
+    result.positions  = xprime;
+    result.velocities = v;
+    result.lagrangeMultipliers.resize(numMolecules*constraintsPerMolecule);
+    clear_mat(result.virial);
+    real              dvdlambda = 0;
+    result.bOK        = bshakef(nullptr, shaked, invmass.data(), numMolecules, sblock.data(),
+                                &idef, &ir,
+                                reinterpret_cast<rvec *>(x.data()),
+                                reinterpret_cast<rvec *>(result.positions.data()),
+                                &nrnb, result.lagrangeMultipliers.data(), 0, &dvdlambda,
+                                1/dt, reinterpret_cast<rvec *>(result.velocities.data()),
+                                TRUE, result.virial, FALSE, econqCoord);
+
+    return result;
+}
+
+TEST(ShakeBlocksTest, MultipleTasksGiveTheSerialResult)
+{
+    const int         numMolecules = 11;
+
+    ShakeBlocksResult serial       = shakeBlocks(numMolecules, 1);
+    ShakeBlocksResult parallel     = shakeBlocks(numMolecules, 4);
+
+    ASSERT_TRUE(serial.bOK);
+    ASSERT_TRUE(parallel.bOK);
+    /* The blocks are independent, so only the virial reduction differs */
+    EXPECT_EQ(serial.positions, parallel.positions);
+    EXPECT_EQ(serial.velocities, parallel.velocities);
+    EXPECT_EQ(serial.lagrangeMultipliers, parallel.lagrangeMultipliers);
+    for (int d1 = 0; d1 < DIM; d1++)
+    {
+        for (int d2 = 0; d2 < DIM; d2++)
+        {
+            EXPECT_REAL_EQ_TOL(serial.virial[d1][d2], parallel.virial[d1][d2],
+                               gmx::test::relativeToleranceAsFloatingPoint(1, 10*GMX_REAL_EPS));
+        }
+    }
+    /* Check that SHAKE did some work */
+    EXPECT_NE(0, serial.virial[XX][XX]);
+}
+
+TEST(ShakeBlocksTest, FailureInAnyTaskIsReported)
+{
+    const int numMolecules = 11;
+
+    EXPECT_FALSE(shakeBlocks(numMolecules, 1, 8).bOK);
+    EXPECT_FALSE(shakeBlocks(numMolecules, 4, 8).bOK);
+    EXPECT_FALSE(shakeBlocks(numMolecules, 4, 0).bOK);
+}
+
 } // namespace
@@ -0,0 +1,379 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider code quality and stability a valuable goal for you.
+ *
+ * Contact: gromacs@gromacs.org
+ * Visit: http://www.gromacs.org
+ */
+/*! \internal \file
+ * \brief
+ * Tests for virtual site construction and force spreading.
+ *
+ * The SIMD kernels and the color-scheduled threading of dependent
+ * vsites are compared with the serial plain-C code.
+ *
+ * \ingroup module_mdlib
+ */
+#include "gmxpre.h"
+
+#include "gromacs/mdlib/vsite.h"
+
+#include <cmath>
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/gmxlib/nrnb.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdlib/gmx_omp_nthreads.h"
+#include "gromacs/mdtypes/commrec.h"
+#include "gromacs/mdtypes/mdatom.h"
+#include "gromacs/pbcutil/ishift.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/topology/ifunc.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/unique_cptr.h"
+
+#include "testutils/testasserts.h"
+
+namespace gmx
+{
+
+namespace test
+{
+
+namespace
+{
+
+//! Number of atoms in the test molecule
+const int c_numAtomsPerMolecule = 9;
+
+/*! \brief Test fixture for vsite construction and spreading
+ *
+ * The test molecule has four real atoms, one vsite of each type
+ * with a SIMD kernel, and a vsite of a later type without SIMD kernel
+ * constructed from a vsite.
+ * Parameters are the number of molecules and whether PBC is used.
+ */
+class VsiteTest : public ::testing::TestWithParam<std::tuple<int, bool> >
+{
+    public:
+        VsiteTest() : numMolecules_(std::get<0>(GetParam())),
+                      usePbc_(std::get<1>(GetParam())),
+                      numAtoms_(numMolecules_*c_numAtomsPerMolecule)
+        {
+            /* Setting up the iparams */
+            iparams_.resize(5);
+            iparams_[0].vsite.a = 0.3;
+            iparams_[0].vsite.b = 0.2;
+            iparams_[1].vsite.a = 0.4;
+            iparams_[1].vsite.b = 0.07;
+            iparams_[2].vsite.a = 0.2;
+            iparams_[2].vsite.b = 0.3;
+            iparams_[2].vsite.c = 2.5;
+            iparams_[3].vsite.a = 0.8;
+            iparams_[3].vsite.b = 0.9;
+            iparams_[3].vsite.c = 0.05;
+            iparams_[4].vsite.a = 0.3;
+            iparams_[4].vsite.b = 0.4;
+            iparams_[4].vsite.c = 0.05;
+
+            /* The molecule and the local topology of all molecules */
+            addVsite(moleculeIatoms_, F_VSITE3,    0, { 4, 0, 1, 2 });
+            addVsite(moleculeIatoms_, F_VSITE3FD,  1, { 5, 0, 1, 2 });
+            addVsite(moleculeIatoms_, F_VSITE3OUT, 2, { 6, 0, 1, 2 });
+            addVsite(moleculeIatoms_, F_VSITE4FDN, 3, { 7, 0, 1, 2, 3 });
+            addVsite(moleculeIatoms_, F_VSITE4FD,  4, { 8, 4, 1, 2, 3 });
+            for (int m = 0; m < numMolecules_; m++)
+            {
+                for (int ftype = 0; ftype < F_NRE; ftype++)
+                {
+                    const std::vector<int> &molIatoms = moleculeIatoms_[ftype];
+                    for (size_t i = 0; i < molIatoms.size(); i += 1 + NRAL(ftype))
+                    {
+                        localIatoms_[ftype].push_back(molIatoms[i]);
+                        for (int a = 1; a <= NRAL(ftype); a++)
+                        {
+                            localIatoms_[ftype].push_back(m*c_numAtomsPerMolecule + molIatoms[i + a]);
+                        }
+                    }
+                }
+            }
+            for (int ftype = 0; ftype < F_NRE; ftype++)
+            {
+                idef_.il[ftype].nr     = localIatoms_[ftype].size();
+                idef_.il[ftype].iatoms = localIatoms_[ftype].data();
+            }
+            idef_.iparams = iparams_.data();
+
+            /* Every atom is a charge group, so vsites follow their own PBC */
+            cgsIndex_.resize(c_numAtomsPerMolecule + 1);
+            for (int a = 0; a <= c_numAtomsPerMolecule; a++)
+            {
+                cgsIndex_[a] = a;
+            }
+
+            for (int m = 0; m < numMolecules_; m++)
+            {
+                for (int a = 0; a < c_numAtomsPerMolecule; a++)
+                {
+                    ptype_.push_back(a < 4 ? eptAtom : eptVSite);
+                }
+            }
+            mdatoms_.nr     = numAtoms_;
+            mdatoms_.homenr = numAtoms_;
+            mdatoms_.ptype  = ptype_.data();
+
+            clear_mat(box_);
+            box_[XX][XX] = 1.9;
+            box_[YY][YY] = 2.1;
+            box_[ZZ][ZZ] = 2.0;
+
+            /* Deterministic, irregular molecule geometries and positions */
+            x_.resize(numAtoms_);
+            for (int m = 0; m < numMolecules_; m++)
+            {
+                rvec center = {
+                    real(std::fmod(0.37*m, 1.0)*box_[XX][XX]),
+                    real(std::fmod(0.61*m, 1.0)*box_[YY][YY]),
+                    real(std::fmod(0.23*m, 1.0)*box_[ZZ][ZZ])
+                };
+                const real delta[4][DIM] = {
+                    { 0, 0, 0 }, { 0.1, 0, 0 }, { 0, 0.1, 0 }, { 0, 0, 0.1 }
+                };
+                for (int a = 0; a < c_numAtomsPerMolecule; a++)
+                {
+                    RVec &xa = x_[m*c_numAtomsPerMolecule + a];
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        xa[d] = center[d] + (a < 4 ? delta[a][d] : 0) + 0.01*std::sin(m + 3*a + 5*d);
+                    }
+                    if (usePbc_)
+                    {
+                        /* Put each atom in the box, which breaks molecules */
+                        for (int d = 0; d < DIM; d++)
+                        {
+                            xa[d] = xa[d] - box_[d][d]*std::floor(xa[d]/box_[d][d]);
+                        }
+                    }
+                }
+            }
+        }
+
+        //! Adds a vsite of type \p ftype with parameters \p type and \p atoms to \p iatoms
+        static void addVsite(std::vector<int> *iatoms, int ftype, int type,
+                             const std::vector<int> &atoms)
+        {
+            iatoms[ftype].push_back(type);
+            iatoms[ftype].insert(iatoms[ftype].end(), atoms.begin(), atoms.end());
+        }
+
+        /*! \brief Returns the vsite setup with \p numThreads threads
+         *
+         * With \p useSimd false, the plain-C construction is used.
+         * The returned object is not freed, as vsite.h has no function for that.
+         */
+        gmx_vsite_t *makeVsite(int numThreads, bool useSimd)
+        {
+            gmx_mtop_t                   *mtop;
+            snew(mtop, 1);
+            const unique_cptr<gmx_mtop_t> mtopGuard(mtop);
+            mtop->natoms    = numAtoms_;
+            mtop->nmoltype  = 1;
+            snew(mtop->moltype, mtop->nmoltype);
+            const unique_cptr<gmx_moltype_t> moltypeGuard(mtop->moltype);
+            mtop->nmolblock = 1;
+            snew(mtop->molblock, mtop->nmolblock);
+            const unique_cptr<gmx_molblock_t> molblockGuard(mtop->molblock);
+            mtop->molblock[0].type = 0;
+            mtop->molblock[0].nmol = numMolecules_;
+            gmx_moltype_t *molt    = &mtop->moltype[0];
+            molt->cgs.nr           = c_numAtomsPerMolecule;
+            molt->cgs.index        = cgsIndex_.data();
+            molt->atoms.nr         = c_numAtomsPerMolecule;
+            for (int ftype = 0; ftype < F_NRE; ftype++)
+            {
+                molt->ilist[ftype].nr     = moleculeIatoms_[ftype].size();
+                molt->ilist[ftype].iatoms = moleculeIatoms_[ftype].data();
+            }
+
+            t_commrec cr = {};
+            gmx_omp_nthreads_set(emntVSITE, numThreads);
+            gmx_vsite_t *vsite = init_vsite(mtop, &cr, FALSE);
+            split_vsites_over_threads(idef_.il, idef_.iparams, &mdatoms_, TRUE, vsite);
+            if (!useSimd)
+            {
+                vsite->simdConstructMask = 0;
+            }
+
+            return vsite;
+        }
+
+        //! Constructs the vsites in \p x using \p vsite
+        void construct(const gmx_vsite_t *vsite, std::vector<RVec> *x)
+        {
+            t_commrec cr = {};
+            construct_vsites(vsite, as_rvec_array(x->data()), 0.002, nullptr,
+                             idef_.iparams, idef_.il,
+                             usePbc_ ? epbcXYZ : epbcNONE, TRUE, &cr, box_);
+        }
+
+        //! Spreads the forces \p f using \p vsite, returns the virial correction in \p vir
+        void spread(const gmx_vsite_t *vsite, std::vector<RVec> *f,
+                    std::vector<RVec> *fshift, matrix vir)
+        {
+            t_commrec cr = {};
+            t_nrnb    nrnb;
+            init_nrnb(&nrnb);
+            clear_mat(vir);
+            spread_vsite_f(vsite, as_rvec_array(x_.data()),
+                           as_rvec_array(f->data()), as_rvec_array(fshift->data()),
+                           TRUE, vir, &nrnb, &idef_,
+                           usePbc_ ? epbcXYZ : epbcNONE, TRUE, nullptr, box_, &cr);
+        }
+
+        //! Number of molecules
+        int                         numMolecules_;
+        //! Whether to use PBC
+        bool                        usePbc_;
+        //! Total number of atoms
+        int                         numAtoms_;
+        //! The interaction parameters
+        std::vector<t_iparams>      iparams_;
+        //! The vsite interactions of the molecule
+        std::vector<int>            moleculeIatoms_[F_NRE];
+        //! The vsite interactions of all molecules
+        std::vector<int>            localIatoms_[F_NRE];
+        //! Local interaction definitions, pointing to localIatoms_
+        t_idef                      idef_ = {};
+        //! Charge group index of the molecule
+        std::vector<int>            cgsIndex_;
+        //! Particle types
+        std::vector<unsigned short> ptype_;
+        //! Atom data used for splitting over threads
+        t_mdatoms                   mdatoms_ = {};
+        //! The box
+        matrix                      box_;
+        //! The coordinates, without padding
+        std::vector<RVec>           x_;
+};
+
+TEST_P(VsiteTest, ConstructionMatchesPlainC)
+{
+    gmx_vsite_t      *vsiteRef = makeVsite(1, false);
+    std::vector<RVec> xRef(x_);
+    construct(vsiteRef, &xRef);
+
+    const int         numThreads[] = { 1, 4 };
+    for (int nt : numThreads)
+    {
+        gmx_vsite_t      *vsite = makeVsite(nt, true);
+#if GMX_SIMD_HAVE_REAL
+        EXPECT_NE(0, vsite->simdConstructMask);
+#endif
+        if (nt > 1)
+        {
+            EXPECT_GT(vsite->ncolor, 0) << "The dependent vsites should need colors";
+        }
+        std::vector<RVec> x(x_);
+        construct(vsite, &x);
+
+        FloatingPointTolerance tolerance(relativeToleranceAsFloatingPoint(1.0, 1e-5));
+        for (int a = 0; a < numAtoms_; a++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                EXPECT_REAL_EQ_TOL(xRef[a][d], x[a][d], tolerance)
+                << "atom " << a << " dim " << d << " with " << nt << " threads";
+            }
+        }
+    }
+}
+
+TEST_P(VsiteTest, SpreadingMatchesSerial)
+{
+    /* Spread with constructed vsites, as in MD */
+    gmx_vsite_t *vsiteRef = makeVsite(1, false);
+    construct(vsiteRef, &x_);
+
+    std::vector<RVec> fInput(numAtoms_);
+    for (int a = 0; a < numAtoms_; a++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            fInput[a][d] = 10*std::cos(a + 7*d);
+        }
+    }
+
+    std::vector<RVec> fRef(fInput), fshiftRef(SHIFTS, {0, 0, 0});
+    matrix            virRef;
+    spread(vsiteRef, &fRef, &fshiftRef, virRef);
+
+    gmx_vsite_t      *vsite = makeVsite(4, true);
+    EXPECT_GT(vsite->ncolor, 0) << "The dependent vsites should need colors";
+    std::vector<RVec> f(fInput), fshift(SHIFTS, {0, 0, 0});
+    matrix            vir;
+    spread(vsite, &f, &fshift, vir);
+
+    FloatingPointTolerance tolerance(relativeToleranceAsFloatingPoint(10.0, 1e-5));
+    for (int a = 0; a < numAtoms_; a++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(fRef[a][d], f[a][d], tolerance) << "atom " << a << " dim " << d;
+        }
+    }
+    for (int i = 0; i < SHIFTS; i++)
+    {
+        for (int d = 0; d < DIM; d++)
+        {
+            EXPECT_REAL_EQ_TOL(fshiftRef[i][d], fshift[i][d], tolerance) << "shift " << i << " dim " << d;
+        }
+    }
+    for (int d1 = 0; d1 < DIM; d1++)
+    {
+        for (int d2 = 0; d2 < DIM; d2++)
+        {
+            EXPECT_REAL_EQ_TOL(virRef[d1][d2], vir[d1][d2], tolerance) << "virial " << d1 << " " << d2;
+        }
+    }
+}
+
+/* 13 molecules do not fill the last SIMD batch for any SIMD width */
+INSTANTIATE_TEST_CASE_P(WithMoleculeCountsAndPbc, VsiteTest,
+                            ::testing::Combine(::testing::Values(1, 13),
+                                                   ::testing::Bool()));
+
+} // namespace
+
+} // namespace test
+
+} // namespace gmx
@@ -154,6 +154,8 @@ void init_ekindata(FILE gmx_unused *log, gmx_mtop_t *mtop, t_grpopts *opts,
         GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
 
+    ekind->bEkinhWorkSet = FALSE;
+
     ekind->ngacc = opts->ngacc;
     snew(ekind->grpstat, opts->ngacc);
     init_grpstat(mtop, opts->ngacc, ekind->grpstat);
@@ -97,10 +97,22 @@ do_md_trajectory_writing(FILE             *fplog,
     {
         mdof_flags |= MDOF_X_COMPRESSED;
     }
+    for (int s = 0; s < ir->n_x_streams; s++)
+    {
+        if (do_per_step(step, ir->x_streams[s].nstxout))
+        {
+            mdof_flags |= MDOF_X_STREAMS;
+        }
+    }
     if (bCPT)
     {
         mdof_flags |= MDOF_CPT;
     }
+    if (bLastStep && step_rel == ir->nsteps && bDoConfOut && !bRerunMD)
+    {
+        /* A checkpoint written in parts does not collect x and v */
+        mdof_flags |= MDOF_CONFOUT;
+    }
     ;
 
 #if defined(GMX_FAHCORE)
@@ -174,8 +186,7 @@ do_md_trajectory_writing(FILE             *fplog,
             }
 
             /* x and v have been collected in mdoutf_write_to_trajectory_files,
-             * because a checkpoint file will always be written
-             * at the last step.
+             * because of MDOF_CONFOUT.
              */
             fprintf(stderr, "\nWriting final coordinates.\n");
             if (fr->bMolPBC)
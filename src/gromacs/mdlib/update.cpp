@@ -925,12 +925,69 @@ static void dump_it_all(FILE gmx_unused *fp, const char gmx_unused *title,
 #endif
 }
 
+/*! \brief Accumulates the kinetic energy of atoms \p start_t to \p end_t
+ * in the work buffers of \p thread */
+static void calc_ke_part_thread(const rvec v[], const t_grpopts *opts,
+                                const t_mdatoms *md, gmx_ekindata_t *ekind,
+                                int thread, int start_t, int end_t)
+{
+    const t_grp_acc *grpstat = ekind->grpstat;
+    int              n;
+    int              ga, gt;
+    rvec             v_corrt;
+    real             hm;
+    int              d, m;
+    matrix          *ekin_sum;
+    real            *dekindl_sum;
+
+    ekin_sum    = ekind->ekin_work[thread];
+    dekindl_sum = ekind->dekindl_work[thread];
+
+    for (gt = 0; gt < opts->ngtc; gt++)
+    {
+        clear_mat(ekin_sum[gt]);
+    }
+    *dekindl_sum = 0.0;
+
+    ga = 0;
+    gt = 0;
+    for (n = start_t; n < end_t; n++)
+    {
+        if (md->cACC)
+        {
+            ga = md->cACC[n];
+        }
+        if (md->cTC)
+        {
+            gt = md->cTC[n];
+        }
+        hm   = 0.5*md->massT[n];
+
+        for (d = 0; (d < DIM); d++)
+        {
+            v_corrt[d]  = v[n][d]  - grpstat[ga].u[d];
+        }
+        for (d = 0; (d < DIM); d++)
+        {
+            for (m = 0; (m < DIM); m++)
+            {
+                /* if we're computing a full step velocity, v_corrt[d] has v(t).  Otherwise, v(t+dt/2) */
+                ekin_sum[gt][m][d] += hm*v_corrt[m]*v_corrt[d];
+            }
+        }
+        if (md->nMassPerturbed && md->bPerturbed[n])
+        {
+            *dekindl_sum +=
+                0.5*(md->massB[n] - md->massA[n])*iprod(v_corrt, v_corrt);
+        }
+    }
+}
+
 static void calc_ke_part_normal(rvec v[], t_grpopts *opts, t_mdatoms *md,
                                 gmx_ekindata_t *ekind, t_nrnb *nrnb, gmx_bool bEkinAveVel)
 {
     int           g;
     t_grp_tcstat *tcstat  = ekind->tcstat;
-    t_grp_acc    *grpstat = ekind->grpstat;
     int           nthread, thread;
 
     /* three main: VV with AveVel, vv with AveEkin, leap with AveEkin.  Leap with AveVel is also
@@ -958,65 +1015,26 @@ static void calc_ke_part_normal(rvec v[], t_grpopts *opts, t_mdatoms *md,
     ekind->dekindl_old = ekind->dekindl;
     nthread            = gmx_omp_nthreads_get(emntUpdate);
 
-#pragma omp parallel for num_threads(nthread) schedule(static)
-    for (thread = 0; thread < nthread; thread++)
+    /* With leap-frog the update can already have accumulated the half-step
+     * kinetic energy into the work buffers, while v was in cache.
+     */
+    if (!(ekind->bEkinhWorkSet && !bEkinAveVel))
     {
-        // This OpenMP only loops over arrays and does not call any functions
-        // or memory allocation. It should not be able to throw, so for now
-        // we do not need a try/catch wrapper.
-        int     start_t, end_t, n;
-        int     ga, gt;
-        rvec    v_corrt;
-        real    hm;
-        int     d, m;
-        matrix *ekin_sum;
-        real   *dekindl_sum;
-
-        start_t = ((thread+0)*md->homenr)/nthread;
-        end_t   = ((thread+1)*md->homenr)/nthread;
-
-        ekin_sum    = ekind->ekin_work[thread];
-        dekindl_sum = ekind->dekindl_work[thread];
-
-        for (gt = 0; gt < opts->ngtc; gt++)
+#pragma omp parallel for num_threads(nthread) schedule(static)
+        for (thread = 0; thread < nthread; thread++)
         {
-            clear_mat(ekin_sum[gt]);
-        }
-        *dekindl_sum = 0.0;
+            // This OpenMP only loops over arrays and does not call any functions
+            // or memory allocation. It should not be able to throw, so for now
+            // we do not need a try/catch wrapper.
+            int start_t, end_t;
 
-        ga = 0;
-        gt = 0;
-        for (n = start_t; n < end_t; n++)
-        {
-            if (md->cACC)
-            {
-                ga = md->cACC[n];
-            }
-            if (md->cTC)
-            {
-                gt = md->cTC[n];
-            }
-            hm   = 0.5*md->massT[n];
+            start_t = ((thread+0)*md->homenr)/nthread;
+            end_t   = ((thread+1)*md->homenr)/nthread;
 
-            for (d = 0; (d < DIM); d++)
-            {
-                v_corrt[d]  = v[n][d]  - grpstat[ga].u[d];
-            }
-            for (d = 0; (d < DIM); d++)
-            {
-                for (m = 0; (m < DIM); m++)
-                {
-                    /* if we're computing a full step velocity, v_corrt[d] has v(t).  Otherwise, v(t+dt/2) */
-                    ekin_sum[gt][m][d] += hm*v_corrt[m]*v_corrt[d];
-                }
-            }
-            if (md->nMassPerturbed && md->bPerturbed[n])
-            {
-                *dekindl_sum +=
-                    0.5*(md->massB[n] - md->massA[n])*iprod(v_corrt, v_corrt);
-            }
+            calc_ke_part_thread(v, opts, md, ekind, thread, start_t, end_t);
         }
     }
+    ekind->bEkinhWorkSet = FALSE;
 
     ekind->dekindl = 0;
     for (thread = 0; thread < nthread; thread++)
@@ -1260,12 +1278,7 @@ static void deform(gmx_update_t *upd,
     copy_mat(bnew, box);
     mmul_ur0(box, invbox, mu);
 
-    for (i = start; i < start+homenr; i++)
-    {
-        x[i][XX] = mu[XX][XX]*x[i][XX]+mu[YY][XX]*x[i][YY]+mu[ZZ][XX]*x[i][ZZ];
-        x[i][YY] = mu[YY][YY]*x[i][YY]+mu[ZZ][YY]*x[i][ZZ];
-        x[i][ZZ] = mu[ZZ][ZZ]*x[i][ZZ];
-    }
+    scale_coordinates_ur0(mu, start, homenr, x, nullptr, nullptr);
 }
 
 void update_tcouple(gmx_int64_t       step,
@@ -1360,7 +1373,9 @@ void update_constraints(FILE             *fplog,
                         gmx_update_t     *upd,
                         gmx_constr_t      constr,
                         gmx_bool          bFirstHalf,
-                        gmx_bool          bCalcVir)
+                        gmx_bool          bCalcVir,
+                        gmx_ekindata_t   *ekind,
+                        gmx_bool          bCalcEkinh)
 {
     gmx_bool             bLastStep, bLog = FALSE, bEner = FALSE, bDoConstr = FALSE;
     tensor               vir_con;
@@ -1497,6 +1512,15 @@ void update_constraints(FILE             *fplog,
         }
     }
 
+    /* We can accumulate the half-step kinetic energy in the same pass
+     * as the final copy of the coordinates, when the velocities are final
+     * and the plain kinetic energy calculation is used.
+     */
+    bool bFuseEkinh = (bCalcEkinh && !bFirstHalf && !EI_VV(inputrec->eI) &&
+                       !ekind->bNEMD && ekind->cosacc.cos_accel == 0 &&
+                       !(graph && (graph->nnodes > 0)));
+    ekind->bEkinhWorkSet = FALSE;
+
     /* We must always unshift after updating coordinates; if we did not shake
        x was shifted in do_force */
 
@@ -1565,11 +1589,37 @@ void update_constraints(FILE             *fplog,
             // cppcheck-suppress unreadVariable
             nth = gmx_omp_nthreads_get(emntUpdate);
 #endif
+            if (bFuseEkinh)
+            {
+                const rvec *v = as_rvec_array(state->v.data());
+
+                /* Use the same atom division over the threads as
+                 * calc_ke_part, so each thread fills its own work buffer.
+                 */
 #pragma omp parallel for num_threads(nth) schedule(static)
-            for (int i = start; i < nrend; i++)
+                for (th = 0; th < nth; th++)
+                {
+                    // This only loops over arrays, it does not throw
+                    int start_th = start + ((nrend - start)* th     )/nth;
+                    int end_th   = start + ((nrend - start)*(th + 1))/nth;
+
+                    for (int i = start_th; i < end_th; i++)
+                    {
+                        copy_rvec(xp[i], state->x[i]);
+                    }
+                    calc_ke_part_thread(v, &inputrec->opts, md, ekind,
+                                        th, start_th, end_th);
+                }
+                ekind->bEkinhWorkSet = TRUE;
+            }
+            else
             {
-                // Trivial statement, does not throw
-                copy_rvec(xp[i], state->x[i]);
+#pragma omp parallel for num_threads(nth) schedule(static)
+                for (int i = start; i < nrend; i++)
+                {
+                    // Trivial statement, does not throw
+                    copy_rvec(xp[i], state->x[i]);
+                }
             }
         }
         wallcycle_stop(wcycle, ewcUPDATE);
@@ -1633,10 +1683,9 @@ void update_pcouple_after_coordinates(FILE             *fplog,
                 preserve_box_shape(inputrec, state->box_rel, state->box);
 
                 /* Scale the coordinates */
-                for (int n = start; n < start + homenr; n++)
-                {
-                    tmvmul_ur0(parrinellorahmanMu, state->x[n], state->x[n]);
-                }
+                scale_coordinates_ur0(parrinellorahmanMu, start, homenr,
+                                      as_rvec_array(state->x.data()),
+                                      nullptr, nullptr);
             }
             break;
         case (epcMTTK):
@@ -146,7 +146,13 @@ void update_constraints(FILE              *fplog,
                         gmx_update_t      *upd,
                         gmx_constr        *constr,
                         gmx_bool           bFirstHalf,
-                        gmx_bool           bCalcVir);
+                        gmx_bool           bCalcVir,
+                        gmx_ekindata_t    *ekind,
+                        gmx_bool           bCalcEkinh);
+/* When bCalcEkinh is set, the half-step kinetic energy is accumulated
+ * while copying the final coordinates, when possible. calc_ke_part then
+ * only needs to reduce the thread contributions.
+ */
 
 /* Return TRUE if OK, FALSE in case of Shake Error */
 
@@ -233,6 +239,14 @@ void berendsen_pcoupl(FILE *fplog, gmx_int64_t step,
                       const tensor pres, const matrix box,
                       matrix mu);
 
+void scale_coordinates_ur0(const matrix mu,
+                           int start, int nr_atoms, rvec x[],
+                           const ivec *nFreeze, const unsigned short cFREEZE[]);
+/* Scales x[start] to x[start+nr_atoms-1] by the transpose of
+ * the upper-triangular matrix mu, as tmvmul_ur0, using the update
+ * OpenMP threads. Dimensions frozen in nFreeze are not scaled,
+ * nFreeze can be NULL.
+ */
 
 void berendsen_pscale(const t_inputrec *ir, const matrix mu,
                       matrix box, matrix box_rel,
@@ -54,6 +54,10 @@
 #include "gromacs/pbcutil/ishift.h"
 #include "gromacs/pbcutil/mshift.h"
 #include "gromacs/pbcutil/pbc.h"
+#include "gromacs/pbcutil/pbc-simd.h"
+#include "gromacs/simd/simd.h"
+#include "gromacs/simd/simd_math.h"
+#include "gromacs/simd/vector_operations.h"
 #include "gromacs/topology/mtop_util.h"
 #include "gromacs/utility/exceptions.h"
 #include "gromacs/utility/fatalerror.h"
@@ -79,7 +83,11 @@
  * Note that this option is turned off with large (local) atom counts
  * to avoid high memory usage.
  *
- * Any remaining vsites are assigned to a separate master thread task.
+ * Any remaining vsites depend on vsites assigned to other tasks. These are
+ * colored such that a vsite only depends on vsites with a lower color and
+ * such that vsites with the same color do not share constructing atoms.
+ * The vsites of each color are divided over all threads, with a barrier
+ * between colors, so no serial task is required.
  */
 
 using gmx::RVec;
@@ -127,6 +135,18 @@ struct InterdependentTask
     }
 };
 
+/*! \brief Vsite interaction lists for one color on one thread */
+struct VsiteColor
+{
+    //! The interaction lists, only vsite entries are used
+    t_ilist ilist[F_NRE];
+
+    VsiteColor()
+    {
+        init_ilist(ilist);
+    }
+};
+
 /*! \brief Vsite thread task data structure */
 struct VsiteThread {
     //! Start of atom range of this task
@@ -143,6 +163,8 @@ struct VsiteThread {
     bool               useInterdependentTask;
     //! Data for vsites that involve constructing atoms in the atom range of other threads/tasks
     InterdependentTask idTask;
+    //! Vsites that depend on vsites of other tasks, per color, size >= gmx_vsite_t::ncolor
+    std::vector<VsiteColor> color;
 
     VsiteThread()
     {
@@ -164,6 +186,11 @@ struct VsiteThread {
 static const int c_ftypeVsiteStart = F_VSITE2;
 static const int c_ftypeVsiteEnd   = F_VSITEN + 1;
 
+/* The number of colors that can execute in parallel, vsites that would need
+ * more colors are put into one extra color that is executed by thread 0.
+ */
+static const int c_numVsiteParallelColors = 64;
+
 
 /* Returns the sum of the vsite ilist sizes over all vsite types */
 static int vsiteIlistNrCount(const t_ilist *ilist)
@@ -421,6 +448,234 @@ static int constr_vsiten(const t_iatom *ia, const t_iparams ip[],
 }
 
 
+#if GMX_SIMD_HAVE_REAL
+
+/*! \brief Loads the coordinates of atoms \p index into SIMD registers
+ *
+ * gatherLoadUTranspose<3> can read one real beyond the rvec of each atom.
+ * For a batch that contains the highest atom index in use, which could
+ * be the last element of \p x, \p mayReadBeyond should be false;
+ * the coordinates are then collected with plain loads.
+ */
+static gmx_inline void gatherVsiteCoordinates(const real *x, const int index[],
+                                              bool mayReadBeyond,
+                                              gmx::SimdReal *xS,
+                                              gmx::SimdReal *yS,
+                                              gmx::SimdReal *zS)
+{
+    using namespace gmx;
+
+    if (mayReadBeyond)
+    {
+        gatherLoadUTranspose<3>(x, index, xS, yS, zS);
+    }
+    else
+    {
+        GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH) buf[DIM*GMX_SIMD_REAL_WIDTH];
+
+        for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                buf[d*GMX_SIMD_REAL_WIDTH + s] = x[index[s]*DIM + d];
+            }
+        }
+        *xS = load(buf);
+        *yS = load(buf + GMX_SIMD_REAL_WIDTH);
+        *zS = load(buf + 2*GMX_SIMD_REAL_WIDTH);
+    }
+}
+
+/*! \brief Constructs all vsites of type \p ftype in \p ia, GMX_SIMD_REAL_WIDTH at a time
+ *
+ * Only allowed when none of the constructing atoms is a vsite of this type,
+ * since all vsites in a batch are gathered before any is stored.
+ * The coordinate arrays need no padding: batches that use the highest
+ * atom index are loaded without reading beyond it.
+ * The last batch is filled up with the last vsite.
+ * With \p pbc set, each vsite is put at the periodic image closest
+ * to its old position, as the plain-C code does without charge groups.
+ */
+template <int ftype>
+static void constructVsitesSimd(const t_iatom ia[], int nr, const t_iparams ip[],
+                                rvec x[], real inv_dt, rvec *v, const t_pbc *pbc)
+{
+    using namespace gmx;
+
+    const int                               nral1 = (ftype == F_VSITE4FDN ? 6 : 5);
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)   av[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)   ai[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)   aj[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)   ak[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(int, GMX_SIMD_REAL_WIDTH)   al[GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH)  coeff[3*GMX_SIMD_REAL_WIDTH];
+    GMX_ALIGNED(real, GMX_SIMD_REAL_WIDTH)  pbc_simd[9*GMX_SIMD_REAL_WIDTH];
+    SimdReal                                xi_S, yi_S, zi_S;
+    SimdReal                                xj_S, yj_S, zj_S;
+    SimdReal                                xk_S, yk_S, zk_S;
+    SimdReal                                xl_S, yl_S, zl_S;
+    SimdReal                                xv_S, yv_S, zv_S;
+    SimdReal                                dx_S, dy_S, dz_S;
+
+    set_pbc_simd(pbc, pbc_simd);
+
+    real *xr = x[0];
+
+    int   atomMax = 0;
+    for (int i = 0; i < nr; i += nral1)
+    {
+        for (int j = i + 1; j < i + nral1; j++)
+        {
+            atomMax = std::max(atomMax, ia[j]);
+        }
+    }
+
+    for (int i = 0; i < nr; i += GMX_SIMD_REAL_WIDTH*nral1)
+    {
+        bool mayReadBeyond = true;
+        int  iu            = i;
+        for (int s = 0; s < GMX_SIMD_REAL_WIDTH; s++)
+        {
+            int tp    = ia[iu];
+            av[s]     = ia[iu + 1];
+            ai[s]     = ia[iu + 2];
+            aj[s]     = ia[iu + 3];
+            ak[s]     = ia[iu + 4];
+            al[s]     = (ftype == F_VSITE4FDN ? ia[iu + 5] : ai[s]);
+            coeff[s]                         = ip[tp].vsite.a;
+            coeff[GMX_SIMD_REAL_WIDTH + s]   = ip[tp].vsite.b;
+            coeff[2*GMX_SIMD_REAL_WIDTH + s] = ip[tp].vsite.c;
+
+            for (int j = iu + 1; j < iu + nral1; j++)
+            {
+                if (ia[j] == atomMax)
+                {
+                    mayReadBeyond = false;
+                }
+            }
+
+            /* At the end, fill up with copies of the last vsite */
+            if (iu + nral1 < nr)
+            {
+                iu += nral1;
+            }
+        }
+
+        SimdReal a_S = load(coeff);
+        SimdReal b_S = load(coeff + GMX_SIMD_REAL_WIDTH);
+        SimdReal c_S = load(coeff + 2*GMX_SIMD_REAL_WIDTH);
+
+        gatherVsiteCoordinates(xr, ai, mayReadBeyond, &xi_S, &yi_S, &zi_S);
+        gatherVsiteCoordinates(xr, aj, mayReadBeyond, &xj_S, &yj_S, &zj_S);
+        gatherVsiteCoordinates(xr, ak, mayReadBeyond, &xk_S, &yk_S, &zk_S);
+
+        SimdReal x_S, y_S, z_S;
+        if (ftype == F_VSITE3)
+        {
+            SimdReal xij_S = xj_S - xi_S, yij_S = yj_S - yi_S, zij_S = zj_S - zi_S;
+            SimdReal xik_S = xk_S - xi_S, yik_S = yk_S - yi_S, zik_S = zk_S - zi_S;
+            pbc_correct_dx_simd(&xij_S, &yij_S, &zij_S, pbc_simd);
+            pbc_correct_dx_simd(&xik_S, &yik_S, &zik_S, pbc_simd);
+
+            x_S = fma(b_S, xik_S, fma(a_S, xij_S, xi_S));
+            y_S = fma(b_S, yik_S, fma(a_S, yij_S, yi_S));
+            z_S = fma(b_S, zik_S, fma(a_S, zij_S, zi_S));
+        }
+        else if (ftype == F_VSITE3FD)
+        {
+            SimdReal xij_S = xj_S - xi_S, yij_S = yj_S - yi_S, zij_S = zj_S - zi_S;
+            SimdReal xjk_S = xk_S - xj_S, yjk_S = yk_S - yj_S, zjk_S = zk_S - zj_S;
+            pbc_correct_dx_simd(&xij_S, &yij_S, &zij_S, pbc_simd);
+            pbc_correct_dx_simd(&xjk_S, &yjk_S, &zjk_S, pbc_simd);
+
+            /* temp goes from i to a point on the line jk */
+            SimdReal xt_S = fma(a_S, xjk_S, xij_S);
+            SimdReal yt_S = fma(a_S, yjk_S, yij_S);
+            SimdReal zt_S = fma(a_S, zjk_S, zij_S);
+            SimdReal d_S  = b_S * invsqrt(norm2(xt_S, yt_S, zt_S));
+
+            x_S = fma(d_S, xt_S, xi_S);
+            y_S = fma(d_S, yt_S, yi_S);
+            z_S = fma(d_S, zt_S, zi_S);
+        }
+        else if (ftype == F_VSITE3OUT)
+        {
+            SimdReal xij_S = xj_S - xi_S, yij_S = yj_S - yi_S, zij_S = zj_S - zi_S;
+            SimdReal xik_S = xk_S - xi_S, yik_S = yk_S - yi_S, zik_S = zk_S - zi_S;
+            pbc_correct_dx_simd(&xij_S, &yij_S, &zij_S, pbc_simd);
+            pbc_correct_dx_simd(&xik_S, &yik_S, &zik_S, pbc_simd);
+
+            SimdReal xt_S, yt_S, zt_S;
+            cprod(xij_S, yij_S, zij_S, xik_S, yik_S, zik_S, &xt_S, &yt_S, &zt_S);
+
+            x_S = fma(c_S, xt_S, fma(b_S, xik_S, fma(a_S, xij_S, xi_S)));
+            y_S = fma(c_S, yt_S, fma(b_S, yik_S, fma(a_S, yij_S, yi_S)));
+            z_S = fma(c_S, zt_S, fma(b_S, zik_S, fma(a_S, zij_S, zi_S)));
+        }
+        else
+        {
+            GMX_ASSERT(ftype == F_VSITE4FDN, "Only vsite types 3, 3FD, 3OUT and 4FDN have SIMD kernels");
+
+            gatherVsiteCoordinates(xr, al, mayReadBeyond, &xl_S, &yl_S, &zl_S);
+
+            SimdReal xij_S = xj_S - xi_S, yij_S = yj_S - yi_S, zij_S = zj_S - zi_S;
+            SimdReal xik_S = xk_S - xi_S, yik_S = yk_S - yi_S, zik_S = zk_S - zi_S;
+            SimdReal xil_S = xl_S - xi_S, yil_S = yl_S - yi_S, zil_S = zl_S - zi_S;
+            pbc_correct_dx_simd(&xij_S, &yij_S, &zij_S, pbc_simd);
+            pbc_correct_dx_simd(&xik_S, &yik_S, &zik_S, pbc_simd);
+            pbc_correct_dx_simd(&xil_S, &yil_S, &zil_S, pbc_simd);
+
+            SimdReal xja_S = fms(a_S, xik_S, xij_S);
+            SimdReal yja_S = fms(a_S, yik_S, yij_S);
+            SimdReal zja_S = fms(a_S, zik_S, zij_S);
+            SimdReal xjb_S = fms(b_S, xil_S, xij_S);
+            SimdReal yjb_S = fms(b_S, yil_S, yij_S);
+            SimdReal zjb_S = fms(b_S, zil_S, zij_S);
+
+            SimdReal xm_S, ym_S, zm_S;
+            cprod(xja_S, yja_S, zja_S, xjb_S, yjb_S, zjb_S, &xm_S, &ym_S, &zm_S);
+            SimdReal d_S = c_S * invsqrt(norm2(xm_S, ym_S, zm_S));
+
+            x_S = fma(d_S, xm_S, xi_S);
+            y_S = fma(d_S, ym_S, yi_S);
+            z_S = fma(d_S, zm_S, zi_S);
+        }
+
+        if (pbc != nullptr || v != nullptr)
+        {
+            /* Load the old vsite positions */
+            gatherVsiteCoordinates(xr, av, mayReadBeyond, &xv_S, &yv_S, &zv_S);
+        }
+        if (pbc != nullptr)
+        {
+            /* Shift the vsite to the image closest to its old position,
+             * the correction is exactly zero when no shift is needed.
+             */
+            dx_S = x_S - xv_S;
+            dy_S = y_S - yv_S;
+            dz_S = z_S - zv_S;
+            SimdReal dxc_S = dx_S, dyc_S = dy_S, dzc_S = dz_S;
+            pbc_correct_dx_simd(&dxc_S, &dyc_S, &dzc_S, pbc_simd);
+            x_S = x_S + (dxc_S - dx_S);
+            y_S = y_S + (dyc_S - dy_S);
+            z_S = z_S + (dzc_S - dz_S);
+        }
+
+        transposeScatterStoreU<3>(xr, av, x_S, y_S, z_S);
+
+        if (v != nullptr)
+        {
+            SimdReal inv_dt_S = SimdReal(inv_dt);
+            transposeScatterStoreU<3>(v[0], av,
+                                      inv_dt_S*(x_S - xv_S),
+                                      inv_dt_S*(y_S - yv_S),
+                                      inv_dt_S*(z_S - zv_S));
+        }
+    }
+}
+
+#endif // GMX_SIMD_HAVE_REAL
+
 static void construct_vsites_thread(const gmx_vsite_t *vsite,
                                     rvec x[],
                                     real dt, rvec *v,
@@ -468,6 +723,31 @@ static void construct_vsites_thread(const gmx_vsite_t *vsite,
                 vsite_pbc = vsite->vsite_pbc_loc[ftype - c_ftypeVsiteStart];
             }
 
+#if GMX_SIMD_HAVE_REAL
+            if ((vsite->simdConstructMask & (1 << (ftype - c_ftypeVsiteStart))) &&
+                (pbc_null == nullptr || (bPBCAll && pbc_null->ePBC != epbcSCREW)))
+            {
+                switch (ftype)
+                {
+                    case F_VSITE3:
+                        constructVsitesSimd<F_VSITE3>(ia, nr, ip, x, inv_dt, v, pbc_null2);
+                        break;
+                    case F_VSITE3FD:
+                        constructVsitesSimd<F_VSITE3FD>(ia, nr, ip, x, inv_dt, v, pbc_null2);
+                        break;
+                    case F_VSITE3OUT:
+                        constructVsitesSimd<F_VSITE3OUT>(ia, nr, ip, x, inv_dt, v, pbc_null2);
+                        break;
+                    case F_VSITE4FDN:
+                        constructVsitesSimd<F_VSITE4FDN>(ia, nr, ip, x, inv_dt, v, pbc_null2);
+                        break;
+                    default:
+                        gmx_incons("SIMD vsite construction requested for a type without SIMD kernel");
+                }
+                continue;
+            }
+#endif
+
             for (int i = 0; i < nr; )
             {
                 int  tp     = ia[0];
@@ -661,14 +941,20 @@ void construct_vsites(const gmx_vsite_t *vsite,
                                             ip, vsite->tData[th]->idTask.ilist,
                                             pbc_null);
                 }
+                /* Now we can construct the vsites that depend on vsites
+                 * of other tasks, one color at a time.
+                 */
+                for (int c = 0; c < vsite->ncolor; c++)
+                {
+#pragma omp barrier
+                    construct_vsites_thread(vsite,
+                                            x, dt, v,
+                                            ip, vsite->tData[th]->color[c].ilist,
+                                            pbc_null);
+                }
             }
             GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
         }
-        /* Now we can construct the vsites that might depend on other vsites */
-        construct_vsites_thread(vsite,
-                                x, dt, v,
-                                ip, vsite->tData[vsite->nthreads]->ilist,
-                                pbc_null);
     }
 }
 
@@ -1608,18 +1894,6 @@ void spread_vsite_f(const gmx_vsite_t *vsite,
     }
     else
     {
-        /* First spread the vsites that might depend on non-local vsites */
-        if (VirCorr)
-        {
-            clear_mat(vsite->tData[vsite->nthreads]->dxdf);
-        }
-        spread_vsite_f_thread(vsite,
-                              x, f, fshift,
-                              VirCorr, vsite->tData[vsite->nthreads]->dxdf,
-                              idef->iparams,
-                              vsite->tData[vsite->nthreads]->ilist,
-                              g, pbc_null);
-
 #pragma omp parallel num_threads(vsite->nthreads)
         {
             try
@@ -1646,6 +1920,20 @@ void spread_vsite_f(const gmx_vsite_t *vsite,
                     clear_mat(tData->dxdf);
                 }
 
+                /* First spread the vsites that depend on vsites of other
+                 * tasks, in reverse color order.
+                 */
+                for (int c = vsite->ncolor - 1; c >= 0; c--)
+                {
+                    spread_vsite_f_thread(vsite,
+                                          x, f, fshift_t,
+                                          VirCorr, tData->dxdf,
+                                          idef->iparams,
+                                          tData->color[c].ilist,
+                                          g, pbc_null);
+#pragma omp barrier
+                }
+
                 if (tData->useInterdependentTask)
                 {
                     /* Spread the vsites that spread outside our local range.
@@ -1731,7 +2019,7 @@ void spread_vsite_f(const gmx_vsite_t *vsite,
 
     if (VirCorr)
     {
-        for (int th = 0; th < (vsite->nthreads == 1 ? 1 : vsite->nthreads + 1); th++)
+        for (int th = 0; th < vsite->nthreads; th++)
         {
             for (int i = 0; i < DIM; i++)
             {
@@ -2016,8 +2304,7 @@ gmx_vsite_t *init_vsite(const gmx_mtop_t *mtop, t_commrec *cr,
     }
     if (!bSerial_NoPBC)
     {
-        /* We need one extra thread data structure for the overlap vsites */
-        snew(vsite->tData, vsite->nthreads + 1);
+        snew(vsite->tData, vsite->nthreads);
 #pragma omp parallel for num_threads(vsite->nthreads) schedule(static)
         for (int thread = 0; thread < vsite->nthreads; thread++)
         {
@@ -2031,14 +2318,14 @@ gmx_vsite_t *init_vsite(const gmx_mtop_t *mtop, t_commrec *cr,
             }
             GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
         }
-        if (vsite->nthreads > 1)
-        {
-            vsite->tData[vsite->nthreads] = new VsiteThread;
-        }
     }
 
-    vsite->taskIndex       = nullptr;
-    vsite->taskIndexNalloc = 0;
+    vsite->taskIndex         = nullptr;
+    vsite->taskIndexNalloc   = 0;
+    vsite->ncolor            = 0;
+    vsite->colorMask         = nullptr;
+    vsite->colorMaskNalloc   = 0;
+    vsite->simdConstructMask = 0;
 
     return vsite;
 }
@@ -2066,7 +2353,7 @@ static gmx_inline void flagAtom(InterdependentTask *idTask, int atom,
  * are assigned to task tData->ilist. Vsites that depend on non-local atoms
  * but not on other vsites are assigned to task tData->id_task.ilist.
  * taskIndex[] is set for all vsites in our range, either to our local tasks
- * or to the single last task as taskIndex[]=2*nthreads.
+ * or to taskIndex[]=2*nthreads for vsites that are assigned to a color later.
  */
 static void assignVsitesToThread(VsiteThread           *tData,
                                  int                    thread,
@@ -2212,47 +2499,218 @@ static void assignVsitesToThread(VsiteThread           *tData,
     }
 }
 
-/*! \brief Assign all vsites with taskIndex[]==task to task tData */
-static void assignVsitesToSingleTask(VsiteThread     *tData,
-                                     int              task,
-                                     const int       *taskIndex,
-                                     const t_ilist   *ilist,
-                                     const t_iparams *ip)
+/*! \brief Returns a bit mask over vsite types that can use SIMD construction
+ *
+ * We only use SIMD kernels for types where no constructing atom is a vsite,
+ * so all vsites in a SIMD batch can be constructed independently.
+ */
+static int vsiteSimdConstructMask(const t_ilist        gmx_unused *ilist,
+                                  const unsigned short gmx_unused *ptype)
 {
-    for (int ftype = c_ftypeVsiteStart; ftype < c_ftypeVsiteEnd; ftype++)
+    int mask = 0;
+
+#if GMX_SIMD_HAVE_REAL
+    const int simdFtypes[] = { F_VSITE3, F_VSITE3FD, F_VSITE3OUT, F_VSITE4FDN };
+
+    for (int ftype : simdFtypes)
     {
-        tData->ilist[ftype].nr        = 0;
-        tData->idTask.ilist[ftype].nr = 0;
+        int            nral1               = 1 + NRAL(ftype);
+        const t_iatom *iat                 = ilist[ftype].iatoms;
+        bool           constructedFromVsite = false;
+        for (int i = 0; i < ilist[ftype].nr && !constructedFromVsite; i += nral1)
+        {
+            for (int j = i + 2; j < i + nral1; j++)
+            {
+                if (ptype[iat[j]] == eptVSite)
+                {
+                    constructedFromVsite = true;
+                }
+            }
+        }
+        if (!constructedFromVsite)
+        {
+            mask |= (1 << (ftype - c_ftypeVsiteStart));
+        }
+    }
+#endif
 
-        int      nral1   = 1 + NRAL(ftype);
-        int      inc     = nral1;
-        t_iatom *iat     = ilist[ftype].iatoms;
-        t_ilist *il_task = &tData->ilist[ftype];
+    return mask;
+}
 
-        for (int i = 0; i < ilist[ftype].nr; )
+/*! \brief Returns the constructing atoms of vsite entry \p iat of type \p ftype
+ *
+ * Also sets *inc to the number of ilist entries for this vsite.
+ */
+static int vsiteConstructingAtoms(int ftype, const t_iatom *iat,
+                                  const t_iparams *ip,
+                                  std::vector<int> *atoms, int *inc)
+{
+    atoms->resize(0);
+    if (ftype != F_VSITEN)
+    {
+        *inc = 1 + NRAL(ftype);
+        for (int j = 2; j < *inc; j++)
         {
-            if (ftype == F_VSITEN)
+            atoms->push_back(iat[j]);
+        }
+    }
+    else
+    {
+        /* The 3 below is from 1+NRAL(ftype)=3 */
+        *inc = ip[iat[0]].vsiten.n*3;
+        for (int j = 2; j < *inc; j += 3)
+        {
+            atoms->push_back(iat[j]);
+        }
+    }
+
+    return atoms->size();
+}
+
+/*! \brief Assign all vsites with taskIndex[]==2*nthreads to colors
+ *
+ * These vsites depend on vsites of other tasks. A vsite gets the lowest
+ * color higher than the colors of the vsites it depends on that is not
+ * used by other vsites that share a constructing atom. Then the vsites
+ * of one color can be constructed and spread in parallel. The vsites
+ * of each color are divided in contiguous blocks over the threads.
+ * Vsites that need more than c_numVsiteParallelColors colors go into
+ * one extra color that is only executed by thread 0.
+ */
+static void assignVsitesToColors(gmx_vsite_t     *vsite,
+                                 int             *taskIndex,
+                                 const t_ilist   *ilist,
+                                 const t_iparams *ip,
+                                 int              natoms)
+{
+    const int nthread    = vsite->nthreads;
+    /* taskIndex of colored vsites is colorTaskOffset + color */
+    const int colorTaskOffset = 2*nthread + 1;
+
+    if (natoms > vsite->colorMaskNalloc)
+    {
+        int nallocOld          = vsite->colorMaskNalloc;
+        vsite->colorMaskNalloc = over_alloc_large(natoms);
+        srenew(vsite->colorMask, vsite->colorMaskNalloc);
+        for (int a = nallocOld; a < vsite->colorMaskNalloc; a++)
+        {
+            vsite->colorMask[a] = 0;
+        }
+    }
+    gmx_uint64_t *colorMask = vsite->colorMask;
+
+    std::vector<int> atoms;
+    std::vector<int> colorCount(c_numVsiteParallelColors + 1, 0);
+    int              ncolor = 0;
+
+    /* Color the vsites in construction order */
+    for (int ftype = c_ftypeVsiteStart; ftype < c_ftypeVsiteEnd; ftype++)
+    {
+        const t_iatom *iat = ilist[ftype].iatoms;
+        int            inc;
+        for (int i = 0; i < ilist[ftype].nr; i += inc)
+        {
+            int natom = vsiteConstructingAtoms(ftype, iat + i, ip, &atoms, &inc);
+            if (taskIndex[iat[i + 1]] != 2*nthread)
             {
-                /* The 3 below is from 1+NRAL(ftype)=3 */
-                inc = ip[iat[i]].vsiten.n*3;
+                continue;
             }
-            /* Check if the vsite is assigned to our task */
-            if (taskIndex[iat[1 + i]] == task)
+
+            int          colorMin  = 0;
+            gmx_uint64_t colorUsed = 0;
+            for (int a = 0; a < natom; a++)
             {
-                /* Ensure we have sufficient memory allocated */
-                if (il_task->nr + inc > il_task->nalloc)
+                int task = taskIndex[atoms[a]];
+                if (task >= colorTaskOffset)
                 {
-                    il_task->nalloc = over_alloc_large(il_task->nr + inc);
-                    srenew(il_task->iatoms, il_task->nalloc);
+                    colorMin = std::max(colorMin, task - colorTaskOffset + 1);
                 }
-                /* Copy the vsite data to the thread-task local array */
-                for (int j = i; j < i + inc; j++)
+                colorUsed |= colorMask[atoms[a]];
+            }
+            int color = colorMin;
+            while (color < c_numVsiteParallelColors &&
+                   (colorUsed & (static_cast<gmx_uint64_t>(1) << color)))
+            {
+                color++;
+            }
+            if (color < c_numVsiteParallelColors)
+            {
+                for (int a = 0; a < natom; a++)
                 {
-                    il_task->iatoms[il_task->nr++] = iat[j];
+                    colorMask[atoms[a]] |= (static_cast<gmx_uint64_t>(1) << color);
                 }
             }
+            else
+            {
+                color = c_numVsiteParallelColors;
+            }
+            taskIndex[iat[i + 1]] = colorTaskOffset + color;
+            colorCount[color]++;
+            ncolor                = std::max(ncolor, color + 1);
+        }
+    }
 
-            i += inc;
+    vsite->ncolor = ncolor;
+    for (int th = 0; th < nthread; th++)
+    {
+        VsiteThread *tData = vsite->tData[th];
+        if (static_cast<int>(tData->color.size()) < ncolor)
+        {
+            tData->color.resize(ncolor);
+        }
+        for (int c = 0; c < ncolor; c++)
+        {
+            for (int ftype = c_ftypeVsiteStart; ftype < c_ftypeVsiteEnd; ftype++)
+            {
+                tData->color[c].ilist[ftype].nr = 0;
+            }
+        }
+    }
+
+    /* Divide the vsites of each color over the threads */
+    std::vector<int> colorIndex(ncolor, 0);
+    for (int ftype = c_ftypeVsiteStart; ftype < c_ftypeVsiteEnd; ftype++)
+    {
+        const t_iatom *iat = ilist[ftype].iatoms;
+        int            inc;
+        for (int i = 0; i < ilist[ftype].nr; i += inc)
+        {
+            int natom = vsiteConstructingAtoms(ftype, iat + i, ip, &atoms, &inc);
+            int color = taskIndex[iat[i + 1]] - colorTaskOffset;
+            if (color < 0)
+            {
+                continue;
+            }
+
+            int thread;
+            if (color < c_numVsiteParallelColors)
+            {
+                thread = (colorIndex[color]*nthread)/colorCount[color];
+            }
+            else
+            {
+                thread = 0;
+            }
+            colorIndex[color]++;
+
+            t_ilist *il_task = &vsite->tData[thread]->color[color].ilist[ftype];
+            /* Ensure we have sufficient memory allocated */
+            if (il_task->nr + inc > il_task->nalloc)
+            {
+                il_task->nalloc = over_alloc_large(il_task->nr + inc);
+                srenew(il_task->iatoms, il_task->nalloc);
+            }
+            /* Copy the vsite data to the thread-task local array */
+            for (int j = i; j < i + inc; j++)
+            {
+                il_task->iatoms[il_task->nr++] = iat[j];
+            }
+
+            /* Clear the color mask for the next call */
+            for (int a = 0; a < natom; a++)
+            {
+                colorMask[atoms[a]] = 0;
+            }
         }
     }
 }
@@ -2265,9 +2723,11 @@ void split_vsites_over_threads(const t_ilist   *ilist,
 {
     int      vsite_atom_range, natperthread;
 
+    vsite->simdConstructMask = vsiteSimdConstructMask(ilist, mdatoms->ptype);
+
     if (vsite->nthreads == 1)
     {
-        /* Nothing to do */
+        /* Nothing else to do */
         return;
     }
 
@@ -2482,22 +2942,21 @@ void split_vsites_over_threads(const t_ilist   *ilist,
         GMX_CATCH_ALL_AND_EXIT_WITH_FATAL_ERROR;
     }
     /* Assign all remaining vsites, that will have taskIndex[]=2*vsite->nthreads,
-     * to a single task that will not run in parallel with other tasks.
+     * to colors that are each executed in parallel over all threads.
      */
-    assignVsitesToSingleTask(vsite->tData[vsite->nthreads],
-                             2*vsite->nthreads,
-                             taskIndex,
-                             ilist, ip);
+    assignVsitesToColors(vsite, taskIndex, ilist, ip, mdatoms->nr);
 
     if (debug && vsite->nthreads > 1)
     {
         fprintf(debug, "virtual site useInterdependentTask %d, nuse:\n",
                 vsite->tData[0]->useInterdependentTask);
-        for (int th = 0; th < vsite->nthreads + 1; th++)
+        for (int th = 0; th < vsite->nthreads; th++)
         {
             fprintf(debug, " %4d", vsite->tData[th]->idTask.nuse);
         }
         fprintf(debug, "\n");
+        fprintf(debug, "virtual site colors for vsites depending on other tasks: %d\n",
+                vsite->ncolor);
 
         for (int ftype = c_ftypeVsiteStart; ftype < c_ftypeVsiteEnd; ftype++)
         {
@@ -2505,11 +2964,17 @@ void split_vsites_over_threads(const t_ilist   *ilist,
             {
                 fprintf(debug, "%-20s thread dist:",
                         interaction_function[ftype].longname);
-                for (int th = 0; th < vsite->nthreads + 1; th++)
+                for (int th = 0; th < vsite->nthreads; th++)
                 {
-                    fprintf(debug, " %4d %4d ",
+                    int nrColor = 0;
+                    for (int c = 0; c < vsite->ncolor; c++)
+                    {
+                        nrColor += vsite->tData[th]->color[c].ilist[ftype].nr;
+                    }
+                    fprintf(debug, " %4d %4d %4d ",
                             vsite->tData[th]->ilist[ftype].nr,
-                            vsite->tData[th]->idTask.ilist[ftype].nr);
+                            vsite->tData[th]->idTask.ilist[ftype].nr,
+                            nrColor);
                 }
                 fprintf(debug, "\n");
             }
@@ -2519,11 +2984,15 @@ void split_vsites_over_threads(const t_ilist   *ilist,
 #ifndef NDEBUG
     int nrOrig     = vsiteIlistNrCount(ilist);
     int nrThreaded = 0;
-    for (int th = 0; th < vsite->nthreads + 1; th++)
+    for (int th = 0; th < vsite->nthreads; th++)
     {
         nrThreaded +=
             vsiteIlistNrCount(vsite->tData[th]->ilist) +
             vsiteIlistNrCount(vsite->tData[th]->idTask.ilist);
+        for (int c = 0; c < vsite->ncolor; c++)
+        {
+            nrThreaded += vsiteIlistNrCount(vsite->tData[th]->color[c].ilist);
+        }
     }
     GMX_ASSERT(nrThreaded == nrOrig, "The number of virtual sites assigned to all thread task has to match the total number of virtual sites");
 #endif
@@ -2546,14 +3015,11 @@ void set_vsite_top(gmx_vsite_t *vsite, gmx_localtop_t *top, t_mdatoms *md,
 
     }
 
-    if (vsite->nthreads > 1)
+    if (vsite->nthreads > 1 && vsite->bHaveChargeGroups)
     {
-        if (vsite->bHaveChargeGroups)
-        {
-            gmx_fatal(FARGS, "The combination of threading, virtual sites and charge groups is not implemented");
-        }
-
-        split_vsites_over_threads(top->idef.il, top->idef.iparams,
-                                  md, !DOMAINDECOMP(cr), vsite);
+        gmx_fatal(FARGS, "The combination of threading, virtual sites and charge groups is not implemented");
     }
+
+    split_vsites_over_threads(top->idef.il, top->idef.iparams,
+                              md, !DOMAINDECOMP(cr), vsite);
 }
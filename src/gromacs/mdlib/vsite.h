@@ -62,6 +62,10 @@ typedef struct gmx_vsite_t {
     struct VsiteThread **tData;                /* Thread local vsites and work structs    */
     int                 *taskIndex;            /* Work array                              */
     int                  taskIndexNalloc;      /* Size of taskIndex                       */
+    int                  ncolor;               /* Number of colors of dependent vsites    */
+    gmx_uint64_t        *colorMask;            /* Work array, colors in use per atom      */
+    int                  colorMaskNalloc;      /* Size of colorMask                       */
+    int                  simdConstructMask;    /* Bits of vsite types using SIMD kernels  */
 } gmx_vsite_t;
 
 void construct_vsites(const gmx_vsite_t *vsite,
@@ -120,6 +124,8 @@ void split_vsites_over_threads(const t_ilist   *ilist,
                                gmx_bool         bLimitRange,
                                gmx_vsite_t     *vsite);
 /* Divide the vsite work-load over the threads.
+ * Also determines which vsite types can be constructed with SIMD kernels,
+ * so this should also be called with a single thread.
  * Should be called at the end of the domain decomposition.
  */
 
@@ -58,12 +58,16 @@
 #include "gromacs/fileio/gmxfio.h"
 #include "gromacs/gmxlib/network.h"
 #include "gromacs/mdlib/main.h"
+#include "gromacs/mdlib/mdoutf.h"
 #include "gromacs/mdtypes/commrec.h"
 #include "gromacs/utility/basedefinitions.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/smalloc.h"
 
 /*! \brief Search for \p fnm_cp in fnm and return true iff found
+ *
+ * The files of the additional compressed x streams, which are named
+ * after the compressed trajectory file, are also accepted.
  *
  * \todo This could be implemented sanely with a for loop. */
 static gmx_bool exist_output_file(const char *fnm_cp, int nfile, const t_filenm fnm[])
@@ -80,7 +84,8 @@ static gmx_bool exist_output_file(const char *fnm_cp, int nfile, const t_filenm
         i++;
     }
 
-    return (i < nfile && gmx_fexist(fnm_cp));
+    return ((i < nfile || mdoutf_is_x_stream_filename(fnm_cp, nfile, fnm)) &&
+            gmx_fexist(fnm_cp));
 }
 
 /*! \brief Support handling restarts
@@ -87,6 +87,13 @@ class DefaultThreadAffinityAccess : public gmx::IThreadAffinityAccess
 //! Global instance of DefaultThreadAffinityAccess
 DefaultThreadAffinityAccess g_defaultAffinityAccess;
 
+#if HAVE_SCHED_AFFINITY
+//! Affinity mask of the process before mdrun set any thread affinities
+cpu_set_t g_processAffinityMask;
+//! Whether g_processAffinityMask has been stored
+bool      g_processAffinityMaskSaved = false;
+#endif
+
 } // namespace
 
 gmx::IThreadAffinityAccess::~IThreadAffinityAccess()
@@ -465,6 +472,18 @@ gmx_check_thread_affinity_set(const gmx::MDLogger &mdlog,
 {
     GMX_RELEASE_ASSERT(hw_opt, "hw_opt must be a non-NULL pointer");
 
+#if HAVE_SCHED_AFFINITY
+    /* The first call is before any affinity is set. With thread-MPI
+     * this is on the master thread before the other ranks are started.
+     */
+    if (!bAfterOpenmpInit && !g_processAffinityMaskSaved)
+    {
+        CPU_ZERO(&g_processAffinityMask);
+        g_processAffinityMaskSaved =
+            (sched_getaffinity(0, sizeof(cpu_set_t), &g_processAffinityMask) == 0);
+    }
+#endif
+
     if (!bAfterOpenmpInit)
     {
         /* Check for externally set OpenMP affinity and turn off internal
@@ -598,3 +617,18 @@ gmx_check_thread_affinity_set(const gmx::MDLogger &mdlog,
     }
 #endif /* HAVE_SCHED_AFFINITY */
 }
+
+void gmx_reset_thread_affinity()
+{
+#if HAVE_SCHED_AFFINITY
+    if (g_processAffinityMaskSaved)
+    {
+        /* On Linux pid 0 sets the affinity of the calling thread only */
+        int ret = sched_setaffinity(0, sizeof(cpu_set_t), &g_processAffinityMask);
+        if (ret != 0 && debug)
+        {
+            fprintf(debug, "Failed to reset the thread affinity mask (error %d)\n", ret);
+        }
+    }
+#endif
+}
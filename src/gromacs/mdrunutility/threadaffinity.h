@@ -98,4 +98,17 @@ gmx_check_thread_affinity_set(const gmx::MDLogger &mdlog, const t_commrec *cr,
                               gmx_hw_opt_t *hw_opt, int ncpus,
                               gmx_bool bAfterOpenmpInit);
 
+/*! \brief
+ * Sets the affinity of the calling thread to the process affinity mask
+ * from before mdrun set any thread affinities.
+ *
+ * Meant for helper threads that are started by a pinned thread, such as
+ * the trajectory output thread, which would otherwise share the single
+ * core of that thread. The mask is stored by the first call of
+ * gmx_check_thread_affinity_set(). Does nothing when the mask is not
+ * known, which includes platforms other than Linux.
+ */
+void
+gmx_reset_thread_affinity();
+
 #endif
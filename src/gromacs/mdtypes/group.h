@@ -81,6 +81,8 @@ typedef struct gmx_ekindata_t {
     real             dekindl;         /* dEkin/dlambda at half step           */
     real             dekindl_old;     /* dEkin/dlambda at old half step       */
     t_cos_acc        cosacc;          /* Cosine acceleration data             */
+    gmx_bool         bEkinhWorkSet;   /* ekin_work contains the 1/2 step ekin of the
+                                         current velocities, set by the update */
 } gmx_ekindata_t;
 
 #define GID(igid, jgid, gnr) ((igid < jgid) ? (igid*gnr+jgid) : (jgid*gnr+igid))
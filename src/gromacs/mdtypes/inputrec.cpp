@@ -332,6 +332,12 @@ void done_inputrec(t_inputrec *ir)
     sfree(ir->expandedvals);
     sfree(ir->simtempvals);
 
+    for (int i = 0; i < ir->n_x_streams; i++)
+    {
+        sfree(ir->x_streams[i].ind);
+    }
+    sfree(ir->x_streams);
+
     if (ir->pull)
     {
         done_pull_params(ir->pull);
@@ -749,6 +755,19 @@ static void pr_swap(FILE *fp, int indent, const t_swapcoords *swap)
 }
 
 
+static void pr_x_stream(FILE *fp, int indent, int s, const t_compressed_x_stream *xs)
+{
+    char str[STRLEN];
+
+    snprintf(str, STRLEN, "compressed-x-stream%d-nstxout", s + 1);
+    PI(str, xs->nstxout);
+    snprintf(str, STRLEN, "compressed-x-stream%d-precision", s + 1);
+    PR(str, xs->precision);
+    snprintf(str, STRLEN, "compressed-x-stream%d-atoms", s + 1);
+    pr_ivec_block(fp, indent, str, xs->ind, xs->nat, TRUE);
+}
+
+
 static void pr_imd(FILE *fp, int indent, const t_IMD *imd)
 {
     PI("IMD-atoms", imd->nat);
@@ -804,6 +823,11 @@ void pr_inputrec(FILE *fp, int indent, const char *title, const t_inputrec *ir,
         PI("nstenergy", ir->nstenergy);
         PI("nstxout-compressed", ir->nstxout_compressed);
         PR("compressed-x-precision", ir->x_compression_precision);
+        PI("compressed-x-streams", ir->n_x_streams);
+        for (int s = 0; s < ir->n_x_streams; s++)
+        {
+            pr_x_stream(fp, indent, s, &ir->x_streams[s]);
+        }
 
         /* Neighborsearching parameters */
         PS("cutoff-scheme", ECUTSCHEME(ir->cutoff_scheme));
@@ -1175,6 +1199,13 @@ void cmp_inputrec(FILE *fp, const t_inputrec *ir1, const t_inputrec *ir2, real f
     cmp_double(fp, "inputrec->init_t", -1, ir1->init_t, ir2->init_t, ftol, abstol);
     cmp_double(fp, "inputrec->delta_t", -1, ir1->delta_t, ir2->delta_t, ftol, abstol);
     cmp_real(fp, "inputrec->x_compression_precision", -1, ir1->x_compression_precision, ir2->x_compression_precision, ftol, abstol);
+    cmp_int(fp, "inputrec->n_x_streams", -1, ir1->n_x_streams, ir2->n_x_streams);
+    for (int s = 0; s < std::min(ir1->n_x_streams, ir2->n_x_streams); s++)
+    {
+        cmp_int(fp, "inputrec->x_streams->nstxout", s, ir1->x_streams[s].nstxout, ir2->x_streams[s].nstxout);
+        cmp_real(fp, "inputrec->x_streams->precision", s, ir1->x_streams[s].precision, ir2->x_streams[s].precision, ftol, abstol);
+        cmp_int(fp, "inputrec->x_streams->nat", s, ir1->x_streams[s].nat, ir2->x_streams[s].nat);
+    }
     cmp_real(fp, "inputrec->fourierspacing", -1, ir1->fourier_spacing, ir2->fourier_spacing, ftol, abstol);
     cmp_int(fp, "inputrec->nkx", -1, ir1->nkx, ir2->nkx);
     cmp_int(fp, "inputrec->nky", -1, ir1->nky, ir2->nky);
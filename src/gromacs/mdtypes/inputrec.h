@@ -203,6 +203,13 @@ typedef struct t_IMD {
     struct t_gmx_IMD *setup; /* Stores non-inputrec IMD data                  */
 } t_IMD;
 
+typedef struct t_compressed_x_stream {
+    int   nstxout;   /* Output frequency of this stream                */
+    real  precision; /* Precision of x in the compressed trajectory    */
+    int   nat;       /* Number of atoms written to this stream         */
+    int  *ind;       /* The sorted global indices of the written atoms */
+} t_compressed_x_stream;
+
 /* Abstract types for position swapping only defined in swapcoords.cpp */
 typedef struct t_swap *gmx_swapcoords_t;
 
@@ -353,6 +360,10 @@ struct t_inputrec
     real            wall_density[2];         /* Number density for walls                     */
     real            wall_ewald_zfac;         /* Scaling factor for the box for Ewald         */
 
+    /* Additional compressed coordinate output */
+    int                    n_x_streams;  /* Number of additional compressed x streams    */
+    t_compressed_x_stream *x_streams;    /* The additional compressed x streams          */
+
     /* COM pulling data */
     gmx_bool              bPull;             /* Do we do COM pulling?                        */
     struct pull_params_t *pull;              /* The data for center of mass pulling          */
@@ -49,9 +49,11 @@
 #include "gromacs/pbcutil/pbc.h"
 #include "gromacs/topology/atoms.h"
 #include "gromacs/topology/idef.h"
+#include "gromacs/topology/topology.h"
 #include "gromacs/trajectory/trajectoryframe.h"
 #include "gromacs/utility/fatalerror.h"
 #include "gromacs/utility/futil.h"
+#include "gromacs/utility/gmxassert.h"
 #include "gromacs/utility/smalloc.h"
 
 typedef struct {
@@ -60,11 +62,16 @@ typedef struct {
 } rmpbc_graph_t;
 
 struct gmx_rmpbc {
-    const t_idef  *idef;
-    int            natoms_init;
-    int            ePBC;
-    int            ngraph;
-    rmpbc_graph_t *graph;
+    const t_idef      *idef;
+    const gmx_mtop_t  *mtop;     /* when set, graphs are made per molecule type */
+    t_graph          **molGraph; /* the graph of one molecule of each type, made on first use */
+    t_graph           *partialGraph;   /* the graph of the molecule the coordinates end in */
+    int                partialMoltype; /* the molecule type of partialGraph */
+    int                partialNatoms;  /* the number of atoms in partialGraph */
+    int                natoms_init;
+    int                ePBC;
+    int                ngraph;
+    rmpbc_graph_t     *graph;
 };
 
 static t_graph *gmx_rmpbc_get_graph(gmx_rmpbc_t gpbc, int ePBC, int natoms)
@@ -136,12 +143,46 @@ gmx_rmpbc_t gmx_rmpbc_init(const t_idef *idef, int ePBC, int natoms)
     return gpbc;
 }
 
+gmx_rmpbc_t gmx_rmpbc_init_mtop(const gmx_mtop_t *mtop, int ePBC, int natoms)
+{
+    gmx_rmpbc_t gpbc;
+
+    GMX_RELEASE_ASSERT(!mtop->bIntermolecularInteractions,
+                       "Intermolecular interactions can connect molecules, use gmx_rmpbc_init");
+
+    snew(gpbc, 1);
+
+    gpbc->natoms_init = natoms;
+    gpbc->ePBC        = ePBC;
+    gpbc->mtop        = mtop;
+    snew(gpbc->molGraph, mtop->nmoltype);
+
+    return gpbc;
+}
+
 void gmx_rmpbc_done(gmx_rmpbc_t gpbc)
 {
     int i;
 
     if (nullptr != gpbc)
     {
+        if (gpbc->mtop != nullptr)
+        {
+            for (i = 0; i < gpbc->mtop->nmoltype; i++)
+            {
+                if (gpbc->molGraph[i] != nullptr)
+                {
+                    done_graph(gpbc->molGraph[i]);
+                    sfree(gpbc->molGraph[i]);
+                }
+            }
+            sfree(gpbc->molGraph);
+            if (gpbc->partialGraph != nullptr)
+            {
+                done_graph(gpbc->partialGraph);
+                sfree(gpbc->partialGraph);
+            }
+        }
         for (i = 0; i < gpbc->ngraph; i++)
         {
             done_graph(gpbc->graph[i].gr);
@@ -167,12 +208,93 @@ static int gmx_rmpbc_ePBC(gmx_rmpbc_t gpbc, const matrix box)
     }
 }
 
+/* Makes the molecules in the first natoms atoms of x whole.
+ * Each molecule is shifted with the graph of its molecule type, so only
+ * the molecule types are expanded instead of the whole topology.
+ */
+static void gmx_rmpbc_molecules(gmx_rmpbc_t gpbc, int ePBC, int natoms,
+                                const matrix box, rvec x[])
+{
+    const gmx_mtop_t *mtop = gpbc->mtop;
+    int               at   = 0;
+
+    if (ePBC == epbcNONE)
+    {
+        return;
+    }
+    if (natoms > gpbc->natoms_init)
+    {
+        gmx_fatal(FARGS, "Structure or trajectory file has more atoms (%d) than the topology (%d)", natoms, gpbc->natoms_init);
+    }
+    for (int mb = 0; mb < mtop->nmolblock && at < natoms; mb++)
+    {
+        const gmx_molblock_t *molb = &mtop->molblock[mb];
+        const gmx_moltype_t  *molt = &mtop->moltype[molb->type];
+        const int             nat  = molt->atoms.nr;
+        t_graph              *gr   = gpbc->molGraph[molb->type];
+
+        if (gr == nullptr)
+        {
+            snew(gr, 1);
+            mk_graph_ilist(nullptr, molt->ilist, 0, nat, FALSE, FALSE, gr);
+            gpbc->molGraph[molb->type] = gr;
+        }
+        if (gr->nbound == 0)
+        {
+            /* Nothing to make whole, e.g. ions */
+            at += std::min(molb->nmol*nat, natoms - at);
+            continue;
+        }
+        for (int mol = 0; mol < molb->nmol && at < natoms; mol++, at += nat)
+        {
+            if (at + nat <= natoms)
+            {
+                mk_mshift(stdout, gr, ePBC, box, x + at);
+                shift_self(gr, box, x + at);
+            }
+            else
+            {
+                /* The coordinates end inside this molecule. As with the
+                 * graph of the whole system, this is only accepted when
+                 * no interaction connects the atoms to those beyond the
+                 * frame. Keep the graph, as a trajectory usually has the
+                 * same number of atoms in every frame.
+                 */
+                t_graph *partial = gpbc->partialGraph;
+
+                if (partial != nullptr &&
+                    (gpbc->partialMoltype != molb->type || gpbc->partialNatoms != natoms - at))
+                {
+                    done_graph(partial);
+                    sfree(partial);
+                    partial = nullptr;
+                }
+                if (partial == nullptr)
+                {
+                    snew(partial, 1);
+                    mk_graph_ilist(nullptr, molt->ilist, 0, natoms - at, FALSE, FALSE, partial);
+                    gpbc->partialGraph   = partial;
+                    gpbc->partialMoltype = molb->type;
+                    gpbc->partialNatoms  = natoms - at;
+                }
+                mk_mshift(stdout, partial, ePBC, box, x + at);
+                shift_self(partial, box, x + at);
+            }
+        }
+    }
+}
+
 void gmx_rmpbc(gmx_rmpbc_t gpbc, int natoms, const matrix box, rvec x[])
 {
     int      ePBC;
     t_graph *gr;
 
     ePBC = gmx_rmpbc_ePBC(gpbc, box);
+    if (gpbc != nullptr && gpbc->mtop != nullptr)
+    {
+        gmx_rmpbc_molecules(gpbc, ePBC, natoms, box, x);
+        return;
+    }
     gr   = gmx_rmpbc_get_graph(gpbc, ePBC, natoms);
     if (gr != nullptr)
     {
@@ -188,6 +310,15 @@ void gmx_rmpbc_copy(gmx_rmpbc_t gpbc, int natoms, const matrix box, rvec x[], rv
     int      i;
 
     ePBC = gmx_rmpbc_ePBC(gpbc, box);
+    if (gpbc != nullptr && gpbc->mtop != nullptr)
+    {
+        for (i = 0; i < natoms; i++)
+        {
+            copy_rvec(x[i], x_s[i]);
+        }
+        gmx_rmpbc_molecules(gpbc, ePBC, natoms, box, x_s);
+        return;
+    }
     gr   = gmx_rmpbc_get_graph(gpbc, ePBC, natoms);
     if (gr != nullptr)
     {
@@ -211,6 +342,11 @@ void gmx_rmpbc_trxfr(gmx_rmpbc_t gpbc, t_trxframe *fr)
     if (fr->bX && fr->bBox)
     {
         ePBC = gmx_rmpbc_ePBC(gpbc, fr->box);
+        if (gpbc != nullptr && gpbc->mtop != nullptr)
+        {
+            gmx_rmpbc_molecules(gpbc, ePBC, fr->natoms, fr->box, fr->x);
+            return;
+        }
         gr   = gmx_rmpbc_get_graph(gpbc, ePBC, fr->natoms);
         if (gr != nullptr)
         {
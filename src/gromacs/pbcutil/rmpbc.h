@@ -43,6 +43,7 @@
 extern "C" {
 #endif
 
+struct gmx_mtop_t;
 struct t_atoms;
 struct t_idef;
 struct t_trxframe;
@@ -51,6 +52,13 @@ typedef struct gmx_rmpbc *gmx_rmpbc_t;
 
 gmx_rmpbc_t gmx_rmpbc_init(const t_idef *idef, int ePBC, int natoms);
 
+gmx_rmpbc_t gmx_rmpbc_init_mtop(const struct gmx_mtop_t *mtop, int ePBC, int natoms);
+/* As gmx_rmpbc_init, but makes each molecule whole with the connection
+ * graph of its molecule type, so the topology does not need to be
+ * expanded to a t_idef for the whole system. mtop should not have
+ * intermolecular interactions and should outlive the returned struct.
+ */
+
 void gmx_rmpbc_done(gmx_rmpbc_t gpbc);
 
 void gmx_rmpbc(gmx_rmpbc_t gpbc, int natoms, const matrix box, rvec x[]);
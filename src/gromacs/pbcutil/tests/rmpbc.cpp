@@ -0,0 +1,189 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider code quality and stability a valuable goal for you.
+ *
+ * Contact: gromacs@gromacs.org
+ * Visit: http://www.gromacs.org
+ */
+/*! \internal \file
+ * \brief
+ * Tests for making molecules whole with gmx_rmpbc
+ *
+ * The graphs per molecule type of gmx_rmpbc_init_mtop() should give
+ * the same result as the graph of the whole system.
+ *
+ * \ingroup module_pbcutil
+ */
+#include "gmxpre.h"
+
+#include "gromacs/pbcutil/rmpbc.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/tpxio.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/math/vectypes.h"
+#include "gromacs/mdtypes/inputrec.h"
+#include "gromacs/mdtypes/state.h"
+#include "gromacs/pbcutil/pbc.h"
+#include "gromacs/topology/mtop_util.h"
+#include "gromacs/topology/topology.h"
+
+#include "testutils/testasserts.h"
+#include "testutils/testfilemanager.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+/*! \brief Test fixture for gmx_rmpbc
+ *
+ * multiblock.tpr has 160 emim, 160 tfsi and 20 CO2 molecules,
+ * in three molecule blocks.
+ */
+class RmpbcTest : public ::testing::Test
+{
+    public:
+        RmpbcTest()
+        {
+            TestFileManager fileManager;
+            read_tpx_state(fileManager.getInputFilePath("multiblock.tpr").c_str(),
+                           &ir_, &state_, &mtop_);
+            top_ = gmx_mtop_t_to_t_topology(&mtop_, false);
+        }
+        ~RmpbcTest()
+        {
+            done_top_mtop(&top_, &mtop_);
+        }
+
+        /*! \brief Returns the coordinates translated for \p frame and put in the box
+         *
+         * This breaks molecules over the periodic boundaries, differently
+         * for each frame.
+         */
+        std::vector<RVec> brokenFrame(int frame)
+        {
+            std::vector<RVec> x(state_.x.begin(), state_.x.begin() + mtop_.natoms);
+            for (RVec &xi : x)
+            {
+                xi[XX] += 0.37*frame;
+                xi[YY] += 0.53*frame;
+                xi[ZZ] += 0.71*frame;
+            }
+            put_atoms_in_box(ir_.ePBC, state_.box, mtop_.natoms, as_rvec_array(x.data()));
+            return x;
+        }
+
+        //! Returns the number of atoms before molecule \p mol of block \p mb
+        int firstAtom(int mb, int mol)
+        {
+            int at = 0;
+            for (int b = 0; b < mb; b++)
+            {
+                at += mtop_.molblock[b].nmol*mtop_.molblock[b].natoms_mol;
+            }
+            return at + mol*mtop_.molblock[mb].natoms_mol;
+        }
+
+        /*! \brief Expects the same result from both initializations of gmx_rmpbc
+         *
+         * Frame f uses the first \p natoms[f] atoms, so the coordinates
+         * can end inside a molecule.
+         */
+        void compareWithGlobalGraph(const std::vector<int> &natoms)
+        {
+            gmx_rmpbc_t ref       = gmx_rmpbc_init(&top_.idef, ir_.ePBC, top_.atoms.nr);
+            gmx_rmpbc_t test      = gmx_rmpbc_init_mtop(&mtop_, ir_.ePBC, mtop_.natoms);
+            int         numMoved  = 0;
+            for (size_t frame = 0; frame < natoms.size(); frame++)
+            {
+                std::vector<RVec> broken = brokenFrame(frame);
+                std::vector<RVec> xRef(broken), xTest(broken);
+                gmx_rmpbc(ref, natoms[frame], state_.box, as_rvec_array(xRef.data()));
+                if (frame % 2 == 0)
+                {
+                    gmx_rmpbc(test, natoms[frame], state_.box, as_rvec_array(xTest.data()));
+                }
+                else
+                {
+                    gmx_rmpbc_copy(test, natoms[frame], state_.box,
+                                   as_rvec_array(broken.data()), as_rvec_array(xTest.data()));
+                }
+                for (int i = 0; i < mtop_.natoms; i++)
+                {
+                    for (int d = 0; d < DIM; d++)
+                    {
+                        EXPECT_REAL_EQ_TOL(xRef[i][d], xTest[i][d], defaultRealTolerance())
+                        << "frame " << frame << " atom " << i << " dimension " << d;
+                        if (i >= natoms[frame])
+                        {
+                            EXPECT_EQ(broken[i][d], xTest[i][d]) << "atom " << i << " beyond the frame was changed";
+                        }
+                        else if (xTest[i][d] != broken[i][d])
+                        {
+                            numMoved++;
+                        }
+                    }
+                }
+            }
+            /* Check that there were broken molecules to make whole */
+            EXPECT_GT(numMoved, 0);
+            gmx_rmpbc_done(ref);
+            gmx_rmpbc_done(test);
+        }
+
+        t_inputrec ir_;
+        t_state    state_;
+        gmx_mtop_t mtop_;
+        t_topology top_;
+};
+
+TEST_F(RmpbcTest, MoleculeGraphsMatchGlobalGraph)
+{
+    ASSERT_EQ(3, mtop_.nmolblock);
+    compareWithGlobalGraph({ mtop_.natoms, mtop_.natoms, mtop_.natoms });
+}
+
+TEST_F(RmpbcTest, MoleculeGraphsMatchGlobalGraphForFewerAtoms)
+{
+    ASSERT_EQ(3, mtop_.nmolblock);
+    /* The graph of the whole system does not allow frames that end
+     * inside a bonded molecule, so end at molecules in each block,
+     * changing the number of atoms between frames.
+     */
+    const int inFirstBlock  = firstAtom(0, 100);
+    const int inSecondBlock = firstAtom(1, 3);
+    const int inThirdBlock  = firstAtom(2, 5);
+    compareWithGlobalGraph({ inSecondBlock, inSecondBlock, inFirstBlock, inThirdBlock, inSecondBlock });
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -180,9 +180,13 @@ TrajectoryAnalysisRunnerCommon::Impl::initTopology(bool required)
     // Load the topology if requested.
     if (!topfile_.empty())
     {
+        // Only read the coordinates when they are used, they are the
+        // largest part of a tpr file.
+        const bool needTopX = (!hasTrajectory()
+                               || settings_.hasFlag(TrajectoryAnalysisSettings::efUseTopX));
         snew(topInfo_.mtop_, 1);
         readConfAndTopology(topfile_.c_str(), &topInfo_.bTop_, topInfo_.mtop_,
-                            &topInfo_.ePBC_, &topInfo_.xtop_, nullptr,
+                            &topInfo_.ePBC_, needTopX ? &topInfo_.xtop_ : nullptr, nullptr,
                             topInfo_.boxtop_);
         // TODO: Only load this here if the tool actually needs it; selections
         // take care of themselves.
@@ -195,12 +199,6 @@ TrajectoryAnalysisRunnerCommon::Impl::initTopology(bool required)
                 atomsSetMassesBasedOnNames(&moltype.atoms, FALSE);
             }
         }
-        if (hasTrajectory()
-            && !settings_.hasFlag(TrajectoryAnalysisSettings::efUseTopX))
-        {
-            sfree(topInfo_.xtop_);
-            topInfo_.xtop_ = nullptr;
-        }
     }
 }
 
@@ -231,7 +229,7 @@ TrajectoryAnalysisRunnerCommon::Impl::initFirstFrame()
 
         if (topInfo_.hasTopology())
         {
-            const int topologyAtomCount = topInfo_.topology()->atoms.nr;
+            const int topologyAtomCount = topInfo_.mtop()->natoms;
             if (fr->natoms > topologyAtomCount)
             {
                 const std::string message
@@ -253,7 +251,7 @@ TrajectoryAnalysisRunnerCommon::Impl::initFirstFrame()
         {
             GMX_THROW(InvalidInputError("Forces cannot be read from a topology"));
         }
-        fr->natoms = topInfo_.topology()->atoms.nr;
+        fr->natoms = topInfo_.mtop()->natoms;
         fr->bX     = TRUE;
         snew(fr->x, fr->natoms);
         memcpy(fr->x, topInfo_.xtop_,
@@ -265,8 +263,18 @@ TrajectoryAnalysisRunnerCommon::Impl::initFirstFrame()
     set_trxframe_ePBC(fr, topInfo_.ePBC());
     if (topInfo_.hasTopology() && settings_.hasRmPBC())
     {
-        gpbc_ = gmx_rmpbc_init(&topInfo_.topology()->idef, topInfo_.ePBC(),
-                               fr->natoms);
+        // Making molecules whole per molecule type avoids expanding
+        // the topology, which only modules that need it do.
+        if (topInfo_.mtop()->bIntermolecularInteractions)
+        {
+            gpbc_ = gmx_rmpbc_init(&topInfo_.topology()->idef, topInfo_.ePBC(),
+                                   fr->natoms);
+        }
+        else
+        {
+            gpbc_ = gmx_rmpbc_init_mtop(topInfo_.mtop(), topInfo_.ePBC(),
+                                        fr->natoms);
+        }
     }
 }
 
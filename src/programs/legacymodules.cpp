@@ -217,6 +217,8 @@ void registerLegacyModules(gmx::CommandLineModuleManager *manager)
                    "Concatenate trajectory files");
     registerModule(manager, &gmx_trjconv, "trjconv",
                    "Convert and manipulates trajectory files");
+    registerModule(manager, &gmx_trjindex, "trjindex",
+                   "Create or update the frame index of a trajectory");
     registerModule(manager, &gmx_trjorder, "trjorder",
                    "Order molecules according to their distance to a group");
     registerModule(manager, &gmx_xpm2ps, "xpm2ps",
@@ -269,6 +271,8 @@ void registerLegacyModules(gmx::CommandLineModuleManager *manager)
                    "Extract dye dynamics from trajectories");
     registerModule(manager, &gmx_dyndom, "dyndom",
                    "Interpolate and extrapolate structure rotations");
+    registerModule(manager, &gmx_enecolumns, "enecolumns",
+                   "Create or update the columnar copy of an energy file");
     registerModule(manager, &gmx_enemat, "enemat",
                    "Extract an energy matrix from an energy file");
     registerModule(manager, &gmx_energy, "energy",
@@ -386,6 +390,7 @@ void registerLegacyModules(gmx::CommandLineModuleManager *manager)
     {
         gmx::CommandLineModuleGroup group =
             manager->addModuleGroup("Processing energies");
+        group.addModule("enecolumns");
         group.addModule("enemat");
         group.addModule("energy");
         group.addModuleWithDescription("mdrun", "(Re)calculate energies for trajectory frames with -rerun");
@@ -398,6 +403,7 @@ void registerLegacyModules(gmx::CommandLineModuleManager *manager)
         group.addModule("sigeps");
         group.addModule("trjcat");
         group.addModule("trjconv");
+        group.addModule("trjindex");
         group.addModule("xpm2ps");
     }
     {
@@ -1129,7 +1129,7 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                                    state, fr->bMolPBC, graph, &f,
                                    &top->idef, shake_vir,
                                    cr, nrnb, wcycle, upd, constr,
-                                   TRUE, bCalcVir);
+                                   TRUE, bCalcVir, ekind, FALSE);
                 wallcycle_start(wcycle, ewcUPDATE);
             }
             else if (graph)
@@ -1370,7 +1370,7 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                                    state, fr->bMolPBC, graph, &f,
                                    &top->idef, tmp_vir,
                                    cr, nrnb, wcycle, upd, constr,
-                                   TRUE, bCalcVir);
+                                   TRUE, bCalcVir, ekind, FALSE);
             }
         }
         /* Box is changed in update() when we do pressure coupling,
@@ -1431,11 +1431,20 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                           ekind, M, upd, etrtPOSITION, cr, constr);
             wallcycle_stop(wcycle, ewcUPDATE);
 
+            /* With leap-frog, the half-step kinetic energy needed by
+             * compute_globals below can be computed during the update.
+             * This condition should match the one for compute_globals.
+             */
+            bool bCalcEkinhInUpdate =
+                (!EI_VV(ir->eI) &&
+                 (bGStat || do_per_step(step+1, nstglobalcomm) ||
+                  (!bFirstStep && bDoReplEx) || bUsingEnsembleRestraints));
+
             update_constraints(fplog, step, &dvdl_constr, ir, mdatoms, state,
                                fr->bMolPBC, graph, &f,
                                &top->idef, shake_vir,
                                cr, nrnb, wcycle, upd, constr,
-                               FALSE, bCalcVir);
+                               FALSE, bCalcVir, ekind, bCalcEkinhInUpdate);
 
             if (ir->eI == eiVVAK)
             {
@@ -1465,7 +1474,7 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
                                    state, fr->bMolPBC, graph, &f,
                                    &top->idef, tmp_vir,
                                    cr, nrnb, wcycle, upd, nullptr,
-                                   FALSE, bCalcVir);
+                                   FALSE, bCalcVir, ekind, FALSE);
             }
             if (EI_VV(ir->eI))
             {
@@ -1524,7 +1533,27 @@ double gmx::do_md(FILE *fplog, t_commrec *cr, const gmx::MDLogger &mdlog,
             // and when algorithms require it.
             bool doInterSimSignal = (!bFirstStep && bDoReplEx) || bUsingEnsembleRestraints;
 
-            if (bGStat || (!EI_VV(ir->eI) && do_per_step(step+1, nstglobalcomm)) || doInterSimSignal)
+            bool doComputeGlobals;
+            if (EI_VV(ir->eI) && !bRerunMD)
+            {
+                /* With VV the kinetic energy and COM motion were already
+                 * reduced in the first half of the step. But the constraint
+                 * virial of the second half is needed for the full-step
+                 * pressure on virial and pressure coupling steps, so we can
+                 * only skip the second reduction on steps without virial
+                 * and COM motion removal.
+                 */
+                doComputeGlobals = (bCalcVir || bStopCM ||
+                                    do_per_step(step, nstglobalcomm) ||
+                                    shouldCheckNumberOfBondedInteractions ||
+                                    doInterSimSignal);
+            }
+            else
+            {
+                doComputeGlobals = (bGStat || (!EI_VV(ir->eI) && do_per_step(step+1, nstglobalcomm)) || doInterSimSignal);
+            }
+
+            if (doComputeGlobals)
             {
                 // Since we're already communicating at this step, we
                 // can propagate intra-simulation signals. Note that
@@ -1394,6 +1394,11 @@ int mdrunner(gmx_hw_opt_t *hw_opt,
                                      Flags,
                                      walltime_accounting);
 
+        if (DOMAINDECOMP(cr))
+        {
+            dd_finish_collect(cr->dd);
+        }
+
         if (inputrec->bRot)
         {
             finish_rot(inputrec->rot);
@@ -0,0 +1,299 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ * \brief
+ * Tests for writing checkpoints in parts with domain decomposition
+ *
+ * With GMX_CHECKPOINT_PARTS set, each domain decomposition rank writes
+ * its home atoms to a separate file, which are combined on reading.
+ *
+ * \ingroup module_mdrun_integration_tests
+ */
+#include "gmxpre.h"
+
+#include "config.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/fileio/checkpoint.h"
+#include "gromacs/fileio/confio.h"
+#include "gromacs/fileio/gmxfio.h"
+#include "gromacs/math/vec.h"
+#include "gromacs/topology/topology.h"
+#include "gromacs/trajectory/trajectoryframe.h"
+#include "gromacs/utility/path.h"
+#include "gromacs/utility/smalloc.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/cmdlinetest.h"
+#include "testutils/mpitest.h"
+
+#include "moduletest.h"
+#include "trajectoryreader.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+#if GMX_THREAD_MPI && !GMX_NATIVE_WINDOWS
+
+//! Test fixture for checkpoints written in parts
+class CheckpointPartsTest : public MdrunTestFixture
+{
+    public:
+        CheckpointPartsTest()
+        {
+            setenv("GMX_CHECKPOINT_PARTS", "1", 1);
+        }
+        ~CheckpointPartsTest()
+        {
+            unsetenv("GMX_CHECKPOINT_PARTS");
+        }
+
+        //! Returns the name of \p part of the checkpoint at \p step, registered for clean-up
+        std::string partFileName(int step, int part)
+        {
+            return fileManager_.getTemporaryFilePath(formatString("step%d_part%d.cpt", step, part));
+        }
+
+        /*! \brief Reads the last frame of \p filename into \p frame
+         *
+         * Returns the number of frames in the file.
+         */
+        int readLastFrame(const std::string &filename, t_trxframe *frame)
+        {
+            TrajectoryFrameReader reader(filename);
+            int                   numFrames = 0;
+            while (reader.readNextFrame())
+            {
+                const t_trxframe *fr = reader.frame().frame_;
+                if (frame->x == nullptr)
+                {
+                    frame->natoms = fr->natoms;
+                    snew(frame->x, frame->natoms);
+                    snew(frame->v, frame->natoms);
+                }
+                EXPECT_EQ(frame->natoms, fr->natoms);
+                frame->step   = fr->step;
+                copy_mat(fr->box, frame->box);
+                frame->bV     = fr->bV;
+                for (int i = 0; i < fr->natoms; i++)
+                {
+                    copy_rvec(fr->x[i], frame->x[i]);
+                    if (fr->bV)
+                    {
+                        copy_rvec(fr->v[i], frame->v[i]);
+                    }
+                }
+                numFrames++;
+            }
+            return numFrames;
+        }
+
+        //! Reads the checkpoint, combining its parts, into \p frame
+        void readCheckpoint(t_trxframe *frame)
+        {
+            t_fileio *fio = gmx_fio_open(runner_.cptFileName_.c_str(), "r");
+            read_checkpoint_trxframe(fio, frame);
+            gmx_fio_close(fio);
+        }
+
+        //! Reads x and v of the final configuration \p filename into \p frame
+        void readConfout(const std::string &filename, t_trxframe *frame)
+        {
+            t_topology top;
+            int        ePBC;
+
+            read_tps_conf(filename.c_str(), &top, &ePBC, &frame->x, &frame->v, frame->box, FALSE);
+            frame->natoms = top.atoms.nr;
+            frame->bV     = (frame->v != nullptr);
+            done_top(&top);
+        }
+
+        /*! \brief Expects x and v of \p test to match \p ref within \p tolerance
+         *
+         * With \p bWhole the positions may differ by rectangular box
+         * vectors of \p ref, as molecules can be made whole.
+         */
+        void compareCoordinatesAndVelocities(const t_trxframe &ref, const t_trxframe &test,
+                                             real tolerance, bool bWhole = false)
+        {
+            ASSERT_EQ(ref.natoms, test.natoms);
+            ASSERT_TRUE(test.bV);
+            for (int i = 0; i < ref.natoms; i++)
+            {
+                for (int d = 0; d < DIM; d++)
+                {
+                    real dx = test.x[i][d] - ref.x[i][d];
+                    if (bWhole)
+                    {
+                        dx -= ref.box[d][d]*std::round(dx/ref.box[d][d]);
+                    }
+                    EXPECT_NEAR(0, dx, tolerance) << "x of atom " << i;
+                    EXPECT_NEAR(ref.v[i][d], test.v[i][d], tolerance) << "v of atom " << i;
+                }
+            }
+        }
+};
+
+TEST_F(CheckpointPartsTest, PartsCombineToTheWrittenState)
+{
+    if (getNumberOfTestMpiRanks() != 2)
+    {
+        return;
+    }
+    runner_.useStringAsMdpFile("integrator = md\n"
+                               "cutoff-scheme = Verlet\n"
+                               "coulombtype = PME\n"
+                               "rcoulomb = 0.7\n"
+                               "rvdw = 0.7\n"
+                               "nsteps = 10\n"
+                               "nstxout = 10\n"
+                               "nstvout = 10\n"
+                               "nstcalcenergy = 10\n"
+                               "nstenergy = 10\n");
+    runner_.useTopGroAndNdxFromDatabase("spc216");
+    ASSERT_EQ(0, runner_.callGrompp());
+
+    runner_.fullPrecisionTrajectoryFileName_ = fileManager_.getTemporaryFilePath(".trr");
+    runner_.cptFileName_                     = fileManager_.getTemporaryFilePath(".cpt");
+    std::string confout                      = fileManager_.getTemporaryFilePath("state.gro");
+    fileManager_.getTemporaryFilePath(".trr.fidx");
+    fileManager_.getTemporaryFilePath("prev.cpt");
+
+    /* Two domains, each writing its own part of the last checkpoint */
+    CommandLine firstRun;
+    firstRun.addOption("-cpo", runner_.cptFileName_);
+    firstRun.addOption("-npme", 0);
+    ASSERT_EQ(0, runner_.callMdrun(firstRun));
+    for (int part = 0; part < 2; part++)
+    {
+        EXPECT_TRUE(File::exists(partFileName(10, part), File::returnFalseOnError));
+    }
+
+    t_trxframe last;
+    clear_trxframe(&last, TRUE);
+    ASSERT_EQ(2, readLastFrame(runner_.fullPrecisionTrajectoryFileName_, &last));
+    ASSERT_EQ(10, last.step);
+
+    /* The final configuration is written at the last checkpoint */
+    t_trxframe conf;
+    clear_trxframe(&conf, TRUE);
+    readConfout(confout, &conf);
+    compareCoordinatesAndVelocities(last, conf, 0.001, true);
+    sfree(conf.x);
+    sfree(conf.v);
+
+    /* Reading in a single process combines the parts */
+    t_trxframe cpt;
+    clear_trxframe(&cpt, TRUE);
+    readCheckpoint(&cpt);
+    EXPECT_EQ(10, cpt.step);
+    compareCoordinatesAndVelocities(last, cpt, 1e-6);
+
+    /* Files of an earlier run with more ranks should be removed,
+     * the parts of the checkpoint we continue from should stay.
+     */
+    for (const std::string &stale : { partFileName(5, 0), partFileName(5, 3) })
+    {
+        FILE *fp = std::fopen(stale.c_str(), "w");
+        ASSERT_NE(nullptr, fp);
+        std::fclose(fp);
+    }
+
+    /* Continue with one PP rank and one PME rank, so a single
+     * rank reads the parts written by two. Without appending,
+     * mdrun adds the simulation part to the output file names.
+     */
+    runner_.fullPrecisionTrajectoryFileName_ = fileManager_.getTemporaryFilePath("continuation.trr");
+    std::string continuation                 = fileManager_.getTemporaryFilePath("continuation.part0002.trr");
+    std::string continuationConfout          = fileManager_.getTemporaryFilePath("state.part0002.gro");
+    for (const char *name : { "continuation.part0002.trr.fidx", ".part0002.log", ".part0002.edr" })
+    {
+        fileManager_.getTemporaryFilePath(name);
+    }
+    CommandLine secondRun;
+    secondRun.addOption("-cpi", runner_.cptFileName_);
+    secondRun.addOption("-cpo", runner_.cptFileName_);
+    secondRun.addOption("-npme", 1);
+    secondRun.append("-noappend");
+    secondRun.addOption("-nsteps", 15);
+    ASSERT_EQ(0, runner_.callMdrun(secondRun));
+
+    EXPECT_FALSE(File::exists(partFileName(5, 0), File::returnFalseOnError));
+    EXPECT_FALSE(File::exists(partFileName(5, 3), File::returnFalseOnError));
+    EXPECT_TRUE(File::exists(partFileName(10, 0), File::returnFalseOnError));
+    EXPECT_TRUE(File::exists(partFileName(25, 0), File::returnFalseOnError));
+
+    TrajectoryFrameReader reader(continuation);
+    ASSERT_TRUE(reader.readNextFrame());
+    const t_trxframe *first = reader.frame().frame_;
+    EXPECT_EQ(10, first->step);
+    compareCoordinatesAndVelocities(last, *first, 1e-6);
+
+    /* The continuation ends at step 25, where no trajectory frame
+     * collects x and v, so the final configuration has to collect them.
+     */
+    t_trxframe end;
+    clear_trxframe(&end, TRUE);
+    readCheckpoint(&end);
+    EXPECT_EQ(25, end.step);
+    t_trxframe endConf;
+    clear_trxframe(&endConf, TRUE);
+    readConfout(continuationConfout, &endConf);
+    compareCoordinatesAndVelocities(end, endConf, 0.001, true);
+
+    for (t_trxframe *fr : { &last, &cpt, &end, &endConf })
+    {
+        sfree(fr->x);
+        sfree(fr->v);
+    }
+}
+
+#endif
+
+} // namespace
+} // namespace test
+} // namespace gmx
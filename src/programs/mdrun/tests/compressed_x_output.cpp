@@ -48,10 +48,12 @@
 
 #include "gromacs/options/filenameoption.h"
 #include "gromacs/tools/check.h"
+#include "gromacs/trajectory/trajectoryframe.h"
 
 #include "testutils/cmdlinetest.h"
 
 #include "moduletest.h"
+#include "trajectoryreader.h"
 
 namespace
 {
@@ -86,6 +88,74 @@ TEST_P(MdrunCompressedXOutput, ExitsNormally)
     ASSERT_EQ(0, gmx_check(checkCaller.argc(), checkCaller.argv()));
 }
 
+/* The TRR, XTC and additional XTC stream frames of a step are queued
+ * after each other for the output thread, which holds two frames, so
+ * the frame buffers are reused for frames with different numbers of
+ * atoms. All of them should be written correctly.
+ */
+TEST_F(MdrunCompressedXOutputTest, FramesWithDifferentAtomCountsAreWritten)
+{
+    runner_.useStringAsMdpFile("cutoff-scheme = Group\n"
+                               "nsteps = 4\n"
+                               "nstxout = 1\n"
+                               "nstvout = 1\n"
+                               "nstxout-compressed = 1\n"
+                               "compressed-x-grps = SecondWaterMolecule\n"
+                               "compressed-x-streams = 1\n"
+                               "compressed-x-stream1-grps = System\n"
+                               "compressed-x-stream1-nstxout = 1\n"
+                               "compressed-x-stream1-precision = 100\n");
+    runner_.useTopGroAndNdxFromDatabase("spc2");
+    ASSERT_EQ(0, runner_.callGrompp());
+
+    runner_.fullPrecisionTrajectoryFileName_    = fileManager_.getTemporaryFilePath(".trr");
+    runner_.reducedPrecisionTrajectoryFileName_ = fileManager_.getTemporaryFilePath(".xtc");
+    /* mdrun names the stream file after the compressed trajectory,
+     * and writes frame indices that should also be cleaned up.
+     */
+    std::string streamFileName                  = fileManager_.getTemporaryFilePath("stream1.xtc");
+    for (const char *index : { ".trr.fidx", ".xtc.fidx", "stream1.xtc.fidx" })
+    {
+        fileManager_.getTemporaryFilePath(index);
+    }
+    ASSERT_EQ(0, runner_.callMdrun());
+
+    gmx::test::TrajectoryFrameReader trrReader(runner_.fullPrecisionTrajectoryFileName_);
+    gmx::test::TrajectoryFrameReader xtcReader(runner_.reducedPrecisionTrajectoryFileName_);
+    gmx::test::TrajectoryFrameReader streamReader(streamFileName);
+    int                              numFrames = 0;
+    while (trrReader.readNextFrame())
+    {
+        const t_trxframe *trr = trrReader.frame().frame_;
+        ASSERT_TRUE(xtcReader.readNextFrame());
+        const t_trxframe *xtc = xtcReader.frame().frame_;
+        ASSERT_TRUE(streamReader.readNextFrame());
+        const t_trxframe *stream = streamReader.frame().frame_;
+
+        ASSERT_EQ(6, trr->natoms);
+        ASSERT_TRUE(trr->bV);
+        ASSERT_EQ(3, xtc->natoms);
+        ASSERT_EQ(6, stream->natoms);
+        EXPECT_EQ(trr->step, xtc->step);
+        EXPECT_EQ(trr->step, stream->step);
+        for (int i = 0; i < trr->natoms; i++)
+        {
+            for (int d = 0; d < DIM; d++)
+            {
+                if (i >= 3)
+                {
+                    EXPECT_NEAR(trr->x[i][d], xtc->x[i - 3][d], 0.0005);
+                }
+                EXPECT_NEAR(trr->x[i][d], stream->x[i][d], 0.005);
+            }
+        }
+        numFrames++;
+    }
+    EXPECT_FALSE(xtcReader.readNextFrame());
+    EXPECT_FALSE(streamReader.readNextFrame());
+    EXPECT_EQ(5, numFrames);
+}
+
 INSTANTIATE_TEST_CASE_P(WithDifferentOutputGroupSettings, MdrunCompressedXOutput,
                             ::testing::Values
                             ( // Test writing the whole system via
@@ -42,13 +42,21 @@
  */
 #include "gmxpre.h"
 
+#include "config.h"
+
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
+#include "gromacs/utility/basenetwork.h"
+#include "gromacs/utility/textreader.h"
+
 #include "testutils/cmdlinetest.h"
+#include "testutils/mpitest.h"
 
 #include "moduletest.h"
+#include "scopedenvironment.h"
 
 namespace
 {
@@ -74,4 +82,33 @@ TEST_F(DomainDecompositionSpecialCasesTest, AnEmptyDomainWorks)
     ASSERT_EQ(0, runner_.callMdrun());
 }
 
+#if !GMX_NATIVE_WINDOWS && !GMX_DOUBLE
+//! Checks that halo coordinate compression is used with a typical decomposition
+TEST_F(DomainDecompositionSpecialCasesTest, HaloCoordinateCompressionTurnsOn)
+{
+    if (gmx::test::getNumberOfTestMpiRanks() < 2)
+    {
+        return;
+    }
+    runner_.useStringAsMdpFile("cutoff-scheme = Verlet\n"
+                               "nsteps = 20\n"
+                               "nstlist = 10\n"
+                               "rcoulomb = 0.7\n"
+                               "rvdw = 0.7\n");
+    runner_.useTopGroAndNdxFromDatabase("spc216");
+    ASSERT_EQ(0, runner_.callGrompp());
+
+    std::vector<gmx::test::ScopedEnvironment::Variable> variables = { { "GMX_DD_COMPRESS_X", "1" } };
+    gmx::test::ScopedEnvironment                        environment(variables);
+    ASSERT_EQ(0, runner_.callMdrun());
+
+    if (gmx_node_rank() == 0)
+    {
+        std::string log = gmx::TextReader::readFileToString(runner_.logFileName_);
+        EXPECT_NE(std::string::npos, log.find("turning on compressed halo coordinate communication"));
+        EXPECT_EQ(std::string::npos, log.find("insufficient precision"));
+    }
+}
+#endif
+
 } // namespace
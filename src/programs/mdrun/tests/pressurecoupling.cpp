@@ -0,0 +1,142 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ * \brief
+ * Tests for pressure coupling with the velocity Verlet integrator
+ *
+ * \ingroup module_mdrun_integration_tests
+ */
+#include "gmxpre.h"
+
+#include <string>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/math/vectypes.h"
+#include "gromacs/utility/real.h"
+#include "gromacs/utility/stringutil.h"
+
+#include "testutils/testasserts.h"
+
+#include "moduletest.h"
+#include "trajectoryreader.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+//! Test fixture for pressure coupling
+class PressureCouplingTest : public MdrunTestFixture
+{
+    public:
+        //! Runs md-vv with Berendsen pressure coupling and SETTLE with \p nstcalcenergy, returns the trajectory file name
+        std::string runWithNstcalcenergy(int nstcalcenergy)
+        {
+            runner_.useStringAsMdpFile(formatString("integrator = md-vv\n"
+                                                    "dt = 0.002\n"
+                                                    "nsteps = 20\n"
+                                                    "nstcalcenergy = %d\n"
+                                                    "nstenergy = 20\n"
+                                                    "nstxout = 5\n"
+                                                    "nstvout = 5\n"
+                                                    "cutoff-scheme = Verlet\n"
+                                                    "rcoulomb = 0.7\n"
+                                                    "rvdw = 0.7\n"
+                                                    "tcoupl = no\n"
+                                                    "pcoupl = berendsen\n"
+                                                    "nstpcouple = 5\n"
+                                                    "tau-p = 0.5\n"
+                                                    "ref-p = 1\n"
+                                                    "compressibility = 4.5e-5\n", nstcalcenergy));
+            runner_.tprFileName_                     = fileManager_.getTemporaryFilePath(formatString("nstcalcenergy%d.tpr", nstcalcenergy));
+            runner_.fullPrecisionTrajectoryFileName_ = fileManager_.getTemporaryFilePath(formatString("nstcalcenergy%d.trr", nstcalcenergy));
+            runner_.useTopGroAndNdxFromDatabase("spc216");
+            EXPECT_EQ(0, runner_.callGrompp());
+            EXPECT_EQ(0, runner_.callMdrun());
+
+            return runner_.fullPrecisionTrajectoryFileName_;
+        }
+};
+
+/* Pressure coupling steps that are not energy calculation steps
+ * should use the same full-step pressure as energy steps do,
+ * so the box and the coordinates should not depend on nstcalcenergy.
+ * Without temperature coupling the trajectories agree closely over
+ * a few pressure coupling intervals.
+ */
+TEST_F(PressureCouplingTest, VelocityVerletBerendsenDoesNotDependOnNstcalcenergy)
+{
+    std::string            trrEveryPcoupleStep = runWithNstcalcenergy(5);
+    std::string            trrEnergyOnLastStep = runWithNstcalcenergy(20);
+
+    TrajectoryFrameReader  ref(trrEveryPcoupleStep);
+    TrajectoryFrameReader  test(trrEnergyOnLastStep);
+    FloatingPointTolerance tolerance(relativeToleranceAsFloatingPoint(1, 1e-5));
+    int                    numFrames  = 0;
+    real                   boxXXStart = 0, boxXXEnd = 0;
+    while (ref.readNextFrame())
+    {
+        ASSERT_TRUE(test.readNextFrame());
+        auto frames = std::make_pair(ref.frame(), test.frame());
+        compareFrames(frames, tolerance);
+        if (numFrames == 0)
+        {
+            boxXXStart = frames.first.frame_->box[XX][XX];
+        }
+        boxXXEnd = frames.first.frame_->box[XX][XX];
+        for (int d1 = 0; d1 < DIM; d1++)
+        {
+            for (int d2 = 0; d2 < DIM; d2++)
+            {
+                EXPECT_REAL_EQ_TOL(frames.first.frame_->box[d1][d2], frames.second.frame_->box[d1][d2], tolerance)
+                << "box element " << d1 << " " << d2 << " in " << frames.first.getFrameName();
+            }
+        }
+        numFrames++;
+    }
+    EXPECT_FALSE(test.readNextFrame());
+    EXPECT_EQ(5, numFrames);
+    /* Check that the pressure coupling did scale the box */
+    EXPECT_NE(boxXXStart, boxXXEnd);
+}
+
+} // namespace
+} // namespace test
+} // namespace gmx
@@ -0,0 +1,77 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider that scientific software is very special. Version
+ * control is crucial - bugs must be traceable. We will be happy to
+ * consider code for inclusion in the official distribution, but
+ * derived work must not be called official GROMACS. Details are found
+ * in the README & COPYING files - if they are missing, get the
+ * official version at http://www.gromacs.org.
+ *
+ * To help us fund GROMACS development, we humbly ask that you cite
+ * the research papers on the package. Check out http://www.gromacs.org.
+ */
+
+/*! \internal \file
+ * \brief Declares a helper for setting environment variables in mdrun tests
+ *
+ * \ingroup module_mdrun_integration_tests
+ */
+#ifndef GMX_MDRUN_TESTS_SCOPEDENVIRONMENT_H
+#define GMX_MDRUN_TESTS_SCOPEDENVIRONMENT_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gmx
+{
+namespace test
+{
+
+/*! \internal
+ * \brief Sets environment variables for its lifetime
+ *
+ * Several mdrun options are only controlled through the environment.
+ * Not supported on Windows.
+ */
+class ScopedEnvironment
+{
+    public:
+        //! The name and value of an environment variable
+        typedef std::pair<std::string, std::string> Variable;
+
+        //! Sets the \p name=value pairs in \p variables
+        explicit ScopedEnvironment(const std::vector<Variable> &variables);
+        //! Unsets the variables
+        ~ScopedEnvironment();
+
+    private:
+        std::vector<Variable> variables_;
+};
+
+} // namespace test
+} // namespace gmx
+
+#endif
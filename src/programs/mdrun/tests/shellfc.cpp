@@ -0,0 +1,165 @@
+/*
+ * This file is part of the GROMACS molecular simulation package.
+ *
+ * Copyright (c) 2017, by the GROMACS development team, led by
+ * Mark Abraham, David van der Spoel, Berk Hess, and Erik Lindahl,
+ * and including many others, as listed in the AUTHORS file in the
+ * top-level source directory and at http://www.gromacs.org.
+ *
+ * GROMACS is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * GROMACS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GROMACS; if not, see
+ * http://www.gnu.org/licenses, or write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA.
+ *
+ * If you want to redistribute modifications to GROMACS, please
+ * consider code quality and stability a valuable goal for you.
+ *
+ * Contact: gromacs@gromacs.org
+ * Visit: http://www.gromacs.org
+ */
+/*! \internal \file
+ * \brief
+ * Tests for the prediction and relaxation of shell positions
+ *
+ * The history-based predictor and Anderson acceleration should give
+ * the same trajectory as the plain relaxation, up to the shell force
+ * tolerance, with fewer force evaluations.
+ *
+ * \ingroup module_mdrun_integration_tests
+ */
+#include "gmxpre.h"
+
+#include "config.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gromacs/utility/stringutil.h"
+#include "gromacs/utility/textreader.h"
+
+#include "testutils/testasserts.h"
+
+#include "energyreader.h"
+#include "moduletest.h"
+#include "scopedenvironment.h"
+
+namespace gmx
+{
+namespace test
+{
+namespace
+{
+
+#if !GMX_NATIVE_WINDOWS
+
+//! Test fixture for shell relaxation
+class ShellRelaxationTest : public MdrunTestFixture
+{
+    public:
+        /*! \brief Runs mdrun with the environment \p variables
+         *
+         * The log and energy files get names with \p name,
+         * returns the average number of force evaluations per step.
+         */
+        double runWith(const char                                   *name,
+                       const std::vector<ScopedEnvironment::Variable> &variables)
+        {
+            runner_.logFileName_ = fileManager_.getTemporaryFilePath(formatString("%s.log", name));
+            runner_.edrFileName_ = fileManager_.getTemporaryFilePath(formatString("%s.edr", name));
+
+            ScopedEnvironment environment(variables);
+            EXPECT_EQ(0, runner_.callMdrun());
+
+            const std::string log   = TextReader::readFileToString(runner_.logFileName_);
+            const char       *label = "Average number of force evaluations per MD step:";
+            size_t            pos   = log.find(label);
+            EXPECT_NE(std::string::npos, pos) << "Log file of run " << name << " has no shell statistics";
+            if (pos == std::string::npos)
+            {
+                return 0;
+            }
+            return std::strtod(log.c_str() + pos + std::strlen(label), nullptr);
+        }
+
+        //! Compares the energies of all frames of the energy files \p edrRef and \p edrTest
+        void compareEnergies(const std::string &edrRef, const std::string &edrTest)
+        {
+            const std::vector<std::string> names = {
+                "Polarization", "Potential", "Kinetic En.", "Total Energy"
+            };
+            EnergyFrameReaderPtr           ref  = openEnergyFileToReadFields(edrRef, names);
+            EnergyFrameReaderPtr           test = openEnergyFileToReadFields(edrTest, names);
+            /* The shell force tolerance is 0.1, which gives relative
+             * energy differences of about 1e-5.
+             */
+            FloatingPointTolerance         tolerance(relativeToleranceAsFloatingPoint(1e4, 1e-5));
+            int                            numFrames = 0;
+            while (ref->readNextFrame())
+            {
+                ASSERT_TRUE(test->readNextFrame());
+                compareFrames(std::make_pair(ref->frame(), test->frame()), tolerance);
+                numFrames++;
+            }
+            EXPECT_FALSE(test->readNextFrame());
+            EXPECT_GT(numFrames, 10);
+        }
+};
+
+TEST_F(ShellRelaxationTest, PredictionAndAndersonMatchPlainRelaxation)
+{
+    runner_.useStringAsMdpFile("integrator = md\n"
+                               "dt = 0.0005\n"
+                               "nsteps = 20\n"
+                               "cutoff-scheme = group\n"
+                               "coulombtype = PME\n"
+                               "rlist = 0.9\n"
+                               "rcoulomb = 0.9\n"
+                               "rvdw = 0.9\n"
+                               "emtol = 0.1\n"
+                               "niter = 50\n"
+                               "nstcalcenergy = 1\n"
+                               "nstenergy = 1\n"
+                               "gen-vel = yes\n"
+                               "gen-temp = 300\n"
+                               "gen-seed = 1234\n");
+    runner_.useTopGroAndNdxFromDatabase("sw216");
+    ASSERT_EQ(0, runner_.callGrompp());
+
+    double evaluationsPlain     = runWith("plain", { { "GMX_SHELL_PREDICT_ORDER", "-1" } });
+    std::string edrPlain        = runner_.edrFileName_;
+    double evaluationsPredicted = runWith("predicted", {});
+    std::string edrPredicted    = runner_.edrFileName_;
+    double evaluationsAnderson  = runWith("anderson", { { "GMX_SHELL_ANDERSON", "4" } });
+    std::string edrAnderson     = runner_.edrFileName_;
+
+    compareEnergies(edrPlain, edrPredicted);
+    compareEnergies(edrPlain, edrAnderson);
+
+    /* The history predictor is on by default, because it gives
+     * a better initial guess for the relaxation.
+     */
+    EXPECT_LT(evaluationsPredicted, evaluationsPlain);
+    EXPECT_LT(evaluationsAnderson, evaluationsPredicted);
+}
+
+#endif
+
+} // namespace
+} // namespace test
+} // namespace gmx